@@ -13,9 +13,12 @@
 # full license information.
 #*******************************************************************/
 
-if (PNET_OPTION_SNMP)
+if (PNET_OPTION_SNMP AND NOT PNET_OPTION_SNMP_BUILTIN)
+  set(PNET_USE_NETSNMP ON)
   find_package(NetSNMP REQUIRED)
   find_package(NetSNMPAgent REQUIRED)
+else()
+  set(PNET_USE_NETSNMP OFF)
 endif()
 
 target_include_directories(profinet
@@ -29,18 +32,19 @@ target_sources(profinet
   src/ports/linux/pnal_eth.c
   src/ports/linux/pnal_udp.c
   src/ports/linux/pnal_filetools.c
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/pnal_snmp.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/system_mib.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpLocalSystemData.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpLocPortTable.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpConfigManAddrTable.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpLocManAddrTable.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpRemTable.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpRemManAddrTable.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpXdot3LocPortTable.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpXdot3RemPortTable.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpXPnoLocTable.c>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:src/ports/linux/mib/lldpXPnoRemTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/pnal_snmp.c>
+  $<$<BOOL:${PNET_OPTION_SNMP_BUILTIN}>:src/ports/linux/pnal_snmp_builtin.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/system_mib.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpLocalSystemData.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpLocPortTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpConfigManAddrTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpLocManAddrTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpRemTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpRemManAddrTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpXdot3LocPortTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpXdot3RemPortTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpXPnoLocTable.c>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:src/ports/linux/mib/lldpXPnoRemTable.c>
   )
 
 target_compile_options(profinet
@@ -57,8 +61,8 @@ target_compile_options(profinet
 
 target_link_libraries(profinet
   PUBLIC
-  $<$<BOOL:${PNET_OPTION_SNMP}>:NetSNMP::NetSNMPAgent>
-  $<$<BOOL:${PNET_OPTION_SNMP}>:NetSNMP::NetSNMP>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:NetSNMP::NetSNMPAgent>
+  $<$<BOOL:${PNET_USE_NETSNMP}>:NetSNMP::NetSNMP>
   INTERFACE
   $<$<CONFIG:Coverage>:--coverage>
   )
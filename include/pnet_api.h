@@ -730,6 +730,13 @@ typedef int (*pnet_state_ind) (
    uint32_t arep,
    pnet_event_values_t state);
 
+/**
+ * Return value from \a pnet_read_ind() and \a pnet_write_ind() when the
+ * application will respond later, via \a pnet_read_record_rsp() or
+ * \a pnet_write_record_rsp().
+ */
+#define PNET_RECORD_RSP_PENDING 1
+
 /**
  * Indication to the application that an IODRead request was received from the
  * controller.
@@ -754,6 +761,15 @@ typedef int (*pnet_state_ind) (
  * the number of bytes it expects to receive, just the maximum number of
  * bytes it is able to handle.
  *
+ * If the data is not immediately available, the application may return
+ * \a PNET_RECORD_RSP_PENDING. The stack then keeps the request and does not
+ * respond to the controller until the application calls
+ * \a pnet_read_record_rsp(). Cyclic data exchange continues meanwhile.
+ * This is not supported for implicit reads (Read Implicit requests sent
+ * outside of the AR, for example by engineering tools), which are rejected
+ * with PNET_ERROR_CODE_1_RES_RESOURCE_BUSY if the application returns
+ * \a PNET_RECORD_RSP_PENDING.
+ *
  * @param net              InOut: The p-net stack instance
  * @param arg              InOut: User-defined data (not used by p-net)
  * @param arep             In:    The AREP.
@@ -768,6 +784,7 @@ typedef int (*pnet_state_ind) (
  * @param p_result         Out:   Detailed error information if returning != 0
  * @return  0  on success.
  *          -1 if an error occurred.
+ *          PNET_RECORD_RSP_PENDING if the response is given later.
  */
 typedef int (*pnet_read_ind) (
    pnet_t * net,
@@ -801,6 +818,13 @@ typedef int (*pnet_read_ind) (
  * In case of error the application should provide error information in \a
  * p_result.
  *
+ * If the write can not be completed immediately, the application may copy
+ * the data and return \a PNET_RECORD_RSP_PENDING. The stack then keeps the
+ * request and does not respond to the controller until the application calls
+ * \a pnet_write_record_rsp(). This is not supported for records that are
+ * part of a multiple write request, which are rejected with
+ * PNET_ERROR_CODE_1_RES_RESOURCE_BUSY.
+ *
  * @param net              InOut: The p-net stack instance
  * @param arg              InOut: User-defined data (not used by p-net)
  * @param arep             In:    The AREP.
@@ -814,6 +838,7 @@ typedef int (*pnet_read_ind) (
  * @param p_result         Out:   Detailed error information if returning != 0
  * @return  0  on success.
  *          -1 if an error occurred.
+ *          PNET_RECORD_RSP_PENDING if the response is given later.
  */
 typedef int (*pnet_write_ind) (
    pnet_t * net,
@@ -1383,6 +1408,47 @@ typedef struct pnet_cfg
    /** Send diagnosis in the qualified format (otherwise extended format) */
    bool use_qualified_diagnosis;
 
+   /** Rate limit for diagnosis alarms, per AR. Max number of diagnosis alarms
+    *  sent per second, once a burst of diag_alarm_burst alarms has been sent.
+    *  Alarms waiting due to the limit are merged with newer alarms for the
+    *  same diagnosis. Use 0 for no rate limit. */
+   uint16_t diag_alarm_rate;
+
+   /** Max number of diagnosis alarms sent in a burst, when diag_alarm_rate is
+    *  used. Use 0 for the same value as diag_alarm_rate. */
+   uint16_t diag_alarm_burst;
+
+   /** Max number of incoming alarm frames handled per AR and priority, in each
+    *  call to pnet_handle_periodic(). Use 0 for no limit. */
+   uint16_t alarm_receive_budget;
+
+   /** Max number of alarms sent per AR in each call to pnet_handle_periodic().
+    *  High and low priority alarms are sent independently of each other, so
+    *  with a value of 2 or more a low priority alarm can be sent in the same
+    *  call as a high priority alarm. Use 0 for one alarm per call. */
+   uint16_t alarm_send_budget;
+
+   /** Number of diagnosis items in the pool shared by all subslots. Allocated
+    *  at init. Max 65534. Use 0 for the default PNET_MAX_DIAG_ITEMS. */
+   uint16_t max_diag_items;
+
+   /** Number of alarms in each alarm queue (one send and one receive queue
+    *  per alarm priority and AR). Allocated at init. Max 32767. Use 0 for the
+    *  default PNET_MAX_ALARMS. */
+   uint16_t max_alarms;
+
+   /** Rate limit for incoming DCP requests. Max number of DCP Identify, Get
+    *  and Set requests handled per second, for each of the three services.
+    *  Additional requests are dropped. Use 0 for no rate limit. */
+   uint16_t dcp_rate_limit;
+
+   /** Rate limit for incoming DCP requests from each source MAC address. Max
+    *  number of DCP Identify, Get and Set requests handled per second from a
+    *  single source. Additional requests are dropped. Only the most recent
+    *  sources are tracked, and requests from other sources are limited by
+    *  dcp_rate_limit only. Use 0 for no rate limit. */
+   uint16_t dcp_source_rate_limit;
+
    pnet_if_cfg_t if_cfg;
 
 #if PNET_OPTION_DRIVER_ENABLE
@@ -1730,6 +1796,54 @@ PNET_EXPORT int pnet_set_redundancy_state (pnet_t * net, bool redundant);
  */
 PNET_EXPORT int pnet_set_provider_state (pnet_t * net, bool run);
 
+/**
+ * Application delivers the response to a deferred IODRead request.
+ *
+ * Use this after returning \a PNET_RECORD_RSP_PENDING from the
+ * \a pnet_read_ind() user callback. The response is sent to the controller
+ * before this function returns, so \a p_read_data only needs to be valid
+ * during the call.
+ *
+ * Must be called from the same thread as \a pnet_handle_periodic().
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param arep             In:    The AREP.
+ * @param p_read_data      In:    The binary value. May be NULL on error.
+ * @param read_length      In:    The length in bytes of the binary value.
+ * @param p_result         In:    Detailed error information, or NULL if the
+ *                                read succeeded.
+ * @return  0  if the operation succeeded.
+ *          -1 if an error occurred, for example if there is no deferred
+ *             IODRead request for the AREP.
+ */
+PNET_EXPORT int pnet_read_record_rsp (
+   pnet_t * net,
+   uint32_t arep,
+   const uint8_t * p_read_data,
+   uint16_t read_length,
+   const pnet_result_t * p_result);
+
+/**
+ * Application delivers the response to a deferred IODWrite request.
+ *
+ * Use this after returning \a PNET_RECORD_RSP_PENDING from the
+ * \a pnet_write_ind() user callback.
+ *
+ * Must be called from the same thread as \a pnet_handle_periodic().
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param arep             In:    The AREP.
+ * @param p_result         In:    Detailed error information, or NULL if the
+ *                                write succeeded.
+ * @return  0  if the operation succeeded.
+ *          -1 if an error occurred, for example if there is no deferred
+ *             IODWrite request for the AREP.
+ */
+PNET_EXPORT int pnet_write_record_rsp (
+   pnet_t * net,
+   uint32_t arep,
+   const pnet_result_t * p_result);
+
 /**
  * Application requests abortion of the connection.
  *
@@ -1871,6 +1985,115 @@ PNET_EXPORT int pnet_alarm_send_ack (
    const pnet_alarm_argument_t * p_alarm_argument,
    const pnet_pnio_status_t * p_pnio_status);
 
+/** Number of buckets in an alarm latency histogram */
+#define PNET_ALARM_LATENCY_BUCKETS 12
+
+/**
+ * Histogram of alarm latencies.
+ *
+ * Bucket 0 counts latencies below 1 ms. Bucket n (1..10) counts latencies
+ * from 2^(n-1) ms up to 2^n ms. The last bucket counts latencies of 1024 ms
+ * or more.
+ */
+typedef struct pnet_alarm_latency
+{
+   uint32_t count;   /**< Number of measured latencies */
+   uint32_t last_us; /**< Latest latency, in microseconds */
+   uint32_t max_us;  /**< Max latency, in microseconds */
+   uint32_t buckets[PNET_ALARM_LATENCY_BUCKETS];
+} pnet_alarm_latency_t;
+
+/**
+ * Alarm statistics for one alarm priority of an AR.
+ */
+typedef struct pnet_alarm_prio_statistics
+{
+   uint32_t sent;                    /**< Alarm notifications sent */
+   uint32_t retransmissions;         /**< Frames re-sent at TACK timeout */
+   uint32_t send_queue_full;         /**< Alarms dropped, send queue full */
+   uint32_t receive_queue_full;      /**< Frames dropped, receive queue full */
+   uint16_t send_queue_depth_max;    /**< Max alarms in the send queue */
+   uint16_t receive_queue_depth_max; /**< Max frames in the receive queue */
+
+   /** Periodic calls leaving frames in the receive queue, due to the
+    *  alarm_receive_budget */
+   uint32_t receive_budget_exhausted;
+
+   /** From the alarm is queued until it is sent */
+   pnet_alarm_latency_t queue_time;
+   /** From the alarm is sent until the transport ACK (TACK) is received */
+   pnet_alarm_latency_t transport_ack_time;
+   /** From the alarm is sent until the controller acknowledges it */
+   pnet_alarm_latency_t application_ack_time;
+} pnet_alarm_prio_statistics_t;
+
+/**
+ * Alarm statistics of an AR.
+ */
+typedef struct pnet_alarm_statistics
+{
+   pnet_alarm_prio_statistics_t low_prio;
+   pnet_alarm_prio_statistics_t high_prio;
+} pnet_alarm_statistics_t;
+
+/**
+ * Fetch the alarm statistics of an AR.
+ *
+ * The statistics are cleared when the AR is established. They are updated
+ * by the stack without locking, so a value may be off by one update if the
+ * stack updates it at the same time.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param arep             In:    The AREP.
+ * @param p_statistics     Out:   The alarm statistics.
+ * @return  0  If the AREP is valid.
+ *          -1 if the AREP is not valid.
+ */
+PNET_EXPORT int pnet_get_alarm_statistics (
+   pnet_t * net,
+   uint32_t arep,
+   pnet_alarm_statistics_t * p_statistics);
+
+/**
+ * Counters for a DCP service.
+ */
+typedef struct pnet_dcp_service_statistics
+{
+   /** Requests received. For Identify, only requests matching this
+    *  station are counted. */
+   uint32_t received;
+   /** Requests dropped by the rate limits */
+   uint32_t dropped;
+} pnet_dcp_service_statistics_t;
+
+/**
+ * DCP statistics.
+ */
+typedef struct pnet_dcp_statistics
+{
+   pnet_dcp_service_statistics_t identify;
+   pnet_dcp_service_statistics_t get;
+   pnet_dcp_service_statistics_t set;
+   /** Requests (of any service) dropped by the per source rate limit */
+   uint32_t source_dropped;
+} pnet_dcp_statistics_t;
+
+/**
+ * Fetch the DCP statistics.
+ *
+ * The statistics are cleared at init. They are updated by the stack without
+ * locking, so a value may be off by one update if the stack updates it at
+ * the same time.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_statistics     Out:   The DCP statistics.
+ * @return  0  If the statistics were fetched.
+ *          -1 if an error occurred.
+ */
+PNET_EXPORT int pnet_get_dcp_statistics (
+   pnet_t * net,
+   pnet_dcp_statistics_t * p_statistics);
+
 /* ****************************** Diagnosis ****************************** */
 
 #define PNET_CHANNEL_WHOLE_SUBMODULE 0x8000
@@ -2271,6 +2494,40 @@ PNET_EXPORT int pnet_diag_remove (
    uint16_t ext_ch_error_type,
    uint16_t usi);
 
+/**
+ * Start a diagnosis batch.
+ *
+ * Use this when many diagnosis entries change at once, for example when a
+ * module loses its power supply and all its channels report errors.
+ *
+ * Until \a pnet_diag_commit() is called, the pnet_diag_xxx() functions add,
+ * update and remove diagnosis entries as usual, but no diagnosis alarms are
+ * sent.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @return  0  if the operation succeeded.
+ *          -1 if an error occurred (a batch is already started).
+ */
+PNET_EXPORT int pnet_diag_begin (pnet_t * net);
+
+/**
+ * Finish a diagnosis batch, and send diagnosis alarms for the changes.
+ *
+ * For each sub-slot, the diagnosis entries changed in the batch are reported
+ * once with their final value. Entries that were added and then removed
+ * within the batch are not reported at all.
+ *
+ * Entries in standard format with the same USI are sent as a list in a single
+ * alarm, as far as the alarm payload allows. Each entry takes 6, 12 or 16
+ * bytes (channel, extended or qualified channel diagnosis). Increase
+ * PNET_MAX_ALARM_PAYLOAD_DATA_SIZE to fit more entries in each alarm.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @return  0  if the operation succeeded.
+ *          -1 if an error occurred (no batch is started).
+ */
+PNET_EXPORT int pnet_diag_commit (pnet_t * net);
+
 /******************** Show Profinet stack info ********************************/
 
 /**
@@ -2281,6 +2538,7 @@ PNET_EXPORT int pnet_diag_remove (
  *
  *     0x0010              | Show compile time options
  *     0x0020              | Show CMDEV
+ *     0x0040              | Show Fast Startup
  *     0x0080              | Show SNMP
  *     0x0100              | Show Ports
  *     0x0200              | Show diagnosis
@@ -2290,7 +2548,7 @@ PNET_EXPORT int pnet_diag_remove (
  *     0x1001              |     include IOCR.
  *     0x1002              |     include data_descriptors.
  *     0x1003              |     include IOCR and data_descriptors.
- *     0x2000              | Show config/CMINA information.
+ *     0x2000              | Show config/CMINA/DCP information.
  *     0x4000              | Show scheduler information.
  *     0x8000              | Show I&M data.
  *
@@ -2305,6 +2563,7 @@ PNET_EXPORT int pnet_diag_remove (
  *                       1                    Diagnosis
  *                         1                  Ports
  *                           1                SNMP
+ *                             1              Fast Startup
  *                               1            CMDEV
  *                                 1          Options
  *                                       1    More IOCR info on AR
@@ -51,6 +51,11 @@
  * into the send queue and retrieves messages from the send queue.
  * A message in the alarm send queue contains the full alarm, including payload.
  *
+ * A diagnosis alarm for the same diagnosis as an alarm already waiting in the
+ * send queue replaces the waiting alarm, so the controller gets the latest
+ * state instead of a backlog. Diagnosis alarms can also be rate limited per AR
+ * (a token bucket), see diag_alarm_rate in pnet_cfg_t.
+ *
  * There are convenience functions to send different types of alarms, for
  * example process alarms.
  *
@@ -59,6 +64,7 @@
  */
 
 #ifdef UNIT_TEST
+#define os_get_current_time_us mock_os_get_current_time_us
 #endif
 
 /*
@@ -92,6 +98,9 @@
 #endif
 
 CC_STATIC_ASSERT (PNET_MAX_ALARM_PAYLOAD_DATA_SIZE >= sizeof (pf_diag_item_t));
+CC_STATIC_ASSERT (
+   sizeof (((pf_alarm_payload_t *)0)->data) >=
+   PNET_MAX_ALARM_PAYLOAD_DATA_SIZE);
 
 /*************** Diagnostic strings *****************************************/
 
@@ -237,10 +246,78 @@ static const char * pf_alarm_apmr_state_to_string (pf_apmr_state_values_t state)
    return s;
 }
 
+/**
+ * @internal
+ * Show an alarm latency histogram.
+ *
+ * @param name             In:    Name of the latency
+ * @param p_latency        In:    Latency histogram
+ */
+static void pf_alarm_show_latency (
+   const char * name,
+   const pnet_alarm_latency_t * p_latency)
+{
+   uint16_t ix;
+
+   printf (
+      "  %-27s = %u (last %u us, max %u us)\n",
+      name,
+      (unsigned)p_latency->count,
+      (unsigned)p_latency->last_us,
+      (unsigned)p_latency->max_us);
+   printf ("    Histogram <1,2,4..1024,>= ms:");
+   for (ix = 0; ix < PNET_ALARM_LATENCY_BUCKETS; ix++)
+   {
+      printf (" %u", (unsigned)p_latency->buckets[ix]);
+   }
+   printf ("\n");
+}
+
+/**
+ * @internal
+ * Show the alarm statistics for one priority.
+ *
+ * @param p_counters       In:    Alarm statistics
+ */
+static void pf_alarm_show_counters (
+   const pnet_alarm_prio_statistics_t * p_counters)
+{
+   printf (
+      "  Alarms sent                 = %u\n",
+      (unsigned)p_counters->sent);
+   printf (
+      "  Alarm retransmissions       = %u\n",
+      (unsigned)p_counters->retransmissions);
+   printf (
+      "  Dropped, send queue full    = %u\n",
+      (unsigned)p_counters->send_queue_full);
+   printf (
+      "  Dropped, receive queue full = %u\n",
+      (unsigned)p_counters->receive_queue_full);
+   printf (
+      "  Max send queue depth        = %u\n",
+      (unsigned)p_counters->send_queue_depth_max);
+   printf (
+      "  Max receive queue depth     = %u\n",
+      (unsigned)p_counters->receive_queue_depth_max);
+   printf (
+      "  Receive budget exhausted    = %u\n",
+      (unsigned)p_counters->receive_budget_exhausted);
+   pf_alarm_show_latency ("Time in send queue", &p_counters->queue_time);
+   pf_alarm_show_latency (
+      "Time to transport ACK",
+      &p_counters->transport_ack_time);
+   pf_alarm_show_latency (
+      "Time to alarm ACK",
+      &p_counters->application_ack_time);
+}
+
 void pf_alarm_show (const pf_ar_t * p_ar)
 {
    printf ("Alarms\n");
-   printf ("  PNET_MAX_ALARMS             = %d\n", PNET_MAX_ALARMS);
+   printf (
+      "  Max alarms per queue        = %u\n",
+      (unsigned)p_ar->alarm_send_q[0].accountant.max_items);
    printf ("Alarms   (low prio)\n");
    printf (
       "  alpmi_state                 = %s\n",
@@ -271,7 +348,8 @@ void pf_alarm_show (const pf_ar_t * p_ar)
       (unsigned)p_ar->alpmx[0].sequence_number);
    printf (
       "  Number of frames in incoming queue = %u\n",
-      p_ar->apmx[0].alarm_receive_q.accountant.count);
+      pf_alarm_queue_count (&p_ar->apmx[0].alarm_receive_q.accountant));
+   pf_alarm_show_counters (&p_ar->apmx[0].counters);
    printf ("Alarms   (high prio)\n");
    printf (
       "  alpmi_state                 = %s\n",
@@ -302,7 +380,11 @@ void pf_alarm_show (const pf_ar_t * p_ar)
       (unsigned)p_ar->alpmx[1].sequence_number);
    printf (
       "  Number of frames in incoming queue = %u\n",
-      p_ar->apmx[1].alarm_receive_q.accountant.count);
+      pf_alarm_queue_count (&p_ar->apmx[1].alarm_receive_q.accountant));
+   pf_alarm_show_counters (&p_ar->apmx[1].counters);
+   printf (
+      "  Low prio alarms held back   = %u\n",
+      (unsigned)p_ar->alarm_low_prio_skips);
 }
 
 /*****************************************************************************/
@@ -528,6 +610,9 @@ static int pf_alarm_alpmi_apmr_a_data_ind (
    case PF_ALPMI_STATE_W_ACK:
       /* This function is only called for DATA = ACK */
       p_apmx->p_alpmx->alpmi_state = PF_ALPMI_STATE_W_ALARM;
+      pf_alarm_latency_add (
+         &p_apmx->counters.application_ack_time,
+         os_get_current_time_us() - p_apmx->notify_sent_time_us);
       pf_fspm_alpmi_alarm_cnf (net, p_apmx->p_ar, p_pnio_status);
       ret = 0;
       break;
@@ -797,6 +882,10 @@ static int pf_alarm_apmr_frame_handler (
       }
       else
       {
+         if (ar != NULL)
+         {
+            ar->apmx[priority].counters.receive_queue_full++;
+         }
          LOG_ERROR (
             PF_ALARM_LOG,
             "Alarm(%d): Failed to put incoming %s prio alarm frame in "
@@ -868,6 +957,7 @@ static void pf_alarm_apms_timeout (
       else if (p_apmx->resend_counter > 0)
       {
          p_apmx->resend_counter--;
+         p_apmx->counters.retransmissions++;
 
          /* Retransmit */
          if (p_apmx->p_ar->alarm_cr_request.alarm_cr_properties.transport_udp == true)
@@ -955,6 +1045,69 @@ static void pf_alarm_apms_timeout (
 
 /****************************************************************************/
 
+/**
+ * @internal
+ * Build the Ethernet header used by all alarm frames of an APMX instance.
+ *
+ * The header contains destination and source MAC addresses, VLAN tag,
+ * EtherType and frame ID, which do not change while the AR is active.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_apmx           InOut: The APMX instance.
+ */
+static void pf_alarm_apmx_header_init (pnet_t * net, pf_apmx_t * p_apmx)
+{
+   const pnet_ethaddr_t * mac_address = pf_cmina_get_device_macaddr (net);
+   uint16_t pos = 0;
+   uint16_t u16;
+
+   /* Destination MAC address (IO-controller) */
+   pf_put_mem (
+      &p_apmx->da,
+      sizeof (p_apmx->da),
+      sizeof (p_apmx->header),
+      p_apmx->header,
+      &pos);
+
+   /* Source MAC address (our interface MAC address) */
+   pf_put_mem (
+      mac_address->addr,
+      sizeof (pnet_ethaddr_t),
+      sizeof (p_apmx->header),
+      p_apmx->header,
+      &pos);
+
+   /* VLAN Tag protocol identifier (TPID) */
+   pf_put_uint16 (
+      true,
+      PNAL_ETHTYPE_VLAN,
+      sizeof (p_apmx->header),
+      p_apmx->header,
+      &pos);
+
+   /* VLAN prio (and VLAN ID=0) */
+   u16 = (p_apmx->vlan_prio & 0x0007) << 13; /* Three leftmost bits */
+   pf_put_uint16 (true, u16, sizeof (p_apmx->header), p_apmx->header, &pos);
+
+   /* EtherType */
+   pf_put_uint16 (
+      true,
+      PNAL_ETHTYPE_PROFINET,
+      sizeof (p_apmx->header),
+      p_apmx->header,
+      &pos);
+
+   /* Profinet frame ID (first part of Ethernet frame payload) */
+   pf_put_uint16 (
+      true,
+      p_apmx->frame_id,
+      sizeof (p_apmx->header),
+      p_apmx->header,
+      &pos);
+
+   CC_ASSERT (pos == sizeof (p_apmx->header));
+}
+
 /**
  * @internal
  * Initialize and start an AMPX instance (an APMS/APMR pair).
@@ -1034,6 +1187,7 @@ static int pf_alarm_apmx_activate (pnet_t * net, pf_ar_t * p_ar)
             p_ar->apmx[ix].block_type_alarm_ack = PF_BT_ALARM_ACK_HIGH;
             p_ar->apmx[ix].frame_id = PF_FRAME_ID_ALARM_HIGH;
          }
+         pf_alarm_apmx_header_init (net, &p_ar->apmx[ix]);
 
          /* Input alarm frame queue */
          pf_alarm_queue_mutex_create (
@@ -1045,6 +1199,11 @@ static int pf_alarm_apmx_activate (pnet_t * net, pf_ar_t * p_ar)
          p_ar->apmx[ix].resend_counter = 0; /* Updated in
                                              * pf_alarm_apms_apms_a_data_req()
                                              */
+         memset (
+            &p_ar->apmx[ix].counters,
+            0,
+            sizeof (p_ar->apmx[ix].counters));
+         p_ar->apmx[ix].notify_wait_tack = false;
 
          p_ar->apmx[ix].p_ar = p_ar;
          p_ar->apmx[ix].p_alpmx = &p_ar->alpmx[ix];
@@ -1134,6 +1293,14 @@ static int pf_alarm_apms_a_data_ind (
                pnal_buf_free (p_rta);
             }
 
+            if (p_apmx->notify_wait_tack)
+            {
+               p_apmx->notify_wait_tack = false;
+               pf_alarm_latency_add (
+                  &p_apmx->counters.transport_ack_time,
+                  os_get_current_time_us() - p_apmx->notify_sent_time_us);
+            }
+
             /* This is APMS_A_Data.cnf(+) */
             pf_alarm_alpmi_apms_a_data_cnf (net, p_apmx, 0);
 
@@ -1198,7 +1365,8 @@ static int pf_alarm_apms_a_data_ind (
  *  ACK (used as transport ACK = TACK)
  *
  * Messages with TACK == true are saved in the APMX instance in order
- * to handle re-transmissions.
+ * to handle re-transmissions. The Ethernet header is copied from the
+ * template built at activation.
  *
  * APMS: A_Data_req  (This is LMPM_A_Data.req via macro)
  *
@@ -1215,13 +1383,13 @@ static int pf_alarm_apms_a_data_ind (
  *                                block type = alarm notify.
  *                                Use 0 for no payload.
  * @param payload_len      In:    Number of bytes of manufaturer data.
- *                                Only used for manufacturer data ("USI format",
- *                                payload USI <= 0x7FFF).
+ *                                For diagnosis in standard format, the size
+ *                                of the pf_diag_std_t array.
  *                                May be 0 for manufacturer data.
- * @param p_payload        In:    pf_diag_item_t, manufacturer data or NULL.
- *                                Mandatory if payload_len > 0 or for USI
- *                                values for diagnosis in standard format
- *                                (which expect a pf_diag_item_t)
+ * @param p_payload        In:    Array of pf_diag_std_t, manufacturer data or
+ *                                NULL. Mandatory if payload_len > 0 or for
+ *                                USI values for diagnosis in standard format
+ *                                (which expect a pf_diag_std_t)
  * @param p_pnio_status    In:    Mandatory for ERROR messages.
  *                                For DATA messages a NULL value gives an Alarm
  *                                Notification DATA message, otherwise an
@@ -1246,8 +1414,6 @@ static int pf_alarm_apms_a_data_req (
    pnal_buf_t * p_rta;
    uint8_t * p_buf = NULL;
    uint16_t pos = 0;
-   const pnet_ethaddr_t * mac_address = pf_cmina_get_device_macaddr (net);
-   uint16_t u16 = 0;
 
    if (p_apmx->p_ar->alarm_cr_request.alarm_cr_properties.transport_udp == true)
    {
@@ -1283,43 +1449,10 @@ static int pf_alarm_apms_a_data_req (
                pf_alarm_pdu_type_to_string (p_fixed->pdu_type.type),
                p_rta);
 
-            /* Insert destination MAC address */
+            /* Insert the prebuilt Ethernet header, including frame ID */
             pf_put_mem (
-               &p_apmx->da,
-               sizeof (p_apmx->da),
-               PF_FRAME_BUFFER_SIZE,
-               p_buf,
-               &pos);
-
-            /* Insert source MAC address (our interface MAC address) */
-            memcpy (&p_buf[pos], mac_address->addr, sizeof (pnet_ethaddr_t));
-            pos += sizeof (pnet_ethaddr_t);
-
-            /* Insert VLAN Tag protocol identifier (TPID) */
-            pf_put_uint16 (
-               true,
-               PNAL_ETHTYPE_VLAN,
-               PF_FRAME_BUFFER_SIZE,
-               p_buf,
-               &pos);
-
-            /* Insert VLAN prio (and VLAN ID=0) */
-            u16 = (p_apmx->vlan_prio & 0x0007) << 13; /* Three leftmost bits */
-            pf_put_uint16 (true, u16, PF_FRAME_BUFFER_SIZE, p_buf, &pos);
-
-            /* Insert EtherType */
-            pf_put_uint16 (
-               true,
-               PNAL_ETHTYPE_PROFINET,
-               PF_FRAME_BUFFER_SIZE,
-               p_buf,
-               &pos);
-
-            /* Insert Profinet frame ID (first part of Ethernet frame payload)
-             */
-            pf_put_uint16 (
-               true,
-               p_apmx->frame_id,
+               p_apmx->header,
+               sizeof (p_apmx->header),
                PF_FRAME_BUFFER_SIZE,
                p_buf,
                &pos);
@@ -1452,7 +1585,9 @@ static int pf_alarm_apms_a_data_req (
          }
          else
          {
-            /* ACK, NAK and ERR buffers are not saved for retransmission. */
+            /* ACK, NAK and ERR buffers are not saved for retransmission.
+             * The driver may still hold the buffer after sending (for
+             * example for zero-copy DMA), so it is not reused. */
             LOG_DEBUG (
                PF_AL_BUF_LOG,
                "Alarm(%d): Free unsaved alarm output buffer %p\n",
@@ -2063,6 +2198,9 @@ static int pf_alarm_get_diag_summary (
  *
  * Incoming ACK is sent to APMS.
  *
+ * At most alarm_receive_budget frames (from pnet_cfg_t) are handled per
+ * queue in each call. Remaining frames are handled in the next call.
+ *
  * APMR + APMS: Implementation detail
  *
  * @param net              InOut: The p-net stack instance
@@ -2082,6 +2220,11 @@ static int pf_alarm_apmr_periodic (pnet_t * net, pf_ar_t * p_ar)
    pf_get_info_t get_info;
    uint16_t pos;
    pf_apmr_msg_t inputmsg;
+   pnet_cfg_t * p_cfg = NULL;
+   uint16_t depth;
+   uint16_t handled;
+
+   pf_fspm_get_cfg (net, &p_cfg);
 
    /*
     * Periodic is run cyclically. It may run for some time.
@@ -2093,11 +2236,29 @@ static int pf_alarm_apmr_periodic (pnet_t * net, pf_ar_t * p_ar)
    {
       p_apmx = &p_ar->apmx[ix];
       p_buf = NULL;
+      handled = 0;
+
+      depth = pf_alarm_queue_count (&p_apmx->alarm_receive_q.accountant);
+      if (depth > p_apmx->counters.receive_queue_depth_max)
+      {
+         p_apmx->counters.receive_queue_depth_max = depth;
+      }
+      if (
+         (p_cfg->alarm_receive_budget > 0) &&
+         (depth > p_cfg->alarm_receive_budget))
+      {
+         p_apmx->counters.receive_budget_exhausted++;
+      }
+
       while (
          (ret == 0) && (p_apmx->apmr_state != PF_APMR_STATE_CLOSED) &&
+         ((p_cfg->alarm_receive_budget == 0) ||
+          (handled < p_cfg->alarm_receive_budget)) &&
          (pf_alarm_receive_queue_fetch (&p_apmx->alarm_receive_q, &inputmsg) ==
           0))
       {
+         handled++;
+
          /* Got something - extract! */
          p_buf = inputmsg.p_buf;
 
@@ -2331,6 +2492,8 @@ static int pf_alarm_send_internal (
    if (ret == 0)
    {
       p_apmx->p_alpmx->alpmi_state = PF_ALPMI_STATE_W_ACK;
+      p_apmx->notify_sent_time_us = os_get_current_time_us();
+      p_apmx->notify_wait_tack = true;
    }
    else
    {
@@ -2342,6 +2505,22 @@ static int pf_alarm_send_internal (
 
 /************************ Queue handling ************************************/
 
+/*
+ * Each queue has a single consumer, which is the stack thread. For the
+ * receive queue the producer is the Ethernet receive thread. The send queues
+ * are posted to both by the stack thread and by the application thread (via
+ * the pnet_xxx() API functions), so there may be several producers. The
+ * producers always take the queue mutex.
+ *
+ * With PNET_USE_ATOMICS a producer publishes a new item by a release store
+ * of write_index, after the item has been written. The consumer frees a
+ * slot by a release store of read_index, after the item has been read. The
+ * consumer of the receive queue then does not take the mutex, so the
+ * Ethernet receive thread never waits for the stack thread. The consumer of
+ * a send queue still takes the mutex, as waiting alarms may be modified in
+ * place by pf_alarm_send_queue_merge().
+ */
+
 /**
  * @internal
  * Create a mutex for a queue.
@@ -2412,28 +2591,141 @@ static void pf_alarm_queue_unlock (pf_queue_accountant_t * p_accountant)
 
 /**
  * @internal
- * Reset the queue indexes.
+ * Lock a queue for the consumer of the receive queue. This is a no-op when
+ * PNET_USE_ATOMICS is enabled.
  *
- * NOTE: Remember to lock/unlock the queue before and after this operation.
+ * @param p_accountant     InOut: Queue accountant
+ */
+static void pf_alarm_queue_lock_consumer (pf_queue_accountant_t * p_accountant)
+{
+#if !PNET_USE_ATOMICS
+   pf_alarm_queue_lock (p_accountant);
+#endif
+}
+
+/**
+ * @internal
+ * Unlock a queue for the consumer of the receive queue. This is a no-op when
+ * PNET_USE_ATOMICS is enabled.
  *
  * @param p_accountant     InOut: Queue accountant
  */
-static void pf_alarm_queue_accountant_reset (
+static void pf_alarm_queue_unlock_consumer (
    pf_queue_accountant_t * p_accountant)
 {
-   p_accountant->count = 0;
-   p_accountant->read_index = 0;
-   p_accountant->write_index = 0;
+#if !PNET_USE_ATOMICS
+   pf_alarm_queue_unlock (p_accountant);
+#endif
+}
+
+/**
+ * @internal
+ * Load a queue index written by the other side of the queue.
+ *
+ * @param p_index          In:    Queue index
+ * @return the index value
+ */
+static uint16_t pf_alarm_queue_load_index (const pf_queue_index_t * p_index)
+{
+#if PNET_USE_ATOMICS
+   return atomic_load_explicit (p_index, memory_order_acquire);
+#else
+   return *p_index;
+#endif
+}
+
+/**
+ * @internal
+ * Store a queue index, making it visible to the other side of the queue.
+ *
+ * @param p_index          Out:   Queue index
+ * @param value            In:    New index value
+ */
+static void pf_alarm_queue_store_index (
+   pf_queue_index_t * p_index,
+   uint16_t value)
+{
+#if PNET_USE_ATOMICS
+   atomic_store_explicit (p_index, value, memory_order_release);
+#else
+   *p_index = value;
+#endif
+}
+
+/**
+ * @internal
+ * Step a queue index to the next position.
+ *
+ * @param p_accountant     In:    Queue accountant
+ * @param index            In:    Queue index
+ * @return the next index value
+ */
+static uint16_t pf_alarm_queue_next_index (
+   const pf_queue_accountant_t * p_accountant,
+   uint16_t index)
+{
+   index++;
+   if (index >= 2 * p_accountant->max_items)
+   {
+      index = 0;
+   }
+
+   return index;
+}
+
+/**
+ * @internal
+ * Get the item position in the queue for an index.
+ *
+ * @param p_accountant     In:    Queue accountant
+ * @param index            In:    Queue index
+ * @return the item position
+ */
+static uint16_t pf_alarm_queue_slot (
+   const pf_queue_accountant_t * p_accountant,
+   uint16_t index)
+{
+   return (index >= p_accountant->max_items) ? index - p_accountant->max_items
+                                             : index;
+}
+
+/**
+ * @internal
+ * Get the number of items in a queue.
+ *
+ * The result is exact for the consumer and for the producer. For others it
+ * may be outdated already when returned.
+ *
+ * @param p_accountant     InOut: Queue accountant
+ * @return the number of items in the queue
+ */
+uint16_t pf_alarm_queue_count (const pf_queue_accountant_t * p_accountant)
+{
+   uint16_t write_index;
+   uint16_t read_index;
+
+   write_index = pf_alarm_queue_load_index (&p_accountant->write_index);
+   read_index = pf_alarm_queue_load_index (&p_accountant->read_index);
+
+   if (write_index >= read_index)
+   {
+      return write_index - read_index;
+   }
+
+   return write_index + 2 * p_accountant->max_items - read_index;
 }
 
 /**
  * @internal
- * Get next write index for a queue.
+ * Get next write position for a queue.
+ *
+ * Only to be used by a producer, holding the queue mutex. The item is not
+ * visible to the consumer until pf_alarm_queue_commit_write() is called.
  *
  * NOTE: Remember to lock/unlock the queue before and after this operation.
  *
  * @param p_accountant     InOut: Queue accountant
- * @param p_write_index    Out:   Write index to use
+ * @param p_write_index    Out:   Item position to write
  * @return 0 if there is room in the queue
  *         -1 if the queue is full
  */
@@ -2441,31 +2733,47 @@ static int pf_alarm_queue_get_writeindex (
    pf_queue_accountant_t * p_accountant,
    uint16_t * p_write_index)
 {
-   if (p_accountant->count >= PNET_MAX_ALARMS)
+   if (pf_alarm_queue_count (p_accountant) >= p_accountant->max_items)
    {
       return -1;
    }
 
-   *p_write_index = p_accountant->write_index;
-
-   p_accountant->write_index++;
-   if (p_accountant->write_index >= PNET_MAX_ALARMS)
-   {
-      p_accountant->write_index = 0;
-   }
-   p_accountant->count++;
+   *p_write_index = pf_alarm_queue_slot (
+      p_accountant,
+      pf_alarm_queue_load_index (&p_accountant->write_index));
 
    return 0;
 }
 
 /**
  * @internal
- * Get next read index for a queue.
+ * Publish the item written at the position from
+ * pf_alarm_queue_get_writeindex().
+ *
+ * NOTE: Remember to lock/unlock the queue before and after this operation.
+ *
+ * @param p_accountant     InOut: Queue accountant
+ */
+static void pf_alarm_queue_commit_write (pf_queue_accountant_t * p_accountant)
+{
+   pf_alarm_queue_store_index (
+      &p_accountant->write_index,
+      pf_alarm_queue_next_index (
+         p_accountant,
+         pf_alarm_queue_load_index (&p_accountant->write_index)));
+}
+
+/**
+ * @internal
+ * Get next read position for a queue.
+ *
+ * Only to be used by the consumer. The item stays in the queue until
+ * pf_alarm_queue_commit_read() is called.
  *
  * NOTE: Remember to lock/unlock the queue before and after this operation.
  *
  * @param p_accountant     InOut: Queue accountant
- * @param p_read_index     Out:   Read index to use
+ * @param p_read_index     Out:   Item position to read
  * @return 0 if the queue has an item to read
  *         -1 if the queue is empty
  */
@@ -2473,26 +2781,61 @@ static int pf_alarm_queue_get_readindex (
    pf_queue_accountant_t * p_accountant,
    uint16_t * p_read_index)
 {
-   if (p_accountant->count == 0)
+   if (pf_alarm_queue_count (p_accountant) == 0)
    {
       return -1;
    }
 
-   *p_read_index = p_accountant->read_index;
-
-   p_accountant->read_index++;
-   if (p_accountant->read_index >= PNET_MAX_ALARMS)
-   {
-      p_accountant->read_index = 0;
-   }
-   p_accountant->count--;
+   *p_read_index = pf_alarm_queue_slot (
+      p_accountant,
+      pf_alarm_queue_load_index (&p_accountant->read_index));
 
    return 0;
 }
 
+/**
+ * @internal
+ * Release the item read at the position from pf_alarm_queue_get_readindex().
+ *
+ * NOTE: Remember to lock/unlock the queue before and after this operation.
+ *
+ * @param p_accountant     InOut: Queue accountant
+ */
+static void pf_alarm_queue_commit_read (pf_queue_accountant_t * p_accountant)
+{
+   pf_alarm_queue_store_index (
+      &p_accountant->read_index,
+      pf_alarm_queue_next_index (
+         p_accountant,
+         pf_alarm_queue_load_index (&p_accountant->read_index)));
+}
+
+/**
+ * Set the memory used for the items in the receive queue.
+ *
+ * Note: The queue must be empty.
+ *
+ * @param q                InOut: Alarm receive queue
+ * @param p_items          In:    Memory for max_items frames
+ * @param max_items        In:    Max number of frames in the queue
+ */
+void pf_alarm_receive_queue_init (
+   pf_alarm_receive_queue_t * q,
+   pf_apmr_msg_t * p_items,
+   uint16_t max_items)
+{
+   q->items = p_items;
+   q->accountant.max_items = max_items;
+   pf_alarm_queue_store_index (&q->accountant.write_index, 0);
+   pf_alarm_queue_store_index (&q->accountant.read_index, 0);
+}
+
 /**
  * Reset queue for incoming alarm frames. Will free corresponding buffers.
  *
+ * Only to be used by the consumer. Frames in the queue are removed the same
+ * way as when fetched, so the producer may post concurrently.
+ *
  * Note: The mutex must have been created before.
  *       First time the pf_alarm_receive_queue_t is used it should be fully
  *       cleared. So if this function is used immediately thereafter on the
@@ -2502,7 +2845,7 @@ static int pf_alarm_queue_get_readindex (
  */
 void pf_alarm_receive_queue_reset (pf_alarm_receive_queue_t * q)
 {
-   uint16_t ix;
+   uint16_t read_index;
 
    if (pf_alarm_queue_is_available (&q->accountant) == false)
    {
@@ -2514,18 +2857,18 @@ void pf_alarm_receive_queue_reset (pf_alarm_receive_queue_t * q)
       return;
    }
 
-   pf_alarm_queue_lock (&q->accountant);
-   pf_alarm_queue_accountant_reset (&q->accountant);
-   for (ix = 0; ix < PNET_MAX_ALARMS; ix++)
+   pf_alarm_queue_lock_consumer (&q->accountant);
+   while (pf_alarm_queue_get_readindex (&q->accountant, &read_index) == 0)
    {
-      if (q->items[ix].p_buf != NULL)
+      if (q->items[read_index].p_buf != NULL)
       {
-         pnal_buf_free (q->items[ix].p_buf);
-         q->items[ix].p_buf = NULL;
+         pnal_buf_free (q->items[read_index].p_buf);
+         q->items[read_index].p_buf = NULL;
       }
-      q->items[ix].frame_id_pos = 0;
+      q->items[read_index].frame_id_pos = 0;
+      pf_alarm_queue_commit_read (&q->accountant);
    }
-   pf_alarm_queue_unlock (&q->accountant);
+   pf_alarm_queue_unlock_consumer (&q->accountant);
 }
 
 /**
@@ -2557,6 +2900,7 @@ int pf_alarm_receive_queue_post (
    {
       q->items[write_index].frame_id_pos = p_alarm_frame->frame_id_pos;
       q->items[write_index].p_buf = p_alarm_frame->p_buf;
+      pf_alarm_queue_commit_write (&q->accountant);
       ret = 0;
    }
    pf_alarm_queue_unlock (&q->accountant);
@@ -2591,7 +2935,7 @@ int pf_alarm_receive_queue_fetch (
       return ret;
    }
 
-   pf_alarm_queue_lock (&q->accountant);
+   pf_alarm_queue_lock_consumer (&q->accountant);
    if (pf_alarm_queue_get_readindex (&q->accountant, &read_index) == 0)
    {
       p_alarm_frame->frame_id_pos = q->items[read_index].frame_id_pos;
@@ -2600,19 +2944,42 @@ int pf_alarm_receive_queue_fetch (
       p_alarm_frame->p_buf = q->items[read_index].p_buf;
       q->items[read_index].p_buf = NULL;
 
+      pf_alarm_queue_commit_read (&q->accountant);
       ret = 0;
    }
-   pf_alarm_queue_unlock (&q->accountant);
+   pf_alarm_queue_unlock_consumer (&q->accountant);
 
    return ret;
 }
 
+/**
+ * Set the memory used for the items in the send queue.
+ *
+ * Note: The queue must be empty.
+ *
+ * @param q                InOut: Alarm send queue (High or low prio)
+ * @param p_items          In:    Memory for max_items alarms
+ * @param max_items        In:    Max number of alarms in the queue
+ */
+void pf_alarm_send_queue_init (
+   pf_alarm_send_queue_t * q,
+   pf_alarm_data_t * p_items,
+   uint16_t max_items)
+{
+   q->items = p_items;
+   q->accountant.max_items = max_items;
+   pf_alarm_queue_store_index (&q->accountant.write_index, 0);
+   pf_alarm_queue_store_index (&q->accountant.read_index, 0);
+}
+
 /**
  * Reset queue for outgoing alarms
  * @param q                InOut: Alarm send queue (High or low prio)
  */
 void pf_alarm_send_queue_reset (pf_alarm_send_queue_t * q)
 {
+   uint16_t read_index;
+
    if (pf_alarm_queue_is_available (&q->accountant) == false)
    {
       LOG_ERROR (
@@ -2624,8 +2991,11 @@ void pf_alarm_send_queue_reset (pf_alarm_send_queue_t * q)
    }
 
    pf_alarm_queue_lock (&q->accountant);
-   pf_alarm_queue_accountant_reset (&q->accountant);
-   memset (q->items, 0, sizeof (q->items));
+   while (pf_alarm_queue_get_readindex (&q->accountant, &read_index) == 0)
+   {
+      pf_alarm_queue_commit_read (&q->accountant);
+   }
+   memset (q->items, 0, q->accountant.max_items * sizeof (*q->items));
    pf_alarm_queue_unlock (&q->accountant);
 }
 
@@ -2657,6 +3027,7 @@ int pf_alarm_send_queue_post (
    if (pf_alarm_queue_get_writeindex (&q->accountant, &write_index) == 0)
    {
       memcpy (&q->items[write_index], p_alarm_data, sizeof (*p_alarm_data));
+      pf_alarm_queue_commit_write (&q->accountant);
       ret = 0;
    }
    pf_alarm_queue_unlock (&q->accountant);
@@ -2696,6 +3067,7 @@ int pf_alarm_send_queue_fetch (
    if (pf_alarm_queue_get_readindex (&q->accountant, &read_index) == 0)
    {
       memcpy (p_alarm_data, &q->items[read_index], sizeof (*p_alarm_data));
+      pf_alarm_queue_commit_read (&q->accountant);
       ret = 0;
    }
    pf_alarm_queue_unlock (&q->accountant);
@@ -2703,76 +3075,450 @@ int pf_alarm_send_queue_fetch (
    return ret;
 }
 
-/****************************************************************************/
+/**
+ * @internal
+ * Check if an alarm type is used for diagnosis alarms that may be merged and
+ * rate limited.
+ *
+ * @param alarm_type       In:    The alarm type. pf_alarm_type_values_t
+ * @return true if it is a diagnosis alarm type.
+ */
+static bool pf_alarm_is_diagnosis_type (uint16_t alarm_type)
+{
+   return (alarm_type == PF_ALARM_TYPE_DIAGNOSIS) ||
+          (alarm_type == PF_ALARM_TYPE_DIAGNOSIS_DISAPPEARS);
+}
 
 /**
  * @internal
- * Handle outgoing alarm messages for one AR instance.
+ * Check if two alarms are about the same diagnosis.
  *
- * When called this function checks the ALMPI state for high and
- * low priority alarms. If state is PF_ALPMI_STATE_W_ALARM and a alarm
- * is found in the send queue this alarm is sent.
+ * Diagnosis in USI format is identified by the USI. Diagnosis in standard
+ * format is identified by the channel number, accumulative and direction
+ * properties and the error types (same as in the CMDEV diagnosis index).
+ * Alarms with several diag items are never considered the same.
  *
- * @param net              InOut: The p-net stack instance
- * @param p_ar             InOut: The AR instance.
- * @return  0  if operation succeeded.
- *          -1 if an error occurred.
+ * @param p_a              In:    Alarm.
+ * @param p_b              In:    Another alarm.
+ * @return true if both alarms are about the same diagnosis.
  */
-static void pf_alarm_almpi_periodic (pnet_t * net, pf_ar_t * p_ar)
+static bool pf_alarm_is_same_diagnosis (
+   const pf_alarm_data_t * p_a,
+   const pf_alarm_data_t * p_b)
 {
-   int res = 0;
-   int16_t prio;
-   pf_apmx_t * p_apmx;
-   pf_alarm_send_queue_t * q;
-   pf_alarm_data_t alarm_data;
+   const pf_diag_std_t * p_item_a;
+   const pf_diag_std_t * p_item_b;
 
-   if (p_ar->alarm_enable == true)
+   if (
+      (pf_alarm_is_diagnosis_type (p_a->alarm_type) == false) ||
+      (pf_alarm_is_diagnosis_type (p_b->alarm_type) == false) ||
+      (p_a->api_id != p_b->api_id) || (p_a->slot_nbr != p_b->slot_nbr) ||
+      (p_a->subslot_nbr != p_b->subslot_nbr))
    {
-      for (prio = 1; prio >= 0; prio--)
-      {
-         p_apmx = &p_ar->apmx[prio];
-         q = &p_ar->alarm_send_q[prio];
-         if (p_apmx->p_alpmx->alpmi_state == PF_ALPMI_STATE_W_ALARM)
-         {
-            res = pf_alarm_send_queue_fetch (q, &alarm_data);
-            if (res == 0)
-            {
-               (void)pf_alarm_send_internal (net, p_ar, p_apmx, &alarm_data);
-               /*
-                * If a high prio alarm is found don't check low prio
-                * alarms until next call of this operation.
-                */
-               break;
-            }
-         }
-      }
+      return false;
    }
-}
 
-/************************ Common alarm functions *****************************/
+   if (
+      (p_a->payload.usi < PF_USI_CHANNEL_DIAGNOSIS) ||
+      (p_b->payload.usi < PF_USI_CHANNEL_DIAGNOSIS))
+   {
+      return p_a->payload.usi == p_b->payload.usi;
+   }
 
-void pf_alarm_enable (pf_ar_t * p_ar)
-{
-   p_ar->alarm_enable = true;
-}
+   if (
+      (p_a->payload.len != sizeof (pf_diag_std_t)) ||
+      (p_b->payload.len != sizeof (pf_diag_std_t)))
+   {
+      return false;
+   }
 
-void pf_alarm_disable (pf_ar_t * p_ar)
-{
-   p_ar->alarm_enable = false;
+   p_item_a = (const pf_diag_std_t *)p_a->payload.data;
+   p_item_b = (const pf_diag_std_t *)p_b->payload.data;
+
+   return (p_item_a->ch_nbr == p_item_b->ch_nbr) &&
+          (PF_DIAG_CH_PROP_ACC_GET (p_item_a->ch_properties) ==
+           PF_DIAG_CH_PROP_ACC_GET (p_item_b->ch_properties)) &&
+          (PF_DIAG_CH_PROP_DIR_GET (p_item_a->ch_properties) ==
+           PF_DIAG_CH_PROP_DIR_GET (p_item_b->ch_properties)) &&
+          (p_item_a->ch_error_type == p_item_b->ch_error_type) &&
+          (p_item_a->ext_ch_error_type == p_item_b->ext_ch_error_type);
 }
 
-bool pf_alarm_pending (const pf_ar_t * p_ar)
-{
+/**
+ * Merge a diagnosis alarm with an alarm for the same diagnosis waiting in
+ * the send queue.
+ *
+ * Only the latest waiting alarm for the same diagnosis is considered, so that
+ * the alarms for a diagnosis reach the controller in the order they were
+ * queued. It is replaced by the new alarm, but keeps its place in the queue
+ * and its time of queueing.
+ *
+ * In standard format, only an "appears" alarm replaces a waiting "appears"
+ * alarm. The waiting value has not been sent, so it is not needed anymore.
+ * A disappear alarm is never merged, as it might remove a value that
+ * the controller already has (for example the old value when a diagnosis is
+ * updated).
+ *
+ * Waiting alarms are modified in place, under the queue mutex. The consumer
+ * of a send queue also takes the mutex, so it never reads a waiting alarm
+ * while it is modified.
+ *
+ * @param q                InOut: Alarm send queue (High or low prio)
+ * @param p_alarm_data     In:    Alarm details (Alarm type, slot, subslot,
+ *                                possibly payload etc)
+ * @return 0  if the alarm is merged with a waiting alarm
+ *         -1 if there is no waiting alarm it can be merged with
+ */
+int pf_alarm_send_queue_merge (
+   pf_alarm_send_queue_t * q,
+   const pf_alarm_data_t * p_alarm_data)
+{
+   const pf_diag_std_t * p_new_item;
+   const pf_diag_std_t * p_waiting_item;
+   uint16_t read_index;
+   uint16_t slot;
+   uint16_t latest_slot = 0;
+   bool found = false;
+   uint16_t n;
+   uint32_t queued_time_us;
+   int ret = -1;
+
+   if (
+      (pf_alarm_queue_is_available (&q->accountant) == false) ||
+      (pf_alarm_is_diagnosis_type (p_alarm_data->alarm_type) == false))
+   {
+      return ret;
+   }
+
+   pf_alarm_queue_lock (&q->accountant);
+   read_index = pf_alarm_queue_load_index (&q->accountant.read_index);
+   for (n = pf_alarm_queue_count (&q->accountant); n > 0; n--)
+   {
+      slot = pf_alarm_queue_slot (&q->accountant, read_index);
+      if (pf_alarm_is_same_diagnosis (&q->items[slot], p_alarm_data))
+      {
+         latest_slot = slot;
+         found = true;
+      }
+
+      read_index = pf_alarm_queue_next_index (&q->accountant, read_index);
+   }
+
+   if (found == true)
+   {
+      p_new_item = (const pf_diag_std_t *)p_alarm_data->payload.data;
+      p_waiting_item =
+         (const pf_diag_std_t *)q->items[latest_slot].payload.data;
+      if (
+         (p_alarm_data->payload.usi < PF_USI_CHANNEL_DIAGNOSIS) ||
+         ((PF_DIAG_CH_PROP_SPEC_GET (p_new_item->ch_properties) ==
+           PF_DIAG_CH_PROP_SPEC_APPEARS) &&
+          (PF_DIAG_CH_PROP_SPEC_GET (p_waiting_item->ch_properties) ==
+           PF_DIAG_CH_PROP_SPEC_APPEARS)))
+      {
+         queued_time_us = q->items[latest_slot].queued_time_us;
+         q->items[latest_slot] = *p_alarm_data;
+         q->items[latest_slot].queued_time_us = queued_time_us;
+         ret = 0;
+      }
+   }
+   pf_alarm_queue_unlock (&q->accountant);
+
+   return ret;
+}
+
+/****************************************************************************/
+
+/**
+ * @internal
+ * Get the max number of tokens in the diagnosis alarm token bucket.
+ *
+ * @param net              In:    The p-net stack instance
+ * @return The bucket size.
+ */
+static uint16_t pf_alarm_diag_bucket_size (pnet_t * net)
+{
+   pnet_cfg_t * p_cfg = NULL;
+
+   pf_fspm_get_cfg (net, &p_cfg);
+   if (p_cfg->diag_alarm_burst > 0)
+   {
+      return p_cfg->diag_alarm_burst;
+   }
+
+   return p_cfg->diag_alarm_rate;
+}
+
+/**
+ * @internal
+ * Check the diagnosis alarm rate limit, before sending the next alarm in a
+ * send queue.
+ *
+ * The token bucket is refilled with diag_alarm_rate tokens per second, up to
+ * the bucket size. Sending a diagnosis alarm uses one token. Other alarm
+ * types are not limited, but wait behind limited diagnosis alarms in the same
+ * queue.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @param q                InOut: Alarm send queue (High or low prio)
+ * @return true if the next alarm in the queue may be sent now.
+ */
+static bool pf_alarm_diag_rate_check (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   pf_alarm_send_queue_t * q)
+{
+   pnet_cfg_t * p_cfg = NULL;
+   uint16_t bucket_size = pf_alarm_diag_bucket_size (net);
+   bool is_diagnosis = false;
+   uint16_t read_index;
+
+   pf_fspm_get_cfg (net, &p_cfg);
+   if (p_cfg->diag_alarm_rate == 0)
+   {
+      return true;
+   }
+
+   pf_alarm_queue_lock (&q->accountant);
+   if (pf_alarm_queue_get_readindex (&q->accountant, &read_index) == 0)
+   {
+      is_diagnosis =
+         pf_alarm_is_diagnosis_type (q->items[read_index].alarm_type);
+   }
+   pf_alarm_queue_unlock (&q->accountant);
+
+   if (is_diagnosis == false)
+   {
+      return true;
+   }
+
+   return pf_scheduler_token_take (
+      &p_ar->diag_alarm_bucket,
+      p_cfg->diag_alarm_rate,
+      bucket_size,
+      os_get_current_time_us());
+}
+
+/**
+ * Add a measured latency to an alarm latency histogram.
+ *
+ * @param p_latency        InOut: Latency histogram
+ * @param latency_us       In:    Measured latency, in microseconds
+ */
+void pf_alarm_latency_add (
+   pnet_alarm_latency_t * p_latency,
+   uint32_t latency_us)
+{
+   uint32_t latency_ms = latency_us / 1000;
+   uint16_t bucket = 0;
+
+   while ((latency_ms > 0) && (bucket < PNET_ALARM_LATENCY_BUCKETS - 1))
+   {
+      latency_ms >>= 1;
+      bucket++;
+   }
+
+   p_latency->count++;
+   p_latency->last_us = latency_us;
+   if (latency_us > p_latency->max_us)
+   {
+      p_latency->max_us = latency_us;
+   }
+   p_latency->buckets[bucket]++;
+}
+
+/**
+ * @internal
+ * Update the send queue counters when an alarm is fetched from the queue.
+ *
+ * @param p_counters       InOut: Queue counters
+ * @param p_alarm_data     In:    The fetched alarm
+ */
+static void pf_alarm_count_sent (
+   pnet_alarm_prio_statistics_t * p_counters,
+   const pf_alarm_data_t * p_alarm_data)
+{
+   p_counters->sent++;
+   pf_alarm_latency_add (
+      &p_counters->queue_time,
+      os_get_current_time_us() - p_alarm_data->queued_time_us);
+}
+
+/**
+ * @internal
+ * Handle outgoing alarm messages for one AR instance.
+ *
+ * When called this function checks the ALMPI state for high and
+ * low priority alarms. If state is PF_ALPMI_STATE_W_ALARM and a alarm
+ * is found in the send queue this alarm is sent.
+ *
+ * At most alarm_send_budget alarms (from pnet_cfg_t) are sent in each call,
+ * high prio first. A low prio alarm that has been held back by high prio
+ * alarms in PF_ALARM_LOW_PRIO_MAX_SKIPS calls is sent before high prio
+ * alarms in the next call.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+static void pf_alarm_almpi_periodic (pnet_t * net, pf_ar_t * p_ar)
+{
+   int res = 0;
+   int16_t prio;
+   uint16_t n;
+   uint16_t budget;
+   bool low_prio_first;
+   pf_apmx_t * p_apmx;
+   pf_alarm_send_queue_t * q;
+   pf_alarm_data_t alarm_data;
+   pnet_cfg_t * p_cfg = NULL;
+
+   if (p_ar->alarm_enable == true)
+   {
+      pf_fspm_get_cfg (net, &p_cfg);
+      budget = (p_cfg->alarm_send_budget > 0) ? p_cfg->alarm_send_budget : 1;
+      low_prio_first =
+         (p_ar->alarm_low_prio_skips >= PF_ALARM_LOW_PRIO_MAX_SKIPS);
+
+      for (n = 0; n < PF_ALARM_NUMBER_OF_PRIORITY_LEVELS; n++)
+      {
+         prio = low_prio_first ? n : 1 - n;
+         p_apmx = &p_ar->apmx[prio];
+         q = &p_ar->alarm_send_q[prio];
+         if (p_apmx->p_alpmx->alpmi_state != PF_ALPMI_STATE_W_ALARM)
+         {
+            continue;
+         }
+
+         if (budget == 0)
+         {
+            if (prio == 0 && pf_alarm_queue_count (&q->accountant) > 0)
+            {
+               p_ar->alarm_low_prio_skips++;
+            }
+            continue;
+         }
+
+         if (pf_alarm_diag_rate_check (net, p_ar, q) == true)
+         {
+            res = pf_alarm_send_queue_fetch (q, &alarm_data);
+            if (res == 0)
+            {
+               pf_alarm_count_sent (&p_apmx->counters, &alarm_data);
+               (void)pf_alarm_send_internal (net, p_ar, p_apmx, &alarm_data);
+               budget--;
+               if (prio == 0)
+               {
+                  p_ar->alarm_low_prio_skips = 0;
+               }
+            }
+         }
+      }
+   }
+}
+
+/************************ Common alarm functions *****************************/
+
+void pf_alarm_enable (pf_ar_t * p_ar)
+{
+   p_ar->alarm_enable = true;
+}
+
+void pf_alarm_disable (pf_ar_t * p_ar)
+{
+   p_ar->alarm_enable = false;
+}
+
+bool pf_alarm_pending (const pf_ar_t * p_ar)
+{
    /* ToDo: Handle this call from cmpbe. */
    return false;
 }
 
+/**
+ * @internal
+ * Calculate the size of the alarm queue memory for one AR.
+ *
+ * @param max_alarms       In:    Number of alarms in each queue.
+ * @return the size in bytes.
+ */
+static size_t pf_alarm_pool_size_per_ar (uint16_t max_alarms)
+{
+   return PF_ALARM_NUMBER_OF_PRIORITY_LEVELS *
+          (PF_POOL_ALIGN (max_alarms * sizeof (pf_alarm_data_t)) +
+           PF_POOL_ALIGN (max_alarms * sizeof (pf_apmr_msg_t)));
+}
+
+size_t pf_alarm_pool_size (const pnet_cfg_t * p_cfg)
+{
+   /* One part for each instance in net->cmrpc_ar */
+   return (PNET_MAX_AR + 1) * pf_alarm_pool_size_per_ar (p_cfg->max_alarms);
+}
+
+/**
+ * @internal
+ * Set the memory for the alarm queues of an AR, from the alarm pool.
+ *
+ * The AR instances are cleared when released, so this is done at each
+ * activation.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+static int pf_alarm_init_queues (pnet_t * net, pf_ar_t * p_ar)
+{
+   pnet_cfg_t * p_cfg = NULL;
+   uint8_t * p_mem;
+   uint16_t ar_ix;
+   uint16_t i;
+
+   ar_ix = (uint16_t)(p_ar - net->cmrpc_ar);
+   if (ar_ix >= NELEMENTS (net->cmrpc_ar))
+   {
+      LOG_ERROR (
+         PF_ALARM_LOG,
+         "Alarm(%d): No alarm queue memory for AR index %u\n",
+         __LINE__,
+         (unsigned)ar_ix);
+      return -1;
+   }
+
+   pf_fspm_get_cfg (net, &p_cfg);
+   p_mem = net->alarm_pool +
+           ar_ix * pf_alarm_pool_size_per_ar (p_cfg->max_alarms);
+   for (i = 0; i < PF_ALARM_NUMBER_OF_PRIORITY_LEVELS; i++)
+   {
+      pf_alarm_send_queue_init (
+         &p_ar->alarm_send_q[i],
+         (pf_alarm_data_t *)p_mem,
+         p_cfg->max_alarms);
+      p_mem += PF_POOL_ALIGN (p_cfg->max_alarms * sizeof (pf_alarm_data_t));
+
+      pf_alarm_receive_queue_init (
+         &p_ar->apmx[i].alarm_receive_q,
+         (pf_apmr_msg_t *)p_mem,
+         p_cfg->max_alarms);
+      p_mem += PF_POOL_ALIGN (p_cfg->max_alarms * sizeof (pf_apmr_msg_t));
+   }
+
+   return 0;
+}
+
 int pf_alarm_activate (pnet_t * net, pf_ar_t * p_ar)
 {
    int ret = 0; /* Assume all goes well */
    int16_t i;
    pf_alarm_send_queue_t * q;
 
+   if (pf_alarm_init_queues (net, p_ar) != 0)
+   {
+      return -1;
+   }
+
    for (i = 0; i < PF_ALARM_NUMBER_OF_PRIORITY_LEVELS; i++)
    {
       q = &p_ar->alarm_send_q[i];
@@ -2780,6 +3526,11 @@ int pf_alarm_activate (pnet_t * net, pf_ar_t * p_ar)
       pf_alarm_send_queue_reset (q);
    }
 
+   /* Start with a full token bucket for the diagnosis alarm rate limit */
+   p_ar->diag_alarm_bucket.tokens = pf_alarm_diag_bucket_size (net);
+   p_ar->diag_alarm_bucket.time = os_get_current_time_us();
+   p_ar->alarm_low_prio_skips = 0;
+
    if (pf_alarm_alpmx_activate (p_ar) != 0)
    {
       ret = -1;
@@ -3088,15 +3839,17 @@ int pf_alarm_alpmr_alarm_ack (
  *                                block type = alarm notify.
  *                                Use 0 for no payload (not even the USI value).
  * @param payload_len      In:    Number of bytes of manufaturer data,
- *                                or sizeof(pf_diag_item_t) for diagnosis in
- *                                standard format.
+ *                                or the size of the pf_diag_std_t array for
+ *                                diagnosis in standard format.
  *                                May be 0 also for manufacturer data.
- *                                Max PNET_MAX_ALARM_PAYLOAD_DATA_SIZE or
+ *                                The encoded size is max
+ *                                PNET_MAX_ALARM_PAYLOAD_DATA_SIZE or
  *                                value from PLC.
- * @param p_payload        In:    pf_diag_item_t, manufacturer data or NULL.
+ * @param p_payload        In:    Array of pf_diag_std_t (all with the payload
+ *                                USI), manufacturer data or NULL.
  *                                Mandatory if payload_len > 0 or for USI
  *                                values for diagnosis in standard format
- *                                (which expect a pf_diag_item_t)
+ *                                (which expect a pf_diag_std_t)
  * @return  0  if operation succeeded.
  *          -1 if an error occurred. Errors include:
  *             Payload oversize (process alarms only)
@@ -3119,6 +3872,11 @@ static int pf_alarm_send_alarm (
    const uint8_t * p_payload)
 {
    pf_alarm_data_t alarm_data;
+   pf_alarm_send_queue_t * p_queue;
+   pnet_alarm_prio_statistics_t * p_counters;
+   pf_diag_item_t item;
+   uint16_t depth;
+   uint16_t data_len = payload_len;
 
    if (net->global_alarm_enable == false || p_ar->alarm_enable == false)
    {
@@ -3133,39 +3891,52 @@ static int pf_alarm_send_alarm (
       return -1;
    }
 
-   if (payload_len > sizeof (alarm_data.payload.data))
+   if (payload_len > 0 && p_payload == NULL)
    {
       LOG_ERROR (
          PF_ALARM_LOG,
-         "Alarm(%d): You provided too long alarm payload (%u bytes) but max "
-         "is %zu. Increase PNET_MAX_ALARM_PAYLOAD_DATA_SIZE.\n",
+         "Alarm(%d): payload_len is %u but no payload is given.\n",
          __LINE__,
-         payload_len,
-         sizeof (alarm_data.payload.data));
+         payload_len);
 
       return -1;
    }
 
-   if (payload_len > p_ar->alarm_cr_request.max_alarm_data_length)
+   /* Diagnosis in standard format is stored as an array of pf_diag_std_t,
+      but the limits apply to the encoded size */
+   if (
+      payload_usi == PF_USI_CHANNEL_DIAGNOSIS ||
+      payload_usi == PF_USI_EXTENDED_CHANNEL_DIAGNOSIS ||
+      payload_usi == PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS)
+   {
+      memset (&item, 0, sizeof (item));
+      item.usi = payload_usi;
+      data_len = (payload_len / sizeof (pf_diag_std_t)) *
+                 pf_put_diag_item_size (&item);
+   }
+
+   if (data_len > PNET_MAX_ALARM_PAYLOAD_DATA_SIZE)
    {
       LOG_ERROR (
          PF_ALARM_LOG,
-         "Alarm(%d): You provided too long alarm payload (%u bytes) but PLC "
-         "said max %u bytes.\n",
+         "Alarm(%d): You provided too long alarm payload (%u bytes) but max "
+         "is %d. Increase PNET_MAX_ALARM_PAYLOAD_DATA_SIZE.\n",
          __LINE__,
-         payload_len,
-         p_ar->alarm_cr_request.max_alarm_data_length);
+         data_len,
+         PNET_MAX_ALARM_PAYLOAD_DATA_SIZE);
 
       return -1;
    }
 
-   if (payload_len > 0 && p_payload == NULL)
+   if (data_len > p_ar->alarm_cr_request.max_alarm_data_length)
    {
       LOG_ERROR (
          PF_ALARM_LOG,
-         "Alarm(%d): payload_len is %u but no payload is given.\n",
+         "Alarm(%d): You provided too long alarm payload (%u bytes) but PLC "
+         "said max %u bytes.\n",
          __LINE__,
-         payload_len);
+         data_len,
+         p_ar->alarm_cr_request.max_alarm_data_length);
 
       return -1;
    }
@@ -3186,6 +3957,7 @@ static int pf_alarm_send_alarm (
    {
       memcpy (alarm_data.payload.data, p_payload, payload_len);
    }
+   alarm_data.queued_time_us = os_get_current_time_us();
 
    LOG_DEBUG (
       PF_ALARM_LOG,
@@ -3196,9 +3968,31 @@ static int pf_alarm_send_alarm (
       alarm_type,
       payload_len);
 
-   return pf_alarm_send_queue_post (
-      &p_ar->alarm_send_q[high_prio ? 1 : 0],
-      &alarm_data);
+   p_queue = &p_ar->alarm_send_q[high_prio ? 1 : 0];
+   p_counters = &p_ar->apmx[high_prio ? 1 : 0].counters;
+   if (pf_alarm_send_queue_merge (p_queue, &alarm_data) == 0)
+   {
+      LOG_DEBUG (
+         PF_ALARM_LOG,
+         "Alarm(%d): Merged with a waiting alarm for the same diagnosis.\n",
+         __LINE__);
+
+      return 0;
+   }
+
+   if (pf_alarm_send_queue_post (p_queue, &alarm_data) != 0)
+   {
+      p_counters->send_queue_full++;
+      return -1;
+   }
+
+   depth = pf_alarm_queue_count (&p_queue->accountant);
+   if (depth > p_counters->send_queue_depth_max)
+   {
+      p_counters->send_queue_depth_max = depth;
+   }
+
+   return 0;
 }
 
 /************************ Send specific alarm types **************************/
@@ -3285,41 +4079,41 @@ int pf_alarm_send_process (
       p_payload);
 }
 
-int pf_alarm_send_diagnosis (
+/**
+ * @internal
+ * Find the module and sub-module identities, and put a diagnosis alarm in
+ * the low prio send queue.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @param alarm_type       In:    The alarm type.
+ * @param api_id           In:    The API identifier.
+ * @param slot_nbr         In:    The slot number.
+ * @param subslot_nbr      In:    The sub-slot number.
+ * @param usi              In:    The payload USI.
+ * @param nbr_of_items     In:    Number of diag items (for logging).
+ * @param payload_len      In:    Number of bytes of manufacturer data, or
+ *                                the size of the pf_diag_std_t array.
+ * @param p_payload        In:    Manufacturer data or array of
+ *                                pf_diag_std_t.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+static int pf_alarm_send_diagnosis_payload (
    pnet_t * net,
    pf_ar_t * p_ar,
+   pf_alarm_type_values_t alarm_type,
    uint32_t api_id,
    uint16_t slot_nbr,
    uint16_t subslot_nbr,
-   const pf_diag_item_t * p_diag_item)
+   uint16_t usi,
+   uint16_t nbr_of_items,
+   uint16_t payload_len,
+   const uint8_t * p_payload)
 {
-   pf_alarm_type_values_t alarm_type = PF_ALARM_TYPE_DIAGNOSIS;
    uint32_t module_ident = 0;
    uint32_t submodule_ident = 0;
 
-   if (p_diag_item == NULL)
-   {
-      LOG_ERROR (
-         PF_ALARM_LOG,
-         "Alarm(%d): The diagnosis item is NULL\n",
-         __LINE__);
-
-      return -1;
-   }
-
-   /* Calculate alarm type */
-   if (p_diag_item->usi >= PF_USI_CHANNEL_DIAGNOSIS)
-   {
-      switch (p_diag_item->fmt.std.ch_error_type)
-      {
-      case PF_WRT_ERROR_REMOTE_MISMATCH:
-         alarm_type = PF_ALARM_TYPE_PORT_DATA_CHANGE;
-         break;
-      default:
-         break;
-      }
-   }
-
    /* Find module and submodule identities */
    if (pf_cmdev_get_module_ident (net, api_id, slot_nbr, &module_ident) != 0)
    {
@@ -3355,49 +4149,170 @@ int pf_alarm_send_diagnosis (
       "Alarm(%d): Sending diagnosis alarm "
       "(type 0x%04X) Slot: %u  Subslot: 0x%04X  "
       "Module ident: %u Submodule ident: %u "
-      "USI: 0x%04X\n",
+      "USI: 0x%04X Items: %u\n",
       __LINE__,
       alarm_type,
       slot_nbr,
       subslot_nbr,
       (unsigned)module_ident,
       (unsigned)submodule_ident,
-      p_diag_item->usi);
+      usi,
+      nbr_of_items);
+
+   return pf_alarm_send_alarm (
+      net,
+      p_ar,
+      alarm_type,
+      false, /* Low prio */
+      api_id,
+      slot_nbr,
+      subslot_nbr,
+      NULL,
+      module_ident,
+      submodule_ident,
+      usi,
+      payload_len,
+      p_payload);
+}
+
+/**
+ * @internal
+ * Calculate the alarm type for a diag item in standard format.
+ *
+ * @param p_diag_std       In:    The diag item in standard format.
+ * @return The alarm type.
+ */
+static pf_alarm_type_values_t pf_alarm_diag_std_alarm_type (
+   const pf_diag_std_t * p_diag_std)
+{
+   if (p_diag_std->ch_error_type == PF_WRT_ERROR_REMOTE_MISMATCH)
+   {
+      return PF_ALARM_TYPE_PORT_DATA_CHANGE;
+   }
+
+   return PF_ALARM_TYPE_DIAGNOSIS;
+}
+
+int pf_alarm_send_diagnosis (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   uint16_t subslot_nbr,
+   const pf_diag_item_t * p_diag_item)
+{
+   if (p_diag_item == NULL)
+   {
+      LOG_ERROR (
+         PF_ALARM_LOG,
+         "Alarm(%d): The diagnosis item is NULL\n",
+         __LINE__);
+
+      return -1;
+   }
 
    if (p_diag_item->usi < PF_USI_CHANNEL_DIAGNOSIS)
    {
       /* USI format */
-      return pf_alarm_send_alarm (
+      return pf_alarm_send_diagnosis_payload (
          net,
          p_ar,
-         alarm_type,
-         false, /* Low prio */
+         pf_alarm_diag_item_alarm_type (p_diag_item),
          api_id,
          slot_nbr,
          subslot_nbr,
-         p_diag_item,
-         module_ident,
-         submodule_ident,
          p_diag_item->usi,
+         1,
          p_diag_item->fmt.usi.len,
          (uint8_t *)&p_diag_item->fmt.usi.manuf_data);
    }
 
    /* Standard format */
-   return pf_alarm_send_alarm (
+   return pf_alarm_send_diagnosis_items (
       net,
       p_ar,
-      alarm_type,
-      false, /* Low prio */
       api_id,
       slot_nbr,
       subslot_nbr,
-      p_diag_item,
-      module_ident,
-      submodule_ident,
       p_diag_item->usi,
-      sizeof (*p_diag_item),
-      (uint8_t *)p_diag_item);
+      &p_diag_item->fmt.std,
+      1);
+}
+
+pf_alarm_type_values_t pf_alarm_diag_item_alarm_type (
+   const pf_diag_item_t * p_diag_item)
+{
+   if (p_diag_item->usi >= PF_USI_CHANNEL_DIAGNOSIS)
+   {
+      return pf_alarm_diag_std_alarm_type (&p_diag_item->fmt.std);
+   }
+
+   return PF_ALARM_TYPE_DIAGNOSIS;
+}
+
+int pf_alarm_send_diagnosis_items (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   uint16_t subslot_nbr,
+   uint16_t usi,
+   const pf_diag_std_t * p_diag_items,
+   uint16_t nbr_of_items)
+{
+   pf_alarm_type_values_t alarm_type = PF_ALARM_TYPE_DIAGNOSIS;
+   uint16_t ix;
+
+   if (p_diag_items == NULL || nbr_of_items == 0)
+   {
+      LOG_ERROR (
+         PF_ALARM_LOG,
+         "Alarm(%d): The diagnosis item is NULL\n",
+         __LINE__);
+
+      return -1;
+   }
+
+   if (usi < PF_USI_CHANNEL_DIAGNOSIS)
+   {
+      LOG_ERROR (
+         PF_ALARM_LOG,
+         "Alarm(%d): Only diagnosis in standard format can be sent as a "
+         "list\n",
+         __LINE__);
+
+      return -1;
+   }
+
+   /* Calculate alarm type. All items are sent in the same alarm, so they
+      must give the same alarm type. */
+   alarm_type = pf_alarm_diag_std_alarm_type (&p_diag_items[0]);
+   for (ix = 1; ix < nbr_of_items; ix++)
+   {
+      if (pf_alarm_diag_std_alarm_type (&p_diag_items[ix]) != alarm_type)
+      {
+         LOG_ERROR (
+            PF_ALARM_LOG,
+            "Alarm(%d): Diagnosis item %u has another alarm type than the "
+            "first one\n",
+            __LINE__,
+            ix);
+
+         return -1;
+      }
+   }
+
+   return pf_alarm_send_diagnosis_payload (
+      net,
+      p_ar,
+      alarm_type,
+      api_id,
+      slot_nbr,
+      subslot_nbr,
+      usi,
+      nbr_of_items,
+      nbr_of_items * sizeof (*p_diag_items),
+      (const uint8_t *)p_diag_items);
 }
 
 int pf_alarm_send_usi_diagnosis_disappears (
@@ -20,6 +20,10 @@
 extern "C" {
 #endif
 
+/* Number of periodic calls a low prio alarm may be held back by high prio
+ * alarms, before it is sent first */
+#define PF_ALARM_LOW_PRIO_MAX_SKIPS 4
+
 /**
  * Initialize the alarm component.
  *
@@ -53,6 +57,16 @@ void pf_alarm_free_endpoint (pnet_t * net, pf_ar_t * ar);
  */
 int pf_alarm_activate (pnet_t * net, pf_ar_t * p_ar);
 
+/**
+ * Calculate the size of the memory pool for the alarm queues of all ARs.
+ *
+ * The queues of each AR are placed in net->alarm_pool at activation.
+ *
+ * @param p_cfg            In:    Configuration, with max_alarms set.
+ * @return  The pool size in bytes.
+ */
+size_t pf_alarm_pool_size (const pnet_cfg_t * p_cfg);
+
 /**
  * Close an alarm instance for the specified AR.
  *
@@ -273,6 +287,37 @@ int pf_alarm_send_diagnosis (
    uint16_t subslot_nbr,
    const pf_diag_item_t * p_diag_item);
 
+/**
+ * Send one diagnosis alarm for several diag items in standard format.
+ *
+ * All items have the given USI, and their channel error types must give
+ * the same alarm type. The items are sent as a list in the alarm payload, so
+ * the encoded items must fit PNET_MAX_ALARM_PAYLOAD_DATA_SIZE.
+ *
+ * The AlarmSpecifier and maintenance status are calculated when the alarm is
+ * sent, from all diagnosis entries of the sub-slot.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @param api_id           In:    The API identifier.
+ * @param slot_nbr         In:    The slot number.
+ * @param subslot_nbr      In:    The sub-slot number.
+ * @param usi              In:    The USI of the items. Min 0x8000.
+ * @param p_diag_items     In:    Array of diag items in standard format.
+ * @param nbr_of_items     In:    Number of diag items in the array.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+int pf_alarm_send_diagnosis_items (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   uint16_t subslot_nbr,
+   uint16_t usi,
+   const pf_diag_std_t * p_diag_items,
+   uint16_t nbr_of_items);
+
 /**
  * Send "diagnosis disappears" alarm for diagnosis in USI format.
  *
@@ -334,6 +379,19 @@ void pf_alarm_queue_mutex_destroy (pf_queue_accountant_t * p_accountant);
 
 bool pf_alarm_queue_is_available (pf_queue_accountant_t * p_accountant);
 
+uint16_t pf_alarm_queue_count (const pf_queue_accountant_t * p_accountant);
+
+int pf_alarm_send_queue_merge (
+   pf_alarm_send_queue_t * q,
+   const pf_alarm_data_t * p_alarm_data);
+
+void pf_alarm_latency_add (
+   pnet_alarm_latency_t * p_latency,
+   uint32_t latency_us);
+
+pf_alarm_type_values_t pf_alarm_diag_item_alarm_type (
+   const pf_diag_item_t * p_diag_item);
+
 void pf_alarm_add_diag_item_to_summary (
    const pf_ar_t * p_ar,
    const pf_subslot_t * p_subslot,
@@ -341,6 +399,11 @@ void pf_alarm_add_diag_item_to_summary (
    pnet_alarm_spec_t * p_alarm_spec,
    uint32_t * p_maint_status);
 
+void pf_alarm_receive_queue_init (
+   pf_alarm_receive_queue_t * q,
+   pf_apmr_msg_t * p_items,
+   uint16_t max_items);
+
 void pf_alarm_receive_queue_reset (pf_alarm_receive_queue_t * q);
 
 int pf_alarm_receive_queue_post (
@@ -351,6 +414,11 @@ int pf_alarm_receive_queue_fetch (
    pf_alarm_receive_queue_t * q,
    pf_apmr_msg_t * p_alarm_frame);
 
+void pf_alarm_send_queue_init (
+   pf_alarm_send_queue_t * q,
+   pf_alarm_data_t * p_items,
+   uint16_t max_items);
+
 void pf_alarm_send_queue_reset (pf_alarm_send_queue_t * q);
 
 int pf_alarm_send_queue_post (
@@ -34,6 +34,7 @@
 #define BG_JOB_EVENT_SAVE_ASE_NVM_DATA    BIT (1)
 #define BG_JOB_EVENT_SAVE_IM_NVM_DATA     BIT (2)
 #define BG_JOB_EVENT_SAVE_PDPORT_NVM_DATA BIT (3)
+#define BG_JOB_EVENT_SAVE_FSU_NVM_DATA    BIT (4)
 
 static void bg_worker_task (void * arg);
 
@@ -71,6 +72,9 @@ int pf_bg_worker_start_job (pnet_t * net, pf_bg_job_t job_id)
    case PF_BGJOB_SAVE_PDPORT_NVM_DATA:
       os_event_set (net->pf_bg_worker.events, BG_JOB_EVENT_SAVE_PDPORT_NVM_DATA);
       break;
+   case PF_BGJOB_SAVE_FSU_NVM_DATA:
+      os_event_set (net->pf_bg_worker.events, BG_JOB_EVENT_SAVE_FSU_NVM_DATA);
+      break;
    default:
       LOG_ERROR (
          PNET_LOG,
@@ -93,7 +97,8 @@ static void bg_worker_task (void * arg)
    pnet_t * net = (pnet_t *)arg;
    uint32_t mask =
       BG_JOB_EVENT_UPDATE_PORTS_STATUS | BG_JOB_EVENT_SAVE_ASE_NVM_DATA |
-      BG_JOB_EVENT_SAVE_IM_NVM_DATA | BG_JOB_EVENT_SAVE_PDPORT_NVM_DATA;
+      BG_JOB_EVENT_SAVE_IM_NVM_DATA | BG_JOB_EVENT_SAVE_PDPORT_NVM_DATA |
+      BG_JOB_EVENT_SAVE_FSU_NVM_DATA;
    uint32_t flags = 0;
 
    for (;;)
@@ -120,6 +125,16 @@ static void bg_worker_task (void * arg)
 
          (void)pf_pdport_save_all (net);
       }
+      if (flags & BG_JOB_EVENT_SAVE_FSU_NVM_DATA)
+      {
+         os_event_clr (
+            net->pf_bg_worker.events,
+            BG_JOB_EVENT_SAVE_FSU_NVM_DATA);
+
+#if PNET_OPTION_FAST_STARTUP
+         pf_fsu_save (net);
+#endif
+      }
       if (flags & BG_JOB_EVENT_UPDATE_PORTS_STATUS)
       {
          os_event_clr (
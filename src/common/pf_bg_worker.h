@@ -36,6 +36,9 @@ typedef enum pf_bg_job
 
    /** Save non volatile PDPort data to file */
    PF_BGJOB_SAVE_PDPORT_NVM_DATA,
+
+   /** Save non volatile Fast Startup data to file */
+   PF_BGJOB_SAVE_FSU_NVM_DATA,
 } pf_bg_job_t;
 
 /**
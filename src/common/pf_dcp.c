@@ -36,6 +36,7 @@
  */
 
 #ifdef UNIT_TEST
+#define os_get_current_time_us mock_os_get_current_time_us
 #endif
 
 #include <string.h>
@@ -902,6 +903,188 @@ static int pf_dcp_set_req (
    return ret;
 }
 
+/**
+ * @internal
+ * Find the rate limiter state for a source MAC address.
+ *
+ * If the source is not tracked, a free entry or the least recently used
+ * entry is taken over. Its token bucket starts half full, so that a sender
+ * changing its source MAC address for each request does not get a full
+ * bucket each time.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_mac_address    In:    Source MAC address.
+ * @param rate             In:    Rate limit per source, in requests per second
+ * @param now              In:    Current time, in microseconds.
+ * @param p_is_new         Out:   true if the source was not tracked before.
+ * @return The rate limiter state for the source.
+ */
+static pf_dcp_source_t * pf_dcp_source_get (
+   pnet_t * net,
+   const pnet_ethaddr_t * p_mac_address,
+   uint16_t rate,
+   uint32_t now,
+   bool * p_is_new)
+{
+   pf_dcp_source_t * p_source = NULL;
+   pf_dcp_source_t * p_oldest = NULL;
+   uint16_t ix;
+
+   for (ix = 0; ix < NELEMENTS (net->dcp_sources); ix++)
+   {
+      p_source = &net->dcp_sources[ix];
+      if (p_source->in_use == false)
+      {
+         if ((p_oldest == NULL) || p_oldest->in_use)
+         {
+            p_oldest = p_source;
+         }
+      }
+      else if (
+         memcmp (
+            p_source->mac_address.addr,
+            p_mac_address->addr,
+            sizeof (pnet_ethaddr_t)) == 0)
+      {
+         p_source->last_time = now;
+         *p_is_new = false;
+         return p_source;
+      }
+      else if (
+         (p_oldest == NULL) ||
+         (p_oldest->in_use &&
+          ((now - p_source->last_time) > (now - p_oldest->last_time))))
+      {
+         p_oldest = p_source;
+      }
+   }
+
+   p_oldest->in_use = true;
+   p_oldest->mac_address = *p_mac_address;
+   p_oldest->last_time = now;
+   p_oldest->bucket.tokens = rate / 2;
+   p_oldest->bucket.time = now;
+   *p_is_new = true;
+
+   return p_oldest;
+}
+
+/**
+ * @internal
+ * Check the rate limits for an incoming DCP request, and update the
+ * DCP statistics.
+ *
+ * Requests are first checked against the token bucket of the source MAC
+ * address, and then against the token bucket of the service. This way a
+ * single flooding source does not use up the tokens of the service.
+ *
+ * Only the PF_DCP_MAX_SOURCES most recent sources are tracked. A request
+ * from a source that is not tracked is checked against the token bucket of
+ * the service only. A flood with changing source MAC addresses is thus
+ * limited only by the service rate limit.
+ *
+ * Get and Set requests are checked before they are parsed. Identify
+ * requests are first parsed and checked against their filter, and only
+ * requests for this station are checked here. Identify requests for other
+ * stations thus do not use up the tokens, but they are always parsed.
+ * Dropped requests get no response.
+ *
+ * Dropping excess requests early keeps the time spent on DCP in the
+ * receive thread bounded, so that cyclic data is not delayed by DCP storms.
+ * It also limits the number of DCP Set requests causing NVM writes.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param service          In:    DCP service of the request.
+ * @param p_mac_address    In:    Source MAC address of the request.
+ * @return true if the request may be handled, false if it should be dropped.
+ */
+static bool pf_dcp_rate_check (
+   pnet_t * net,
+   pf_dcp_rate_service_t service,
+   const pnet_ethaddr_t * p_mac_address)
+{
+   pnet_cfg_t * p_cfg = NULL;
+   pnet_dcp_service_statistics_t * p_counters = NULL;
+   pf_dcp_source_t * p_source = NULL;
+   bool is_new_source = false;
+   uint32_t now;
+
+   switch (service)
+   {
+   case PF_DCP_RATE_IDENTIFY:
+      p_counters = &net->dcp_statistics.identify;
+      break;
+   case PF_DCP_RATE_GET:
+      p_counters = &net->dcp_statistics.get;
+      break;
+   default:
+      p_counters = &net->dcp_statistics.set;
+      break;
+   }
+   p_counters->received++;
+
+   pf_fspm_get_cfg (net, &p_cfg);
+   if ((p_cfg->dcp_rate_limit == 0) && (p_cfg->dcp_source_rate_limit == 0))
+   {
+      return true;
+   }
+
+   now = os_get_current_time_us();
+   if (p_cfg->dcp_source_rate_limit > 0)
+   {
+      p_source = pf_dcp_source_get (
+         net,
+         p_mac_address,
+         p_cfg->dcp_source_rate_limit,
+         now,
+         &is_new_source);
+      if (
+         (is_new_source == false) &&
+         (pf_scheduler_token_take (
+             &p_source->bucket,
+             p_cfg->dcp_source_rate_limit,
+             p_cfg->dcp_source_rate_limit,
+             now) == false))
+      {
+         p_counters->dropped++;
+         net->dcp_statistics.source_dropped++;
+         LOG_DEBUG (
+            PF_DCP_LOG,
+            "DCP(%d): Dropped request. Source rate limit exceeded for "
+            "%02X:%02X:%02X:%02X:%02X:%02X\n",
+            __LINE__,
+            p_mac_address->addr[0],
+            p_mac_address->addr[1],
+            p_mac_address->addr[2],
+            p_mac_address->addr[3],
+            p_mac_address->addr[4],
+            p_mac_address->addr[5]);
+
+         return false;
+      }
+   }
+
+   if (
+      (p_cfg->dcp_rate_limit > 0) &&
+      (pf_scheduler_token_take (
+          &net->dcp_service_bucket[service],
+          p_cfg->dcp_rate_limit,
+          p_cfg->dcp_rate_limit,
+          now) == false))
+   {
+      p_counters->dropped++;
+      LOG_DEBUG (
+         PF_DCP_LOG,
+         "DCP(%d): Dropped request. Rate limit exceeded for service %u\n",
+         __LINE__,
+         (unsigned)service);
+
+      return false;
+   }
+
+   return true;
+}
+
 /**
  * @internal
  * Handle a DCP Set or Get request.
@@ -983,6 +1166,16 @@ static int pf_dcp_get_set (
       goto out;
    }
 
+   if (
+      pf_dcp_rate_check (
+         net,
+         (p_src_dcphdr->service_id == PF_DCP_SERVICE_SET) ? PF_DCP_RATE_SET
+                                                          : PF_DCP_RATE_GET,
+         &p_src_ethhdr->src) == false)
+   {
+      goto out;
+   }
+
    /* Prepare the response */
    p_dst = (uint8_t *)p_rsp->payload;
    dst_pos = 0;
@@ -1420,6 +1613,85 @@ uint32_t pf_dcp_calculate_response_delay (
    return spread * 10 * 1000;
 }
 
+/**
+ * @internal
+ * Insert the blocks of a DCP identify response.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_dst            Out:   The response frame buffer.
+ * @param p_dst_pos        InOut: Position in the response frame buffer.
+ * @param alias_name       In:    Alias name appended if != NULL
+ */
+static void pf_dcp_identify_rsp_put_blocks (
+   pnet_t * net,
+   uint8_t * p_dst,
+   uint16_t * p_dst_pos,
+   const char * alias_name)
+{
+   uint16_t ix;
+
+   for (ix = 0; ix < NELEMENTS (device_options); ix++)
+   {
+      pf_dcp_get_req (
+         net,
+         p_dst,
+         p_dst_pos,
+         PF_FRAME_BUFFER_SIZE,
+         device_options[ix].opt,
+         device_options[ix].sub,
+         true,
+         alias_name);
+   }
+}
+
+/**
+ * @internal
+ * Rebuild the cached blocks of the DCP identify response, if needed.
+ * The length of the station name, used for filtering, is refreshed as well.
+ *
+ * The blocks are stored at the same position as in the response frame, after
+ * the Ethernet header, the frame ID and the DCP header.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param dst_start        In:    Position of the first block in the frame.
+ */
+static void pf_dcp_identify_rsp_update (pnet_t * net, uint16_t dst_start)
+{
+   uint16_t dst_pos = dst_start;
+   uint32_t generation = net->dcp_identify_generation;
+
+   if (
+      (net->dcp_identify_rsp_valid == false) ||
+      (net->dcp_identify_rsp_generation != generation))
+   {
+      net->dcp_station_name_len =
+         (uint16_t)strlen (net->cmina_current_dcp_ase.station_name);
+
+      pf_dcp_identify_rsp_put_blocks (
+         net,
+         net->dcp_identify_rsp,
+         &dst_pos,
+         NULL);
+      net->dcp_identify_rsp_len = dst_pos;
+      net->dcp_identify_rsp_generation = generation;
+      net->dcp_identify_rsp_valid = true;
+
+      LOG_DEBUG (
+         PF_DCP_LOG,
+         "DCP(%d): Rebuilt DCP identify response. Length %u\n",
+         __LINE__,
+         (unsigned)(dst_pos - dst_start));
+   }
+}
+
+void pf_dcp_identify_rsp_invalidate (pnet_t * net)
+{
+   /* The cached response is only written by the thread handling DCP
+    * requests. A change made while it is being rebuilt gives a new
+    * generation, so the response is rebuilt again at the next request. */
+   net->dcp_identify_generation++;
+}
+
 /**
  * @internal
  * Handle an incoming DCP identify request.
@@ -1450,7 +1722,6 @@ static int pf_dcp_identify_req (
    void * p_arg) /* Not used */
 {
    int ret = 0; /* Assume all OK */
-   uint16_t ix;
    bool first = true;   /* First of the blocks */
    bool match = false;  /* Is it for us? */
    bool filter = false; /* Is it IdentifyFilter or IdentifyAll? */
@@ -1568,6 +1839,9 @@ static int pf_dcp_identify_req (
 
    src_block_len = ntohs (p_src_block_hdr->block_length);
 
+   /* Refresh the cached response and the data used for filtering */
+   pf_dcp_identify_rsp_update (net, dst_start);
+
    match = true; /* So far so good */
    while ((ret == 0) && (first || (filter && match)) &&
           (src_dcplen >= (src_pos + src_block_len)) &&
@@ -1711,9 +1985,10 @@ static int pf_dcp_identify_req (
                stationname_position = src_pos;
                stationname_len = src_block_len;
 #endif
+               /* Reject on length before comparing the names */
                if (
-                  (memcmp (p_value, &p_src[src_pos], src_block_len) == 0) &&
-                  (p_value[src_block_len] == '\0'))
+                  (src_block_len == net->dcp_station_name_len) &&
+                  (memcmp (p_value, &p_src[src_pos], src_block_len) == 0))
                {
                   if (first == true)
                   {
@@ -1906,20 +2181,36 @@ static int pf_dcp_identify_req (
       first = false;
    }
 
+   /* Only requests for this station are rate limited, so identify requests
+      for other stations do not use up the tokens */
+   if (
+      (ret == 0) && (match == true) &&
+      (pf_dcp_rate_check (net, PF_DCP_RATE_IDENTIFY, &p_src_ethhdr->src) ==
+       false))
+   {
+      pnal_buf_free (p_rsp);
+      goto out1;
+   }
+
    if ((ret == 0) && (match == true))
    {
 
-      /* Build the response */
-      for (ix = 0; ix < NELEMENTS (device_options); ix++)
+      /* Build the response. The blocks only depend on the request if it
+       * is filtered on an alias name. */
+      if (p_req_alias_name == NULL)
+      {
+         memcpy (
+            &p_dst[dst_start],
+            &net->dcp_identify_rsp[dst_start],
+            net->dcp_identify_rsp_len - dst_start);
+         dst_pos = net->dcp_identify_rsp_len;
+      }
+      else
       {
-         pf_dcp_get_req (
+         pf_dcp_identify_rsp_put_blocks (
             net,
             p_dst,
             &dst_pos,
-            PF_FRAME_BUFFER_SIZE,
-            device_options[ix].opt,
-            device_options[ix].sub,
-            true,
             p_req_alias_name);
       }
 
@@ -2006,8 +2297,22 @@ void pf_dcp_exit (pnet_t * net)
 
 void pf_dcp_init (pnet_t * net)
 {
+   pnet_cfg_t * p_cfg = NULL;
+   uint32_t now = os_get_current_time_us();
+   uint16_t ix;
+
+   pf_fspm_get_cfg (net, &p_cfg);
+   for (ix = 0; ix < NELEMENTS (net->dcp_service_bucket); ix++)
+   {
+      net->dcp_service_bucket[ix].tokens = p_cfg->dcp_rate_limit;
+      net->dcp_service_bucket[ix].time = now;
+   }
+   memset (net->dcp_sources, 0, sizeof (net->dcp_sources));
+   memset (&net->dcp_statistics, 0, sizeof (net->dcp_statistics));
+
    net->dcp_global_block_qualifier = 0;
    net->dcp_delayed_response_waiting = false;
+   net->dcp_identify_rsp_valid = false;
    net->dcp_sam = mac_nil;
    pf_scheduler_init_handle (&net->dcp_sam_timeout, "dcp_sam");
    pf_scheduler_init_handle (&net->dcp_led_timeout, "dcp_led");
@@ -2027,3 +2332,53 @@ void pf_dcp_init (pnet_t * net)
       pf_dcp_identify_req,
       NULL);
 }
+
+void pf_dcp_show (pnet_t * net)
+{
+   pnet_cfg_t * p_cfg = NULL;
+   const pnet_dcp_statistics_t * p_stat = &net->dcp_statistics;
+   const pf_dcp_source_t * p_source = NULL;
+   uint16_t ix;
+
+   pf_fspm_get_cfg (net, &p_cfg);
+
+   printf ("DCP\n");
+   printf (
+      "Rate limit per service         : %u/s\n",
+      (unsigned)p_cfg->dcp_rate_limit);
+   printf (
+      "Rate limit per source          : %u/s\n",
+      (unsigned)p_cfg->dcp_source_rate_limit);
+   printf (
+      "Identify received / dropped    : %u / %u\n",
+      (unsigned)p_stat->identify.received,
+      (unsigned)p_stat->identify.dropped);
+   printf (
+      "Get received / dropped         : %u / %u\n",
+      (unsigned)p_stat->get.received,
+      (unsigned)p_stat->get.dropped);
+   printf (
+      "Set received / dropped         : %u / %u\n",
+      (unsigned)p_stat->set.received,
+      (unsigned)p_stat->set.dropped);
+   printf (
+      "Dropped by source rate limit   : %u\n",
+      (unsigned)p_stat->source_dropped);
+
+   for (ix = 0; ix < NELEMENTS (net->dcp_sources); ix++)
+   {
+      p_source = &net->dcp_sources[ix];
+      if (p_source->in_use)
+      {
+         printf (
+            "Source %02X:%02X:%02X:%02X:%02X:%02X        : %u tokens\n",
+            p_source->mac_address.addr[0],
+            p_source->mac_address.addr[1],
+            p_source->mac_address.addr[2],
+            p_source->mac_address.addr[3],
+            p_source->mac_address.addr[4],
+            p_source->mac_address.addr[5],
+            (unsigned)p_source->bucket.tokens);
+      }
+   }
+}
@@ -128,6 +128,24 @@ void pf_dcp_exit (pnet_t * net);
  */
 int pf_dcp_hello_req (pnet_t * net);
 
+/**
+ * Invalidate the cached response to DCP IDENTIFY requests.
+ *
+ * Must be called whenever data in the response (station name, IP suite,
+ * device identity etc) is changed. May be called from any thread. The
+ * response is rebuilt at the next IDENTIFY request.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+void pf_dcp_identify_rsp_invalidate (pnet_t * net);
+
+/**
+ * Show the DCP rate limiter state and counters.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+void pf_dcp_show (pnet_t * net);
+
 /************ Internal functions, made available for unit testing ************/
 
 uint32_t pf_dcp_calculate_response_delay (
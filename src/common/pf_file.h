@@ -32,6 +32,7 @@ extern "C" {
 #define PF_FILENAME_PDPORT_2    "pnet_data_pdport_2.bin"
 #define PF_FILENAME_PDPORT_3    "pnet_data_pdport_3.bin"
 #define PF_FILENAME_PDPORT_4    "pnet_data_pdport_4.bin"
+#define PF_FILENAME_FSU         "pnet_data_fsu.bin"
 
 /**
  * Load a binary file, and verify the file version.
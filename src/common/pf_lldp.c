@@ -72,6 +72,9 @@
 #define LLDP_PNIO_SUBTYPE_CHASSIS_MAC_TLV_LEN       10
 #define LLDP_IEEE_SUBTYPE_MAC_PHY_TLV_LEN           9
 
+/* Lock-free attempts to copy the peer information before taking the mutex */
+#define LLDP_SNAPSHOT_MAX_ATTEMPTS 8
+
 /* Autonegotiation status */
 #define LLDP_AUTONEG_SUPPORTED BIT (0)
 #define LLDP_AUTONEG_ENABLED   BIT (1)
@@ -457,11 +460,103 @@ static void pf_lldp_add_management (
    pf_put_byte (0, PF_FRAME_BUFFER_SIZE, p_buf, p_pos);
 }
 
+/**
+ * @internal
+ * Start updating the peer information of a port.
+ *
+ * Makes the sequence counter odd, so that lock-free readers retry.
+ * Writers are serialized by the LLDP mutex, which must be held.
+ *
+ * @param p_port_data      InOut: Port runtime data
+ */
+static void pf_lldp_peer_write_begin (pf_port_t * p_port_data)
+{
+#if PNET_USE_ATOMICS
+   atomic_fetch_add_explicit (
+      &p_port_data->lldp.peer_info_seq,
+      1,
+      memory_order_relaxed);
+   atomic_thread_fence (memory_order_release);
+#endif
+}
+
+/**
+ * @internal
+ * Finish updating the peer information of a port.
+ *
+ * Makes the sequence counter even again, publishing the new information.
+ *
+ * @param p_port_data      InOut: Port runtime data
+ */
+static void pf_lldp_peer_write_end (pf_port_t * p_port_data)
+{
+#if PNET_USE_ATOMICS
+   atomic_fetch_add_explicit (
+      &p_port_data->lldp.peer_info_seq,
+      1,
+      memory_order_release);
+#endif
+}
+
+void pf_lldp_get_peer_snapshot (
+   pnet_t * net,
+   int loc_port_num,
+   pf_lldp_peer_snapshot_t * p_snapshot)
+{
+   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+#if PNET_USE_ATOMICS
+   unsigned int seq;
+   uint16_t attempt;
+
+   for (attempt = 0; attempt < LLDP_SNAPSHOT_MAX_ATTEMPTS; attempt++)
+   {
+      seq = atomic_load_explicit (
+         &p_port_data->lldp.peer_info_seq,
+         memory_order_acquire);
+      if ((seq & 1) == 0)
+      {
+         p_snapshot->is_received = p_port_data->lldp.is_peer_info_received;
+         p_snapshot->timestamp_10ms =
+            p_port_data->lldp.timestamp_for_last_peer_change;
+         p_snapshot->info = p_port_data->lldp.peer_info;
+
+         atomic_thread_fence (memory_order_acquire);
+         if (
+            atomic_load_explicit (
+               &p_port_data->lldp.peer_info_seq,
+               memory_order_relaxed) == seq)
+         {
+            return;
+         }
+      }
+   }
+
+   /* The information keeps changing. Writers hold the mutex, so wait for
+    * them instead of spinning. */
+   LOG_DEBUG (
+      PF_LLDP_LOG,
+      "LLDP(%d): Peer information busy on port %d, using the mutex.\n",
+      __LINE__,
+      loc_port_num);
+#endif
+   os_mutex_lock (net->lldp_mutex);
+   p_snapshot->is_received = p_port_data->lldp.is_peer_info_received;
+   p_snapshot->timestamp_10ms =
+      p_port_data->lldp.timestamp_for_last_peer_change;
+   p_snapshot->info = p_port_data->lldp.peer_info;
+   os_mutex_unlock (net->lldp_mutex);
+}
+
 void pf_lldp_invalidate_peer_info (pnet_t * net, int loc_port_num)
 {
    pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
 
    os_mutex_lock (net->lldp_mutex);
+   pf_lldp_peer_write_begin (p_port_data);
+   if (p_port_data->lldp.is_peer_info_received)
+   {
+      net->lldp_peer_generation++;
+   }
    p_port_data->lldp.is_peer_info_received = false;
    p_port_data->lldp.peer_info.chassis_id.is_valid = false;
    p_port_data->lldp.peer_info.port_id.is_valid = false;
@@ -470,6 +565,9 @@ void pf_lldp_invalidate_peer_info (pnet_t * net, int loc_port_num)
    p_port_data->lldp.peer_info.port_delay.is_valid = false;
    p_port_data->lldp.peer_info.phy_config.is_valid = false;
    p_port_data->lldp.peer_info.ttl = 0;
+   p_port_data->lldp.alias_name_len = 0;
+   p_port_data->lldp.is_rx_frame_hash_valid = false;
+   pf_lldp_peer_write_end (p_port_data);
    os_mutex_unlock (net->lldp_mutex);
 }
 
@@ -570,15 +668,12 @@ int pf_lldp_get_peer_timestamp (
    int loc_port_num,
    uint32_t * timestamp_10ms)
 {
-   bool is_received;
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
 
-   os_mutex_lock (net->lldp_mutex);
-   *timestamp_10ms = p_port_data->lldp.timestamp_for_last_peer_change;
-   is_received = p_port_data->lldp.is_peer_info_received;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   *timestamp_10ms = snapshot.timestamp_10ms;
 
-   return is_received ? 0 : -1;
+   return snapshot.is_received ? 0 : -1;
 }
 
 void pf_lldp_get_chassis_id (pnet_t * net, pf_lldp_chassis_id_t * p_chassis_id)
@@ -634,11 +729,10 @@ int pf_lldp_get_peer_chassis_id (
    int loc_port_num,
    pf_lldp_chassis_id_t * p_chassis_id)
 {
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
 
-   os_mutex_lock (net->lldp_mutex);
-   *p_chassis_id = p_port_data->lldp.peer_info.chassis_id;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   *p_chassis_id = snapshot.info.chassis_id;
 
    return p_chassis_id->is_valid ? 0 : -1;
 }
@@ -694,11 +788,10 @@ int pf_lldp_get_peer_port_id (
    int loc_port_num,
    pf_lldp_port_id_t * p_port_id)
 {
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
 
-   os_mutex_lock (net->lldp_mutex);
-   *p_port_id = p_port_data->lldp.peer_info.port_id;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   *p_port_id = snapshot.info.port_id;
 
    return p_port_id->is_valid ? 0 : -1;
 }
@@ -724,11 +817,10 @@ int pf_lldp_get_peer_port_description (
    int loc_port_num,
    pf_lldp_port_description_t * p_port_desc)
 {
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
 
-   os_mutex_lock (net->lldp_mutex);
-   *p_port_desc = p_port_data->lldp.peer_info.port_description;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   *p_port_desc = snapshot.info.port_description;
 
    return p_port_desc->is_valid ? 0 : -1;
 }
@@ -756,11 +848,10 @@ int pf_lldp_get_peer_management_address (
    int loc_port_num,
    pf_lldp_management_address_t * p_man_address)
 {
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
 
-   os_mutex_lock (net->lldp_mutex);
-   *p_man_address = p_port_data->lldp.peer_info.management_address;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   *p_man_address = snapshot.info.management_address;
 
    return p_man_address->is_valid ? 0 : -1;
 }
@@ -775,13 +866,12 @@ int pf_lldp_get_peer_station_name (
    char * p;
    bool found = false;
 
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
    memset (p_station_name, 0, sizeof (*p_station_name));
 
-   os_mutex_lock (net->lldp_mutex);
-   port_id = p_port_data->lldp.peer_info.port_id;
-   chassis_id = p_port_data->lldp.peer_info.chassis_id;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   port_id = snapshot.info.port_id;
+   chassis_id = snapshot.info.chassis_id;
 
    if (port_id.is_valid)
    {
@@ -834,12 +924,11 @@ int pf_lldp_get_peer_port_name (
 {
    pf_lldp_port_id_t port_id;
    size_t i;
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
    memset (p_port_name, 0, sizeof (*p_port_name));
 
-   os_mutex_lock (net->lldp_mutex);
-   port_id = p_port_data->lldp.peer_info.port_id;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   port_id = snapshot.info.port_id;
 
    if (!port_id.is_valid)
    {
@@ -882,11 +971,10 @@ int pf_lldp_get_peer_signal_delays (
    int loc_port_num,
    pf_lldp_signal_delay_t * p_delays)
 {
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
 
-   os_mutex_lock (net->lldp_mutex);
-   *p_delays = p_port_data->lldp.peer_info.port_delay;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   *p_delays = snapshot.info.port_delay;
 
    return p_delays->is_valid ? 0 : -1;
 }
@@ -914,11 +1002,10 @@ int pf_lldp_get_peer_link_status (
    int loc_port_num,
    pf_lldp_link_status_t * p_link_status)
 {
-   const pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pf_lldp_peer_snapshot_t snapshot;
 
-   os_mutex_lock (net->lldp_mutex);
-   *p_link_status = p_port_data->lldp.peer_info.phy_config;
-   os_mutex_unlock (net->lldp_mutex);
+   pf_lldp_get_peer_snapshot (net, loc_port_num, &snapshot);
+   *p_link_status = snapshot.info.phy_config;
 
    return p_link_status->is_valid ? 0 : -1;
 }
@@ -1047,7 +1134,48 @@ size_t pf_lldp_construct_frame (pnet_t * net, int loc_port_num, uint8_t buf[])
 }
 
 /**
- * Build and send a LLDP message on a specific port.
+ * @internal
+ * Compare the parts of two link statuses that are sent in LLDP frames.
+ *
+ * @param p_a              In:    Link status
+ * @param p_b              In:    Link status
+ * @return true if the link statuses are equal.
+ */
+static bool pf_lldp_link_status_is_equal (
+   const pf_lldp_link_status_t * p_a,
+   const pf_lldp_link_status_t * p_b)
+{
+   return (p_a->is_autonegotiation_supported ==
+           p_b->is_autonegotiation_supported) &&
+          (p_a->is_autonegotiation_enabled ==
+           p_b->is_autonegotiation_enabled) &&
+          (p_a->autonegotiation_advertised_capabilities ==
+           p_b->autonegotiation_advertised_capabilities) &&
+          (p_a->operational_mau_type == p_b->operational_mau_type);
+}
+
+void pf_lldp_invalidate_tx_frames (pnet_t * net)
+{
+   net->lldp_tx_generation++;
+}
+
+uint32_t pf_lldp_get_generation (pnet_t * net)
+{
+   uint32_t generation;
+
+   os_mutex_lock (net->lldp_mutex);
+   generation = net->lldp_peer_generation;
+   os_mutex_unlock (net->lldp_mutex);
+
+   return generation + net->lldp_tx_generation;
+}
+
+/**
+ * Send the prebuilt LLDP message on a specific port.
+ *
+ * The message is rebuilt first, if the data in it has changed. It is copied
+ * into a newly allocated buffer, as the driver may keep the buffer after
+ * sending it.
  *
  * @param net              InOut: The p-net stack instance
  * @param loc_port_num     In:    Local port number.
@@ -1055,9 +1183,30 @@ size_t pf_lldp_construct_frame (pnet_t * net, int loc_port_num, uint8_t buf[])
  */
 static void pf_lldp_send (pnet_t * net, int loc_port_num)
 {
-   /* FIXME: Buffer size should include Ethernet header (14 bytes) */
-   pnal_buf_t * p_buffer = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+   pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+   pnal_buf_t * p_buffer = NULL;
+   uint32_t generation = net->lldp_tx_generation;
+   pf_lldp_link_status_t link_status;
+
+   pf_lldp_get_link_status (net, loc_port_num, &link_status);
+   if (
+      (p_port_data->lldp.is_tx_frame_valid == false) ||
+      (p_port_data->lldp.tx_frame_generation != generation) ||
+      (pf_lldp_link_status_is_equal (
+          &p_port_data->lldp.tx_frame_link_status,
+          &link_status) == false))
+   {
+      /* FIXME: Buffer size should include Ethernet header (14 bytes) */
+      p_port_data->lldp.tx_frame_len = (uint16_t)pf_lldp_construct_frame (
+         net,
+         loc_port_num,
+         p_port_data->lldp.tx_frame);
+      p_port_data->lldp.tx_frame_generation = generation;
+      p_port_data->lldp.tx_frame_link_status = link_status;
+      p_port_data->lldp.is_tx_frame_valid = true;
+   }
 
+   p_buffer = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
    if (p_buffer == NULL)
    {
       return;
@@ -1065,8 +1214,11 @@ static void pf_lldp_send (pnet_t * net, int loc_port_num)
 
    if (p_buffer->payload != NULL)
    {
-      p_buffer->len =
-         pf_lldp_construct_frame (net, loc_port_num, p_buffer->payload);
+      memcpy (
+         p_buffer->payload,
+         p_port_data->lldp.tx_frame,
+         p_port_data->lldp.tx_frame_len);
+      p_buffer->len = p_port_data->lldp.tx_frame_len;
       (void)pf_eth_send_on_physical_port (net, loc_port_num, p_buffer);
    }
 
@@ -1169,6 +1321,11 @@ void pf_lldp_init (pnet_t * net)
 
 void pf_lldp_send_enable (pnet_t * net, int loc_port_num)
 {
+   pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
+
+   /* The LLDP mode might have changed */
+   p_port_data->lldp.is_tx_frame_valid = false;
+
    LOG_DEBUG (
       PF_LLDP_LOG,
       "LLDP(%d): Enabling LLDP transmission for port %d\n",
@@ -1805,9 +1962,33 @@ int pf_lldp_generate_alias_name (
    return 0;
 }
 
+/**
+ * @internal
+ * Calculate the hash of an alias name.
+ *
+ * FNV-1a. Only used to quickly reject alias names that do not match.
+ *
+ * @param alias            In:    Alias name. Not necessarily terminated.
+ * @param len              In:    Length of the alias name.
+ * @return  the hash value.
+ */
+static uint32_t pf_lldp_alias_hash (const char * alias, size_t len)
+{
+   uint32_t hash = 2166136261u;
+   size_t ix;
+
+   for (ix = 0; ix < len; ix++)
+   {
+      hash = (hash ^ (uint8_t)alias[ix]) * 16777619u;
+   }
+
+   return hash;
+}
+
 bool pf_lldp_is_alias_matching (pnet_t * net, const char * alias)
 {
-   char port_alias[PF_ALIAS_NAME_MAX_SIZE]; /** Terminated */
+   size_t len = strlen (alias);
+   uint32_t hash = pf_lldp_alias_hash (alias, len);
    int port;
    pf_port_iterator_t port_iterator;
    pf_port_t * p_port_data = NULL;
@@ -1819,16 +2000,11 @@ bool pf_lldp_is_alias_matching (pnet_t * net, const char * alias)
       p_port_data = pf_port_get_state (net, port);
       if (
          p_port_data->lldp.is_peer_info_received &&
-         (pf_lldp_generate_alias_name (
-             p_port_data->lldp.peer_info.port_id.string,
-             p_port_data->lldp.peer_info.chassis_id.string,
-             port_alias,
-             sizeof (port_alias)) == 0))
+         (p_port_data->lldp.alias_name_len == len) &&
+         (p_port_data->lldp.alias_name_hash == hash) &&
+         (strcmp (alias, p_port_data->lldp.alias_name) == 0))
       {
-         if (strcmp (alias, port_alias) == 0)
-         {
-            return true;
-         }
+         return true;
       }
 
       port = pf_port_get_next (&port_iterator);
@@ -1844,7 +2020,8 @@ bool pf_lldp_is_alias_matching (pnet_t * net, const char * alias)
  * Information is stored atomically (by means of the LLDP mutex).
  * This ensures that other threads (e.g. SNMP) will read consistent data.
  *
- * A timestamp is also generated and stored.
+ * A timestamp is also generated and stored, as well as the alias name
+ * generated from the peer information.
  *
  * @param net              InOut: p-net stack instance
  * @param loc_port_num     In:    Local port number.
@@ -1858,13 +2035,36 @@ void pf_lldp_store_peer_info (
 {
    pf_port_t * p_port_data = pf_port_get_state (net, loc_port_num);
    uint32_t timestamp = pnal_get_system_uptime_10ms();
+   char alias[PF_ALIAS_NAME_MAX_SIZE]; /** Terminated */
+   uint16_t alias_len = 0;
+   uint32_t alias_hash = 0;
+
+   if (
+      pf_lldp_generate_alias_name (
+         new_info->port_id.string,
+         new_info->chassis_id.string,
+         alias,
+         sizeof (alias)) == 0)
+   {
+      alias_len = (uint16_t)strlen (alias);
+      alias_hash = pf_lldp_alias_hash (alias, alias_len);
+   }
 
    os_mutex_lock (net->lldp_mutex);
+   pf_lldp_peer_write_begin (p_port_data);
 
+   net->lldp_peer_generation++;
    p_port_data->lldp.is_peer_info_received = true;
    p_port_data->lldp.timestamp_for_last_peer_change = timestamp;
-   p_port_data->lldp.peer_info = *new_info,
+   p_port_data->lldp.peer_info = *new_info;
+   p_port_data->lldp.alias_name_len = alias_len;
+   p_port_data->lldp.alias_name_hash = alias_hash;
+   if (alias_len > 0)
+   {
+      memcpy (p_port_data->lldp.alias_name, alias, alias_len + 1);
+   }
 
+   pf_lldp_peer_write_end (p_port_data);
    os_mutex_unlock (net->lldp_mutex);
 }
 
@@ -1957,6 +2157,75 @@ void pf_lldp_update_peer (
    pf_pdport_peer_indication (net, loc_port_num);
 }
 
+/**
+ * @internal
+ * Calculate a hash of the TLVs in a received LLDP frame, and get the TTL.
+ *
+ * The TTL value is not included in the hash, as it might change without the
+ * rest of the frame changing. Data after the end TLV is not included.
+ *
+ * FNV-1a. Used to detect frames identical to the previous one.
+ *
+ * @param buf              In:    Buffer with the LLDP PDU.
+ * @param len              In:    Length of the buffer.
+ * @param p_hash           Out:   Hash value.
+ * @param p_ttl            Out:   Time to live, in seconds.
+ * @return  0  if the frame has a TTL TLV and an end TLV.
+ *          -1 if the frame is malformed.
+ */
+static int pf_lldp_hash_frame (
+   const uint8_t * buf,
+   uint16_t len,
+   uint32_t * p_hash,
+   uint16_t * p_ttl)
+{
+   uint32_t hash = 2166136261u;
+   uint16_t pos = 0;
+   uint16_t hash_len;
+   uint16_t tlv_header;
+   uint16_t tlv_type;
+   uint16_t tlv_len;
+   uint16_t ix;
+   bool is_ttl_found = false;
+
+   while ((pos + 2) <= len)
+   {
+      tlv_header = (buf[pos] << 8) | buf[pos + 1];
+      tlv_type = (tlv_header & LLDP_TYPE_MASK) >> LLDP_TYPE_SHIFT;
+      tlv_len = tlv_header & LLDP_LENGTH_MASK;
+      if ((pos + 2 + tlv_len) > len)
+      {
+         return -1;
+      }
+
+      hash_len = 2 + tlv_len;
+      if (tlv_type == LLDP_TYPE_TTL)
+      {
+         if (tlv_len < 2)
+         {
+            return -1;
+         }
+         *p_ttl = (buf[pos + 2] << 8) | buf[pos + 3];
+         is_ttl_found = true;
+         hash_len = 2;
+      }
+
+      for (ix = 0; ix < hash_len; ix++)
+      {
+         hash = (hash ^ buf[pos + ix]) * 16777619u;
+      }
+      pos += 2 + tlv_len;
+
+      if (tlv_type == LLDP_TYPE_END)
+      {
+         *p_hash = hash;
+         return is_ttl_found ? 0 : -1;
+      }
+   }
+
+   return -1;
+}
+
 int pf_lldp_recv (
    pnet_t * net,
    int loc_port_num,
@@ -1966,8 +2235,29 @@ int pf_lldp_recv (
    uint8_t * buf = p_frame_buf->payload + offset;
    uint16_t buf_len = p_frame_buf->len - offset;
    pf_lldp_peer_info_t peer_data;
+   pf_port_t * p_port_data = NULL;
+   uint32_t hash = 0;
+   uint16_t ttl = 0;
+   bool is_hashed;
    int err = 0;
 
+   /* Fast path for frames identical to the previous one (except the TTL) */
+   is_hashed = (pf_lldp_hash_frame (buf, buf_len, &hash, &ttl) == 0);
+   if (is_hashed && pf_port_is_valid (net, loc_port_num))
+   {
+      p_port_data = pf_port_get_state (net, loc_port_num);
+      if (
+         p_port_data->lldp.is_rx_frame_hash_valid &&
+         (p_port_data->lldp.rx_frame_hash == hash) &&
+         (p_port_data->lldp.rx_frame_len == buf_len))
+      {
+         pf_lldp_restart_peer_timeout (net, loc_port_num, ttl);
+         pnal_buf_free (p_frame_buf);
+
+         return 1; /* Means: handled */
+      }
+   }
+
    err = pf_lldp_parse_packet (buf, buf_len, &peer_data);
 
    if (!err)
@@ -2019,6 +2309,11 @@ int pf_lldp_recv (
       if (pf_port_is_valid (net, loc_port_num))
       {
          pf_lldp_update_peer (net, loc_port_num, &peer_data);
+
+         p_port_data = pf_port_get_state (net, loc_port_num);
+         p_port_data->lldp.rx_frame_hash = hash;
+         p_port_data->lldp.rx_frame_len = buf_len;
+         p_port_data->lldp.is_rx_frame_hash_valid = is_hashed;
       }
       else
       {
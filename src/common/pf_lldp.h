@@ -261,6 +261,20 @@ typedef struct pf_lldp_peer_info
    pf_lldp_link_status_t phy_config;
 } pf_lldp_peer_info_t;
 
+/**
+ * Consistent copy of the peer information of a port.
+ */
+typedef struct pf_lldp_peer_snapshot
+{
+   /** Is information about peer device received? */
+   bool is_received;
+
+   /** Time of last change of the peer information, in units of 10 ms */
+   uint32_t timestamp_10ms;
+
+   pf_lldp_peer_info_t info;
+} pf_lldp_peer_snapshot_t;
+
 /**
  * Get time when new information about remote device was received.
  *
@@ -678,6 +692,48 @@ int pf_lldp_recv (
  */
 bool pf_lldp_is_alias_matching (pnet_t * net, const char * alias);
 
+/**
+ * Get a consistent copy of the peer information of a port.
+ *
+ * With PNET_USE_ATOMICS the information is read without locking, by means
+ * of a sequence counter per port (a seqlock). A reader never blocks the
+ * LLDP receive path, and retries the copy if the information was updated
+ * during the copy. After a few failed attempts the LLDP mutex is used
+ * instead. Without PNET_USE_ATOMICS the LLDP mutex is always used.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param loc_port_num     In:    Local port number.
+ *                                Valid range: 1 .. num_physical_ports
+ * @param p_snapshot       Out:   Copy of the peer information.
+ */
+void pf_lldp_get_peer_snapshot (
+   pnet_t * net,
+   int loc_port_num,
+   pf_lldp_peer_snapshot_t * p_snapshot);
+
+/**
+ * Invalidate the prebuilt LLDP frames of all ports.
+ *
+ * Must be called whenever the station name or IP address is changed.
+ * The frames are rebuilt before they are sent the next time. Changes of
+ * the link status are detected when sending.
+ *
+ * @param net              InOut: The p-net stack instance.
+ */
+void pf_lldp_invalidate_tx_frames (pnet_t * net);
+
+/**
+ * Get a counter that changes whenever local or peer LLDP data changes.
+ *
+ * Covers the station name, the IP address and the peer information of
+ * all ports. The link status is not covered. Intended for callers that
+ * cache data derived from LLDP, to detect when the cache must be rebuilt.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @return Generation counter. Only comparisons for equality are meaningful.
+ */
+uint32_t pf_lldp_get_generation (pnet_t * net);
+
 /************ Internal functions, made available for unit testing ************/
 
 int pf_lldp_generate_alias_name (
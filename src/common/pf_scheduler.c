@@ -640,3 +640,35 @@ uint32_t pf_scheduler_sanitize_delay (
 
    return resulting_delay;
 }
+
+bool pf_scheduler_token_take (
+   pf_token_bucket_t * p_bucket,
+   uint16_t rate,
+   uint16_t size,
+   uint32_t now)
+{
+   uint32_t new_tokens;
+
+   CC_ASSERT (rate > 0);
+
+   new_tokens =
+      (uint32_t)(((uint64_t)(now - p_bucket->time) * rate) / 1000000);
+   if (p_bucket->tokens + new_tokens >= size)
+   {
+      p_bucket->tokens = size;
+      p_bucket->time = now;
+   }
+   else if (new_tokens > 0)
+   {
+      p_bucket->tokens += new_tokens;
+      p_bucket->time += (uint32_t)(((uint64_t)new_tokens * 1000000) / rate);
+   }
+
+   if (p_bucket->tokens == 0)
+   {
+      return false;
+   }
+
+   p_bucket->tokens--;
+   return true;
+}
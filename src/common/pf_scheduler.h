@@ -167,6 +167,24 @@ void pf_scheduler_tick (pnet_t * net);
  */
 void pf_scheduler_show (pnet_t * net);
 
+/**
+ * Take a token from a rate limiter token bucket.
+ *
+ * The bucket is refilled with \a rate tokens per second, up to \a size
+ * tokens.
+ *
+ * @param p_bucket         InOut: Token bucket.
+ * @param rate             In:    Rate limit, in tokens per second. Not 0.
+ * @param size             In:    Max number of tokens in the bucket.
+ * @param now              In:    Current time, in microseconds.
+ * @return true if a token was available.
+ */
+bool pf_scheduler_token_take (
+   pf_token_bucket_t * p_bucket,
+   uint16_t rate,
+   uint16_t size,
+   uint32_t now);
+
 /************ Internal functions, made available for unit testing ************/
 
 uint32_t pf_scheduler_sanitize_delay (
@@ -503,6 +503,11 @@ int pf_snmp_get_peer_timestamp (
    return pf_lldp_get_peer_timestamp (net, loc_port_num, timestamp_10ms);
 }
 
+uint32_t pf_snmp_get_generation (pnet_t * net)
+{
+   return pf_lldp_get_generation (net);
+}
+
 void pf_snmp_get_chassis_id (pnet_t * net, pf_lldp_chassis_id_t * p_chassis_id)
 {
    pf_lldp_get_chassis_id (net, p_chassis_id);
@@ -499,6 +499,19 @@ int pf_snmp_get_peer_timestamp (
    int loc_port_num,
    uint32_t * p_timestamp_10ms);
 
+/**
+ * Get counter for changes of table rows.
+ * The counter changes whenever a row may have been added to or removed from
+ * a table, or when the index of a row may have changed. This happens when
+ * information about a remote device is received or times out, or when the
+ * station name or IP address is changed. Column values that are not part of
+ * the index (such as link status) may change without affecting the counter.
+ * This may be used by the SNMP server thread for caching table rows.
+ * @param net              In:    The p-net stack instance.
+ * @return Generation counter. Only comparisons for equality are meaningful.
+ */
+uint32_t pf_snmp_get_generation (pnet_t * net);
+
 /**
  * Get Chassis ID of local device.
  *
@@ -23,6 +23,10 @@
  * Most functions have (at least) an input buffer and a position in the buffer
  * as input arguments.
  *
+ * Fixed size parts of headers and blocks are validated against the buffer
+ * length once, by pf_get_reserve(). The fields are then decoded without
+ * further checks by the pf_load_xxx() functions, for the byte order given
+ * by the caller.
  */
 
 #ifdef UNIT_TEST
@@ -35,23 +39,46 @@
 #include "pf_includes.h"
 #include "pf_block_reader.h"
 
-void pf_get_mem (
+/* Sizes of fixed size fields and headers on the wire */
+#define PF_UUID_SIZE             16
+#define PF_BLOCK_HEADER_SIZE     6
+#define PF_FRAME_DESCRIPTOR_SIZE 6
+#define PF_RPC_HANDLE_SIZE       20
+#define PF_DATA_DESCRIPTOR_SIZE  6
+#define PF_NDR_DATA_SIZE         20
+#define PF_DCE_RPC_HEADER_SIZE   80
+
+/* Block lengths, including the block version but not type and length */
+#define PF_FSU_BLOCK_MIN_LENGTH      4 /* Version and padding */
+#define PF_FS_PARAMETER_BLOCK_LENGTH 24
+
+/**
+ * @internal
+ * Reserve a fixed size part of the input buffer.
+ *
+ * Does the bounds check for all fields in the part, which then are decoded
+ * with the unchecked pf_load_xxx() functions.
+ *
+ * @param p_info           InOut: The parser state.
+ * @param p_pos            InOut: Position in the buffer. Advanced by size
+ *                                on success.
+ * @param size             In:    Number of bytes to reserve.
+ * @return Pointer to the first reserved byte, or NULL on error (also sets
+ *         the parser result, unless already in error).
+ */
+static const uint8_t * pf_get_reserve (
    pf_get_info_t * p_info,
    uint16_t * p_pos,
-   uint16_t dest_size,
-   void * p_dest)
+   uint16_t size)
 {
+   const uint8_t * p_data = NULL;
+
    if (p_info->result != PF_PARSE_OK)
    {
       /* Preserve first error */
    }
-   else if (((*p_pos) + dest_size) > p_info->len)
+   else if (((uint32_t)*p_pos + size) > p_info->len)
    {
-      /*
-       * Reached end of buffer
-       * If this is a chain of pbuff then goto the next pbuff,
-       * else this should never happen.
-       */
       LOG_DEBUG (PNET_LOG, "BR(%d): Unexpected end of input data\n", __LINE__);
       p_info->result = PF_PARSE_END_OF_INPUT;
    }
@@ -61,83 +88,113 @@ void pf_get_mem (
    }
    else
    {
-      memcpy (p_dest, &p_info->p_buf[*p_pos], dest_size);
-      (*p_pos) += dest_size;
+      p_data = &p_info->p_buf[*p_pos];
+      (*p_pos) += size;
    }
+
+   return p_data;
 }
 
-uint8_t pf_get_byte (pf_get_info_t * p_info, uint16_t * p_pos)
+/**
+ * @internal
+ * Decode a uint16_t, without bounds check.
+ *
+ * @param p_data           In:    Data to decode.
+ * @param is_big_endian    In:    Byte order of the data.
+ * @return The decoded value.
+ */
+static inline uint16_t pf_load_uint16 (
+   const uint8_t * p_data,
+   bool is_big_endian)
 {
-   uint8_t res = 0;
-
-   if (p_info->result != PF_PARSE_OK)
-   {
-      /* Preserve first error */
-   }
-   else if (*p_pos >= p_info->len)
-   {
-      /* Reached end of buffer */
-      LOG_DEBUG (
-         PNET_LOG,
-         "BR(%d): End of buffer reached when looking for a byte\n",
-         __LINE__);
-      p_info->result = PF_PARSE_END_OF_INPUT;
-   }
-   else if (p_info->p_buf == NULL)
+   if (is_big_endian)
    {
-      p_info->result = PF_PARSE_NULL_POINTER;
+      return (uint16_t)(((uint16_t)p_data[0] << 8) | p_data[1]);
    }
-   else
+
+   return (uint16_t)(((uint16_t)p_data[1] << 8) | p_data[0]);
+}
+
+/**
+ * @internal
+ * Decode a uint32_t, without bounds check.
+ *
+ * @param p_data           In:    Data to decode.
+ * @param is_big_endian    In:    Byte order of the data.
+ * @return The decoded value.
+ */
+static inline uint32_t pf_load_uint32 (
+   const uint8_t * p_data,
+   bool is_big_endian)
+{
+   if (is_big_endian)
    {
-      res = p_info->p_buf[*p_pos];
-      (*p_pos)++;
+      return ((uint32_t)p_data[0] << 24) | ((uint32_t)p_data[1] << 16) |
+             ((uint32_t)p_data[2] << 8) | (uint32_t)p_data[3];
    }
 
-   return res;
+   return ((uint32_t)p_data[3] << 24) | ((uint32_t)p_data[2] << 16) |
+          ((uint32_t)p_data[1] << 8) | (uint32_t)p_data[0];
 }
 
-uint16_t pf_get_uint16 (pf_get_info_t * p_info, uint16_t * p_pos)
+/**
+ * @internal
+ * Decode a UUID, without bounds check.
+ *
+ * @param p_data           In:    Data to decode. PF_UUID_SIZE bytes.
+ * @param is_big_endian    In:    Byte order of the data.
+ * @param p_dest           Out:   Destination buffer.
+ */
+static inline void pf_load_uuid (
+   const uint8_t * p_data,
+   bool is_big_endian,
+   pf_uuid_t * p_dest)
 {
-   uint16_t res = 0;
+   p_dest->data1 = pf_load_uint32 (&p_data[0], is_big_endian);
+   p_dest->data2 = pf_load_uint16 (&p_data[4], is_big_endian);
+   p_dest->data3 = pf_load_uint16 (&p_data[6], is_big_endian);
+   memcpy (p_dest->data4, &p_data[8], sizeof (p_dest->data4));
+}
 
-   if (p_info->result != PF_PARSE_OK)
-   {
-      /* Keep first error */
-   }
-   else if (p_info->is_big_endian)
+void pf_get_mem (
+   pf_get_info_t * p_info,
+   uint16_t * p_pos,
+   uint16_t dest_size,
+   void * p_dest)
+{
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, dest_size);
+
+   if (p_data != NULL)
    {
-      res = ((uint16_t)pf_get_byte (p_info, p_pos) << 8) +
-            (uint16_t)pf_get_byte (p_info, p_pos);
+      memcpy (p_dest, p_data, dest_size);
    }
    else
    {
-      res = (uint16_t)pf_get_byte (p_info, p_pos) +
-            ((uint16_t)pf_get_byte (p_info, p_pos) << 8);
+      memset (p_dest, 0, dest_size);
    }
+}
+
+uint8_t pf_get_byte (pf_get_info_t * p_info, uint16_t * p_pos)
+{
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 1);
 
-   return res;
+   return (p_data != NULL) ? p_data[0] : 0;
 }
 
-uint32_t pf_get_uint32 (pf_get_info_t * p_info, uint16_t * p_pos)
+uint16_t pf_get_uint16 (pf_get_info_t * p_info, uint16_t * p_pos)
 {
-   uint32_t res = 0;
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 2);
 
-   if (p_info->is_big_endian)
-   {
-      res = ((uint32_t)pf_get_byte (p_info, p_pos) << 24) +
-            ((uint32_t)pf_get_byte (p_info, p_pos) << 16) +
-            ((uint32_t)pf_get_byte (p_info, p_pos) << 8) +
-            (uint32_t)pf_get_byte (p_info, p_pos);
-   }
-   else
-   {
-      res = (uint32_t)pf_get_byte (p_info, p_pos) +
-            ((uint32_t)pf_get_byte (p_info, p_pos) << 8) +
-            ((uint32_t)pf_get_byte (p_info, p_pos) << 16) +
-            ((uint32_t)pf_get_byte (p_info, p_pos) << 24);
-   }
+   return (p_data != NULL) ? pf_load_uint16 (p_data, p_info->is_big_endian)
+                           : 0;
+}
+
+uint32_t pf_get_uint32 (pf_get_info_t * p_info, uint16_t * p_pos)
+{
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 4);
 
-   return res;
+   return (p_data != NULL) ? pf_load_uint32 (p_data, p_info->is_big_endian)
+                           : 0;
 }
 
 /**
@@ -152,10 +209,16 @@ static void pf_get_uuid (
    uint16_t * p_pos,
    pf_uuid_t * p_dest)
 {
-   p_dest->data1 = pf_get_uint32 (p_info, p_pos);
-   p_dest->data2 = pf_get_uint16 (p_info, p_pos);
-   p_dest->data3 = pf_get_uint16 (p_info, p_pos);
-   pf_get_mem (p_info, p_pos, sizeof (p_dest->data4), p_dest->data4);
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, PF_UUID_SIZE);
+
+   if (p_data != NULL)
+   {
+      pf_load_uuid (p_data, p_info->is_big_endian, p_dest);
+   }
+   else
+   {
+      memset (p_dest, 0, sizeof (*p_dest));
+   }
 }
 
 /**
@@ -170,17 +233,27 @@ static void pf_get_handle (
    uint16_t * p_pos,
    pf_rpc_handle_t * p_handle)
 {
-   p_handle->rpc_entry_handle = pf_get_uint32 (p_info, p_pos);
-   p_handle->handle_uuid.time_low = pf_get_uint32 (p_info, p_pos);
-   p_handle->handle_uuid.time_mid = pf_get_uint16 (p_info, p_pos);
-   p_handle->handle_uuid.time_hi_and_version = pf_get_uint16 (p_info, p_pos);
-   p_handle->handle_uuid.clock_hi_and_reserved = pf_get_byte (p_info, p_pos);
-   p_handle->handle_uuid.clock_low = pf_get_byte (p_info, p_pos);
-   pf_get_mem (
-      p_info,
-      p_pos,
-      sizeof (p_handle->handle_uuid.node),
-      p_handle->handle_uuid.node);
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, PF_RPC_HANDLE_SIZE);
+   bool be = p_info->is_big_endian;
+
+   if (p_data != NULL)
+   {
+      p_handle->rpc_entry_handle = pf_load_uint32 (&p_data[0], be);
+      p_handle->handle_uuid.time_low = pf_load_uint32 (&p_data[4], be);
+      p_handle->handle_uuid.time_mid = pf_load_uint16 (&p_data[8], be);
+      p_handle->handle_uuid.time_hi_and_version =
+         pf_load_uint16 (&p_data[10], be);
+      p_handle->handle_uuid.clock_hi_and_reserved = p_data[12];
+      p_handle->handle_uuid.clock_low = p_data[13];
+      memcpy (
+         p_handle->handle_uuid.node,
+         &p_data[14],
+         sizeof (p_handle->handle_uuid.node));
+   }
+   else
+   {
+      memset (p_handle, 0, sizeof (*p_handle));
+   }
 }
 
 /**
@@ -233,9 +306,20 @@ static void pf_get_frame_descriptor (
    uint16_t * p_pos,
    pf_frame_descriptor_t * p_fd)
 {
-   p_fd->slot_number = pf_get_uint16 (p_info, p_pos);
-   p_fd->subslot_number = pf_get_uint16 (p_info, p_pos);
-   p_fd->frame_offset = pf_get_uint16 (p_info, p_pos);
+   const uint8_t * p_data =
+      pf_get_reserve (p_info, p_pos, PF_FRAME_DESCRIPTOR_SIZE);
+   bool be = p_info->is_big_endian;
+
+   if (p_data != NULL)
+   {
+      p_fd->slot_number = pf_load_uint16 (&p_data[0], be);
+      p_fd->subslot_number = pf_load_uint16 (&p_data[2], be);
+      p_fd->frame_offset = pf_load_uint16 (&p_data[4], be);
+   }
+   else
+   {
+      memset (p_fd, 0, sizeof (*p_fd));
+   }
 }
 
 /**
@@ -277,6 +361,35 @@ static int pf_get_iocr_api_entry (
    return 0;
 }
 
+/**
+ * @internal
+ * Extract a submodule data descriptor from a buffer.
+ * @param p_info           InOut: The parser state.
+ * @param p_pos            InOut: Position in the buffer.
+ * @param p_desc           Out:   Destination buffer.
+ */
+static void pf_get_data_descriptor (
+   pf_get_info_t * p_info,
+   uint16_t * p_pos,
+   pf_data_descriptor_t * p_desc)
+{
+   const uint8_t * p_data =
+      pf_get_reserve (p_info, p_pos, PF_DATA_DESCRIPTOR_SIZE);
+   bool be = p_info->is_big_endian;
+
+   if (p_data != NULL)
+   {
+      p_desc->data_direction = pf_load_uint16 (&p_data[0], be);
+      p_desc->submodule_data_length = pf_load_uint16 (&p_data[2], be);
+      p_desc->length_iocs = p_data[4];
+      p_desc->length_iops = p_data[5];
+   }
+   else
+   {
+      memset (p_desc, 0, sizeof (*p_desc));
+   }
+}
+
 /**
  * @internal
  * Extract an expected sub-module from a buffer.
@@ -289,12 +402,20 @@ static void pf_get_exp_submodule (
    uint16_t * p_pos,
    pf_exp_submodule_t * submodule)
 {
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 8);
+   bool be = p_info->is_big_endian;
    uint16_t temp_u16;
 
-   submodule->subslot_number = pf_get_uint16 (p_info, p_pos);
-   submodule->ident_number = pf_get_uint32 (p_info, p_pos);
+   if (p_data == NULL)
+   {
+      memset (submodule, 0, sizeof (*submodule));
+      return;
+   }
+
+   submodule->subslot_number = pf_load_uint16 (&p_data[0], be);
+   submodule->ident_number = pf_load_uint32 (&p_data[2], be);
    /* subslot_properties */
-   temp_u16 = pf_get_uint16 (p_info, p_pos);
+   temp_u16 = pf_load_uint16 (&p_data[6], be);
    submodule->properties.type = pf_get_bits (temp_u16, 0, 2);
    submodule->properties.sharedInput = (pf_get_bits (temp_u16, 2, 1) != 0);
    submodule->properties.reduce_input_submodule_data_length =
@@ -304,21 +425,12 @@ static void pf_get_exp_submodule (
    submodule->properties.discard_ioxs = (pf_get_bits (temp_u16, 5, 1) != 0);
 
    /* At least one submodule data descriptor */
-   submodule->data_descriptor[0].data_direction = pf_get_uint16 (p_info, p_pos);
-   submodule->data_descriptor[0].submodule_data_length =
-      pf_get_uint16 (p_info, p_pos);
-   submodule->data_descriptor[0].length_iocs = pf_get_byte (p_info, p_pos);
-   submodule->data_descriptor[0].length_iops = pf_get_byte (p_info, p_pos);
+   pf_get_data_descriptor (p_info, p_pos, &submodule->data_descriptor[0]);
    submodule->nbr_data_descriptors = 1;
    /* May have one more */
    if (submodule->properties.type == PNET_DIR_IO)
    {
-      submodule->data_descriptor[1].data_direction =
-         pf_get_uint16 (p_info, p_pos);
-      submodule->data_descriptor[1].submodule_data_length =
-         pf_get_uint16 (p_info, p_pos);
-      submodule->data_descriptor[1].length_iocs = pf_get_byte (p_info, p_pos);
-      submodule->data_descriptor[1].length_iops = pf_get_byte (p_info, p_pos);
+      pf_get_data_descriptor (p_info, p_pos, &submodule->data_descriptor[1]);
       submodule->nbr_data_descriptors = 2;
    }
 
@@ -339,28 +451,46 @@ void pf_get_block_header (
    uint16_t * p_pos,
    pf_block_header_t * p_hdr)
 {
-   p_hdr->block_type = pf_get_uint16 (p_info, p_pos);
-   p_hdr->block_length = pf_get_uint16 (p_info, p_pos);
-   p_hdr->block_version_high = pf_get_byte (p_info, p_pos);
-   p_hdr->block_version_low = pf_get_byte (p_info, p_pos);
+   const uint8_t * p_data =
+      pf_get_reserve (p_info, p_pos, PF_BLOCK_HEADER_SIZE);
+   bool be = p_info->is_big_endian;
+
+   if (p_data != NULL)
+   {
+      p_hdr->block_type = pf_load_uint16 (&p_data[0], be);
+      p_hdr->block_length = pf_load_uint16 (&p_data[2], be);
+      p_hdr->block_version_high = p_data[4];
+      p_hdr->block_version_low = p_data[5];
+   }
+   else
+   {
+      memset (p_hdr, 0, sizeof (*p_hdr));
+   }
 }
 
 void pf_get_ar_param (pf_get_info_t * p_info, uint16_t * p_pos, pf_ar_t * p_ar)
 {
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 52);
+   bool be = p_info->is_big_endian;
    uint32_t temp_u32;
    uint16_t str_len;
 
-   p_ar->ar_param.ar_type = pf_get_uint16 (p_info, p_pos);
-   pf_get_uuid (p_info, p_pos, &p_ar->ar_param.ar_uuid);
-   p_ar->ar_param.session_key = pf_get_uint16 (p_info, p_pos);
-   pf_get_mem (
-      p_info,
-      p_pos,
-      sizeof (p_ar->ar_param.cm_initiator_mac_add),
-      &p_ar->ar_param.cm_initiator_mac_add);
-   pf_get_uuid (p_info, p_pos, &p_ar->ar_param.cm_initiator_object_uuid);
+   if (p_data == NULL)
+   {
+      memset (&p_ar->ar_param, 0, sizeof (p_ar->ar_param));
+      return;
+   }
+
+   p_ar->ar_param.ar_type = pf_load_uint16 (&p_data[0], be);
+   pf_load_uuid (&p_data[2], be, &p_ar->ar_param.ar_uuid);
+   p_ar->ar_param.session_key = pf_load_uint16 (&p_data[18], be);
+   memcpy (
+      &p_ar->ar_param.cm_initiator_mac_add,
+      &p_data[20],
+      sizeof (p_ar->ar_param.cm_initiator_mac_add));
+   pf_load_uuid (&p_data[26], be, &p_ar->ar_param.cm_initiator_object_uuid);
    /* ar_properties */
-   temp_u32 = pf_get_uint32 (p_info, p_pos);
+   temp_u32 = pf_load_uint32 (&p_data[42], be);
    p_ar->ar_param.ar_properties.state = pf_get_bits (temp_u32, 0, 3);
    p_ar->ar_param.ar_properties.supervisor_takeover_allowed =
       (pf_get_bits (temp_u32, 3, 1) != 0);
@@ -380,10 +510,10 @@ void pf_get_ar_param (pf_get_info_t * p_info, uint16_t * p_pos, pf_ar_t * p_ar)
       (pf_get_bits (temp_u32, 31, 1) != 0);
 
    p_ar->ar_param.cm_initiator_activity_timeout_factor =
-      pf_get_uint16 (p_info, p_pos);
-   p_ar->ar_param.cm_initiator_udp_rt_port = pf_get_uint16 (p_info, p_pos);
+      pf_load_uint16 (&p_data[46], be);
+   p_ar->ar_param.cm_initiator_udp_rt_port = pf_load_uint16 (&p_data[48], be);
 
-   str_len = pf_get_uint16 (p_info, p_pos);
+   str_len = pf_load_uint16 (&p_data[50], be);
    p_ar->ar_param.cm_initiator_station_name_len = str_len;
    if (str_len > sizeof (p_ar->ar_param.cm_initiator_station_name) - 1)
    {
@@ -399,15 +529,24 @@ int pf_get_iocr_param (
    uint16_t ix,
    pf_ar_t * p_ar)
 {
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 40);
+   bool be = p_info->is_big_endian;
    uint32_t temp_u32;
    uint16_t temp_u16;
    uint16_t iy;
 
-   p_ar->iocrs[ix].param.iocr_type = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.iocr_reference = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.lt_field = pf_get_uint16 (p_info, p_pos);
+   if (p_data == NULL)
+   {
+      /* The parse error is reported by caller */
+      memset (&p_ar->iocrs[ix].param, 0, sizeof (p_ar->iocrs[ix].param));
+      return 0;
+   }
+
+   p_ar->iocrs[ix].param.iocr_type = pf_load_uint16 (&p_data[0], be);
+   p_ar->iocrs[ix].param.iocr_reference = pf_load_uint16 (&p_data[2], be);
+   p_ar->iocrs[ix].param.lt_field = pf_load_uint16 (&p_data[4], be);
    /* iocr_Properties */
-   temp_u32 = pf_get_uint32 (p_info, p_pos);
+   temp_u32 = pf_load_uint32 (&p_data[6], be);
    p_ar->iocrs[ix].param.iocr_properties.rt_class =
       pf_get_bits (temp_u32, 0, 4);
    p_ar->iocrs[ix].param.iocr_properties.reserved_1 =
@@ -417,29 +556,28 @@ int pf_get_iocr_param (
    p_ar->iocrs[ix].param.iocr_properties.reserved_3 =
       (pf_get_bits (temp_u32, 24, 8) != 0);
 
-   p_ar->iocrs[ix].param.c_sdu_length = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.frame_id = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.send_clock_factor = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.reduction_ratio = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.phase = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.sequence = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.frame_send_offset = pf_get_uint32 (p_info, p_pos);
-   p_ar->iocrs[ix].param.watchdog_factor = pf_get_uint16 (p_info, p_pos);
-   p_ar->iocrs[ix].param.data_hold_factor = pf_get_uint16 (p_info, p_pos);
+   p_ar->iocrs[ix].param.c_sdu_length = pf_load_uint16 (&p_data[10], be);
+   p_ar->iocrs[ix].param.frame_id = pf_load_uint16 (&p_data[12], be);
+   p_ar->iocrs[ix].param.send_clock_factor = pf_load_uint16 (&p_data[14], be);
+   p_ar->iocrs[ix].param.reduction_ratio = pf_load_uint16 (&p_data[16], be);
+   p_ar->iocrs[ix].param.phase = pf_load_uint16 (&p_data[18], be);
+   p_ar->iocrs[ix].param.sequence = pf_load_uint16 (&p_data[20], be);
+   p_ar->iocrs[ix].param.frame_send_offset = pf_load_uint32 (&p_data[22], be);
+   p_ar->iocrs[ix].param.watchdog_factor = pf_load_uint16 (&p_data[26], be);
+   p_ar->iocrs[ix].param.data_hold_factor = pf_load_uint16 (&p_data[28], be);
    /* iocr_tag_header */
-   temp_u16 = pf_get_uint16 (p_info, p_pos);
+   temp_u16 = pf_load_uint16 (&p_data[30], be);
    p_ar->iocrs[ix].param.iocr_tag_header.vlan_id =
       pf_get_bits (temp_u16, 0, 11);
    p_ar->iocrs[ix].param.iocr_tag_header.iocr_user_priority =
       pf_get_bits (temp_u16, 13, 3);
 
-   pf_get_mem (
-      p_info,
-      p_pos,
-      sizeof (p_ar->iocrs[ix].param.iocr_multicast_mac_add),
-      &p_ar->iocrs[ix].param.iocr_multicast_mac_add);
+   memcpy (
+      &p_ar->iocrs[ix].param.iocr_multicast_mac_add,
+      &p_data[32],
+      sizeof (p_ar->iocrs[ix].param.iocr_multicast_mac_add));
 
-   p_ar->iocrs[ix].param.nbr_apis = pf_get_uint16 (p_info, p_pos);
+   p_ar->iocrs[ix].param.nbr_apis = pf_load_uint16 (&p_data[38], be);
    if (p_ar->iocrs[ix].param.nbr_apis > PNET_MAX_API)
    {
       return -1;
@@ -651,6 +789,104 @@ void pf_get_ir_info_request (
 }
 #endif
 
+#if PNET_OPTION_FAST_STARTUP
+void pf_get_ar_fsu_request (
+   pf_get_info_t * p_info,
+   uint16_t * p_pos,
+   uint16_t block_length,
+   pf_ar_t * p_ar)
+{
+   pf_block_header_t sub_header;
+   uint16_t end_pos;
+   uint16_t sub_end_pos;
+#if PNET_MAX_MAN_SPECIFIC_FAST_STARTUP_DATA_LENGTH
+   uint16_t data_len;
+#endif
+
+   memset (&p_ar->fast_startup_data, 0, sizeof (p_ar->fast_startup_data));
+
+   /* Version is included in the block length */
+   if (
+      (block_length < PF_FSU_BLOCK_MIN_LENGTH) ||
+      (((uint32_t)*p_pos + block_length - 2) > p_info->len))
+   {
+      LOG_ERROR (
+         PNET_LOG,
+         "BR(%d): Invalid ARFSUBlock length %u\n",
+         __LINE__,
+         block_length);
+      p_info->result = PF_PARSE_ERROR;
+      return;
+   }
+   end_pos = *p_pos + block_length - 2;
+
+   *p_pos += 2; /* Padding */
+   while ((p_info->result == PF_PARSE_OK) &&
+          (((uint32_t)*p_pos + PF_BLOCK_HEADER_SIZE) <= end_pos))
+   {
+      pf_get_block_header (p_info, p_pos, &sub_header);
+      if (
+         (p_info->result != PF_PARSE_OK) || (sub_header.block_length < 2) ||
+         (((uint32_t)*p_pos + sub_header.block_length - 2) > end_pos))
+      {
+         p_info->result = PF_PARSE_ERROR;
+         break;
+      }
+      sub_end_pos = *p_pos + sub_header.block_length - 2;
+
+      switch (sub_header.block_type)
+      {
+      case PF_BT_FS_PARAMETER:
+         if (sub_header.block_length != PF_FS_PARAMETER_BLOCK_LENGTH)
+         {
+            p_info->result = PF_PARSE_ERROR;
+            break;
+         }
+         *p_pos += 2; /* Padding */
+         p_ar->fast_startup_data.fs_parameter_block.fs_parameter_mode =
+            pf_get_uint32 (p_info, p_pos);
+         pf_get_uuid (
+            p_info,
+            p_pos,
+            &p_ar->fast_startup_data.fs_parameter_block.fs_parameter_uuid);
+         break;
+#if PNET_MAX_MAN_SPECIFIC_FAST_STARTUP_DATA_LENGTH
+      case PF_BT_FAST_STARTUP:
+         if (sub_header.block_length < PF_FSU_BLOCK_MIN_LENGTH)
+         {
+            p_info->result = PF_PARSE_ERROR;
+            break;
+         }
+         *p_pos += 2; /* Padding */
+         data_len = sub_end_pos - *p_pos;
+         if (data_len > PNET_MAX_MAN_SPECIFIC_FAST_STARTUP_DATA_LENGTH)
+         {
+            data_len = PNET_MAX_MAN_SPECIFIC_FAST_STARTUP_DATA_LENGTH;
+         }
+         p_ar->fast_startup_data
+            .length_manufacturer_specific_fast_startup_data = data_len;
+         pf_get_mem (
+            p_info,
+            p_pos,
+            data_len,
+            p_ar->fast_startup_data.manufacturer_specific_fast_startup_data);
+         break;
+#endif
+      default:
+         break;
+      }
+      *p_pos = sub_end_pos;
+   }
+
+   if (p_info->result == PF_PARSE_OK)
+   {
+      /* The caller checks the consumed length with the block header */
+      *p_pos = end_pos;
+   }
+   p_ar->fast_startup_data.valid = (p_info->result == PF_PARSE_OK);
+}
+#endif
+
 #if PNET_OPTION_MC_CR
 void pf_get_mcr_request (
    pf_get_info_t * p_info,
@@ -712,16 +948,29 @@ void pf_get_control (
    uint16_t * p_pos,
    pf_control_block_t * p_req)
 {
-   /* 2 padding bytes */
-   (void)pf_get_uint16 (p_info, p_pos);
-   pf_get_uuid (p_info, p_pos, &p_req->ar_uuid);
-   p_req->session_key = pf_get_uint16 (p_info, p_pos);
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 26);
+   bool be = p_info->is_big_endian;
+
+   if (p_data != NULL)
+   {
+      /* 2 padding bytes */
+      pf_load_uuid (&p_data[2], be, &p_req->ar_uuid);
+      p_req->session_key = pf_load_uint16 (&p_data[18], be);
 
-   p_req->alarm_sequence_number = pf_get_uint16 (p_info, p_pos);
+      p_req->alarm_sequence_number = pf_load_uint16 (&p_data[20], be);
 
-   /* Command and properties are always Big-Endian on the wire!! */
-   p_req->control_command = pf_get_uint16 (p_info, p_pos);
-   p_req->control_block_properties = pf_get_uint16 (p_info, p_pos);
+      /* Command and properties are always Big-Endian on the wire!! */
+      p_req->control_command = pf_load_uint16 (&p_data[22], be);
+      p_req->control_block_properties = pf_load_uint16 (&p_data[24], be);
+   }
+   else
+   {
+      memset (&p_req->ar_uuid, 0, sizeof (p_req->ar_uuid));
+      p_req->session_key = 0;
+      p_req->alarm_sequence_number = 0;
+      p_req->control_command = 0;
+      p_req->control_block_properties = 0;
+   }
 }
 
 void pf_get_ndr_data (
@@ -729,11 +978,21 @@ void pf_get_ndr_data (
    uint16_t * p_pos,
    pf_ndr_data_t * p_ndr)
 {
-   p_ndr->args_maximum = pf_get_uint32 (p_info, p_pos);
-   p_ndr->args_length = pf_get_uint32 (p_info, p_pos);
-   p_ndr->array.maximum_count = pf_get_uint32 (p_info, p_pos);
-   p_ndr->array.offset = pf_get_uint32 (p_info, p_pos);
-   p_ndr->array.actual_count = pf_get_uint32 (p_info, p_pos);
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, PF_NDR_DATA_SIZE);
+   bool be = p_info->is_big_endian;
+
+   if (p_data != NULL)
+   {
+      p_ndr->args_maximum = pf_load_uint32 (&p_data[0], be);
+      p_ndr->args_length = pf_load_uint32 (&p_data[4], be);
+      p_ndr->array.maximum_count = pf_load_uint32 (&p_data[8], be);
+      p_ndr->array.offset = pf_load_uint32 (&p_data[12], be);
+      p_ndr->array.actual_count = pf_load_uint32 (&p_data[16], be);
+   }
+   else
+   {
+      memset (p_ndr, 0, sizeof (*p_ndr));
+   }
 }
 
 void pf_get_dce_rpc_header (
@@ -741,15 +1000,22 @@ void pf_get_dce_rpc_header (
    uint16_t * p_pos,
    pf_rpc_header_t * p_rpc)
 {
+   const uint8_t * p_data =
+      pf_get_reserve (p_info, p_pos, PF_DCE_RPC_HEADER_SIZE);
    uint8_t temp_uint8;
+   bool be;
+
+   if (p_data == NULL)
+   {
+      memset (p_rpc, 0, sizeof (*p_rpc));
+      return;
+   }
 
-   p_rpc->version = pf_get_byte (p_info, p_pos);
-   p_rpc->packet_type = pf_get_byte (p_info, p_pos) & 0x1f; /* Only 5 LSB
-                                                               according to spec
-                                                             */
+   p_rpc->version = p_data[0];
+   p_rpc->packet_type = p_data[1] & 0x1f; /* Only 5 LSB according to spec */
 
    /* flags */
-   temp_uint8 = pf_get_byte (p_info, p_pos);
+   temp_uint8 = p_data[2];
    p_rpc->flags.last_fragment =
       pf_get_bits (temp_uint8, PF_RPC_F_LAST_FRAGMENT, 1);
    p_rpc->flags.fragment = pf_get_bits (temp_uint8, PF_RPC_F_FRAGMENT, 1);
@@ -759,36 +1025,36 @@ void pf_get_dce_rpc_header (
    p_rpc->flags.broadcast = pf_get_bits (temp_uint8, PF_RPC_F_BROADCAST, 1);
 
    /* flags2 */
-   temp_uint8 = pf_get_byte (p_info, p_pos);
+   temp_uint8 = p_data[3];
    p_rpc->flags2.cancel_pending =
       pf_get_bits (temp_uint8, PF_RPC_F2_CANCEL_PENDING, 1);
 
-   /* Data repr */
-   temp_uint8 = pf_get_byte (p_info, p_pos);
+   /* Data repr. Selects the byte order for the rest of the header. */
+   temp_uint8 = p_data[4];
    p_rpc->is_big_endian = (pf_get_bits (temp_uint8, 4, 4) == 0);
    p_info->is_big_endian = p_rpc->is_big_endian;
+   be = p_rpc->is_big_endian;
 
    /* Float repr  - Assume IEEE */
-   (void)pf_get_byte (p_info, p_pos);
    p_rpc->float_repr = 0;
 
    /* Reserved */
-   p_rpc->reserved = pf_get_byte (p_info, p_pos);
-
-   p_rpc->serial_high = pf_get_byte (p_info, p_pos);
-   pf_get_uuid (p_info, p_pos, &p_rpc->object_uuid);
-   pf_get_uuid (p_info, p_pos, &p_rpc->interface_uuid);
-   pf_get_uuid (p_info, p_pos, &p_rpc->activity_uuid);
-   p_rpc->server_boot_time = pf_get_uint32 (p_info, p_pos);
-   p_rpc->interface_version = pf_get_uint32 (p_info, p_pos);
-   p_rpc->sequence_nmb = pf_get_uint32 (p_info, p_pos);
-   p_rpc->opnum = pf_get_uint16 (p_info, p_pos);
-   p_rpc->interface_hint = pf_get_uint16 (p_info, p_pos);
-   p_rpc->activity_hint = pf_get_uint16 (p_info, p_pos);
-   p_rpc->length_of_body = pf_get_uint16 (p_info, p_pos);
-   p_rpc->fragment_nmb = pf_get_uint16 (p_info, p_pos);
-   p_rpc->auth_protocol = pf_get_byte (p_info, p_pos);
-   p_rpc->serial_low = pf_get_byte (p_info, p_pos);
+   p_rpc->reserved = p_data[6];
+
+   p_rpc->serial_high = p_data[7];
+   pf_load_uuid (&p_data[8], be, &p_rpc->object_uuid);
+   pf_load_uuid (&p_data[24], be, &p_rpc->interface_uuid);
+   pf_load_uuid (&p_data[40], be, &p_rpc->activity_uuid);
+   p_rpc->server_boot_time = pf_load_uint32 (&p_data[56], be);
+   p_rpc->interface_version = pf_load_uint32 (&p_data[60], be);
+   p_rpc->sequence_nmb = pf_load_uint32 (&p_data[64], be);
+   p_rpc->opnum = pf_load_uint16 (&p_data[68], be);
+   p_rpc->interface_hint = pf_load_uint16 (&p_data[70], be);
+   p_rpc->activity_hint = pf_load_uint16 (&p_data[72], be);
+   p_rpc->length_of_body = pf_load_uint16 (&p_data[74], be);
+   p_rpc->fragment_nmb = pf_load_uint16 (&p_data[76], be);
+   p_rpc->auth_protocol = p_data[78];
+   p_rpc->serial_low = p_data[79];
 }
 
 void pf_get_read_request (
@@ -796,22 +1062,26 @@ void pf_get_read_request (
    uint16_t * p_pos,
    pf_iod_read_request_t * p_req)
 {
-   uint16_t ix;
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 50);
+   bool be = p_info->is_big_endian;
 
-   p_req->sequence_number = pf_get_uint16 (p_info, p_pos);
-   pf_get_uuid (p_info, p_pos, &p_req->ar_uuid);
-   p_req->api = pf_get_uint32 (p_info, p_pos);
-   p_req->slot_number = pf_get_uint16 (p_info, p_pos);
-   p_req->subslot_number = pf_get_uint16 (p_info, p_pos);
-   p_req->padding[0] = pf_get_byte (p_info, p_pos);
-   p_req->padding[1] = pf_get_byte (p_info, p_pos);
-   p_req->index = pf_get_uint16 (p_info, p_pos);
-   p_req->record_data_length = pf_get_uint32 (p_info, p_pos);
-   pf_get_uuid (p_info, p_pos, &p_req->target_ar_uuid);
-   for (ix = 0; ix < NELEMENTS (p_req->rw_padding); ix++)
+   if (p_data == NULL)
    {
-      p_req->rw_padding[ix] = pf_get_byte (p_info, p_pos);
+      memset (p_req, 0, sizeof (*p_req));
+      return;
    }
+
+   p_req->sequence_number = pf_load_uint16 (&p_data[0], be);
+   pf_load_uuid (&p_data[2], be, &p_req->ar_uuid);
+   p_req->api = pf_load_uint32 (&p_data[18], be);
+   p_req->slot_number = pf_load_uint16 (&p_data[22], be);
+   p_req->subslot_number = pf_load_uint16 (&p_data[24], be);
+   p_req->padding[0] = p_data[26];
+   p_req->padding[1] = p_data[27];
+   p_req->index = pf_load_uint16 (&p_data[28], be);
+   p_req->record_data_length = pf_load_uint32 (&p_data[30], be);
+   pf_load_uuid (&p_data[34], be, &p_req->target_ar_uuid);
+   pf_get_mem (p_info, p_pos, sizeof (p_req->rw_padding), p_req->rw_padding);
 }
 
 void pf_get_epm_lookup_request (
@@ -836,21 +1106,25 @@ void pf_get_write_request (
    uint16_t * p_pos,
    pf_iod_write_request_t * p_req)
 {
-   uint16_t ix;
+   const uint8_t * p_data = pf_get_reserve (p_info, p_pos, 34);
+   bool be = p_info->is_big_endian;
 
-   p_req->sequence_number = pf_get_uint16 (p_info, p_pos);
-   pf_get_uuid (p_info, p_pos, &p_req->ar_uuid);
-   p_req->api = pf_get_uint32 (p_info, p_pos);
-   p_req->slot_number = pf_get_uint16 (p_info, p_pos);
-   p_req->subslot_number = pf_get_uint16 (p_info, p_pos);
-   p_req->padding[0] = pf_get_byte (p_info, p_pos);
-   p_req->padding[1] = pf_get_byte (p_info, p_pos);
-   p_req->index = pf_get_uint16 (p_info, p_pos);
-   p_req->record_data_length = pf_get_uint32 (p_info, p_pos);
-   for (ix = 0; ix < NELEMENTS (p_req->rw_padding); ix++)
+   if (p_data == NULL)
    {
-      p_req->rw_padding[ix] = pf_get_byte (p_info, p_pos);
+      memset (p_req, 0, sizeof (*p_req));
+      return;
    }
+
+   p_req->sequence_number = pf_load_uint16 (&p_data[0], be);
+   pf_load_uuid (&p_data[2], be, &p_req->ar_uuid);
+   p_req->api = pf_load_uint32 (&p_data[18], be);
+   p_req->slot_number = pf_load_uint16 (&p_data[22], be);
+   p_req->subslot_number = pf_load_uint16 (&p_data[24], be);
+   p_req->padding[0] = p_data[26];
+   p_req->padding[1] = p_data[27];
+   p_req->index = pf_load_uint16 (&p_data[28], be);
+   p_req->record_data_length = pf_load_uint32 (&p_data[30], be);
+   pf_get_mem (p_info, p_pos, sizeof (p_req->rw_padding), p_req->rw_padding);
 }
 
 void pf_get_im_1 (pf_get_info_t * p_info, uint16_t * p_pos, pnet_im_1_t * p_im_1)
@@ -206,6 +206,24 @@ void pf_get_ir_info_request (
    pf_ar_t * p_ar);
 #endif
 
+#if PNET_OPTION_FAST_STARTUP
+/**
+ * Extract an AR FSU request block from a buffer.
+ *
+ * Sub-blocks other than FSParameterBlock and FastStartUpBlock are skipped.
+ * @param p_info           InOut: The parser state.
+ * @param p_pos            InOut: Position in the buffer (after the block
+ *                                header).
+ * @param block_length     In:    The block length from the block header.
+ * @param p_ar             Out:   Contains the destination structure.
+ */
+void pf_get_ar_fsu_request (
+   pf_get_info_t * p_info,
+   uint16_t * p_pos,
+   uint16_t block_length,
+   pf_ar_t * p_ar);
+#endif
+
 /**
  * Extract a DCE RPC header from a raw UDP data buffer.
  * @param p_info           InOut: The parser information. Sets
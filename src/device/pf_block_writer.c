@@ -35,6 +35,11 @@
  *       uint16_t res_len,
  *       uint8_t * p_bytes,
  *       uint16_t * p_pos);
+ *
+ * Parts with a size known in advance are written in two steps. The size is
+ * computed first, and the space is reserved with a single check of the buffer
+ * size by pf_put_reserve(). The fields are then written without further
+ * checks by the pf_store_xxx() functions.
  */
 
 #ifdef UNIT_TEST
@@ -49,6 +54,159 @@
 #define STRINGIFY(s)   STRINGIFIED (s)
 #define STRINGIFIED(s) #s
 
+/* Sizes of fixed size fields and headers on the wire */
+#define PF_UUID_SIZE           16
+#define PF_BLOCK_HEADER_SIZE   6
+#define PF_DCE_RPC_HEADER_SIZE 80
+#define PF_SUBMODULE_DIFF_SIZE 8
+
+/**
+ * @internal
+ * Reserve a part of the destination buffer.
+ *
+ * Does the size check for all fields in the part, which then are written
+ * with the unchecked pf_store_xxx() functions.
+ *
+ * @param size             In:    Number of bytes to reserve.
+ * @param res_len          In:    Size of destination buffer.
+ * @param p_bytes          In:    Destination buffer.
+ * @param p_pos            InOut: Position in destination buffer. Advanced
+ *                                by size on success.
+ * @return Pointer to the first reserved byte, or NULL if the buffer is full.
+ */
+static uint8_t * pf_put_reserve (
+   uint16_t size,
+   uint16_t res_len,
+   uint8_t * p_bytes,
+   uint16_t * p_pos)
+{
+   uint8_t * p_dst;
+
+   if (((uint32_t)*p_pos + size) > res_len)
+   {
+      /* Reached end of buffer */
+      LOG_DEBUG (PNET_LOG, "BW(%d): Output buffer is full\n", __LINE__);
+      return NULL;
+   }
+
+   if (p_bytes == NULL)
+   {
+      return NULL;
+   }
+
+   p_dst = &p_bytes[*p_pos];
+   (*p_pos) += size;
+
+   return p_dst;
+}
+
+/**
+ * @internal
+ * Write a uint16_t, without size check.
+ *
+ * @param is_big_endian    In:    Endianness of the destination buffer.
+ * @param val              In:    Value to write.
+ * @param p_dst            Out:   Destination. 2 bytes.
+ * @return Pointer to the byte after the written value.
+ */
+static inline uint8_t * pf_store_uint16 (
+   bool is_big_endian,
+   uint16_t val,
+   uint8_t * p_dst)
+{
+   if (is_big_endian)
+   {
+      p_dst[0] = (uint8_t)(val >> 8);
+      p_dst[1] = (uint8_t)val;
+   }
+   else
+   {
+      p_dst[0] = (uint8_t)val;
+      p_dst[1] = (uint8_t)(val >> 8);
+   }
+
+   return p_dst + 2;
+}
+
+/**
+ * @internal
+ * Write a uint32_t, without size check.
+ *
+ * @param is_big_endian    In:    Endianness of the destination buffer.
+ * @param val              In:    Value to write.
+ * @param p_dst            Out:   Destination. 4 bytes.
+ * @return Pointer to the byte after the written value.
+ */
+static inline uint8_t * pf_store_uint32 (
+   bool is_big_endian,
+   uint32_t val,
+   uint8_t * p_dst)
+{
+   if (is_big_endian)
+   {
+      p_dst[0] = (uint8_t)(val >> 24);
+      p_dst[1] = (uint8_t)(val >> 16);
+      p_dst[2] = (uint8_t)(val >> 8);
+      p_dst[3] = (uint8_t)val;
+   }
+   else
+   {
+      p_dst[0] = (uint8_t)val;
+      p_dst[1] = (uint8_t)(val >> 8);
+      p_dst[2] = (uint8_t)(val >> 16);
+      p_dst[3] = (uint8_t)(val >> 24);
+   }
+
+   return p_dst + 4;
+}
+
+/**
+ * @internal
+ * Write a UUID, without size check.
+ *
+ * @param is_big_endian    In:    Endianness of the destination buffer.
+ * @param p_uuid           In:    The UUID to write.
+ * @param p_dst            Out:   Destination. PF_UUID_SIZE bytes.
+ * @return Pointer to the byte after the written UUID.
+ */
+static inline uint8_t * pf_store_uuid (
+   bool is_big_endian,
+   const pf_uuid_t * p_uuid,
+   uint8_t * p_dst)
+{
+   p_dst = pf_store_uint32 (is_big_endian, p_uuid->data1, p_dst);
+   p_dst = pf_store_uint16 (is_big_endian, p_uuid->data2, p_dst);
+   p_dst = pf_store_uint16 (is_big_endian, p_uuid->data3, p_dst);
+   memcpy (p_dst, p_uuid->data4, sizeof (p_uuid->data4));
+
+   return p_dst + sizeof (p_uuid->data4);
+}
+
+/**
+ * @internal
+ * Write a block header, without size check.
+ *
+ * @param is_big_endian    In:    true if buffer is big-endian.
+ * @param bh_type          In:    Block type.
+ * @param block_len        In:    Total block size, including the header.
+ * @param p_dst            Out:   Destination. PF_BLOCK_HEADER_SIZE bytes.
+ * @return Pointer to the byte after the block header.
+ */
+static uint8_t * pf_store_block_header (
+   bool is_big_endian,
+   pf_block_type_values_t bh_type,
+   uint16_t block_len,
+   uint8_t * p_dst)
+{
+   p_dst = pf_store_uint16 (is_big_endian, (uint16_t)bh_type, p_dst);
+   /* Block length excludes type and length fields */
+   p_dst = pf_store_uint16 (is_big_endian, block_len - 4, p_dst);
+   p_dst[0] = PNET_BLOCK_VERSION_HIGH;
+   p_dst[1] = PNET_BLOCK_VERSION_LOW;
+
+   return p_dst + 2;
+}
+
 /**
  * @internal
  * Insert a block header into a buffer.
@@ -71,17 +229,19 @@ static void pf_put_block_header (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   uint16_t temp_u16 = (uint16_t)bh_type;
+   uint8_t * p_dst =
+      pf_put_reserve (PF_BLOCK_HEADER_SIZE, res_len, p_bytes, p_pos);
 
-   pf_put_uint16 (is_big_endian, temp_u16, res_len, p_bytes, p_pos);
-   pf_put_uint16 (
-      is_big_endian,
-      (bh_length + sizeof (pf_block_header_t)) - 4,
-      res_len,
-      p_bytes,
-      p_pos); /* Always (-4)!! */
-   pf_put_byte (bh_ver_high, res_len, p_bytes, p_pos);
-   pf_put_byte (bh_ver_low, res_len, p_bytes, p_pos);
+   if (p_dst != NULL)
+   {
+      p_dst = pf_store_uint16 (is_big_endian, (uint16_t)bh_type, p_dst);
+      p_dst = pf_store_uint16 (
+         is_big_endian,
+         (bh_length + sizeof (pf_block_header_t)) - 4, /* Always (-4)!! */
+         p_dst);
+      p_dst[0] = bh_ver_high;
+      p_dst[1] = bh_ver_low;
+   }
 }
 
 /**
@@ -106,7 +266,7 @@ static void pf_put_str (
    uint16_t * p_pos)
 {
    uint16_t str_len = (uint16_t)strlen (p_src);
-   uint16_t ix;
+   uint8_t * p_dst;
 
    if (((*p_pos) + src_size) > res_len)
    {
@@ -117,13 +277,15 @@ static void pf_put_str (
 
    if (p_bytes != NULL)
    {
-      memcpy (&p_bytes[*p_pos], p_src, str_len);
+      p_dst = &p_bytes[*p_pos];
+      memcpy (p_dst, p_src, str_len);
       (*p_pos) += str_len;
       /* Pad with spaces - size also includes NUL-terminator. Do not write into
        * that pos. */
-      for (ix = str_len; ix < src_size - 1; ix++)
+      if (str_len < src_size - 1)
       {
-         pf_put_byte (' ', res_len, p_bytes, p_pos);
+         memset (&p_dst[str_len], ' ', (src_size - 1) - str_len);
+         (*p_pos) += (src_size - 1) - str_len;
       }
    }
 }
@@ -144,10 +306,12 @@ static void pf_put_uuid (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   pf_put_uint32 (is_big_endian, p_uuid->data1, res_len, p_bytes, p_pos);
-   pf_put_uint16 (is_big_endian, p_uuid->data2, res_len, p_bytes, p_pos);
-   pf_put_uint16 (is_big_endian, p_uuid->data3, res_len, p_bytes, p_pos);
-   pf_put_mem (p_uuid->data4, sizeof (p_uuid->data4), res_len, p_bytes, p_pos);
+   uint8_t * p_dst = pf_put_reserve (PF_UUID_SIZE, res_len, p_bytes, p_pos);
+
+   if (p_dst != NULL)
+   {
+      (void)pf_store_uuid (is_big_endian, p_uuid, p_dst);
+   }
 }
 
 /**
@@ -165,17 +329,18 @@ static void pf_put_rpc_uuid (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   pf_put_uint32 (is_big_endian, p_uuid->time_low, res_len, p_bytes, p_pos);
-   pf_put_uint16 (is_big_endian, p_uuid->time_mid, res_len, p_bytes, p_pos);
-   pf_put_uint16 (
-      is_big_endian,
-      p_uuid->time_hi_and_version,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_byte (p_uuid->clock_hi_and_reserved, res_len, p_bytes, p_pos);
-   pf_put_byte (p_uuid->clock_low, res_len, p_bytes, p_pos);
-   pf_put_mem (p_uuid->node, sizeof (p_uuid->node), res_len, p_bytes, p_pos);
+   uint8_t * p_dst = pf_put_reserve (PF_UUID_SIZE, res_len, p_bytes, p_pos);
+
+   if (p_dst != NULL)
+   {
+      p_dst = pf_store_uint32 (is_big_endian, p_uuid->time_low, p_dst);
+      p_dst = pf_store_uint16 (is_big_endian, p_uuid->time_mid, p_dst);
+      p_dst =
+         pf_store_uint16 (is_big_endian, p_uuid->time_hi_and_version, p_dst);
+      p_dst[0] = p_uuid->clock_hi_and_reserved;
+      p_dst[1] = p_uuid->clock_low;
+      memcpy (&p_dst[2], p_uuid->node, sizeof (p_uuid->node));
+   }
 }
 /* ======================== Public functions */
 
@@ -186,17 +351,11 @@ void pf_put_mem (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   if (((*p_pos) + src_size) > res_len)
-   {
-      /* Reached end of buffer */
-      LOG_DEBUG (PNET_LOG, "BW(%d): Output buffer is full\n", __LINE__);
-      p_bytes = NULL;
-   }
+   uint8_t * p_dst = pf_put_reserve (src_size, res_len, p_bytes, p_pos);
 
-   if (p_bytes != NULL)
+   if (p_dst != NULL)
    {
-      memcpy (&p_bytes[*p_pos], p_src, src_size);
-      (*p_pos) += src_size;
+      memcpy (p_dst, p_src, src_size);
    }
 }
 
@@ -227,17 +386,11 @@ void pf_put_byte (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   if (*p_pos + 1 > res_len)
-   {
-      /* Reached end of buffer */
-      LOG_DEBUG (PNET_LOG, "BW(%d): End of buffer reached\n", __LINE__);
-      p_bytes = NULL;
-   }
+   uint8_t * p_dst = pf_put_reserve (1, res_len, p_bytes, p_pos);
 
-   if (p_bytes != NULL)
+   if (p_dst != NULL)
    {
-      p_bytes[*p_pos] = val;
-      (*p_pos)++;
+      p_dst[0] = val;
    }
 }
 
@@ -248,15 +401,11 @@ void pf_put_uint16 (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   if (is_big_endian)
-   {
-      pf_put_byte ((val >> 8) & 0xff, res_len, p_bytes, p_pos);
-      pf_put_byte (val & 0xff, res_len, p_bytes, p_pos);
-   }
-   else
+   uint8_t * p_dst = pf_put_reserve (2, res_len, p_bytes, p_pos);
+
+   if (p_dst != NULL)
    {
-      pf_put_byte (val & 0xff, res_len, p_bytes, p_pos);
-      pf_put_byte ((val >> 8) & 0xff, res_len, p_bytes, p_pos);
+      (void)pf_store_uint16 (is_big_endian, val, p_dst);
    }
 }
 
@@ -267,19 +416,11 @@ void pf_put_uint32 (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   if (is_big_endian)
-   {
-      pf_put_byte ((val >> 24) & 0xff, res_len, p_bytes, p_pos);
-      pf_put_byte ((val >> 16) & 0xff, res_len, p_bytes, p_pos);
-      pf_put_byte ((val >> 8) & 0xff, res_len, p_bytes, p_pos);
-      pf_put_byte (val & 0xff, res_len, p_bytes, p_pos);
-   }
-   else
+   uint8_t * p_dst = pf_put_reserve (4, res_len, p_bytes, p_pos);
+
+   if (p_dst != NULL)
    {
-      pf_put_byte (val & 0xff, res_len, p_bytes, p_pos);
-      pf_put_byte ((val >> 8) & 0xff, res_len, p_bytes, p_pos);
-      pf_put_byte ((val >> 16) & 0xff, res_len, p_bytes, p_pos);
-      pf_put_byte ((val >> 24) & 0xff, res_len, p_bytes, p_pos);
+      (void)pf_store_uint32 (is_big_endian, val, p_dst);
    }
 }
 
@@ -289,10 +430,11 @@ void pf_put_padding (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   uint16_t i;
-   for (i = 0; i < n_bytes; i++)
+   uint8_t * p_dst = pf_put_reserve (n_bytes, res_len, p_bytes, p_pos);
+
+   if (p_dst != NULL)
    {
-      pf_put_byte (0, res_len, p_bytes, p_pos);
+      memset (p_dst, 0, n_bytes);
    }
 }
 
@@ -337,51 +479,33 @@ void pf_put_ar_result (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   uint16_t block_pos = *p_pos;
-   uint16_t block_len = 0;
+   const uint16_t block_len =
+      PF_BLOCK_HEADER_SIZE + 2 + PF_UUID_SIZE + 2 +
+      sizeof (p_ar->ar_result.cm_responder_mac_add) + 2;
+   uint8_t * p_dst = pf_put_reserve (block_len, res_len, p_bytes, p_pos);
 
-   pf_put_block_header (
-      is_big_endian,
-      PF_BT_AR_BLOCK_RES,
-      0, /* Dont know block_len yet */
-      PNET_BLOCK_VERSION_HIGH,
-      PNET_BLOCK_VERSION_LOW,
-      res_len,
-      p_bytes,
-      p_pos);
+   if (p_dst == NULL)
+   {
+      return;
+   }
 
-   pf_put_uint16 (
-      is_big_endian,
-      p_ar->ar_param.ar_type,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uuid (is_big_endian, &p_ar->ar_param.ar_uuid, res_len, p_bytes, p_pos);
-   pf_put_uint16 (
+   p_dst = pf_store_block_header (
       is_big_endian,
-      p_ar->ar_param.session_key,
-      res_len,
-      p_bytes,
-      p_pos);
-
-   pf_put_mem (
+      PF_BT_AR_BLOCK_RES,
+      block_len,
+      p_dst);
+   p_dst = pf_store_uint16 (is_big_endian, p_ar->ar_param.ar_type, p_dst);
+   p_dst = pf_store_uuid (is_big_endian, &p_ar->ar_param.ar_uuid, p_dst);
+   p_dst = pf_store_uint16 (is_big_endian, p_ar->ar_param.session_key, p_dst);
+   memcpy (
+      p_dst,
       &p_ar->ar_result.cm_responder_mac_add,
-      sizeof (p_ar->ar_result.cm_responder_mac_add),
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint16 (
+      sizeof (p_ar->ar_result.cm_responder_mac_add));
+   p_dst += sizeof (p_ar->ar_result.cm_responder_mac_add);
+   (void)pf_store_uint16 (
       is_big_endian,
       p_ar->ar_result.responder_udp_rt_port,
-      res_len,
-      p_bytes,
-      p_pos);
-
-   /* Finally insert the block length into the block header */
-   block_len = *p_pos - (block_pos + 4);
-   block_pos += offsetof (pf_block_header_t, block_length); /* Point to correct
-                                                               place */
-   pf_put_uint16 (is_big_endian, block_len, res_len, p_bytes, &block_pos);
+      p_dst);
 }
 
 void pf_put_iocr_result (
@@ -392,43 +516,29 @@ void pf_put_iocr_result (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   uint16_t block_pos = *p_pos;
-   uint16_t block_len = 0;
+   const uint16_t block_len = PF_BLOCK_HEADER_SIZE + 6;
+   uint8_t * p_dst = pf_put_reserve (block_len, res_len, p_bytes, p_pos);
 
-   pf_put_block_header (
-      is_big_endian,
-      PF_BT_IOCR_BLOCK_RES,
-      0, /* Dont know block_len yet */
-      PNET_BLOCK_VERSION_HIGH,
-      PNET_BLOCK_VERSION_LOW,
-      res_len,
-      p_bytes,
-      p_pos);
+   if (p_dst == NULL)
+   {
+      return;
+   }
 
-   pf_put_uint16 (
+   p_dst = pf_store_block_header (
       is_big_endian,
-      p_ar->iocrs[ix].result.iocr_type,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint16 (
+      PF_BT_IOCR_BLOCK_RES,
+      block_len,
+      p_dst);
+   p_dst =
+      pf_store_uint16 (is_big_endian, p_ar->iocrs[ix].result.iocr_type, p_dst);
+   p_dst = pf_store_uint16 (
       is_big_endian,
       p_ar->iocrs[ix].result.iocr_reference,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint16 (
+      p_dst);
+   (void)pf_store_uint16 (
       is_big_endian,
       p_ar->iocrs[ix].result.frame_id,
-      res_len,
-      p_bytes,
-      p_pos);
-
-   /* Finally insert the block length into the block header */
-   block_len = *p_pos - (block_pos + 4);
-   block_pos += offsetof (pf_block_header_t, block_length); /* Point to correct
-                                                               place */
-   pf_put_uint16 (is_big_endian, block_len, res_len, p_bytes, &block_pos);
+      p_dst);
 }
 
 void pf_put_alarm_cr_result (
@@ -438,43 +548,31 @@ void pf_put_alarm_cr_result (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
-   uint16_t block_pos = *p_pos;
-   uint16_t block_len = 0;
+   const uint16_t block_len = PF_BLOCK_HEADER_SIZE + 6;
+   uint8_t * p_dst = pf_put_reserve (block_len, res_len, p_bytes, p_pos);
 
-   pf_put_block_header (
+   if (p_dst == NULL)
+   {
+      return;
+   }
+
+   p_dst = pf_store_block_header (
       is_big_endian,
       PF_BT_ALARM_CR_BLOCK_RES,
-      0, /* Dont know block_len yet */
-      PNET_BLOCK_VERSION_HIGH,
-      PNET_BLOCK_VERSION_LOW,
-      res_len,
-      p_bytes,
-      p_pos);
-
-   pf_put_uint16 (
+      block_len,
+      p_dst);
+   p_dst = pf_store_uint16 (
       is_big_endian,
       p_ar->alarm_cr_result.alarm_cr_type,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint16 (
+      p_dst);
+   p_dst = pf_store_uint16 (
       is_big_endian,
       p_ar->alarm_cr_result.local_alarm_reference,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint16 (
+      p_dst);
+   (void)pf_store_uint16 (
       is_big_endian,
       p_ar->alarm_cr_result.max_alarm_data_length,
-      res_len,
-      p_bytes,
-      p_pos);
-
-   /* Finally insert the block length into the block header */
-   block_len = *p_pos - (block_pos + 4);
-   block_pos += offsetof (pf_block_header_t, block_length); /* Point to correct
-                                                               place */
-   pf_put_uint16 (is_big_endian, block_len, res_len, p_bytes, &block_pos);
+      p_dst);
 }
 
 /**
@@ -498,42 +596,70 @@ static void pf_put_bits (
 
 /**
  * @internal
- * Insert a sub-module diff into a buffer.
+ * Calculate the size of a module diff.
+ * @param module           In:    The expected module containing differences.
+ * @return The number of bytes needed for the module diff.
+ */
+static uint16_t pf_size_module_diff (pf_exp_module_t const * module)
+{
+   if (module->state == PF_MODULE_STATE_NO_MODULE)
+   {
+      return 12;
+   }
+
+   return 10 + module->nbr_diff_submodules * PF_SUBMODULE_DIFF_SIZE;
+}
+
+/**
+ * @internal
+ * Calculate the size of a ModuleDiffBlock, including the block header.
+ * @param ident            In:    The expected identification.
+ * @return The number of bytes needed for the block.
+ */
+static uint32_t pf_size_ar_diff (pf_exp_ident_t const * ident)
+{
+   uint32_t size = PF_BLOCK_HEADER_SIZE + 2;
+   pf_exp_api_t const * api;
+   uint16_t api_ix;
+   uint16_t mod_ix;
+
+   for (api_ix = 0; api_ix < ident->nbr_diff_apis; api_ix++)
+   {
+      api = &ident->api[ident->diff_api[api_ix]];
+      size += 6;
+      for (mod_ix = 0; mod_ix < api->nbr_diff_modules; mod_ix++)
+      {
+         size += pf_size_module_diff (&api->module[api->diff_module[mod_ix]]);
+      }
+   }
+
+   return size;
+}
+
+/**
+ * @internal
+ * Write a sub-module diff, without size check.
  * @param is_big_endian    In:    Endianness of the destination buffer.
- * @param p_diff           In:    The sub-module diff information.
- * @param res_len          In:    Size of destination buffer.
- * @param p_bytes          Out:   Destination buffer.
- * @param p_pos            InOut: Position in destination buffer.
+ * @param submodule        In:    The sub-module diff information.
+ * @param p_dst            Out:   Destination. PF_SUBMODULE_DIFF_SIZE bytes.
+ * @return Pointer to the byte after the sub-module diff.
  */
-static void pf_put_submodule_diff (
+static uint8_t * pf_store_submodule_diff (
    bool is_big_endian,
    pf_exp_submodule_t const * submodule,
-   uint16_t res_len,
-   uint8_t * p_bytes,
-   uint16_t * p_pos)
+   uint8_t * p_dst)
 {
    uint32_t temp_u32 = 0;
-   uint16_t temp_u16 = 0;
 
-   pf_put_uint16 (
-      is_big_endian,
-      submodule->subslot_number,
-      res_len,
-      p_bytes,
-      p_pos);
+   p_dst = pf_store_uint16 (is_big_endian, submodule->subslot_number, p_dst);
 
    if (submodule->state.ident_info == PF_IDENT_INFO_NO)
    {
-      pf_put_uint32 (is_big_endian, 0, res_len, p_bytes, p_pos);
+      p_dst = pf_store_uint32 (is_big_endian, 0, p_dst);
    }
    else
    {
-      pf_put_uint32 (
-         is_big_endian,
-         submodule->ident_number,
-         res_len,
-         p_bytes,
-         p_pos);
+      p_dst = pf_store_uint32 (is_big_endian, submodule->ident_number, p_dst);
    }
    /* submodule_state */
    pf_put_bits (submodule->state.add_info, 3, 0, &temp_u32);
@@ -544,150 +670,102 @@ static void pf_put_submodule_diff (
    pf_put_bits (submodule->state.ar_info, 4, 7, &temp_u32);
    pf_put_bits (submodule->state.ident_info, 4, 11, &temp_u32);
    pf_put_bits (submodule->state.format_indicator, 1, 15, &temp_u32);
-   temp_u16 = (uint16_t)temp_u32;
-   pf_put_uint16 (is_big_endian, temp_u16, res_len, p_bytes, p_pos);
+
+   return pf_store_uint16 (is_big_endian, (uint16_t)temp_u32, p_dst);
 }
 
 /**
  * @internal
- * Insert a module diff into a buffer.
+ * Write a module diff, without size check.
  * @param is_big_endian    In:    Endianness of the destination buffer.
  * @param module           In:    The expected module containing differences.
- * @param res_len          In:    Size of destination buffer.
- * @param p_bytes          Out:   Destination buffer.
- * @param p_pos            InOut: Position in destination buffer.
+ * @param p_dst            Out:   Destination. Size according to
+ *                                pf_size_module_diff().
+ * @return Pointer to the byte after the module diff.
  */
-static void pf_put_module_diff (
+static uint8_t * pf_store_module_diff (
    bool is_big_endian,
    pf_exp_module_t const * module,
-   uint16_t res_len,
-   uint8_t * p_bytes,
-   uint16_t * p_pos)
+   uint8_t * p_dst)
 {
    uint16_t ix;
 
-   pf_put_uint16 (is_big_endian, module->slot_number, res_len, p_bytes, p_pos);
+   p_dst = pf_store_uint16 (is_big_endian, module->slot_number, p_dst);
    if (module->state == PF_MODULE_STATE_NO_MODULE)
    {
-      pf_put_uint32 (is_big_endian, 0, res_len, p_bytes, p_pos);
+      p_dst = pf_store_uint32 (is_big_endian, 0, p_dst);
+      p_dst = pf_store_uint16 (is_big_endian, module->state, p_dst);
+      p_dst = pf_store_uint32 (is_big_endian, 0, p_dst);
    }
    else
    {
-      pf_put_uint32 (
-         is_big_endian,
-         module->ident_number,
-         res_len,
-         p_bytes,
-         p_pos);
-   }
-   pf_put_uint16 (is_big_endian, module->state, res_len, p_bytes, p_pos);
-   if (module->state == PF_MODULE_STATE_NO_MODULE)
-   {
-      pf_put_uint32 (is_big_endian, 0, res_len, p_bytes, p_pos);
-   }
-   else
-   {
-      pf_put_uint16 (
-         is_big_endian,
-         module->nbr_diff_submodules,
-         res_len,
-         p_bytes,
-         p_pos);
+      p_dst = pf_store_uint32 (is_big_endian, module->ident_number, p_dst);
+      p_dst = pf_store_uint16 (is_big_endian, module->state, p_dst);
+      p_dst =
+         pf_store_uint16 (is_big_endian, module->nbr_diff_submodules, p_dst);
       for (ix = 0; ix < module->nbr_diff_submodules; ix++)
       {
-         pf_put_submodule_diff (
+         p_dst = pf_store_submodule_diff (
             is_big_endian,
             &module->submodule[module->diff_submodule[ix]],
-            res_len,
-            p_bytes,
-            p_pos);
+            p_dst);
       }
    }
+
+   return p_dst;
 }
 
-/**
- * @internal
- * Insert an API diff into a buffer.
- * @param is_big_endian    In:    Endianness of the destination buffer.
- * @param api              In:    The expected api containing differences.
- * @param res_len          In:    Size of destination buffer.
- * @param p_bytes          Out:   Destination buffer.
- * @param p_pos            InOut: Position in destination buffer.
- */
-static void pf_put_api_diff (
+void pf_put_ar_diff (
    bool is_big_endian,
-   pf_exp_api_t const * api,
+   const pf_ar_t * p_ar,
    uint16_t res_len,
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
+   pf_exp_ident_t const * ident;
+   pf_exp_api_t const * api;
+   uint32_t block_len;
+   uint8_t * p_dst;
+   uint16_t api_ix;
    uint16_t mod_ix;
 
-   pf_put_uint32 (is_big_endian, api->api, res_len, p_bytes, p_pos);
-
-   pf_put_uint16 (is_big_endian, api->nbr_diff_modules, res_len, p_bytes, p_pos);
-   for (mod_ix = 0; mod_ix < api->nbr_diff_modules; mod_ix++)
+   if ((p_ar == NULL) || (p_ar->exp_ident.nbr_diff_apis == 0))
    {
-      pf_put_module_diff (
-         is_big_endian,
-         &api->module[api->diff_module[mod_ix]],
-         res_len,
-         p_bytes,
-         p_pos);
+      return;
    }
-}
 
-void pf_put_ar_diff (
-   bool is_big_endian,
-   const pf_ar_t * p_ar,
-   uint16_t res_len,
-   uint8_t * p_bytes,
-   uint16_t * p_pos)
-{
-   uint16_t block_pos;
-   uint16_t block_len;
-   uint16_t i;
-
-   if (p_ar != NULL)
+   /* First pass: Calculate the size, and check it against the buffer */
+   ident = &p_ar->exp_ident;
+   block_len = pf_size_ar_diff (ident);
+   if (block_len > UINT16_MAX)
    {
-      pf_exp_ident_t const * ident = &p_ar->exp_ident;
+      LOG_DEBUG (PNET_LOG, "BW(%d): Output buffer is full\n", __LINE__);
+      return;
+   }
+   p_dst = pf_put_reserve ((uint16_t)block_len, res_len, p_bytes, p_pos);
+   if (p_dst == NULL)
+   {
+      return;
+   }
 
-      if (ident->nbr_diff_apis > 0)
+   /* Second pass: Write the block */
+   p_dst = pf_store_block_header (
+      is_big_endian,
+      PF_BT_MODULE_DIFF_BLOCK,
+      (uint16_t)block_len,
+      p_dst);
+   p_dst = pf_store_uint16 (is_big_endian, ident->nbr_diff_apis, p_dst);
+   for (api_ix = 0; api_ix < ident->nbr_diff_apis; api_ix++)
+   {
+      api = &ident->api[ident->diff_api[api_ix]];
+      p_dst = pf_store_uint32 (is_big_endian, api->api, p_dst);
+      p_dst = pf_store_uint16 (is_big_endian, api->nbr_diff_modules, p_dst);
+      for (mod_ix = 0; mod_ix < api->nbr_diff_modules; mod_ix++)
       {
-         block_pos = *p_pos;
-         block_len = 0; /* Dont know block_len yet */
-
-         pf_put_block_header (
+         p_dst = pf_store_module_diff (
             is_big_endian,
-            PF_BT_MODULE_DIFF_BLOCK,
-            block_len,
-            PNET_BLOCK_VERSION_HIGH,
-            PNET_BLOCK_VERSION_LOW,
-            res_len,
-            p_bytes,
-            p_pos);
-
-         pf_put_uint16 (
-            is_big_endian,
-            ident->nbr_diff_apis,
-            res_len,
-            p_bytes,
-            p_pos);
-
-         for (i = 0; i < ident->nbr_diff_apis; ++i)
-         {
-            pf_put_api_diff (
-               is_big_endian,
-               &ident->api[ident->diff_api[i]],
-               res_len,
-               p_bytes,
-               p_pos);
-         }
-
-         /* Finally insert the block length into the block header */
-         block_len = *p_pos - (block_pos + 4);
-         block_pos += offsetof (pf_block_header_t, block_length);
-         pf_put_uint16 (is_big_endian, block_len, res_len, p_bytes, &block_pos);
+            &api->module[api->diff_module[mod_ix]],
+            p_dst);
       }
    }
 }
@@ -1440,108 +1518,68 @@ void pf_put_dce_rpc_header (
    uint8_t * p_bytes,
    uint16_t * p_pos,
    uint16_t * p_pos_body_len)
-{
-   uint32_t temp_u32;
-
-   pf_put_byte (p_rpc->version, res_len, p_bytes, p_pos);
-   pf_put_byte (p_rpc->packet_type, res_len, p_bytes, p_pos);
-   /* flags */
-   temp_u32 = 0;
-   pf_put_bits (
-      p_rpc->flags.last_fragment ? 1 : 0,
-      1,
-      PF_RPC_F_LAST_FRAGMENT,
-      &temp_u32);
-   pf_put_bits (p_rpc->flags.fragment ? 1 : 0, 1, PF_RPC_F_FRAGMENT, &temp_u32);
-   pf_put_bits (p_rpc->flags.no_fack ? 1 : 0, 1, PF_RPC_F_NO_FACK, &temp_u32);
-   pf_put_bits (p_rpc->flags.maybe ? 1 : 0, 1, PF_RPC_F_MAYBE, &temp_u32);
-   pf_put_bits (
-      p_rpc->flags.idempotent ? 1 : 0,
-      1,
-      PF_RPC_F_IDEMPOTENT,
-      &temp_u32);
-   pf_put_bits (
-      p_rpc->flags.broadcast ? 1 : 0,
-      1,
-      PF_RPC_F_BROADCAST,
-      &temp_u32);
-   pf_put_byte (temp_u32 % 0x100, res_len, p_bytes, p_pos);
-
-   /* flags2 */
-   pf_put_byte (0, res_len, p_bytes, p_pos);
-   /* Data repr */
-   temp_u32 = 0; /* Always ASCII */
-   pf_put_bits (p_rpc->is_big_endian ? 0 : 1, 4, 4, &temp_u32);
-   pf_put_byte (temp_u32 % 0x100, res_len, p_bytes, p_pos);
-   /* Float repr */
-   pf_put_byte (p_rpc->float_repr, res_len, p_bytes, p_pos);
-
-   pf_put_byte (p_rpc->reserved, res_len, p_bytes, p_pos);
-   pf_put_byte (p_rpc->serial_high, res_len, p_bytes, p_pos);
-   pf_put_uuid (
-      p_rpc->is_big_endian,
-      &p_rpc->object_uuid,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uuid (
-      p_rpc->is_big_endian,
-      &p_rpc->interface_uuid,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uuid (
-      p_rpc->is_big_endian,
-      &p_rpc->activity_uuid,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint32 (
-      p_rpc->is_big_endian,
-      p_rpc->server_boot_time,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint32 (
-      p_rpc->is_big_endian,
-      p_rpc->interface_version,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint32 (
-      p_rpc->is_big_endian,
-      p_rpc->sequence_nmb,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint16 (p_rpc->is_big_endian, p_rpc->opnum, res_len, p_bytes, p_pos);
-   pf_put_uint16 (
-      p_rpc->is_big_endian,
-      p_rpc->interface_hint,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint16 (
-      p_rpc->is_big_endian,
-      p_rpc->activity_hint,
-      res_len,
-      p_bytes,
-      p_pos);
-   *p_pos_body_len = *p_pos;
-   pf_put_uint16 (
-      p_rpc->is_big_endian,
-      p_rpc->length_of_body,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_uint16 (
-      p_rpc->is_big_endian,
-      p_rpc->fragment_nmb,
-      res_len,
-      p_bytes,
-      p_pos);
-   pf_put_byte (p_rpc->auth_protocol, res_len, p_bytes, p_pos);
-   pf_put_byte (p_rpc->serial_low, res_len, p_bytes, p_pos);
+{
+   const bool be = p_rpc->is_big_endian;
+   uint16_t start_pos = *p_pos;
+   uint8_t * p_dst;
+   uint32_t temp_u32;
+
+   p_dst = pf_put_reserve (PF_DCE_RPC_HEADER_SIZE, res_len, p_bytes, p_pos);
+   if (p_dst == NULL)
+   {
+      *p_pos_body_len = start_pos;
+      return;
+   }
+
+   p_dst[0] = p_rpc->version;
+   p_dst[1] = p_rpc->packet_type;
+   /* flags */
+   temp_u32 = 0;
+   pf_put_bits (
+      p_rpc->flags.last_fragment ? 1 : 0,
+      1,
+      PF_RPC_F_LAST_FRAGMENT,
+      &temp_u32);
+   pf_put_bits (p_rpc->flags.fragment ? 1 : 0, 1, PF_RPC_F_FRAGMENT, &temp_u32);
+   pf_put_bits (p_rpc->flags.no_fack ? 1 : 0, 1, PF_RPC_F_NO_FACK, &temp_u32);
+   pf_put_bits (p_rpc->flags.maybe ? 1 : 0, 1, PF_RPC_F_MAYBE, &temp_u32);
+   pf_put_bits (
+      p_rpc->flags.idempotent ? 1 : 0,
+      1,
+      PF_RPC_F_IDEMPOTENT,
+      &temp_u32);
+   pf_put_bits (
+      p_rpc->flags.broadcast ? 1 : 0,
+      1,
+      PF_RPC_F_BROADCAST,
+      &temp_u32);
+   p_dst[2] = temp_u32 % 0x100;
+
+   /* flags2 */
+   p_dst[3] = 0;
+   /* Data repr */
+   temp_u32 = 0; /* Always ASCII */
+   pf_put_bits (be ? 0 : 1, 4, 4, &temp_u32);
+   p_dst[4] = temp_u32 % 0x100;
+   /* Float repr */
+   p_dst[5] = p_rpc->float_repr;
+
+   p_dst[6] = p_rpc->reserved;
+   p_dst[7] = p_rpc->serial_high;
+   p_dst = pf_store_uuid (be, &p_rpc->object_uuid, &p_dst[8]);
+   p_dst = pf_store_uuid (be, &p_rpc->interface_uuid, p_dst);
+   p_dst = pf_store_uuid (be, &p_rpc->activity_uuid, p_dst);
+   p_dst = pf_store_uint32 (be, p_rpc->server_boot_time, p_dst);
+   p_dst = pf_store_uint32 (be, p_rpc->interface_version, p_dst);
+   p_dst = pf_store_uint32 (be, p_rpc->sequence_nmb, p_dst);
+   p_dst = pf_store_uint16 (be, p_rpc->opnum, p_dst);
+   p_dst = pf_store_uint16 (be, p_rpc->interface_hint, p_dst);
+   p_dst = pf_store_uint16 (be, p_rpc->activity_hint, p_dst);
+   *p_pos_body_len = start_pos + 74;
+   p_dst = pf_store_uint16 (be, p_rpc->length_of_body, p_dst);
+   p_dst = pf_store_uint16 (be, p_rpc->fragment_nmb, p_dst);
+   p_dst[0] = p_rpc->auth_protocol;
+   p_dst[1] = p_rpc->serial_low;
 }
 
 void pf_put_record_data_read (
@@ -2679,6 +2717,21 @@ void pf_put_log_book_data (
    pf_put_uint16 (is_big_endian, block_len, res_len, p_bytes, &block_pos);
 }
 
+uint16_t pf_put_diag_item_size (const pf_diag_item_t * p_item)
+{
+   switch (p_item->usi)
+   {
+   case PF_USI_CHANNEL_DIAGNOSIS:
+      return 6;
+   case PF_USI_EXTENDED_CHANNEL_DIAGNOSIS:
+      return 12;
+   case PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS:
+      return 16;
+   default:
+      return p_item->fmt.usi.len;
+   }
+}
+
 /**
  * @internal
  * Insert one diagnosis item to a buffer.
@@ -2698,7 +2751,7 @@ void pf_put_log_book_data (
  * @param p_bytes          Out:   Destination buffer.
  * @param p_pos            InOut: Position in destination buffer.
  */
-static void pf_put_diag_item (
+void pf_put_diag_item (
    bool is_big_endian,
    const pf_diag_item_t * p_item,
    bool insert_usi,
@@ -2706,116 +2759,56 @@ static void pf_put_diag_item (
    uint8_t * p_bytes,
    uint16_t * p_pos)
 {
+   uint16_t size = pf_put_diag_item_size (p_item) + (insert_usi ? 2 : 0);
+   uint8_t * p_dst;
+
+   p_dst = pf_put_reserve (size, res_len, p_bytes, p_pos);
+   if (p_dst == NULL)
+   {
+      return;
+   }
+
    if (insert_usi == true)
    {
-      pf_put_uint16 (is_big_endian, p_item->usi, res_len, p_bytes, p_pos);
+      p_dst = pf_store_uint16 (is_big_endian, p_item->usi, p_dst);
    }
 
    switch (p_item->usi)
    {
    case PF_USI_CHANNEL_DIAGNOSIS:
-      /* Insert std format diagnosis */
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_nbr,
-         res_len,
-         p_bytes,
-         p_pos);
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_properties,
-         res_len,
-         p_bytes,
-         p_pos);
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_error_type,
-         res_len,
-         p_bytes,
-         p_pos);
-      break;
    case PF_USI_EXTENDED_CHANNEL_DIAGNOSIS:
-      /* Insert std format diagnosis */
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_nbr,
-         res_len,
-         p_bytes,
-         p_pos);
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_properties,
-         res_len,
-         p_bytes,
-         p_pos);
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_error_type,
-         res_len,
-         p_bytes,
-         p_pos);
-
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ext_ch_error_type,
-         res_len,
-         p_bytes,
-         p_pos);
-      pf_put_uint32 (
-         is_big_endian,
-         p_item->fmt.std.ext_ch_add_value,
-         res_len,
-         p_bytes,
-         p_pos);
-      break;
    case PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS:
       /* Insert std format diagnosis */
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_nbr,
-         res_len,
-         p_bytes,
-         p_pos);
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_properties,
-         res_len,
-         p_bytes,
-         p_pos);
-      pf_put_uint16 (
-         is_big_endian,
-         p_item->fmt.std.ch_error_type,
-         res_len,
-         p_bytes,
-         p_pos);
+      p_dst = pf_store_uint16 (is_big_endian, p_item->fmt.std.ch_nbr, p_dst);
+      p_dst =
+         pf_store_uint16 (is_big_endian, p_item->fmt.std.ch_properties, p_dst);
+      p_dst =
+         pf_store_uint16 (is_big_endian, p_item->fmt.std.ch_error_type, p_dst);
+      if (p_item->usi == PF_USI_CHANNEL_DIAGNOSIS)
+      {
+         break;
+      }
 
-      pf_put_uint16 (
+      p_dst = pf_store_uint16 (
          is_big_endian,
          p_item->fmt.std.ext_ch_error_type,
-         res_len,
-         p_bytes,
-         p_pos);
-      pf_put_uint32 (
+         p_dst);
+      p_dst = pf_store_uint32 (
          is_big_endian,
          p_item->fmt.std.ext_ch_add_value,
-         res_len,
-         p_bytes,
-         p_pos);
+         p_dst);
+      if (p_item->usi == PF_USI_EXTENDED_CHANNEL_DIAGNOSIS)
+      {
+         break;
+      }
 
-      pf_put_uint32 (
+      (void)pf_store_uint32 (
          is_big_endian,
          p_item->fmt.std.qual_ch_qualifier,
-         res_len,
-         p_bytes,
-         p_pos);
+         p_dst);
       break;
    default:
-      pf_put_mem (
-         p_item->fmt.usi.manuf_data,
-         p_item->fmt.usi.len,
-         res_len,
-         p_bytes,
-         p_pos);
+      memcpy (p_dst, p_item->fmt.usi.manuf_data, p_item->fmt.usi.len);
       break;
    }
 }
@@ -2981,7 +2974,8 @@ static void pf_put_diag_list (
 
 /**
  * @internal
- * Insert diagnosis items of a subslot into a buffer.
+ * Insert diagnosis items of a subslot into a buffer, one DiagnosisData block
+ * per USI.
  *
  * @param net              InOut: The p-net stack instance
  * @param big_endian       In:    true if buffer is big-endian.
@@ -2993,7 +2987,7 @@ static void pf_put_diag_list (
  * @param bytes            Out:   Destination buffer.
  * @param pos              InOut: Position in destination buffer.
  */
-static void pf_put_diag_subslot (
+static void pf_put_diag_subslot_blocks (
    pnet_t * net,
    bool big_endian,
    pf_diag_filter_level_t diag_filter,
@@ -3029,6 +3023,167 @@ static void pf_put_diag_subslot (
    }
 }
 
+#if PNET_MAX_DIAG_CACHE_SIZE > 0
+/**
+ * @internal
+ * Calculate the size of all DiagnosisData blocks of a subslot, without
+ * filtering.
+ *
+ * Each USI gives one block, with block header, API, slot, subslot,
+ * channel number, channel properties and USI.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param subslot          In:    The subslot instance.
+ * @return  the number of bytes written by pf_put_diag_subslot_blocks() for
+ *          PF_DIAG_FILTER_ALL.
+ */
+static uint32_t pf_put_diag_subslot_size (
+   pnet_t * net,
+   pf_subslot_t const * subslot)
+{
+   const uint32_t block_fixed_size = sizeof (pf_block_header_t) + 14;
+   pf_diag_item_t * p_item = NULL;
+   uint32_t size = 0;
+   uint16_t usi = 0;
+   int err;
+
+   err = pf_cmdev_get_next_diagnosis_usi (net, subslot->diag_list, 0, &usi);
+   while (err == 0)
+   {
+      size += block_fixed_size;
+      err =
+         pf_cmdev_get_next_diagnosis_usi (net, subslot->diag_list, usi, &usi);
+   }
+
+   pf_cmdev_get_diag_item (net, subslot->diag_list, &p_item);
+   while (p_item != NULL)
+   {
+      if (p_item->usi > 0)
+      {
+         size += pf_put_diag_item_size (p_item);
+      }
+      pf_cmdev_get_diag_item (net, p_item->next, &p_item);
+   }
+
+   return size;
+}
+
+/**
+ * @internal
+ * Regenerate the cached DiagnosisData blocks of a subslot.
+ *
+ * If the blocks do not fit into the cache, the cache is marked as such and
+ * the blocks are encoded directly into the response instead.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param api              In:    The API number to write to the cache.
+ * @param slot_number      In:    The slot number to write to the cache.
+ * @param subslot          InOut: The subslot instance.
+ */
+static void pf_put_diag_subslot_cache_update (
+   pnet_t * net,
+   uint32_t api,
+   uint16_t slot_number,
+   pf_subslot_t * subslot)
+{
+   uint16_t len = 0;
+
+   subslot->diag_cache_fits =
+      pf_put_diag_subslot_size (net, subslot) <= sizeof (subslot->diag_cache);
+   if (subslot->diag_cache_fits)
+   {
+      pf_put_diag_subslot_blocks (
+         net,
+         true,
+         PF_DIAG_FILTER_ALL,
+         api,
+         slot_number,
+         subslot,
+         sizeof (subslot->diag_cache),
+         subslot->diag_cache,
+         &len);
+   }
+   subslot->diag_cache_len = len;
+   subslot->diag_cache_valid = true;
+}
+#endif
+
+/**
+ * @internal
+ * Insert diagnosis items of a subslot into a buffer.
+ *
+ * Reads of all diagnosis items (big-endian) use the cached encoding of the
+ * subslot, which is regenerated only after the diagnosis list has changed.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param big_endian       In:    true if buffer is big-endian.
+ * @param diag_filter      In:    Type of diag items to insert.
+ * @param api              In:    The API number to write to buffer.
+ * @param slot_number      In:    The slot number to write to buffer.
+ * @param subslot          InOut: The subslot instance.
+ * @param res_len          In:    Size of destination buffer.
+ * @param bytes            Out:   Destination buffer.
+ * @param pos              InOut: Position in destination buffer.
+ */
+static void pf_put_diag_subslot (
+   pnet_t * net,
+   bool big_endian,
+   pf_diag_filter_level_t diag_filter,
+   uint32_t api,
+   uint16_t slot_number,
+   pf_subslot_t * subslot,
+   uint16_t res_len,
+   uint8_t * bytes,
+   uint16_t * pos)
+{
+#if PNET_MAX_DIAG_CACHE_SIZE > 0
+   if ((diag_filter == PF_DIAG_FILTER_ALL) && (big_endian == true))
+   {
+      os_mutex_lock (net->cmdev_device.diag_mutex);
+      if (subslot->diag_cache_valid == false)
+      {
+         pf_put_diag_subslot_cache_update (net, api, slot_number, subslot);
+      }
+
+      if (subslot->diag_cache_fits)
+      {
+         pf_put_mem (
+            subslot->diag_cache,
+            subslot->diag_cache_len,
+            res_len,
+            bytes,
+            pos);
+      }
+      else
+      {
+         pf_put_diag_subslot_blocks (
+            net,
+            big_endian,
+            diag_filter,
+            api,
+            slot_number,
+            subslot,
+            res_len,
+            bytes,
+            pos);
+      }
+      os_mutex_unlock (net->cmdev_device.diag_mutex);
+      return;
+   }
+#endif
+
+   pf_put_diag_subslot_blocks (
+      net,
+      big_endian,
+      diag_filter,
+      api,
+      slot_number,
+      subslot,
+      res_len,
+      bytes,
+      pos);
+}
+
 /**
  * @internal
  * Insert diagnosis items of a slot into a buffer.
@@ -3047,7 +3202,7 @@ static void pf_put_diag_slot (
    bool big_endian,
    pf_diag_filter_level_t diag_filter,
    uint32_t api,
-   pf_slot_t const * slot,
+   pf_slot_t * slot,
    uint16_t res_len,
    uint8_t * bytes,
    uint16_t * pos)
@@ -3056,7 +3211,7 @@ static void pf_put_diag_slot (
 
    for (s = 0; s < PNET_MAX_SUBSLOTS; ++s)
    {
-      pf_subslot_t const * subslot = &slot->subslots[s];
+      pf_subslot_t * subslot = &slot->subslots[s];
 
       if (subslot->in_use)
       {
@@ -3093,7 +3248,7 @@ static void pf_put_diag_ar_slot (
    bool big_endian,
    pf_diag_filter_level_t diag_filter,
    uint32_t api,
-   pf_slot_t const * slot,
+   pf_slot_t * slot,
    pf_exp_module_t const * module,
    uint16_t res_len,
    uint8_t * bytes,
@@ -3141,12 +3296,12 @@ static void pf_put_diag_api (
    pnet_t * net,
    bool big_endian,
    pf_diag_filter_level_t diag_filter,
-   pf_api_t const * api,
+   pf_api_t * api,
    uint16_t res_len,
    uint8_t * bytes,
    uint16_t * pos)
 {
-   pf_slot_t const * slot;
+   pf_slot_t * slot;
    uint16_t s;
 
    for (s = 0; s < PNET_MAX_SLOTS; ++s)
@@ -3495,6 +3650,9 @@ void pf_put_alarm_block (
    uint16_t block_len = 0;
    uint32_t temp_u16;
    uint32_t temp_u32;
+   pf_diag_item_t item;
+   uint16_t nbr_of_items;
+   uint16_t ix;
 
    /* Insert block header for the alarm block */
    pf_put_block_header (
@@ -3600,13 +3758,25 @@ void pf_put_alarm_block (
                p_bytes,
                p_pos);
          }
-         pf_put_diag_item (
-            is_big_endian,
-            (pf_diag_item_t *)p_payload,
-            true, /* Insert the USI field */
-            res_len,
-            p_bytes,
-            p_pos);
+         /* The USI field is only inserted before the first item */
+         memset (&item, 0, sizeof (item));
+         item.usi = payload_usi;
+         nbr_of_items = payload_len / sizeof (pf_diag_std_t);
+         if (nbr_of_items == 0)
+         {
+            nbr_of_items = 1;
+         }
+         for (ix = 0; ix < nbr_of_items; ix++)
+         {
+            item.fmt.std = ((const pf_diag_std_t *)p_payload)[ix];
+            pf_put_diag_item (
+               is_big_endian,
+               &item,
+               ix == 0,
+               res_len,
+               p_bytes,
+               p_pos);
+         }
          break;
       default:
          /* Manufacturer data */
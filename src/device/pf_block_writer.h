@@ -524,6 +524,19 @@ void pf_put_alarm_fixed (
    uint8_t * p_bytes,
    uint16_t * p_pos);
 
+/**
+ * Calculate the encoded size of a diagnosis item, without the USI field.
+ *
+ * This is the size of the ChannelDiagnosis, ExtChannelDiagnosis or
+ * QualifiedChannelDiagnosis data for diagnosis in standard format, and of
+ * the manufacturer data otherwise.
+ *
+ * @param p_item           In:    The diag item.
+ * @return  the number of bytes written for the item in an alarm or in a
+ *          diagnosis read response.
+ */
+uint16_t pf_put_diag_item_size (const pf_diag_item_t * p_item);
+
 /**
  * Insert an AlarmNotification or AlarmAck block into a buffer.
  *
@@ -539,12 +552,13 @@ void pf_put_alarm_fixed (
  *                                block type = alarm notify.
  *                                Use 0 for no payload.
  * @param payload_len      In:    Number of bytes of manufaturer data.
- *                                Only used for manufacturer data
- *                                (payload USI <= 0x7FFF).
  *                                May be 0 for manufacturer data.
- * @param p_payload        In:    pf_diag_item_t, manufacturer data or NULL.
+ *                                For diagnosis in standard format, the size
+ *                                of the pf_diag_std_t array.
+ * @param p_payload        In:    Array of pf_diag_std_t (all with the payload
+ *                                USI), manufacturer data or NULL.
  *                                Mandatory if payload_len > 0 or for USI
- *                                values that expect a pf_diag_item_t
+ *                                values that expect a pf_diag_std_t
  * @param p_status         In:    PNIO status. Only used for block type = alarm
  *                                ack.
  * @param res_len          In:    Size of destination buffer.
@@ -1019,6 +1033,16 @@ void pf_put_lookup_response_data (
    uint8_t * p_bytes,
    uint16_t * p_pos);
 
+/************ Internal functions, made available for unit testing ************/
+
+void pf_put_diag_item (
+   bool is_big_endian,
+   const pf_diag_item_t * p_item,
+   bool insert_usi,
+   uint16_t res_len,
+   uint8_t * p_bytes,
+   uint16_t * p_pos);
+
 #ifdef __cplusplus
 }
 #endif
@@ -315,7 +315,7 @@ int pf_cmdev_get_diag_item (
 {
    int ret = -1;
 
-   if (item_ix < NELEMENTS (net->cmdev_device.diag_items))
+   if (item_ix < net->cmdev_device.max_diag_items)
    {
       *pp_item = &net->cmdev_device.diag_items[item_ix];
 
@@ -353,10 +353,192 @@ int pf_cmdev_new_diag (pnet_t * net, uint16_t * p_item_ix)
    return ret;
 }
 
+/**
+ * @internal
+ * Calculate the diagnosis index bucket for a diagnosis key.
+ *
+ * For diagnosis in standard format, the USI is not part of the key.
+ *
+ * @param nbr_of_buckets   In:    Number of buckets in the index.
+ * @param api_id           In:    The API.
+ * @param slot_nbr         In:    The slot number.
+ * @param subslot_nbr      In:    The subslot number.
+ * @param usi              In:    The USI.
+ * @param ch_nbr           In:    The channel number. Standard format only.
+ * @param ch_grouping      In:    Accumulative. Standard format only.
+ * @param ch_direction     In:    Channel direction. Standard format only.
+ * @param ch_error_type    In:    The channel error type. Standard format only.
+ * @param ext_ch_error_type In:   The extended channel error type. Standard
+ *                                format only.
+ * @return The bucket index.
+ */
+static uint16_t pf_cmdev_diag_bucket (
+   uint16_t nbr_of_buckets,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   uint16_t subslot_nbr,
+   uint16_t usi,
+   uint16_t ch_nbr,
+   uint16_t ch_grouping,
+   uint16_t ch_direction,
+   uint16_t ch_error_type,
+   uint16_t ext_ch_error_type)
+{
+   /* FNV-1a on 16-bit words */
+   uint32_t hash = 2166136261u;
+
+   hash = (hash ^ (api_id >> 16)) * 16777619u;
+   hash = (hash ^ (api_id & 0xFFFF)) * 16777619u;
+   hash = (hash ^ slot_nbr) * 16777619u;
+   hash = (hash ^ subslot_nbr) * 16777619u;
+   if (usi >= PF_USI_CHANNEL_DIAGNOSIS)
+   {
+      hash = (hash ^ ch_nbr) * 16777619u;
+      hash = (hash ^ ((ch_grouping << 8) | ch_direction)) * 16777619u;
+      hash = (hash ^ ch_error_type) * 16777619u;
+      hash = (hash ^ ext_ch_error_type) * 16777619u;
+   }
+   else
+   {
+      hash = (hash ^ usi) * 16777619u;
+   }
+
+   return (uint16_t)(hash % nbr_of_buckets);
+}
+
+/**
+ * @internal
+ * Calculate the diagnosis index bucket for a diag item.
+ *
+ * @param net              In:    The p-net stack instance
+ * @param item_ix          In:    Index of the diag item.
+ * @return The bucket index.
+ */
+static uint16_t pf_cmdev_diag_item_bucket (const pnet_t * net, uint16_t item_ix)
+{
+   const pf_diag_item_t * p_item = &net->cmdev_device.diag_items[item_ix];
+   const pf_diag_item_link_t * p_link = &net->cmdev_device.diag_links[item_ix];
+
+   return pf_cmdev_diag_bucket (
+      net->cmdev_device.max_diag_items,
+      p_link->api_id,
+      p_link->slot_nbr,
+      p_link->subslot_nbr,
+      p_item->usi,
+      p_item->fmt.std.ch_nbr,
+      PF_DIAG_CH_PROP_ACC_GET (p_item->fmt.std.ch_properties),
+      PF_DIAG_CH_PROP_DIR_GET (p_item->fmt.std.ch_properties),
+      p_item->fmt.std.ch_error_type,
+      p_item->fmt.std.ext_ch_error_type);
+}
+
+void pf_cmdev_index_diag (
+   pnet_t * net,
+   uint16_t item_ix,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   uint16_t subslot_nbr)
+{
+   pf_diag_item_link_t * p_link;
+   uint16_t bucket;
+
+   if (item_ix < net->cmdev_device.max_diag_items)
+   {
+      p_link = &net->cmdev_device.diag_links[item_ix];
+      p_link->api_id = api_id;
+      p_link->slot_nbr = slot_nbr;
+      p_link->subslot_nbr = subslot_nbr;
+
+      bucket = pf_cmdev_diag_item_bucket (net, item_ix);
+      p_link->index_next = net->cmdev_device.diag_index[bucket];
+      net->cmdev_device.diag_index[bucket] = item_ix;
+   }
+}
+
+void pf_cmdev_unindex_diag (pnet_t * net, uint16_t item_ix)
+{
+   uint16_t bucket = pf_cmdev_diag_item_bucket (net, item_ix);
+   uint16_t * p_ix = &net->cmdev_device.diag_index[bucket];
+
+   while (*p_ix != PF_DIAG_IX_NULL)
+   {
+      if (*p_ix == item_ix)
+      {
+         *p_ix = net->cmdev_device.diag_links[item_ix].index_next;
+         break;
+      }
+      p_ix = &net->cmdev_device.diag_links[*p_ix].index_next;
+   }
+}
+
+uint16_t pf_cmdev_find_diag (
+   pnet_t * net,
+   const pnet_diag_source_t * p_diag_source,
+   uint16_t ch_error_type,
+   uint16_t ext_ch_error_type,
+   uint16_t usi)
+{
+   const pf_diag_item_t * p_item;
+   const pf_diag_item_link_t * p_link;
+   uint16_t item_ix;
+
+   item_ix = net->cmdev_device.diag_index[pf_cmdev_diag_bucket (
+      net->cmdev_device.max_diag_items,
+      p_diag_source->api,
+      p_diag_source->slot,
+      p_diag_source->subslot,
+      usi,
+      p_diag_source->ch,
+      p_diag_source->ch_grouping,
+      p_diag_source->ch_direction,
+      ch_error_type,
+      ext_ch_error_type)];
+
+   while (item_ix != PF_DIAG_IX_NULL)
+   {
+      p_item = &net->cmdev_device.diag_items[item_ix];
+      p_link = &net->cmdev_device.diag_links[item_ix];
+      if (
+         (p_link->api_id == p_diag_source->api) &&
+         (p_link->slot_nbr == p_diag_source->slot) &&
+         (p_link->subslot_nbr == p_diag_source->subslot))
+      {
+         if (usi >= PF_USI_CHANNEL_DIAGNOSIS)
+         {
+            if (
+               (p_item->usi >= PF_USI_CHANNEL_DIAGNOSIS) &&
+               (p_item->fmt.std.ch_nbr == p_diag_source->ch) &&
+               (p_item->fmt.std.ch_error_type == ch_error_type) &&
+               (p_item->fmt.std.ext_ch_error_type == ext_ch_error_type) &&
+               (PF_DIAG_CH_PROP_ACC_GET (p_item->fmt.std.ch_properties) ==
+                p_diag_source->ch_grouping) &&
+               (PF_DIAG_CH_PROP_DIR_GET (p_item->fmt.std.ch_properties) ==
+                p_diag_source->ch_direction))
+            {
+               return item_ix;
+            }
+         }
+         else if (p_item->usi == usi)
+         {
+            return item_ix;
+         }
+      }
+
+      item_ix = p_link->index_next;
+   }
+
+   return PF_DIAG_IX_NULL;
+}
+
 void pf_cmdev_free_diag (pnet_t * net, uint16_t item_ix)
 {
-   if (item_ix < NELEMENTS (net->cmdev_device.diag_items))
+   if (item_ix < net->cmdev_device.max_diag_items)
    {
+      if (net->cmdev_device.diag_items[item_ix].in_use)
+      {
+         pf_cmdev_unindex_diag (net, item_ix);
+      }
+
       /* Put it first in the free list. */
       net->cmdev_device.diag_items[item_ix].in_use = false;
       net->cmdev_device.diag_items[item_ix].next =
@@ -561,6 +743,7 @@ static int pf_cmdev_new_subslot (
          memset (p_subslot, 0, sizeof (*p_subslot));
          p_subslot->subslot_number = subslot_nbr;
          p_subslot->diag_list = PF_DIAG_IX_NULL;
+         p_subslot->diag_batch_removed = PF_DIAG_IX_NULL;
          p_subslot->in_use = true;
 
          ret = 0;
@@ -628,6 +811,57 @@ int pf_cmdev_plug_module (
    return ret;
 }
 
+/**
+ * @internal
+ * Free a list of diag items.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param item_ix          In:    Index of the first item in the list.
+ */
+static void pf_cmdev_free_diag_list (pnet_t * net, uint16_t item_ix)
+{
+   uint16_t next_ix;
+
+   while (item_ix < net->cmdev_device.max_diag_items)
+   {
+      next_ix = net->cmdev_device.diag_items[item_ix].next;
+      pf_cmdev_free_diag (net, item_ix);
+      item_ix = next_ix;
+   }
+}
+
+/**
+ * @internal
+ * Free all diag items of a subslot, and remove them from the device diag
+ * counters.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_subslot        InOut: The subslot instance.
+ */
+static void pf_cmdev_free_subslot_diag (pnet_t * net, pf_subslot_t * p_subslot)
+{
+   pf_diag_counters_t * p_counters = &net->cmdev_device.diag_counters;
+
+   os_mutex_lock (net->cmdev_device.diag_mutex);
+   pf_cmdev_free_diag_list (net, p_subslot->diag_list);
+   pf_cmdev_free_diag_list (net, p_subslot->diag_batch_removed);
+   p_subslot->diag_list = PF_DIAG_IX_NULL;
+   p_subslot->diag_batch_removed = PF_DIAG_IX_NULL;
+   p_subslot->diag_batch_changed = false;
+#if PNET_MAX_DIAG_CACHE_SIZE > 0
+   p_subslot->diag_cache_valid = false;
+#endif
+
+   p_counters->fault -= p_subslot->diag_counters.fault;
+   p_counters->maintenance_required -=
+      p_subslot->diag_counters.maintenance_required;
+   p_counters->maintenance_demanded -=
+      p_subslot->diag_counters.maintenance_demanded;
+   p_counters->qualified -= p_subslot->diag_counters.qualified;
+   memset (&p_subslot->diag_counters, 0, sizeof (p_subslot->diag_counters));
+   os_mutex_unlock (net->cmdev_device.diag_mutex);
+}
+
 int pf_cmdev_pull_submodule (
    pnet_t * net,
    uint32_t api_id,
@@ -668,6 +902,7 @@ int pf_cmdev_pull_submodule (
    else
    {
       p_subslot->in_use = false;
+      pf_cmdev_free_subslot_diag (net, p_subslot);
 
       if ((p_subslot->ownsm_state == PF_OWNSM_STATE_IOC) ||
           (p_subslot->ownsm_state == PF_OWNSM_STATE_IOS))
@@ -1151,7 +1386,7 @@ static int pf_cmdev_cfg_dev_show (pf_device_t * p_dev)
    printf (
       "The device can use max %u APIs, and %u diag items.\n",
       (unsigned)PNET_MAX_API,
-      (unsigned)PNET_MAX_DIAG_ITEMS);
+      (unsigned)p_dev->max_diag_items);
    printf ("First unused diag item: %u.\n", (unsigned)p_dev->diag_items_free);
 
    return 0;
@@ -1248,11 +1483,9 @@ void pf_cmdev_diag_show (const pnet_t * net)
    const pf_diag_item_t * p_diag;
 
    printf ("DIAGNOSIS\n");
-   printf (
-      "Max: %u items\n",
-      (uint16_t)NELEMENTS (net->cmdev_device.diag_items));
+   printf ("Max: %u items\n", (unsigned)net->cmdev_device.max_diag_items);
 
-   for (ix = 0; ix < NELEMENTS (net->cmdev_device.diag_items); ix++)
+   for (ix = 0; ix < net->cmdev_device.max_diag_items; ix++)
    {
       if (net->cmdev_device.diag_items[ix].in_use == true)
       {
@@ -1261,7 +1494,7 @@ void pf_cmdev_diag_show (const pnet_t * net)
    }
    printf ("Items in use: %u\n", total);
 
-   for (ix = 0; ix < NELEMENTS (net->cmdev_device.diag_items); ix++)
+   for (ix = 0; ix < net->cmdev_device.max_diag_items; ix++)
    {
       p_diag = &net->cmdev_device.diag_items[ix];
       if (p_diag->in_use == true)
@@ -1309,10 +1542,20 @@ void pf_cmdev_exit (pnet_t * net)
    }
 }
 
+size_t pf_cmdev_pool_size (const pnet_cfg_t * p_cfg)
+{
+   return PF_POOL_ALIGN (p_cfg->max_diag_items * sizeof (pf_diag_item_t)) +
+          PF_POOL_ALIGN (p_cfg->max_diag_items * sizeof (pf_diag_item_link_t)) +
+          PF_POOL_ALIGN (p_cfg->max_diag_items * sizeof (uint16_t));
+}
+
 void pf_cmdev_init (pnet_t * net)
 {
    uint16_t ix;
+   uint16_t max_items;
    pf_api_t * p_api = NULL;
+   pnet_cfg_t * p_cfg = NULL;
+   uint8_t * p_mem;
 
    if (net->cmdev_initialized == false)
    {
@@ -1321,14 +1564,29 @@ void pf_cmdev_init (pnet_t * net)
       memset (&net->cmdev_device, 0, sizeof (net->cmdev_device));
       net->cmdev_device.diag_mutex = os_mutex_create();
 
+      /* Diag items, links and index in the pool allocated at init */
+      pf_fspm_get_cfg (net, &p_cfg);
+      max_items = p_cfg->max_diag_items;
+      p_mem = net->cmdev_pool;
+      memset (p_mem, 0, pf_cmdev_pool_size (p_cfg));
+      net->cmdev_device.max_diag_items = max_items;
+      net->cmdev_device.diag_items = (pf_diag_item_t *)p_mem;
+      p_mem += PF_POOL_ALIGN (max_items * sizeof (pf_diag_item_t));
+      net->cmdev_device.diag_links = (pf_diag_item_link_t *)p_mem;
+      p_mem += PF_POOL_ALIGN (max_items * sizeof (pf_diag_item_link_t));
+      net->cmdev_device.diag_index = (uint16_t *)p_mem;
+
       /* Create a list of free diag items. */
       net->cmdev_device.diag_items_free = 0;
-      for (ix = 0; ix < NELEMENTS (net->cmdev_device.diag_items) - 1; ix++)
+      for (ix = 0; ix < max_items - 1; ix++)
       {
          net->cmdev_device.diag_items[ix].next = ix + 1;
       }
-      net->cmdev_device.diag_items[NELEMENTS (net->cmdev_device.diag_items) - 1]
-         .next = PF_DIAG_IX_NULL;
+      net->cmdev_device.diag_items[max_items - 1].next = PF_DIAG_IX_NULL;
+      for (ix = 0; ix < max_items; ix++)
+      {
+         net->cmdev_device.diag_index[ix] = PF_DIAG_IX_NULL;
+      }
 
       (void)pf_diag_init();
 
@@ -1418,6 +1676,9 @@ int pf_cmdev_state_ind (pnet_t * net, pf_ar_t * p_ar, pnet_event_values_t event)
       pf_cmsm_cmdev_state_ind (net, p_ar, event);
       pf_cmpbe_cmdev_state_ind (p_ar, event);
       pf_cmrpc_cmdev_state_ind (net, p_ar, event);
+#if PNET_OPTION_FAST_STARTUP
+      pf_fsu_cmdev_state_ind (net, p_ar, event);
+#endif
       if (event == PNET_EVENT_ABORT)
       {
          pf_device_clear (net, p_ar);
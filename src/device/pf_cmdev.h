@@ -52,8 +52,19 @@ typedef int (*pf_ftn_slot_t) (pf_slot_t * p_slot);
  */
 typedef int (*pf_ftn_subslot_t) (pf_subslot_t * p_subslot);
 
+/**
+ * Calculate the size of the memory pool used by the cmdev component, for
+ * the diag items.
+ * @param p_cfg            In:    Configuration, with max_diag_items set.
+ * @return  The pool size in bytes.
+ */
+size_t pf_cmdev_pool_size (const pnet_cfg_t * p_cfg);
+
 /**
  * Initialize the cmdev component.
+ *
+ * The diag items are placed in net->cmdev_pool, which must have the size
+ * given by pf_cmdev_pool_size().
  * @param net              InOut: The p-net stack instance
  */
 void pf_cmdev_init (pnet_t * net);
@@ -298,11 +309,64 @@ int pf_cmdev_new_diag (pnet_t * net, uint16_t * p_item_ix);
 
 /**
  * Put a diag item back to the free list.
+ * The item is also removed from the diagnosis index.
  * @param net              InOut: The p-net stack instance
  * @param item_ix          In:    Index of the item to return.
  */
 void pf_cmdev_free_diag (pnet_t * net, uint16_t item_ix);
 
+/**
+ * Insert a diag item into the diagnosis index.
+ *
+ * The USI and for standard format the channel number, channel properties and
+ * error types must be set in the item. These must not be changed while the
+ * item is in the index, except for the channel properties not used for
+ * identification.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param item_ix          In:    Index of the item to insert.
+ * @param api_id           In:    The API of the diagnosis.
+ * @param slot_nbr         In:    The slot number of the diagnosis.
+ * @param subslot_nbr      In:    The subslot number of the diagnosis.
+ */
+void pf_cmdev_index_diag (
+   pnet_t * net,
+   uint16_t item_ix,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   uint16_t subslot_nbr);
+
+/**
+ * Remove a diag item from the diagnosis index.
+ *
+ * The item is still allocated. Use pf_cmdev_free_diag() to free it.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param item_ix          In:    Index of the item to remove.
+ */
+void pf_cmdev_unindex_diag (pnet_t * net, uint16_t item_ix);
+
+/**
+ * Find a diag item using the diagnosis index.
+ *
+ * If the USI is in the manufacturer-specified range then the USI is used to
+ * identify the item. Otherwise the channel number, accumulative (grouping)
+ * and direction and the error types are used.
+ *
+ * @param net               InOut: The p-net stack instance
+ * @param p_diag_source     In:    Slot, subslot, channel, direction etc.
+ * @param ch_error_type     In:    The channel error type.
+ * @param ext_ch_error_type In:    The extended channel error type, or 0.
+ * @param usi               In:    The USI.
+ * @return Index of the diag item, or PF_DIAG_IX_NULL if not found.
+ */
+uint16_t pf_cmdev_find_diag (
+   pnet_t * net,
+   const pnet_diag_source_t * p_diag_source,
+   uint16_t ch_error_type,
+   uint16_t ext_ch_error_type,
+   uint16_t usi);
+
 /**
  * Find next diagnosis USI value (sorted) for a subslot
  *
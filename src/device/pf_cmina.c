@@ -322,6 +322,9 @@ int pf_cmina_set_default_cfg (pnet_t * net, uint16_t reset_mode)
          pf_file_clear (p_file_directory, PF_FILENAME_DIAGNOSTICS);
 #if PNET_OPTION_SNMP
          pf_snmp_data_clear (net);
+#endif
+#if PNET_OPTION_FAST_STARTUP
+         pf_fsu_clear (net);
 #endif
          pf_pdport_reset_all (net);
       }
@@ -358,6 +361,8 @@ int pf_cmina_set_default_cfg (pnet_t * net, uint16_t reset_mode)
 
       /* Init the current communication values */
       net->cmina_current_dcp_ase = net->cmina_nonvolatile_dcp_ase;
+      pf_dcp_identify_rsp_invalidate (net);
+      pf_lldp_invalidate_tx_frames (net);
 
       ret = 0;
    }
@@ -373,6 +378,9 @@ void pf_cmina_dcp_set_commit (pnet_t * net)
    char gateway_string[PNAL_INET_ADDRSTR_SIZE] = {0}; /** Terminated string */
    bool permanent = true;
 
+   pf_dcp_identify_rsp_invalidate (net);
+   pf_lldp_invalidate_tx_frames (net);
+
    if (net->cmina_commit_ip_suite == false)
    {
       LOG_INFO (
@@ -646,6 +654,10 @@ int pf_cmina_dcp_set_ind (
    /* Stop sending Hello packets */
    pf_scheduler_remove_if_running (net, &net->cmina_hello_timeout);
 
+   /* The identify response and LLDP frames reflect cmina_current_dcp_ase */
+   pf_dcp_identify_rsp_invalidate (net);
+   pf_lldp_invalidate_tx_frames (net);
+
    /* Parse incoming DCP SET, without caring about actual CMINA state.
       Update cmina_current_dcp_ase and cmina_nonvolatile_dcp_ase*/
    switch (opt)
@@ -1276,6 +1288,7 @@ int pf_cmina_remove_all_data_files (const char * file_directory)
    pf_file_clear (file_directory, PF_FILENAME_IM);
    pf_file_clear (file_directory, PF_FILENAME_IP);
    pf_file_clear (file_directory, PF_FILENAME_DIAGNOSTICS);
+   pf_file_clear (file_directory, PF_FILENAME_FSU);
 #if PNET_OPTION_SNMP
    pf_snmp_remove_data_files (file_directory);
 #endif
@@ -85,7 +85,8 @@ static const pf_uuid_t uuid_io_device_interface = {
    0x11D1,
    {0x82, 0x71, 0x00, 0xA0, 0x24, 0x42, 0xDF, 0x7D}};
 
-#define PF_CMRPC_NUMBER_OF_RESENDS 3
+#define PF_CMRPC_FRAG_BODY_SIZE                                                \
+   (PF_MAX_UDP_PAYLOAD_SIZE - PF_CMRPC_PDU_HEADER_SIZE)
 
 /**************** Diagnostic strings *****************************************/
 
@@ -300,6 +301,14 @@ void pf_cmrpc_show (pnet_t * net, unsigned level)
          printf (
             "   fragment_nbr       = %u\n",
             (unsigned)p_sess->in_fragment_nbr);
+         printf (
+            "   out fragments      = %u of %u acked, window %u\n",
+            (unsigned)p_sess->out_fragment_acked,
+            (unsigned)p_sess->out_fragment_count,
+            (unsigned)p_sess->out_fragment_window);
+         printf (
+            "   record rsp pending = %s\n",
+            p_sess->record_rsp_pending ? "YES" : "NO");
          printf (
             "   dcontrol_sequence_nmb = %u\n",
             (unsigned)p_sess->dcontrol_sequence_nmb);
@@ -665,6 +674,42 @@ static int pf_session_locate_by_ar (
    return ret;
 }
 
+/**
+ * @internal
+ * Find a session that is parked while waiting for the application to respond
+ * to an IODRead or IODWrite request.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param arep             In:   The AREP of the request.
+ * @param pp_sess          Out:  The session instance.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+static int pf_session_locate_by_pending_record (
+   pnet_t * net,
+   uint32_t arep,
+   pf_session_info_t ** pp_sess)
+{
+   int ret = -1;
+   uint16_t ix;
+
+   ix = 0;
+   while ((ix < NELEMENTS (net->cmrpc_session_info)) &&
+          ((net->cmrpc_session_info[ix].in_use == false) ||
+           (net->cmrpc_session_info[ix].record_rsp_pending == false) ||
+           (net->cmrpc_session_info[ix].record_arep != arep)))
+   {
+      ix++;
+   }
+   if (ix < NELEMENTS (net->cmrpc_session_info))
+   {
+      *pp_sess = &net->cmrpc_session_info[ix];
+      ret = 0;
+   }
+
+   return ret;
+}
+
 /**
  * @internal
  * Allocate and clear a new AR.
@@ -1130,6 +1175,323 @@ static void pf_cmrpc_send_with_timeout (
    }
 }
 
+/**
+ * @internal
+ * Send one fragment of a fragmented response.
+ *
+ * The fragment is created from the complete response in the session output
+ * buffer, so any fragment can be sent (or re-sent) at any time.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_sess           InOut: The session.
+ * @param fragment_nbr     In:    The fragment number.
+ * @param request_fack     In:    true if the controller should acknowledge
+ *                                the fragment.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+static int pf_cmrpc_send_fragment (
+   pnet_t * net,
+   pf_session_info_t * p_sess,
+   uint16_t fragment_nbr,
+   bool request_fack)
+{
+   uint8_t saved[PF_CMRPC_PDU_HEADER_SIZE];
+   pf_rpc_header_t rpc_res = p_sess->out_rpc_header;
+   uint16_t body_pos =
+      PF_CMRPC_PDU_HEADER_SIZE + fragment_nbr * PF_CMRPC_FRAG_BODY_SIZE;
+   uint16_t header_pos = body_pos - PF_CMRPC_PDU_HEADER_SIZE;
+   uint16_t body_len = p_sess->out_buf_len - body_pos;
+   uint16_t length_of_body_pos = 0;
+   uint16_t pos = header_pos;
+   int ret;
+
+   if (body_len > PF_CMRPC_FRAG_BODY_SIZE)
+   {
+      body_len = PF_CMRPC_FRAG_BODY_SIZE;
+   }
+
+   rpc_res.flags.fragment = true;
+   rpc_res.flags.last_fragment =
+      (fragment_nbr + 1 == p_sess->out_fragment_count);
+   rpc_res.flags.no_fack = !request_fack;
+   rpc_res.fragment_nmb = fragment_nbr;
+   rpc_res.serial_high = (uint8_t)(fragment_nbr >> 8U);
+   rpc_res.serial_low = fragment_nbr & UINT8_MAX;
+
+   /* The fragment header is put in front of the fragment body in
+    * out_buffer. The bytes it covers belong to the previous fragment (or
+    * to the original RPC header) and are restored after sending. */
+   memcpy (saved, &p_sess->out_buffer[header_pos], sizeof (saved));
+   pf_put_dce_rpc_header (
+      &rpc_res,
+      sizeof (p_sess->out_buffer),
+      p_sess->out_buffer,
+      &pos,
+      &length_of_body_pos);
+   pf_put_uint16 (
+      rpc_res.is_big_endian,
+      body_len,
+      sizeof (p_sess->out_buffer),
+      p_sess->out_buffer,
+      &length_of_body_pos);
+
+   LOG_DEBUG (
+      PF_RPC_LOG,
+      "CMRPC(%d): Send RPC fragment %u of %u. Fragment size: %u bytes\n",
+      __LINE__,
+      fragment_nbr,
+      p_sess->out_fragment_count,
+      PF_CMRPC_PDU_HEADER_SIZE + body_len);
+
+   ret = pf_cmrpc_send_once_from_buffer (
+      net,
+      p_sess,
+      &p_sess->out_buffer[header_pos],
+      PF_CMRPC_PDU_HEADER_SIZE + body_len,
+      "response fragment");
+
+   memcpy (&p_sess->out_buffer[header_pos], saved, sizeof (saved));
+
+   return ret;
+}
+
+/**
+ * @internal
+ * Re-send the unacknowledged fragments of a fragmented response.
+ * Start a timer that calls this function again if the timer expires.
+ *
+ * This is a callback for the scheduler. Arguments should fulfill
+ * pf_scheduler_timeout_ftn_t
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param arg              InOut: The session.
+ * @param current_time     In:    The current system time, in microseconds,
+ *                                when the scheduler is started to execute
+ *                                stored tasks.
+ */
+void pf_cmrpc_resend_fragments (
+   pnet_t * net,
+   void * arg,
+   uint32_t current_time)
+{
+   pf_session_info_t * p_sess = (pf_session_info_t *)arg;
+   uint16_t ix;
+
+   pf_scheduler_reset_handle (&p_sess->resend_timeout);
+
+   if (p_sess->resend_counter > 0)
+   {
+      p_sess->resend_counter--;
+
+      /* Ask for an acknowledgment of the last fragment in flight only */
+      for (ix = p_sess->out_fragment_acked; ix < p_sess->out_fragment_nbr;
+           ix++)
+      {
+         (void)pf_cmrpc_send_fragment (
+            net,
+            p_sess,
+            ix,
+            ix + 1 == p_sess->out_fragment_nbr);
+      }
+
+      if (
+         pf_scheduler_add (
+            net,
+            PF_FRAG_TIMEOUT * 1000,
+            pf_cmrpc_resend_fragments,
+            p_sess,
+            &p_sess->resend_timeout) != 0)
+      {
+         LOG_ERROR (
+            PF_RPC_LOG,
+            "CMRPC(%d): pf_scheduler_add failed for "
+            "pf_cmrpc_resend_fragments()\n",
+            __LINE__);
+      }
+   }
+   else
+   {
+      /* Error: No reaction to sent fragments */
+      LOG_ERROR (
+         PF_RPC_LOG,
+         "CMRPC(%d): Fragments have been sent, but timing out due to lack "
+         "of incoming message.\n",
+         __LINE__);
+      if (p_sess->p_ar != NULL)
+      {
+         p_sess->p_ar->err_cls = PNET_ERROR_CODE_1_RTA_ERR_CLS_PROTOCOL;
+         p_sess->p_ar->err_code = PNET_ERROR_CODE_2_ABORT_AR_RPC_CONTROL_ERROR;
+         (void)pf_cmdev_cm_abort (net, p_sess->p_ar);
+      }
+   }
+}
+
+/**
+ * @internal
+ * Send the fragments of a fragmented response that are not yet sent, and
+ * that fit in the window.
+ *
+ * Fragments are sent until the number of unacknowledged fragments reaches
+ * the window size. An acknowledgment is requested for the last one.
+ * The re-transmission timer is not touched.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_sess           InOut: The session.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+static int pf_cmrpc_send_new_fragments (
+   pnet_t * net,
+   pf_session_info_t * p_sess)
+{
+   int ret = 0;
+   uint16_t window_end =
+      p_sess->out_fragment_acked + p_sess->out_fragment_window;
+
+   if (window_end > p_sess->out_fragment_count)
+   {
+      window_end = p_sess->out_fragment_count;
+   }
+
+   while (p_sess->out_fragment_nbr < window_end)
+   {
+      if (
+         pf_cmrpc_send_fragment (
+            net,
+            p_sess,
+            p_sess->out_fragment_nbr,
+            p_sess->out_fragment_nbr + 1 == window_end) != 0)
+      {
+         ret = -1;
+      }
+      p_sess->out_fragment_nbr++;
+   }
+
+   return ret;
+}
+
+/**
+ * @internal
+ * Send the fragments of a fragmented response that fit in the window.
+ *
+ * Fragments are sent until the number of unacknowledged fragments reaches
+ * the window size. An acknowledgment is requested for the last one.
+ * Restarts the re-transmission timer and the re-transmission counter.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_sess           InOut: The session.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+int pf_cmrpc_send_fragment_window (
+   pnet_t * net,
+   pf_session_info_t * p_sess)
+{
+   int ret = pf_cmrpc_send_new_fragments (net, p_sess);
+
+   pf_scheduler_remove_if_running (net, &p_sess->resend_timeout);
+   p_sess->resend_counter = PF_CMRPC_NUMBER_OF_RESENDS;
+   if (
+      pf_scheduler_add (
+         net,
+         PF_FRAG_TIMEOUT * 1000,
+         pf_cmrpc_resend_fragments,
+         p_sess,
+         &p_sess->resend_timeout) != 0)
+   {
+      LOG_ERROR (
+         PF_RPC_LOG,
+         "CMRPC(%d): pf_scheduler_add failed for "
+         "pf_cmrpc_resend_fragments()\n",
+         __LINE__);
+      ret = -1;
+   }
+
+   return ret;
+}
+
+/**
+ * @internal
+ * Handle a fragment acknowledgment for a fragmented response.
+ *
+ * The fragment number in the header is the highest fragment received in
+ * order by the controller. The body holds the window size of the
+ * controller, in fragments.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_sess           InOut: The session.
+ * @param p_rpc_fack       In:    The RPC header of the acknowledgment.
+ * @param req_pos          In:    Position of the body in the request.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+int pf_cmrpc_fack_ind (
+   pnet_t * net,
+   pf_session_info_t * p_sess,
+   const pf_rpc_header_t * p_rpc_fack,
+   uint16_t req_pos)
+{
+   uint16_t window_size = 0;
+   bool progress = false;
+
+   if (p_rpc_fack->length_of_body >= 4)
+   {
+      (void)pf_get_byte (&p_sess->get_info, &req_pos); /* Version */
+      (void)pf_get_byte (&p_sess->get_info, &req_pos); /* Padding */
+      window_size = pf_get_uint16 (&p_sess->get_info, &req_pos);
+      if (window_size > PF_CMRPC_MAX_FRAG_WINDOW)
+      {
+         window_size = PF_CMRPC_MAX_FRAG_WINDOW;
+      }
+      if (p_sess->get_info.result == PF_PARSE_OK && window_size > 0)
+      {
+         p_sess->out_fragment_window = window_size;
+      }
+   }
+
+   if (
+      (p_rpc_fack->fragment_nmb < p_sess->out_fragment_nbr) &&
+      (p_rpc_fack->fragment_nmb >= p_sess->out_fragment_acked))
+   {
+      p_sess->out_fragment_acked = p_rpc_fack->fragment_nmb + 1;
+      progress = true;
+   }
+
+   LOG_DEBUG (
+      PF_RPC_LOG,
+      "CMRPC(%d): Received fragment ACK for fragment %u. Acknowledged %u of "
+      "%u fragments. Window %u\n",
+      __LINE__,
+      p_rpc_fack->fragment_nmb,
+      p_sess->out_fragment_acked,
+      p_sess->out_fragment_count,
+      p_sess->out_fragment_window);
+
+   if (p_sess->out_fragment_acked < p_sess->out_fragment_count)
+   {
+      if (progress)
+      {
+         return pf_cmrpc_send_fragment_window (net, p_sess);
+      }
+
+      /* A duplicate or stale acknowledgment. Send what a larger window
+       * allows, but keep counting down the re-transmissions. */
+      return pf_cmrpc_send_new_fragments (net, p_sess);
+   }
+
+   /* The last fragment has been acknowledged */
+   pf_scheduler_remove_if_running (net, &p_sess->resend_timeout);
+   p_sess->out_buf_len = 0;
+   p_sess->out_buf_sent_pos = 0;
+   p_sess->out_buf_send_len = 0;
+   p_sess->out_fragment_nbr = 0;
+   p_sess->out_fragment_count = 0;
+   p_sess->out_fragment_acked = 0;
+
+   return 0;
+}
+
 /******************** RPC parsers *******************************************/
 
 /**
@@ -1642,6 +2004,45 @@ static int pf_cmrpc_rm_connect_interpret_ind (
                }
             }
             break;
+#endif
+#if PNET_OPTION_FAST_STARTUP
+         case PF_BT_AR_FSU_BLOCK_REQ:
+            pf_get_ar_fsu_request (
+               &p_sess->get_info,
+               p_pos,
+               block_header.block_length,
+               p_ar);
+
+            if (p_sess->get_info.result != PF_PARSE_OK)
+            {
+               /* Bad length of the block or of one of its sub-blocks */
+               pf_set_error (
+                  &p_sess->rpc_result,
+                  PNET_ERROR_CODE_CONNECT,
+                  PNET_ERROR_DECODE_PNIO,
+                  PNET_ERROR_CODE_1_CONN_FAULTY_AR_FSU,
+                  PNET_ERROR_CODE_2_INVALID_BLOCK_LEN);
+               ret = -1;
+            }
+            else if (p_ar->ar_param.ar_properties.device_access == true)
+            {
+               pf_set_error (
+                  &p_sess->rpc_result,
+                  PNET_ERROR_CODE_CONNECT,
+                  PNET_ERROR_DECODE_PNIO,
+                  PNET_ERROR_CODE_1_CMRPC,
+                  PNET_ERROR_CODE_2_CMRPC_UNKNOWN_BLOCKS);
+               ret = -1;
+            }
+            else
+            {
+               ret = pf_check_block_header (
+                  (*p_pos - data_pos) + 2,
+                  &block_header,
+                  PNET_ERROR_CODE_1_CONN_FAULTY_AR_FSU,
+                  &p_sess->rpc_result);
+            }
+            break;
 #endif
          default:
             LOG_DEBUG (
@@ -2859,6 +3260,63 @@ static int pf_cmrpc_rm_read_interpret_ind (
    return ret;
 }
 
+/**
+ * @internal
+ * Check if the application deferred its response to a record request.
+ *
+ * If so, mark the session so that it is parked instead of sending the
+ * response. The response is sent when the application calls
+ * \a pnet_read_record_rsp() or \a pnet_write_record_rsp().
+ *
+ * @param p_sess           InOut: The session instance.
+ * @param p_ar             InOut: The AR instance. May be NULL.
+ * @param may_defer        In:    true if the request may be deferred.
+ * @param error_code       In:    Error code to use if deferral is not
+ *                                allowed. PNET_ERROR_CODE_READ or
+ *                                PNET_ERROR_CODE_WRITE.
+ * @param p_stat           Out:   Detailed error information if returning != 0
+ * @return  0  if the response was not deferred, or the session is parked.
+ *          -1 if the application deferred a response that may not be
+ *             deferred.
+ */
+static int pf_cmrpc_park_record_rsp (
+   pf_session_info_t * p_sess,
+   pf_ar_t * p_ar,
+   bool may_defer,
+   uint8_t error_code,
+   pnet_result_t * p_stat)
+{
+   if (p_ar == NULL || p_ar->record_rsp.state != PF_RECORD_RSP_STATE_PENDING)
+   {
+      return 0;
+   }
+
+   if (may_defer == false)
+   {
+      LOG_ERROR (
+         PF_RPC_LOG,
+         "CMRPC(%d): The response to index 0x%04x can not be deferred in this "
+         "type of request. AREP %u\n",
+         __LINE__,
+         p_ar->record_rsp.index,
+         p_ar->arep);
+      p_ar->record_rsp.state = PF_RECORD_RSP_STATE_IDLE;
+      pf_set_error (
+         p_stat,
+         error_code,
+         PNET_ERROR_DECODE_PNIORW,
+         PNET_ERROR_CODE_1_RES_RESOURCE_BUSY,
+         0);
+
+      return -1;
+   }
+
+   p_sess->record_rsp_pending = true;
+   p_sess->record_arep = p_ar->arep;
+
+   return 0;
+}
+
 /**
  * @internal
  * Take a DCE RPC IODRead request and create a DCE RPC IODRead response.
@@ -3018,7 +3476,19 @@ static int pf_cmrpc_rm_read_ind (
                __LINE__);
          }
 
-         /* Insert the actual operation result */
+         /* Read implicit has no AR to hold the deferred response */
+         if (
+            pf_cmrpc_park_record_rsp (
+               p_sess,
+               p_ar,
+               opnum == PF_RPC_DEV_OPNUM_READ,
+               PNET_ERROR_CODE_READ,
+               &p_sess->rpc_result) != 0)
+         {
+            ret = -1;
+         }
+
+         /* Insert the actual operation result */
          pf_put_pnet_status (
             p_sess->get_info.is_big_endian,
             &p_sess->rpc_result.pnio_status,
@@ -3188,6 +3658,8 @@ static int pf_cmrpc_rm_write_interpret_ind (
  * @param p_write_result   Out:   The IODWrite result block.
  * @param p_stat           Out:   Detailed error information if returning != 0
  * @param p_req_pos        InOut: Position in the request buffer.
+ * @param may_defer        In:    true if the application may defer the
+ *                                response. Not possible for multiple writes.
  * @return  0  if operation succeeded.
  *          -1 if an error occurred.
  */
@@ -3197,7 +3669,8 @@ static int pf_cmrpc_perform_one_write (
    const pf_iod_write_request_t * p_write_request,
    pf_iod_write_result_t * p_write_result,
    pnet_result_t * p_stat,
-   uint16_t * p_req_pos)
+   uint16_t * p_req_pos,
+   bool may_defer)
 {
    int ret = -1;
    pf_ar_t * p_ar = NULL;
@@ -3242,7 +3715,13 @@ static int pf_cmrpc_perform_one_write (
                p_stat,
                p_sess->get_info.p_buf,
                p_write_request->record_data_length,
-               p_req_pos) == 0)
+               p_req_pos) == 0 &&
+            pf_cmrpc_park_record_rsp (
+               p_sess,
+               p_ar,
+               may_defer,
+               PNET_ERROR_CODE_WRITE,
+               p_stat) == 0)
          {
             ret = 0;
          }
@@ -3460,7 +3939,8 @@ static int pf_cmrpc_rm_write_ind (
                   &write_request_multi,
                   &write_result_multi,
                   &write_stat_multi,
-                  &req_pos);
+                  &req_pos,
+                  false);
                pf_put_write_result (
                   p_sess->get_info.is_big_endian,
                   &write_result_multi,
@@ -3490,7 +3970,8 @@ static int pf_cmrpc_rm_write_ind (
                &write_request,
                &write_result,
                &p_sess->rpc_result,
-               &req_pos);
+               &req_pos,
+               true);
             pf_put_write_result (
                p_sess->get_info.is_big_endian,
                &write_result,
@@ -4235,6 +4716,270 @@ static int pf_cmrpc_rpc_response (
    return ret;
 }
 
+/**
+ * @internal
+ * Handle a complete incoming DCE RPC request, and send the response.
+ *
+ * If the application defers the response to an IODRead or IODWrite request,
+ * the session is parked without sending anything. The request is then
+ * handled again by \a pf_cmrpc_record_rsp() once the application has
+ * responded.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_sess           InOut: The session instance. The get_info field
+ *                                holds the complete request.
+ * @param p_rpc_req        In:    The RPC header of the request.
+ * @param req_pos          In:    Position of the RPC body in the request.
+ * @param p_close_socket   Out:   Set to true if operation is a release op.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+static int pf_cmrpc_dce_request (
+   pnet_t * net,
+   pf_session_info_t * p_sess,
+   const pf_rpc_header_t * p_rpc_req,
+   uint16_t req_pos,
+   bool * p_close_socket)
+{
+   int ret = -1;
+   pf_rpc_header_t rpc_res;
+   uint16_t start_pos = 0;
+   uint16_t length_of_body_pos = 0;
+   uint16_t body_pos = req_pos;
+   uint16_t max_rsp_len;
+   uint32_t max_rsp_len_remote;
+   bool set_state_paramend = false;
+   pf_ar_t * p_ar = NULL;
+
+   LOG_INFO (
+      PF_RPC_LOG,
+      "CMRPC(%d): Incoming DCE RPC request on UDP.\n",
+      __LINE__);
+   /* A new request - clear the response buffer */
+   p_sess->out_buf_len = 0;
+   p_sess->out_buf_sent_pos = 0;
+   p_sess->out_buf_send_len = 0;
+   p_sess->out_fragment_nbr = 0;
+   p_sess->out_fragment_count = 0;
+   p_sess->out_fragment_acked = 0;
+
+   /*Check what type of request this is EPMv4 or PNIO?*/
+   if (
+      memcmp (
+         &p_rpc_req->interface_uuid,
+         &uuid_epmap_interface,
+         sizeof (p_rpc_req->object_uuid)) != 0)
+   {
+      pf_get_ndr_data (&p_sess->get_info, &req_pos, &p_sess->ndr_data);
+      /* From now on all is big-endian */
+      p_sess->get_info.is_big_endian = true;
+
+      /* Our response is limited by the size of the requesters response
+       * buffer */
+      max_rsp_len_remote = req_pos + p_sess->ndr_data.args_maximum;
+      if (max_rsp_len_remote > sizeof (p_sess->out_buffer))
+      {
+         /* Our response is also limited by what our buffer can
+          * accommodate */
+         max_rsp_len = sizeof (p_sess->out_buffer);
+      }
+      else
+      {
+         max_rsp_len = max_rsp_len_remote;
+      }
+   }
+   else
+   {
+      /* EPM requirement is little endian*/
+      p_sess->get_info.is_big_endian = false;
+      max_rsp_len = sizeof (p_sess->out_buffer);
+   }
+
+   /* Prepare the response */
+   rpc_res = *p_rpc_req;
+   rpc_res.packet_type = PF_RPC_PT_RESPONSE;
+   rpc_res.flags.last_fragment = false;
+   rpc_res.flags.fragment = false;
+   rpc_res.flags.no_fack = true;
+   rpc_res.flags.maybe = false;
+   rpc_res.flags.idempotent = true;
+   rpc_res.flags.broadcast = false;
+   rpc_res.flags2.cancel_pending = false;
+   rpc_res.fragment_nmb = p_sess->out_fragment_nbr;
+   rpc_res.serial_high = (uint8_t)(rpc_res.fragment_nmb >> 8U);
+   rpc_res.serial_low = rpc_res.fragment_nmb & UINT8_MAX;
+   rpc_res.is_big_endian = p_sess->get_info.is_big_endian;
+
+   /* Insert the response header to get pos of rpc response body. */
+   pf_put_dce_rpc_header (
+      &rpc_res,
+      max_rsp_len,
+      p_sess->out_buffer,
+      &p_sess->out_buf_len,
+      &length_of_body_pos);
+   start_pos = p_sess->out_buf_len; /* Save for later */
+
+   if (p_rpc_req->opnum == PF_RPC_DEV_OPNUM_RELEASE)
+   {
+      p_sess->release_in_progress = true; /* Tell everybody */
+      *p_close_socket = p_sess->from_me;
+   }
+
+   if (
+      memcmp (
+         &p_rpc_req->interface_uuid,
+         &uuid_io_device_interface,
+         sizeof (p_rpc_req->object_uuid)) == 0)
+   {
+      /* Handle PNIO requests */
+      ret = pf_cmrpc_rpc_request (
+         net,
+         p_sess,
+         req_pos,
+         p_rpc_req,
+         max_rsp_len,
+         p_sess->out_buffer,
+         &p_sess->out_buf_len,
+         &set_state_paramend);
+   }
+   else if (
+      memcmp (
+         &p_rpc_req->interface_uuid,
+         &uuid_epmap_interface,
+         sizeof (p_rpc_req->object_uuid)) == 0)
+   {
+      rpc_res.fragment_nmb = 0;
+      rpc_res.flags.idempotent = false;
+
+      /* Handle Endpoint Map request */
+      ret = pf_cmrpc_lookup_ind (
+         net,
+         p_sess,
+         p_rpc_req,
+         req_pos,
+         max_rsp_len,
+         p_sess->out_buffer,
+         &p_sess->out_buf_len);
+      *p_close_socket = p_sess->from_me;
+
+      /* Close session after each EPM request
+         If future more advanced EPM usage is required, implement a
+         timeout for closing the session */
+      p_sess->kill_session = true;
+   }
+   else
+   {
+      LOG_ERROR (
+         PF_RPC_LOG,
+         "CMRPC(%d): Unhandled Object or Interface UUID!\n",
+         __LINE__);
+      /*ToDo: Report NULL endpoint with proper error code*/
+   }
+
+   if (p_sess->record_rsp_pending)
+   {
+      /* The application will respond later. Keep the request so that it can
+       * be handled again when the response is available. The response
+       * prepared so far is not sent. */
+      if (p_sess->get_info.len > sizeof (p_sess->in_buffer))
+      {
+         LOG_ERROR (
+            PF_RPC_LOG,
+            "CMRPC(%d): Request too large to be deferred. AREP %u\n",
+            __LINE__,
+            p_sess->record_arep);
+         if (pf_ar_find_by_arep (net, p_sess->record_arep, &p_ar) == 0)
+         {
+            p_ar->record_rsp.state = PF_RECORD_RSP_STATE_IDLE;
+         }
+         p_sess->record_rsp_pending = false;
+         p_sess->kill_session = true;
+         p_sess->out_buf_len = 0;
+
+         return -1;
+      }
+
+      if (p_sess->get_info.p_buf != p_sess->in_buffer)
+      {
+         memcpy (
+            p_sess->in_buffer,
+            p_sess->get_info.p_buf,
+            p_sess->get_info.len);
+      }
+      p_sess->record_rpc_req = *p_rpc_req;
+      p_sess->record_req_pos = body_pos;
+      p_sess->record_req_len = (uint16_t)p_sess->get_info.len;
+      p_sess->kill_session = false;
+      p_sess->out_buf_len = 0;
+
+      LOG_DEBUG (
+         PF_RPC_LOG,
+         "CMRPC(%d): Session %u waits for the application. AREP %u\n",
+         __LINE__,
+         (unsigned)p_sess->ix,
+         p_sess->record_arep);
+
+      return ret;
+   }
+
+   if (p_sess->out_buf_len < PF_MAX_UDP_PAYLOAD_SIZE)
+   {
+      /* Our response will fit into send buffer (not fragmented) */
+      p_sess->out_buf_send_len = p_sess->out_buf_len; /* Send everything */
+
+      LOG_DEBUG (
+         PF_RPC_LOG,
+         "CMRPC(%d): Send RPC response. Total response length %u, "
+         "sending %u bytes. Start of RPC payload: %u\n",
+         __LINE__,
+         p_sess->out_buf_len,
+         p_sess->out_buf_send_len,
+         start_pos);
+
+      /* Insert the real value of length_of_body in the rpc header */
+      pf_put_uint16 (
+         rpc_res.is_big_endian,
+         (uint16_t)(p_sess->out_buf_send_len - start_pos),
+         p_sess->out_buf_send_len,
+         p_sess->out_buffer,
+         &length_of_body_pos);
+
+      /* Non-fragmented responses from us are not re-transmitted */
+      ret = pf_cmrpc_send_once (net, p_sess, "response");
+   }
+   else
+   {
+      /* Send a fragmented response. The fragments are created from
+       * out_buffer when sent, so several can be in flight at the same time.
+       */
+      p_sess->out_rpc_header = rpc_res;
+      p_sess->out_fragment_count =
+         (p_sess->out_buf_len - start_pos + PF_CMRPC_FRAG_BODY_SIZE - 1) /
+         PF_CMRPC_FRAG_BODY_SIZE;
+      p_sess->out_fragment_acked = 0;
+      p_sess->out_fragment_window = PF_CMRPC_INITIAL_FRAG_WINDOW;
+
+      LOG_DEBUG (
+         PF_RPC_LOG,
+         "CMRPC(%d): Send fragmented RPC response. Total response length %u "
+         "in %u fragments.\n",
+         __LINE__,
+         p_sess->out_buf_len,
+         p_sess->out_fragment_count);
+
+      /* Fragmented responses from us (with ack) are supposed to be
+       * re-transmitted according to the spec. */
+      ret = pf_cmrpc_send_fragment_window (net, p_sess);
+   }
+
+   if (set_state_paramend && p_sess->p_ar != NULL)
+   {
+      pf_cmdev_state_ind (net, p_sess->p_ar, PNET_EVENT_PRMEND);
+   }
+
+   return ret;
+}
+
 /**
  * @internal
  * Handle one incoming DCE RPC message, and typically sends a response.
@@ -4277,14 +5022,11 @@ static int pf_cmrpc_dce_packet (
    uint16_t length_of_body_pos = 0;
    uint16_t req_pos = 0;
    uint16_t res_pos = 0;
-   uint16_t max_rsp_len;
-   uint32_t max_rsp_len_remote;
    pf_get_info_t get_info;
    pf_session_info_t * p_sess = NULL;
    bool is_new_session = false;
    uint32_t fault_code = 0;
    uint32_t reject_code = 0;
-   bool set_state_paramend = false;
 
    get_info.result = PF_PARSE_OK;
    get_info.p_buf = p_req;
@@ -4292,6 +5034,17 @@ static int pf_cmrpc_dce_packet (
 
    /* Parse RPC header. This function also sets get_info.is_big_endian */
    pf_get_dce_rpc_header (&get_info, &req_pos, &rpc_req);
+   if (get_info.result != PF_PARSE_OK)
+   {
+      LOG_INFO (
+         PF_RPC_LOG,
+         "CMRPC(%d): Dropped incoming frame of %" PRIu32
+         " bytes. Too short for the RPC header.\n",
+         __LINE__,
+         req_len);
+      *p_res_len = 0;
+      return ret;
+   }
 
    LOG_DEBUG (
       PF_RPC_LOG,
@@ -4331,6 +5084,51 @@ static int pf_cmrpc_dce_packet (
          "CMRPC(%d): Out of session resources for incoming frame.\n",
          __LINE__);
    }
+   else if (p_sess->record_rsp_pending)
+   {
+      /* The parked request is waiting for the application. Tell the
+       * controller that we are working on it, and ignore re-transmissions of
+       * the request. */
+      if (rpc_req.packet_type == PF_RPC_PT_PING)
+      {
+         rpc_res = rpc_req;
+         rpc_res.packet_type = PF_RPC_PT_WORKING;
+         rpc_res.flags.last_fragment = false;
+         rpc_res.flags.fragment = false;
+         rpc_res.flags.no_fack = true;
+         rpc_res.flags.maybe = false;
+         rpc_res.flags.idempotent = true;
+         rpc_res.flags.broadcast = false;
+         rpc_res.flags2.cancel_pending = false;
+         rpc_res.fragment_nmb = 0;
+         rpc_res.is_big_endian = p_sess->is_big_endian;
+
+         pf_put_dce_rpc_header (
+            &rpc_res,
+            *p_res_len,
+            p_res,
+            &res_pos,
+            &length_of_body_pos);
+
+         pf_cmrpc_send_once_from_buffer (
+            net,
+            p_sess,
+            p_res,
+            res_pos,
+            "WORKING");
+      }
+      else
+      {
+         LOG_DEBUG (
+            PF_RPC_LOG,
+            "CMRPC(%d): Session %u waits for the application. Ignoring "
+            "packet_type %u\n",
+            __LINE__,
+            (unsigned)p_sess->ix,
+            (unsigned)rpc_req.packet_type);
+      }
+      ret = 0;
+   }
    else
    {
       p_sess->get_info = get_info;
@@ -4544,195 +5342,22 @@ static int pf_cmrpc_dce_packet (
             p_sess->kill_session = is_new_session;
             break;
          case PF_RPC_PT_REQUEST:
-            LOG_INFO (
-               PF_RPC_LOG,
-               "CMRPC(%d): Incoming DCE RPC request on UDP.\n",
-               __LINE__);
-            /* A new request - clear the response buffer */
-            p_sess->out_buf_len = 0;
-            p_sess->out_buf_sent_pos = 0;
-            p_sess->out_buf_send_len = 0;
-            p_sess->out_fragment_nbr = 0;
-
-            /*Check what type of request this is EPMv4 or PNIO?*/
-            if (
-               memcmp (
-                  &rpc_req.interface_uuid,
-                  &uuid_epmap_interface,
-                  sizeof (rpc_req.object_uuid)) != 0)
-            {
-               pf_get_ndr_data (&p_sess->get_info, &req_pos, &p_sess->ndr_data);
-               /* From now on all is big-endian */
-               p_sess->get_info.is_big_endian = true;
-
-               /* Our response is limited by the size of the requesters response
-                * buffer */
-               max_rsp_len_remote = req_pos + p_sess->ndr_data.args_maximum;
-               if (max_rsp_len_remote > sizeof (p_sess->out_buffer))
-               {
-                  /* Our response is also limited by what our buffer can
-                   * accommodate */
-                  max_rsp_len = sizeof (p_sess->out_buffer);
-               }
-               else
-               {
-                  max_rsp_len = max_rsp_len_remote;
-               }
-            }
-            else
-            {
-               /* EPM requirement is little endian*/
-               p_sess->get_info.is_big_endian = false;
-               max_rsp_len = sizeof (p_sess->out_buffer);
-            }
-
-            /* Prepare the response */
-            rpc_res = rpc_req;
-            rpc_res.packet_type = PF_RPC_PT_RESPONSE;
-            rpc_res.flags.last_fragment = false;
-            rpc_res.flags.fragment = false;
-            rpc_res.flags.no_fack = true;
-            rpc_res.flags.maybe = false;
-            rpc_res.flags.idempotent = true;
-            rpc_res.flags.broadcast = false;
-            rpc_res.flags2.cancel_pending = false;
-            rpc_res.fragment_nmb = p_sess->out_fragment_nbr;
-            rpc_res.serial_high = (uint8_t)(rpc_res.fragment_nmb >> 8U);
-            rpc_res.serial_low = rpc_res.fragment_nmb & UINT8_MAX;
-            rpc_res.is_big_endian = p_sess->get_info.is_big_endian;
-
-            /* Insert the response header to get pos of rpc response body. */
-            rpc_hdr_start_pos = p_sess->out_buf_len;
-            pf_put_dce_rpc_header (
-               &rpc_res,
-               max_rsp_len,
-               p_sess->out_buffer,
-               &p_sess->out_buf_len,
-               &length_of_body_pos);
-            start_pos = p_sess->out_buf_len; /* Save for later */
-
-            if (rpc_req.opnum == PF_RPC_DEV_OPNUM_RELEASE)
-            {
-               p_sess->release_in_progress = true; /* Tell everybody */
-               *p_close_socket = p_sess->from_me;
-            }
-
-            if (
-               memcmp (
-                  &rpc_req.interface_uuid,
-                  &uuid_io_device_interface,
-                  sizeof (rpc_req.object_uuid)) == 0)
-            {
-               /* Handle PNIO requests */
-               ret = pf_cmrpc_rpc_request (
-                  net,
-                  p_sess,
-                  req_pos,
-                  &rpc_req,
-                  max_rsp_len,
-                  p_sess->out_buffer,
-                  &p_sess->out_buf_len,
-                  &set_state_paramend);
-            }
-            else if (
-               memcmp (
-                  &rpc_req.interface_uuid,
-                  &uuid_epmap_interface,
-                  sizeof (rpc_req.object_uuid)) == 0)
-            {
-               rpc_res.fragment_nmb = 0;
-               rpc_res.flags.idempotent = false;
-
-               /* Handle Endpoint Map request */
-               ret = pf_cmrpc_lookup_ind (
-                  net,
-                  p_sess,
-                  &rpc_req,
-                  req_pos,
-                  max_rsp_len,
-                  p_sess->out_buffer,
-                  &p_sess->out_buf_len);
-               *p_close_socket = p_sess->from_me;
-
-               /* Close session after each EPM request
-                  If future more advanced EPM usage is required, implement a
-                  timeout for closing the session */
-               p_sess->kill_session = true;
-            }
-            else
-            {
-               LOG_ERROR (
-                  PF_RPC_LOG,
-                  "CMRPC(%d): Unhandled Object or Interface UUID!\n",
-                  __LINE__);
-               /*ToDo: Report NULL endpoint with proper error code*/
-            }
-
-            if (p_sess->out_buf_len < PF_MAX_UDP_PAYLOAD_SIZE)
-            {
-               /* Our response will fit into send buffer (not fragmented) */
-               p_sess->out_buf_send_len = p_sess->out_buf_len; /* Send
-                                                                  everything */
-            }
-            else
-            {
-               /* Send a fragmented response - Send the first fragment now */
-               p_sess->out_buf_send_len = PF_MAX_UDP_PAYLOAD_SIZE; /* Send as
-                                                                      much as
-                                                                      can fit */
-
-               /* Also set the fragment bit in the RPC response header */
-               rpc_res.flags.fragment = true;
-               rpc_res.flags.no_fack = false;
-
-               /* Re-write the header with the new info */
-               pf_put_dce_rpc_header (
-                  &rpc_res,
-                  max_rsp_len,
-                  p_sess->out_buffer,
-                  &rpc_hdr_start_pos,
-                  &length_of_body_pos);
-            }
-
-            LOG_DEBUG (
-               PF_RPC_LOG,
-               "CMRPC(%d): Send RPC response. Total response length %u, "
-               "sending %u bytes. Start of RPC payload: %u\n",
-               __LINE__,
-               p_sess->out_buf_len,
-               p_sess->out_buf_send_len,
-               start_pos);
-
-            /* Insert the real value of length_of_body in the rpc header */
-            pf_put_uint16 (
-               rpc_res.is_big_endian,
-               (uint16_t)(p_sess->out_buf_send_len - start_pos),
-               p_sess->out_buf_send_len,
-               p_sess->out_buffer,
-               &length_of_body_pos);
-
-            if (rpc_res.flags.fragment == true)
-            {
-               /* Fragmented responses from us (with ack) are supposed to be
-                * re-transmitted according to the spec. */
-               p_sess->resend_counter = PF_CMRPC_NUMBER_OF_RESENDS;
-               pf_cmrpc_send_with_timeout (
-                  net,
-                  p_sess,
-                  os_get_current_time_us());
-            }
-            else
+            ret = pf_cmrpc_dce_request (
+               net,
+               p_sess,
+               &rpc_req,
+               req_pos,
+               p_close_socket);
+            break;
+         case PF_RPC_PT_FRAG_ACK:
+            if ((p_sess->from_me == false) && (p_sess->out_fragment_count > 0))
             {
-               /* Non-fragmented responses from us are not re-transmitted */
-               ret = pf_cmrpc_send_once (net, p_sess, "response");
+               /* Acknowledgment of a fragmented response from us */
+               ret = pf_cmrpc_fack_ind (net, p_sess, &rpc_req, req_pos);
+               res_pos = 0;
+               break;
             }
 
-            if (set_state_paramend && p_sess->p_ar != NULL)
-            {
-               pf_cmdev_state_ind (net, p_sess->p_ar, PNET_EVENT_PRMEND);
-            }
-            break;
-         case PF_RPC_PT_FRAG_ACK:
             /* Handle fragment acknowledgment from the controller. */
             LOG_DEBUG (
                PF_RPC_LOG,
@@ -5048,6 +5673,122 @@ static int pf_cmrpc_dce_packet (
    return ret;
 }
 
+/**
+ * @internal
+ * Send the deferred response to an IODRead or IODWrite request.
+ *
+ * The parked request is handled again, now using the response stored in the
+ * AR by the application.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred.
+ */
+static int pf_cmrpc_record_rsp (pnet_t * net, pf_ar_t * p_ar)
+{
+   int ret = -1;
+   pf_session_info_t * p_sess = NULL;
+   bool close_socket = false;
+
+   if (pf_session_locate_by_pending_record (net, p_ar->arep, &p_sess) != 0)
+   {
+      LOG_ERROR (
+         PF_RPC_LOG,
+         "CMRPC(%d): No session waiting for a record response. AREP %u\n",
+         __LINE__,
+         p_ar->arep);
+      p_ar->record_rsp.state = PF_RECORD_RSP_STATE_IDLE;
+
+      return ret;
+   }
+
+   p_sess->record_rsp_pending = false;
+   p_sess->get_info.result = PF_PARSE_OK;
+   p_sess->get_info.p_buf = p_sess->in_buffer;
+   p_sess->get_info.len = p_sess->record_req_len;
+   p_sess->get_info.is_big_endian = p_sess->is_big_endian;
+   memset (&p_sess->rpc_result, 0, sizeof (p_sess->rpc_result));
+
+   ret = pf_cmrpc_dce_request (
+      net,
+      p_sess,
+      &p_sess->record_rpc_req,
+      p_sess->record_req_pos,
+      &close_socket);
+
+   p_ar->record_rsp.state = PF_RECORD_RSP_STATE_IDLE;
+
+   /* Sessions initiated by the controller have no socket of their own */
+   if (p_sess->kill_session == true)
+   {
+      LOG_DEBUG (PF_RPC_LOG, "CMRPC(%d): Kill session\n", __LINE__);
+      pf_session_release (net, p_sess);
+   }
+
+   return ret;
+}
+
+int pf_cmrpc_rm_read_rsp (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   const uint8_t * p_read_data,
+   uint16_t read_length,
+   const pnet_result_t * p_result)
+{
+   if (
+      (p_ar->record_rsp.state != PF_RECORD_RSP_STATE_PENDING) ||
+      (p_ar->record_rsp.is_read == false))
+   {
+      LOG_ERROR (
+         PF_RPC_LOG,
+         "CMRPC(%d): No read response pending for AREP %u\n",
+         __LINE__,
+         p_ar->arep);
+      return -1;
+   }
+
+   memset (&p_ar->record_rsp.result, 0, sizeof (p_ar->record_rsp.result));
+   if (p_result != NULL)
+   {
+      p_ar->record_rsp.result = *p_result;
+   }
+   p_ar->record_rsp.p_read_data = p_read_data;
+   p_ar->record_rsp.read_length = read_length;
+   p_ar->record_rsp.state = PF_RECORD_RSP_STATE_READY;
+
+   return pf_cmrpc_record_rsp (net, p_ar);
+}
+
+int pf_cmrpc_rm_write_rsp (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   const pnet_result_t * p_result)
+{
+   if (
+      (p_ar->record_rsp.state != PF_RECORD_RSP_STATE_PENDING) ||
+      (p_ar->record_rsp.is_read == true))
+   {
+      LOG_ERROR (
+         PF_RPC_LOG,
+         "CMRPC(%d): No write response pending for AREP %u\n",
+         __LINE__,
+         p_ar->arep);
+      return -1;
+   }
+
+   memset (&p_ar->record_rsp.result, 0, sizeof (p_ar->record_rsp.result));
+   if (p_result != NULL)
+   {
+      p_ar->record_rsp.result = *p_result;
+   }
+   p_ar->record_rsp.p_read_data = NULL;
+   p_ar->record_rsp.read_length = 0;
+   p_ar->record_rsp.state = PF_RECORD_RSP_STATE_READY;
+
+   return pf_cmrpc_record_rsp (net, p_ar);
+}
+
 void pf_cmrpc_periodic (pnet_t * net)
 {
    uint32_t dcerpc_addr;
@@ -5239,6 +5980,13 @@ int pf_cmrpc_cmdev_state_ind (
             pf_session_release (net, p_sess);
          }
 
+         /* Free sessions waiting for a deferred record response */
+         while (
+            pf_session_locate_by_pending_record (net, p_ar->arep, &p_sess) == 0)
+         {
+            pf_session_release (net, p_sess);
+         }
+
          /* Finally free the AR */
          pf_ar_release (net, p_ar);
       }
@@ -20,6 +20,15 @@
 extern "C" {
 #endif
 
+#define PF_CMRPC_NUMBER_OF_RESENDS 3
+
+/* Fragmented responses are sent with several fragments in flight. The window
+ * starts small and follows the window size in the fragment acknowledgments
+ * from the controller, up to the max value.
+ */
+#define PF_CMRPC_INITIAL_FRAG_WINDOW 2
+#define PF_CMRPC_MAX_FRAG_WINDOW     8
+
 /* ================================================
  *       Local primitives
  */
@@ -142,6 +151,39 @@ int pf_cmrpc_rm_ccontrol_req (
    pf_ar_t * p_ar,
    pf_block_type_values_t block_type);
 
+/**
+ * Send the deferred response to an IODRead request.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @param p_read_data      In:    The read data. Must be valid until the
+ *                                function returns.
+ * @param read_length      In:    Size of the read data.
+ * @param p_result         In:    Error information, or NULL on success.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred, or if no read response is pending.
+ */
+int pf_cmrpc_rm_read_rsp (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   const uint8_t * p_read_data,
+   uint16_t read_length,
+   const pnet_result_t * p_result);
+
+/**
+ * Send the deferred response to an IODWrite request.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @param p_result         In:    Error information, or NULL on success.
+ * @return  0  if operation succeeded.
+ *          -1 if an error occurred, or if no write response is pending.
+ */
+int pf_cmrpc_rm_write_rsp (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   const pnet_result_t * p_result);
+
 /**
  * Show AR and session information.
  *
@@ -173,6 +215,21 @@ void pf_cmrpc_show (pnet_t * net, unsigned level);
  */
 void pf_memory_contents_show (const uint8_t * data, int size);
 
+/************ Internal functions, made available for unit testing ************/
+
+void pf_cmrpc_resend_fragments (
+   pnet_t * net,
+   void * arg,
+   uint32_t current_time);
+
+int pf_cmrpc_send_fragment_window (pnet_t * net, pf_session_info_t * p_sess);
+
+int pf_cmrpc_fack_ind (
+   pnet_t * net,
+   pf_session_info_t * p_sess,
+   const pf_rpc_header_t * p_rpc_fack,
+   uint16_t req_pos);
+
 #ifdef __cplusplus
 }
 #endif
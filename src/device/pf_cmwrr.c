@@ -172,7 +172,7 @@ int pf_cmwrr_cmdev_state_ind (
  */
 static int pf_cmwrr_write (
    pnet_t * net,
-   const pf_ar_t * p_ar,
+   pf_ar_t * p_ar,
    const pf_iod_write_request_t * p_write_request,
    const uint8_t * p_req_buf,
    uint16_t data_length,
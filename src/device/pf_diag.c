@@ -29,13 +29,24 @@
  *  - pf_cmdev_get_diag_item()
  *  - pf_cmdev_free_diag()
  *
- * An array of PNET_MAX_DIAG_ITEMS diagnosis items is available for use.
+ * An array of max_diag_items diagnosis items (from pnet_cfg_t, default
+ * PNET_MAX_DIAG_ITEMS) is allocated at init and available for use.
  * In CMDEV, each subslot uses a linked list of diagnosis items, and stores the
  * index to the head of its (possibly empty) list.
+ *
+ * The items in use are also stored in a hash index in CMDEV, so they can be
+ * found without walking the subslot list:
+ *  - pf_cmdev_index_diag()
+ *  - pf_cmdev_find_diag()
+ *
+ * Between pf_diag_begin() and pf_diag_commit() no alarms are sent. Instead
+ * the changed items are marked, and items removed in the batch are kept on a
+ * separate subslot list until the commit has reported them.
  */
 
 #ifdef UNIT_TEST
-#define pf_alarm_send_diagnosis mock_pf_alarm_send_diagnosis
+#define pf_alarm_send_diagnosis       mock_pf_alarm_send_diagnosis
+#define pf_alarm_send_diagnosis_items mock_pf_alarm_send_diagnosis_items
 #endif
 
 #include <string.h>
@@ -51,6 +62,15 @@
 #error "PNET_MAX_DIAG_ITEMS is too large"
 #endif
 
+/* Encoded size of an AlarmNotification block without alarm items. Block
+ * header, AlarmType, API, SlotNumber, SubslotNumber, ModuleIdentNumber,
+ * SubmoduleIdentNumber and AlarmSpecifier. */
+#define PF_DIAG_ALARM_HEADER_SIZE (6 + 2 + 4 + 2 + 2 + 4 + 4 + 2)
+
+/* Encoded size of the MaintenanceItem (USI, block header, padding and
+ * MaintenanceStatus) and the USI preceding the diagnosis items */
+#define PF_DIAG_ALARM_ITEMS_OVERHEAD ((2 + 6 + 2 + 4) + 2)
+
 int pf_diag_init (void)
 {
    return 0;
@@ -63,105 +83,241 @@ int pf_diag_exit (void)
 
 /**
  * @internal
- * Update the problem indicator in the PPM data status
- * by looking at all diagnosis items of a sub-slot.
+ * Update the problem indicator in the PPM data status.
+ *
+ * A problem is indicated if at least one FAULT diagnosis (or diagnosis in
+ * manufacturer specific format) exists in the device.
  *
  * @param net              InOut: The p-net stack instance.
  * @param p_ar             InOut: The AR instance.
- * @param p_subslot        In:    The sub-slot instance.
  */
 static void pf_diag_update_station_problem_indicator (
    pnet_t * net,
-   pf_ar_t * p_ar,
-   const pf_subslot_t * p_subslot)
+   pf_ar_t * p_ar)
 {
-   bool is_problem = false;
-   pf_device_t * p_dev = NULL;
-   uint16_t ix;
-   pf_diag_item_t * p_item;
+   pf_ppm_set_problem_indicator (
+      net,
+      p_ar,
+      net->cmdev_device.diag_counters.fault > 0);
+}
 
-   if (pf_cmdev_get_device (net, &p_dev) == 0)
+/**
+ * @internal
+ * Update the submodule diff state from the diag counters of the sub-slot.
+ *
+ * @param p_subslot        InOut: The sub-slot instance.
+ */
+static void pf_diag_update_submodule_state (pf_subslot_t * p_subslot)
+{
+   const pf_diag_counters_t * p_counters = &p_subslot->diag_counters;
+
+   p_subslot->diag_summary.fault =
+      (p_counters->fault > 0) || (p_counters->qualified > 0);
+   p_subslot->diag_summary.maintenance_required =
+      p_counters->maintenance_required > 0;
+   p_subslot->diag_summary.maintenance_demanded =
+      p_counters->maintenance_demanded > 0;
+}
+
+/**
+ * @internal
+ * Add or subtract a diag item to/from diag counters.
+ *
+ * Diagnosis in manufacturer specific format is counted as fault. Diagnosis
+ * with severity "qualified" is counted once for each of the fault, maintenance
+ * required and maintenance demanded qualifier ranges it has bits set in.
+ *
+ * @param p_counters       InOut: The diag counters.
+ * @param p_item           In:    The diag item.
+ * @param is_added         In:    true if the item is added, false if removed.
+ */
+static void pf_diag_count_item (
+   pf_diag_counters_t * p_counters,
+   const pf_diag_item_t * p_item,
+   bool is_added)
+{
+   pf_diag_counters_t item_counters = {0};
+   uint32_t qualifier = 0;
+
+   if (p_item->usi < PF_USI_CHANNEL_DIAGNOSIS)
    {
-      /* A problem is indicated if at least one FAULT diagnosis exists. */
-      ix = p_subslot->diag_list;
-      pf_cmdev_get_diag_item (net, ix, &p_item);
-      while (p_item != NULL)
+      item_counters.fault = 1;
+   }
+   else
+   {
+      switch (PF_DIAG_CH_PROP_MAINT_GET (p_item->fmt.std.ch_properties))
       {
-         if (
-            (p_item->in_use == true) &&
-            ((p_item->usi < PF_USI_CHANNEL_DIAGNOSIS) ||
-             (PF_DIAG_CH_PROP_MAINT_GET (p_item->fmt.std.ch_properties) ==
-              PNET_DIAG_CH_PROP_MAINT_FAULT)))
-         {
-            is_problem = true;
-         }
-
-         ix = p_item->next;
-         pf_cmdev_get_diag_item (net, ix, &p_item);
+      case PNET_DIAG_CH_PROP_MAINT_FAULT:
+         item_counters.fault = 1;
+         break;
+      case PNET_DIAG_CH_PROP_MAINT_REQUIRED:
+         item_counters.maintenance_required = 1;
+         break;
+      case PNET_DIAG_CH_PROP_MAINT_DEMANDED:
+         item_counters.maintenance_demanded = 1;
+         break;
+      case PNET_DIAG_CH_PROP_MAINT_QUALIFIED:
+         qualifier = p_item->fmt.std.qual_ch_qualifier &
+                     PF_DIAG_QUALIFIED_SEVERITY_MASK;
+         item_counters.qualified =
+            (qualifier & PF_DIAG_QUALIFIER_MASK_FAULT) > 0;
+         item_counters.maintenance_required =
+            (qualifier & PF_DIAG_QUALIFIER_MASK_REQUIRED) > 0;
+         item_counters.maintenance_demanded =
+            (qualifier & PF_DIAG_QUALIFIER_MASK_DEMANDED) > 0;
+         break;
+      default:
+         break;
       }
    }
 
-   pf_ppm_set_problem_indicator (net, p_ar, is_problem);
+   if (is_added == true)
+   {
+      p_counters->fault += item_counters.fault;
+      p_counters->maintenance_required += item_counters.maintenance_required;
+      p_counters->maintenance_demanded += item_counters.maintenance_demanded;
+      p_counters->qualified += item_counters.qualified;
+   }
+   else
+   {
+      p_counters->fault -= item_counters.fault;
+      p_counters->maintenance_required -= item_counters.maintenance_required;
+      p_counters->maintenance_demanded -= item_counters.maintenance_demanded;
+      p_counters->qualified -= item_counters.qualified;
+   }
 }
 
 /**
  * @internal
- * Update the submodule diff state
+ * Link a diag item first in the list of a sub-slot, and count it.
  *
  * @param net              InOut: The p-net stack instance.
- * @param p_ar             InOut: The AR instance.
- * @param p_subslot        In:    The sub-slot instance.
+ * @param p_subslot        InOut: The sub-slot instance.
+ * @param item_ix          In:    The diag item index.
  */
-static void pf_diag_update_submodule_state (
+void pf_diag_link (
    pnet_t * net,
-   pf_ar_t * p_ar,
-   pf_subslot_t * p_subslot)
+   pf_subslot_t * p_subslot,
+   uint16_t item_ix)
 {
-   pf_device_t * p_dev = NULL;
-   uint16_t ix;
-   pf_diag_item_t * p_item;
-   pf_submod_diag_summary_t diag_summary;
-   pnet_alarm_spec_t alarm_spec = {0};
-   uint32_t maint_status = 0;
+   pf_device_t * p_dev = &net->cmdev_device;
+   const pf_diag_item_t * p_item = &p_dev->diag_items[item_ix];
+   uint16_t next_ix = p_subslot->diag_list;
 
-   memset (&diag_summary, 0, sizeof (diag_summary));
+   if (next_ix != PF_DIAG_IX_NULL)
+   {
+      p_dev->diag_links[next_ix].prev = item_ix;
+   }
+   p_dev->diag_items[item_ix].next = next_ix;
+   p_dev->diag_links[item_ix].prev = PF_DIAG_IX_NULL;
+   p_subslot->diag_list = item_ix;
+#if PNET_MAX_DIAG_CACHE_SIZE > 0
+   p_subslot->diag_cache_valid = false;
+#endif
 
-   if (pf_cmdev_get_device (net, &p_dev) == 0)
+   pf_diag_count_item (&p_subslot->diag_counters, p_item, true);
+   pf_diag_count_item (&p_dev->diag_counters, p_item, true);
+}
+
+/**
+ * @internal
+ * Unlink a diag item from the list of a sub-slot, and stop counting it.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param p_subslot        InOut: The sub-slot instance.
+ * @param item_ix          In:    The diag item index.
+ */
+void pf_diag_unlink (
+   pnet_t * net,
+   pf_subslot_t * p_subslot,
+   uint16_t item_ix)
+{
+   pf_device_t * p_dev = &net->cmdev_device;
+   const pf_diag_item_t * p_item = &p_dev->diag_items[item_ix];
+   uint16_t prev_ix = p_dev->diag_links[item_ix].prev;
+   uint16_t next_ix = p_dev->diag_items[item_ix].next;
+
+   if (prev_ix != PF_DIAG_IX_NULL)
    {
-      ix = p_subslot->diag_list;
-      pf_cmdev_get_diag_item (net, ix, &p_item);
-      while (p_item != NULL)
-      {
-         if (p_item->in_use == true)
-         {
-            pf_alarm_add_diag_item_to_summary (
-               p_ar,
-               p_subslot,
-               p_item,
-               &alarm_spec,
-               &maint_status);
+      /* Not first in list */
+      p_dev->diag_items[prev_ix].next = next_ix;
+   }
+   else
+   {
+      /* Unlink the first item in the list */
+      p_subslot->diag_list = next_ix;
+   }
 
-            if (alarm_spec.submodule_diagnosis == true)
-            {
-               diag_summary.fault = true;
-            }
+   if (next_ix != PF_DIAG_IX_NULL)
+   {
+      p_dev->diag_links[next_ix].prev = prev_ix;
+   }
+#if PNET_MAX_DIAG_CACHE_SIZE > 0
+   p_subslot->diag_cache_valid = false;
+#endif
 
-            if (maint_status & PF_DIAG_BIT_MAINTENANCE_REQUIRED)
-            {
-               diag_summary.maintenance_required = true;
-            }
+   pf_diag_count_item (&p_subslot->diag_counters, p_item, false);
+   pf_diag_count_item (&p_dev->diag_counters, p_item, false);
+}
 
-            if (maint_status & PF_DIAG_BIT_MAINTENANCE_DEMANDED)
-            {
-               diag_summary.maintenance_demanded = true;
-            }
-         }
+/**
+ * @internal
+ * Mark a diag item as changed in the ongoing diagnosis batch.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param p_subslot        InOut: The sub-slot instance.
+ * @param item_ix          In:    The diag item index.
+ * @param is_new           In:    true if the item was added in the batch.
+ */
+static void pf_diag_batch_mark (
+   pnet_t * net,
+   pf_subslot_t * p_subslot,
+   uint16_t item_ix,
+   bool is_new)
+{
+   pf_diag_item_link_t * p_link = &net->cmdev_device.diag_links[item_ix];
 
-         ix = p_item->next;
-         pf_cmdev_get_diag_item (net, ix, &p_item);
-      }
-      p_subslot->diag_summary = diag_summary;
+   if (is_new == true)
+   {
+      p_link->batch_state = PF_DIAG_BATCH_ADDED;
+   }
+   else if (p_link->batch_state == PF_DIAG_BATCH_NONE)
+   {
+      p_link->batch_state = PF_DIAG_BATCH_CHANGED;
    }
+   p_subslot->diag_batch_changed = true;
+}
+
+/**
+ * @internal
+ * Remove an (unlinked) diag item in the ongoing diagnosis batch.
+ *
+ * Items added in the batch have never been reported, so they are freed
+ * directly. Other items are kept on the list of removed items until the
+ * disappear alarm has been sent by pf_diag_commit().
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param p_subslot        InOut: The sub-slot instance.
+ * @param item_ix          In:    The diag item index.
+ */
+static void pf_diag_batch_remove (
+   pnet_t * net,
+   pf_subslot_t * p_subslot,
+   uint16_t item_ix)
+{
+   pf_device_t * p_dev = &net->cmdev_device;
+
+   if (p_dev->diag_links[item_ix].batch_state == PF_DIAG_BATCH_ADDED)
+   {
+      pf_cmdev_free_diag (net, item_ix);
+   }
+   else
+   {
+      pf_cmdev_unindex_diag (net, item_ix);
+      p_dev->diag_items[item_ix].next = p_subslot->diag_batch_removed;
+      p_subslot->diag_batch_removed = item_ix;
+   }
+   p_subslot->diag_batch_changed = true;
 }
 
 /**
@@ -182,6 +338,8 @@ static void pf_diag_update_submodule_state (
  * Similarly for diagnosis in USI format, the ManufacturerData is not used
  * for identification.
  *
+ * The item is looked up in the diagnosis index, and stays in the index.
+ *
  * @param net               InOut: The p-net stack instance.
  * @param p_diag_source     In:    Slot, subslot, channel, direction etc.
  * @param ch_error_type     In:    The channel error type.
@@ -199,11 +357,6 @@ static void pf_diag_find_entry (
    pf_subslot_t ** pp_subslot,
    uint16_t * p_diag_ix)
 {
-   pf_diag_item_t * p_item = NULL;
-   pf_diag_item_t * p_prev = NULL;
-   uint16_t prev_ix;
-   uint16_t item_ix;
-
    *p_diag_ix = PF_DIAG_IX_NULL;
    *pp_subslot = NULL;
    if (
@@ -214,68 +367,16 @@ static void pf_diag_find_entry (
          p_diag_source->subslot,
          pp_subslot) == 0)
    {
-      prev_ix = PF_DIAG_IX_NULL;
-      item_ix = (*pp_subslot)->diag_list;
-      pf_cmdev_get_diag_item (net, item_ix, &p_item);
-      while ((p_item != NULL) && (*p_diag_ix == PF_DIAG_IX_NULL))
+      *p_diag_ix = pf_cmdev_find_diag (
+         net,
+         p_diag_source,
+         ch_error_type,
+         ext_ch_error_type,
+         usi);
+      if (*p_diag_ix != PF_DIAG_IX_NULL)
       {
-         /* Found a match if all of:
-          *    format is STD.
-          *    channel number matches.
-          *    individual channel or channel group
-          *    direction matches.
-          *    ch_error_type matches.
-          *    ext_ch_error_type matches.
-          * ToDo: How do we find manuf_data diag entries??
-          */
-         if (p_item->usi >= PF_USI_CHANNEL_DIAGNOSIS)
-         {
-            if (
-               (p_item->fmt.std.ch_nbr == p_diag_source->ch) &&
-               (p_item->fmt.std.ch_error_type == ch_error_type) &&
-               (p_item->fmt.std.ext_ch_error_type == ext_ch_error_type) &&
-               (PF_DIAG_CH_PROP_ACC_GET (p_item->fmt.std.ch_properties) ==
-                p_diag_source->ch_grouping) &&
-               (PF_DIAG_CH_PROP_DIR_GET (p_item->fmt.std.ch_properties) ==
-                p_diag_source->ch_direction))
-            {
-               *p_diag_ix = item_ix;
-
-               /* Unlink it from the list so it can be updated. */
-               if (prev_ix != PF_DIAG_IX_NULL)
-               {
-                  /* Not first in list */
-                  pf_cmdev_get_diag_item (net, prev_ix, &p_prev);
-                  p_prev->next = p_item->next;
-               }
-               else
-               {
-                  /* Unlink the first item in the list */
-                  (*pp_subslot)->diag_list = p_item->next;
-               }
-            }
-         }
-         else if (p_item->usi == usi)
-         {
-            *p_diag_ix = item_ix;
-
-            /* Unlink it from the list so it can be updated. */
-            if (prev_ix != PF_DIAG_IX_NULL)
-            {
-               /* Not first in list */
-               pf_cmdev_get_diag_item (net, prev_ix, &p_prev);
-               p_prev->next = p_item->next;
-            }
-            else
-            {
-               /* Unlink the first item in the list */
-               (*pp_subslot)->diag_list = p_item->next;
-            }
-         }
-
-         prev_ix = item_ix;
-         item_ix = p_item->next;
-         pf_cmdev_get_diag_item (net, item_ix, &p_item);
+         /* Unlink it from the list so it can be updated. */
+         pf_diag_unlink (net, *pp_subslot, *p_diag_ix);
       }
    }
 }
@@ -497,13 +598,28 @@ int pf_diag_add (
                p_item->fmt.std.qual_ch_qualifier = qual_ch_qualifier;
             }
 
+            if (overwrite == false)
+            {
+               pf_cmdev_index_diag (
+                  net,
+                  item_ix,
+                  p_diag_source->api,
+                  p_diag_source->slot,
+                  p_diag_source->subslot);
+            }
+
             /* Link it into the sub-slot reported list */
-            p_item->next = p_subslot->diag_list;
-            p_subslot->diag_list = item_ix;
+            pf_diag_link (net, p_subslot, item_ix);
 
-            pf_diag_update_submodule_state (net, p_ar, p_subslot);
+            pf_diag_update_submodule_state (p_subslot);
 
-            if (
+            if (p_dev->diag_batch == true)
+            {
+               /* The alarm is sent by pf_diag_commit() */
+               pf_diag_batch_mark (net, p_subslot, item_ix, overwrite == false);
+               ret = 0;
+            }
+            else if (
                (p_subslot->ownsm_state == PF_OWNSM_STATE_IOC) ||
                (p_subslot->ownsm_state == PF_OWNSM_STATE_IOS))
             {
@@ -517,7 +633,7 @@ int pf_diag_add (
                   p_diag_source->subslot,
                   p_item);
 
-               pf_diag_update_station_problem_indicator (net, p_ar, p_subslot);
+               pf_diag_update_station_problem_indicator (net, p_ar);
 
                if (overwrite == true)
                {
@@ -703,12 +819,17 @@ int pf_diag_update (
             }
 
             /* Link it into the sub-slot diag list */
-            p_item->next = p_subslot->diag_list;
-            p_subslot->diag_list = item_ix;
+            pf_diag_link (net, p_subslot, item_ix);
 
-            pf_diag_update_submodule_state (net, p_ar, p_subslot);
+            pf_diag_update_submodule_state (p_subslot);
 
-            if (
+            if (p_dev->diag_batch == true)
+            {
+               /* The alarm is sent by pf_diag_commit() */
+               pf_diag_batch_mark (net, p_subslot, item_ix, false);
+               ret = 0;
+            }
+            else if (
                (p_subslot->ownsm_state == PF_OWNSM_STATE_IOC) ||
                (p_subslot->ownsm_state == PF_OWNSM_STATE_IOS))
             {
@@ -722,7 +843,7 @@ int pf_diag_update (
                   p_diag_source->subslot,
                   p_item);
 
-               pf_diag_update_station_problem_indicator (net, p_ar, p_subslot);
+               pf_diag_update_station_problem_indicator (net, p_ar);
 
                /* Remove the old diag by sending a disappear alarm.
                   The old item should be removed after the new is added */
@@ -784,7 +905,9 @@ int pf_diag_remove (
    pf_subslot_t * p_subslot = NULL;
    uint16_t item_ix = PF_DIAG_IX_NULL;
    pf_diag_item_t * p_item = NULL;
+   pf_diag_item_t removed_item;
    pf_ar_t * p_ar = NULL;
+   bool is_batch = false;
 
    if (usi > PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS || usi == PF_USI_ALARM_MULTIPLE)
    {
@@ -827,11 +950,34 @@ int pf_diag_remove (
          &p_subslot,
          &item_ix);
 
+      /* Free the diag entry (and remove it from the diagnosis index). Use a
+         copy of it for the alarm. */
+      is_batch = p_dev->diag_batch;
+      if (pf_cmdev_get_diag_item (net, item_ix, &p_item) == 0)
+      {
+         removed_item = *p_item;
+         if (is_batch == true)
+         {
+            /* The alarm is sent by pf_diag_commit() */
+            pf_diag_batch_remove (net, p_subslot, item_ix);
+            pf_diag_update_submodule_state (p_subslot);
+         }
+         else
+         {
+            pf_cmdev_free_diag (net, item_ix);
+         }
+         p_item = &removed_item;
+      }
+
       os_mutex_unlock (p_dev->diag_mutex);
 
-      if ((p_subslot != NULL) && (item_ix != PF_DIAG_IX_NULL))
+      if ((is_batch == true) && (p_item != NULL))
       {
-         if (pf_cmdev_get_diag_item (net, item_ix, &p_item) == 0)
+         ret = 0;
+      }
+      else if ((p_subslot != NULL) && (item_ix != PF_DIAG_IX_NULL))
+      {
+         if (p_item != NULL)
          {
             if (
                (p_subslot->ownsm_state == PF_OWNSM_STATE_IOC) ||
@@ -902,15 +1048,12 @@ int pf_diag_remove (
                   "DIAG(%d): No active connection, so no alarm is sent.\n",
                   __LINE__);
             }
-            pf_diag_update_submodule_state (net, p_ar, p_subslot);
+            pf_diag_update_submodule_state (p_subslot);
          }
 
-         /* Free diag entry */
-         pf_cmdev_free_diag (net, item_ix);
-
          if (p_ar != NULL)
          {
-            pf_diag_update_station_problem_indicator (net, p_ar, p_subslot);
+            pf_diag_update_station_problem_indicator (net, p_ar);
          }
       }
       else
@@ -933,6 +1076,364 @@ int pf_diag_remove (
    return ret;
 }
 
+uint16_t pf_diag_alarm_max_items (const pf_ar_t * p_ar, uint16_t usi)
+{
+   pf_diag_item_t item;
+   uint16_t item_size;
+   uint16_t max_items;
+   uint16_t overhead = PF_DIAG_ALARM_HEADER_SIZE + PF_DIAG_ALARM_ITEMS_OVERHEAD;
+   uint16_t max_len = p_ar->alarm_cr_request.max_alarm_data_length;
+
+   memset (&item, 0, sizeof (item));
+   item.usi = usi;
+   item_size = pf_put_diag_item_size (&item);
+   if (item_size == 0)
+   {
+      return 1;
+   }
+   max_items = PNET_MAX_ALARM_PAYLOAD_DATA_SIZE / item_size;
+
+   /* The controller may limit the encoded alarm data further */
+   if (max_len > overhead)
+   {
+      if ((max_len - overhead) / item_size < max_items)
+      {
+         max_items = (max_len - overhead) / item_size;
+      }
+   }
+   else
+   {
+      max_items = 1;
+   }
+
+   return (max_items > 0) ? max_items : 1;
+}
+
+/**
+ * @internal
+ * Send diagnosis alarms for the diag items in standard format with the given
+ * USI, that were removed or changed in the diagnosis batch.
+ *
+ * As many items as fit in the alarm payload are sent in each alarm, see
+ * pf_diag_alarm_max_items().
+ *
+ * The AlarmSpecifier and maintenance status of each alarm are calculated
+ * when it is sent, from all diagnosis entries of the sub-slot. As this is
+ * after the commit, they cover all items in the batch and not only the
+ * first one.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param p_ar             InOut: The AR instance.
+ * @param api_id           In:    The API identifier.
+ * @param slot_nbr         In:    The slot number.
+ * @param p_subslot        In:    The sub-slot instance.
+ * @param usi              In:    The USI.
+ */
+static void pf_diag_batch_send_std (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   const pf_subslot_t * p_subslot,
+   uint16_t usi)
+{
+   pf_device_t * p_dev = &net->cmdev_device;
+   pf_diag_std_t items[PF_ALARM_MAX_DIAG_ITEMS];
+   uint16_t max_items = pf_diag_alarm_max_items (p_ar, usi);
+   uint16_t nbr_of_items = 0;
+   uint16_t heads[2];
+   uint16_t list;
+   uint16_t item_ix;
+   const pf_diag_item_t * p_item;
+
+   heads[0] = p_subslot->diag_batch_removed;
+   heads[1] = p_subslot->diag_list;
+   for (list = 0; list < NELEMENTS (heads); list++)
+   {
+      item_ix = heads[list];
+      while (item_ix != PF_DIAG_IX_NULL)
+      {
+         p_item = &p_dev->diag_items[item_ix];
+         /* All removed items, but only the changed items in diag_list */
+         if (
+            (p_item->usi == usi) &&
+            ((list == 0) ||
+             (p_dev->diag_links[item_ix].batch_state != PF_DIAG_BATCH_NONE)))
+         {
+            if (p_item->fmt.std.ch_error_type == PF_WRT_ERROR_REMOTE_MISMATCH)
+            {
+               /* Gives another alarm type, so send it separately */
+               (void)pf_alarm_send_diagnosis (
+                  net,
+                  p_ar,
+                  api_id,
+                  slot_nbr,
+                  p_subslot->subslot_number,
+                  p_item);
+            }
+            else
+            {
+               items[nbr_of_items] = p_item->fmt.std;
+               nbr_of_items++;
+
+               if (nbr_of_items == max_items)
+               {
+                  (void)pf_alarm_send_diagnosis_items (
+                     net,
+                     p_ar,
+                     api_id,
+                     slot_nbr,
+                     p_subslot->subslot_number,
+                     usi,
+                     items,
+                     nbr_of_items);
+                  nbr_of_items = 0;
+               }
+            }
+         }
+
+         item_ix = p_item->next;
+      }
+   }
+
+   if (nbr_of_items > 0)
+   {
+      (void)pf_alarm_send_diagnosis_items (
+         net,
+         p_ar,
+         api_id,
+         slot_nbr,
+         p_subslot->subslot_number,
+         usi,
+         items,
+         nbr_of_items);
+   }
+}
+
+/**
+ * @internal
+ * Send diagnosis alarms for the changes of a sub-slot in the diagnosis
+ * batch, and forget the batch.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param api_id           In:    The API identifier.
+ * @param slot_nbr         In:    The slot number.
+ * @param p_subslot        InOut: The sub-slot instance.
+ */
+static void pf_diag_commit_subslot (
+   pnet_t * net,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   pf_subslot_t * p_subslot)
+{
+   pf_device_t * p_dev = &net->cmdev_device;
+   pf_ar_t * p_ar = NULL;
+   pf_diag_item_t * p_item;
+   uint16_t item_ix;
+   uint16_t next_ix;
+
+   if (
+      (p_subslot->ownsm_state == PF_OWNSM_STATE_IOC) ||
+      (p_subslot->ownsm_state == PF_OWNSM_STATE_IOS))
+   {
+      p_ar = p_subslot->owner;
+   }
+
+   if (p_ar != NULL)
+   {
+      /* Removed items. Diagnosis in USI format is sent one per alarm */
+      item_ix = p_subslot->diag_batch_removed;
+      while (item_ix != PF_DIAG_IX_NULL)
+      {
+         p_item = &p_dev->diag_items[item_ix];
+         if (p_item->usi < PF_USI_CHANNEL_DIAGNOSIS)
+         {
+            (void)pf_alarm_send_usi_diagnosis_disappears (
+               net,
+               p_ar,
+               api_id,
+               slot_nbr,
+               p_subslot->subslot_number,
+               p_item->usi);
+         }
+         else if (p_subslot->diag_list != PF_DIAG_IX_NULL)
+         {
+            PF_DIAG_CH_PROP_SPEC_SET (
+               p_item->fmt.std.ch_properties,
+               PF_DIAG_CH_PROP_SPEC_DISAPPEARS);
+         }
+         else
+         {
+            /* No diagnosis remains. Same as in pf_diag_remove() */
+            p_item->usi = PF_USI_EXTENDED_CHANNEL_DIAGNOSIS;
+            PF_DIAG_CH_PROP_MAINT_SET (
+               p_item->fmt.std.ch_properties,
+               PNET_DIAG_CH_PROP_MAINT_FAULT);
+            PF_DIAG_CH_PROP_SPEC_SET (
+               p_item->fmt.std.ch_properties,
+               PF_DIAG_CH_PROP_SPEC_ALL_DISAPPEARS);
+         }
+         item_ix = p_item->next;
+      }
+
+      /* Changed items in USI format */
+      item_ix = p_subslot->diag_list;
+      while (item_ix != PF_DIAG_IX_NULL)
+      {
+         p_item = &p_dev->diag_items[item_ix];
+         if (
+            (p_item->usi < PF_USI_CHANNEL_DIAGNOSIS) &&
+            (p_dev->diag_links[item_ix].batch_state != PF_DIAG_BATCH_NONE))
+         {
+            (void)pf_alarm_send_diagnosis (
+               net,
+               p_ar,
+               api_id,
+               slot_nbr,
+               p_subslot->subslot_number,
+               p_item);
+         }
+         item_ix = p_item->next;
+      }
+
+      /* Removed and changed items in standard format */
+      pf_diag_batch_send_std (
+         net,
+         p_ar,
+         api_id,
+         slot_nbr,
+         p_subslot,
+         PF_USI_CHANNEL_DIAGNOSIS);
+      pf_diag_batch_send_std (
+         net,
+         p_ar,
+         api_id,
+         slot_nbr,
+         p_subslot,
+         PF_USI_EXTENDED_CHANNEL_DIAGNOSIS);
+      pf_diag_batch_send_std (
+         net,
+         p_ar,
+         api_id,
+         slot_nbr,
+         p_subslot,
+         PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS);
+
+      pf_diag_update_station_problem_indicator (net, p_ar);
+   }
+   else
+   {
+      LOG_DEBUG (
+         PNET_LOG,
+         "DIAG(%d): No active connection, so no alarm is sent.\n",
+         __LINE__);
+   }
+
+   /* Forget the batch */
+   item_ix = p_subslot->diag_batch_removed;
+   while (item_ix != PF_DIAG_IX_NULL)
+   {
+      next_ix = p_dev->diag_items[item_ix].next;
+      pf_cmdev_free_diag (net, item_ix);
+      item_ix = next_ix;
+   }
+   p_subslot->diag_batch_removed = PF_DIAG_IX_NULL;
+
+   item_ix = p_subslot->diag_list;
+   while (item_ix != PF_DIAG_IX_NULL)
+   {
+      p_dev->diag_links[item_ix].batch_state = PF_DIAG_BATCH_NONE;
+      item_ix = p_dev->diag_items[item_ix].next;
+   }
+   p_subslot->diag_batch_changed = false;
+}
+
+int pf_diag_begin (pnet_t * net)
+{
+   int ret = -1;
+   pf_device_t * p_dev = NULL;
+
+   if (pf_cmdev_get_device (net, &p_dev) == 0)
+   {
+      os_mutex_lock (p_dev->diag_mutex);
+      if (p_dev->diag_batch == false)
+      {
+         p_dev->diag_batch = true;
+         ret = 0;
+      }
+      else
+      {
+         LOG_ERROR (
+            PF_ALARM_LOG,
+            "DIAG(%d): A diagnosis batch is already started.\n",
+            __LINE__);
+      }
+      os_mutex_unlock (p_dev->diag_mutex);
+   }
+
+   return ret;
+}
+
+int pf_diag_commit (pnet_t * net)
+{
+   int ret = -1;
+   pf_device_t * p_dev = NULL;
+   pf_api_t * p_api;
+   pf_slot_t * p_slot;
+   pf_subslot_t * p_subslot;
+   uint16_t api_ix;
+   uint16_t slot_ix;
+   uint16_t subslot_ix;
+
+   if (pf_cmdev_get_device (net, &p_dev) == 0)
+   {
+      os_mutex_lock (p_dev->diag_mutex);
+      if (p_dev->diag_batch == true)
+      {
+         p_dev->diag_batch = false;
+
+         for (api_ix = 0; api_ix < PNET_MAX_API; api_ix++)
+         {
+            p_api = &p_dev->real_ident.api[api_ix];
+            for (slot_ix = 0;
+                 (p_api->in_use == true) && (slot_ix < PNET_MAX_SLOTS);
+                 slot_ix++)
+            {
+               p_slot = &p_api->slots[slot_ix];
+               for (subslot_ix = 0;
+                    (p_slot->in_use == true) &&
+                    (subslot_ix < PNET_MAX_SUBSLOTS);
+                    subslot_ix++)
+               {
+                  p_subslot = &p_slot->subslots[subslot_ix];
+                  if (
+                     (p_subslot->in_use == true) &&
+                     (p_subslot->diag_batch_changed == true))
+                  {
+                     pf_diag_commit_subslot (
+                        net,
+                        p_api->api_id,
+                        p_slot->slot_number,
+                        p_subslot);
+                  }
+               }
+            }
+         }
+         ret = 0;
+      }
+      else
+      {
+         LOG_ERROR (
+            PF_ALARM_LOG,
+            "DIAG(%d): No diagnosis batch is started.\n",
+            __LINE__);
+      }
+      os_mutex_unlock (p_dev->diag_mutex);
+   }
+
+   return ret;
+}
+
 /************************** Diagnosis in standard format *********************/
 
 /**
@@ -173,6 +173,32 @@ int pf_diag_remove (
    uint16_t ext_ch_error_type,
    uint16_t usi);
 
+/**
+ * Start a diagnosis batch.
+ *
+ * Until pf_diag_commit() is called, diagnosis entries are added, updated and
+ * removed as usual, but no diagnosis alarms are sent.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @return  0  if the operation succeeded.
+ *          -1 if an error occurred (a batch is already started).
+ */
+int pf_diag_begin (pnet_t * net);
+
+/**
+ * Finish a diagnosis batch, and send diagnosis alarms for the changes.
+ *
+ * For each sub-slot, the changed diagnosis entries are reported with their
+ * final value, and entries that were both added and removed in the batch are
+ * not reported at all. Entries in standard format with the same USI are sent
+ * together in as few alarms as the alarm payload size allows.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @return  0  if the operation succeeded.
+ *          -1 if an error occurred (no batch is started).
+ */
+int pf_diag_commit (pnet_t * net);
+
 /************************** Diagnosis in standard format *********************/
 
 /**
@@ -329,6 +355,23 @@ int pf_diag_usi_remove (
    uint16_t subslot_nbr,
    uint16_t usi);
 
+/**
+ * Calculate the max number of diag items in standard format to send in one
+ * diagnosis alarm.
+ *
+ * Each item is encoded as ChannelDiagnosis, ExtChannelDiagnosis or
+ * QualifiedChannelDiagnosis data, and the encoded items must fit
+ * PNET_MAX_ALARM_PAYLOAD_DATA_SIZE. The complete AlarmNotification,
+ * including header and MaintenanceItem, must also fit the max alarm data
+ * length given by the controller.
+ *
+ * @param p_ar             In:    The AR instance.
+ * @param usi              In:    The USI of the items.
+ * @return  the number of items, at least 1.
+ * @internal
+ */
+uint16_t pf_diag_alarm_max_items (const pf_ar_t * p_ar, uint16_t usi);
+
 /* Not used yet */
 int pf_diag_get_maintenance_status (
    uint32_t api_id,
@@ -336,6 +379,12 @@ int pf_diag_get_maintenance_status (
    uint16_t subslot_nbr,
    uint32_t * p_maint_status);
 
+/************ Internal functions, made available for unit testing ************/
+
+void pf_diag_link (pnet_t * net, pf_subslot_t * p_subslot, uint16_t item_ix);
+
+void pf_diag_unlink (pnet_t * net, pf_subslot_t * p_subslot, uint16_t item_ix);
+
 #ifdef __cplusplus
 }
 #endif
@@ -133,6 +133,9 @@ void pf_fspm_option_show (const pnet_t * net)
    printf (
       "PNET_MAX_DIAG_MANUF_DATA_SIZE                  : %d\n",
       PNET_MAX_DIAG_MANUF_DATA_SIZE);
+   printf (
+      "PNET_MAX_DIAG_CACHE_SIZE                       : %d\n",
+      PNET_MAX_DIAG_CACHE_SIZE);
    printf (
       "PNET_MAX_DIRECTORYPATH_SIZE                    : %d\n",
       PNET_MAX_DIRECTORYPATH_SIZE);
@@ -280,6 +283,28 @@ int pf_fspm_validate_configuration (const pnet_cfg_t * p_cfg)
       return -1;
    }
 
+   if (p_cfg->max_diag_items > 65534)
+   {
+      LOG_ERROR (
+         PNET_LOG,
+         "FSPM(%d): The max_diag_items setting is too large. Given: %u  Max: "
+         "65534\n",
+         __LINE__,
+         (unsigned)p_cfg->max_diag_items);
+      return -1;
+   }
+
+   if (p_cfg->max_alarms > 0x7FFF)
+   {
+      LOG_ERROR (
+         PNET_LOG,
+         "FSPM(%d): The max_alarms setting is too large. Given: %u  Max: "
+         "32767\n",
+         __LINE__,
+         (unsigned)p_cfg->max_alarms);
+      return -1;
+   }
+
    return 0;
 }
 
@@ -421,6 +446,14 @@ int pf_fspm_init (pnet_t * net, const pnet_cfg_t * p_cfg)
    /* Use a copy of the configuration. For example the I&M data might be updated
     * at runtime. */
    net->fspm_cfg = *p_cfg;
+   if (net->fspm_cfg.max_diag_items == 0)
+   {
+      net->fspm_cfg.max_diag_items = PNET_MAX_DIAG_ITEMS;
+   }
+   if (net->fspm_cfg.max_alarms == 0)
+   {
+      net->fspm_cfg.max_alarms = PNET_MAX_ALARMS;
+   }
 
    /* Reference to the default settings (used at factory reset) */
    net->p_fspm_default_cfg = p_cfg;
@@ -658,7 +691,7 @@ void pf_fspm_ccontrol_cnf (
 
 int pf_fspm_cm_read_ind (
    pnet_t * net,
-   const pf_ar_t * p_ar,
+   pf_ar_t * p_ar,
    const pf_iod_read_request_t * p_read_request,
    uint8_t ** pp_read_data,
    uint16_t * p_read_length,
@@ -671,8 +704,40 @@ int pf_fspm_cm_read_ind (
 
    if (p_read_request->index <= PF_IDX_USER_MAX)
    {
+      if (p_ar->record_rsp.state == PF_RECORD_RSP_STATE_READY)
+      {
+         /* The application has responded via pnet_read_record_rsp() */
+         if (
+            p_ar->record_rsp.result.pnio_status.error_code !=
+            PNET_ERROR_CODE_NOERROR)
+         {
+            *p_read_status = p_ar->record_rsp.result;
+         }
+         else if (p_ar->record_rsp.read_length > *p_read_length)
+         {
+            LOG_ERROR (
+               PNET_LOG,
+               "FSPM(%d): Deferred read response for AREP %u is too large: "
+               "%u bytes, max %u\n",
+               __LINE__,
+               p_ar->arep,
+               p_ar->record_rsp.read_length,
+               *p_read_length);
+            p_read_status->pnio_status.error_code = PNET_ERROR_CODE_READ;
+            p_read_status->pnio_status.error_decode = PNET_ERROR_DECODE_PNIORW;
+            p_read_status->pnio_status.error_code_1 =
+               PNET_ERROR_CODE_1_APP_READ_ERROR;
+            p_read_status->pnio_status.error_code_2 = 0;
+         }
+         else
+         {
+            *pp_read_data = (uint8_t *)p_ar->record_rsp.p_read_data;
+            *p_read_length = p_ar->record_rsp.read_length;
+            ret = 0;
+         }
+      }
       /* Trigger callback for application-specific data records */
-      if (net->fspm_cfg.read_cb != NULL)
+      else if (net->fspm_cfg.read_cb != NULL)
       {
          LOG_DEBUG (
             PNET_LOG,
@@ -696,6 +761,20 @@ int pf_fspm_cm_read_ind (
             pp_read_data,
             p_read_length,
             p_read_status);
+
+         if (ret == PNET_RECORD_RSP_PENDING)
+         {
+            LOG_DEBUG (
+               PNET_LOG,
+               "FSPM(%d): Application defers the read response for AREP %u.\n",
+               __LINE__,
+               p_ar->arep);
+            p_ar->record_rsp.state = PF_RECORD_RSP_STATE_PENDING;
+            p_ar->record_rsp.is_read = true;
+            p_ar->record_rsp.index = index;
+            *p_read_length = 0;
+            ret = 0;
+         }
       }
       else
       {
@@ -847,7 +926,7 @@ int pf_fspm_cm_read_ind (
 
 int pf_fspm_cm_write_ind (
    pnet_t * net,
-   const pf_ar_t * p_ar,
+   pf_ar_t * p_ar,
    const pf_iod_write_request_t * p_write_request,
    uint16_t write_length,
    const uint8_t * p_write_data,
@@ -859,8 +938,22 @@ int pf_fspm_cm_write_ind (
 
    if (p_write_request->index <= PF_IDX_USER_MAX)
    {
+      if (p_ar->record_rsp.state == PF_RECORD_RSP_STATE_READY)
+      {
+         /* The application has responded via pnet_write_record_rsp() */
+         if (
+            p_ar->record_rsp.result.pnio_status.error_code !=
+            PNET_ERROR_CODE_NOERROR)
+         {
+            *p_write_status = p_ar->record_rsp.result;
+         }
+         else
+         {
+            ret = 0;
+         }
+      }
       /* Trigger callback for application-specific data records */
-      if (net->fspm_cfg.write_cb != NULL)
+      else if (net->fspm_cfg.write_cb != NULL)
       {
          LOG_DEBUG (
             PNET_LOG,
@@ -885,6 +978,20 @@ int pf_fspm_cm_write_ind (
             write_length,
             p_write_data,
             p_write_status);
+
+         if (ret == PNET_RECORD_RSP_PENDING)
+         {
+            LOG_DEBUG (
+               PNET_LOG,
+               "FSPM(%d): Application defers the write response for AREP "
+               "%u.\n",
+               __LINE__,
+               p_ar->arep);
+            p_ar->record_rsp.state = PF_RECORD_RSP_STATE_PENDING;
+            p_ar->record_rsp.is_read = false;
+            p_ar->record_rsp.index = p_write_request->index;
+            ret = 0;
+         }
       }
       else
       {
@@ -74,18 +74,22 @@ void pf_fspm_create_log_book_entry (
  * If index is user-defined then call application
  * call-back \a pnet_write_ind() if defined.
  *
+ * If the application defers the response, the AR record_rsp state is set to
+ * PF_RECORD_RSP_STATE_PENDING. When it is PF_RECORD_RSP_STATE_READY the
+ * response given by the application is used instead of calling it again.
+ *
  * @param net              InOut: The p-net stack instance
- * @param p_ar             In:    The AR instance.
+ * @param p_ar             InOut: The AR instance.
  * @param p_write_request  In:    The write request record.
  * @param write_length     In:    Length in bytes of write data.
  * @param p_write_data     In:    The data to write.
  * @param p_result         Out:   Detailed error information if returning != 0
- * @return  0  if operation succeeded.
+ * @return  0  if operation succeeded (or was deferred).
  *          -1 if an error occurred.
  */
 int pf_fspm_cm_write_ind (
    pnet_t * net,
-   const pf_ar_t * p_ar,
+   pf_ar_t * p_ar,
    const pf_iod_write_request_t * p_write_request,
    uint16_t write_length,
    const uint8_t * p_write_data,
@@ -95,19 +99,22 @@ int pf_fspm_cm_write_ind (
  * Process read record requests from the controller.
  * Triggers the \a pnet_read_ind() user callback for some values.
  *
+ * Deferred responses are handled as for \a pf_fspm_cm_write_ind(). A
+ * deferred read gives no data (zero length).
+ *
  * @param net              InOut: The p-net stack instance
- * @param p_ar             In:    The AR instance.
+ * @param p_ar             InOut: The AR instance.
  * @param p_read_request   In:    The read request record.
  * @param pp_read_data     Out:   A pointer to the source data.
  * @param p_read_length    InOut: The maximum (in) and actual (out) length in
  *                                bytes of the binary value.
  * @param p_result         Out:   The result information.
- * @return  0  if operation succeeded.
+ * @return  0  if operation succeeded (or was deferred).
  *          -1 if not handled or an error occurred.
  */
 int pf_fspm_cm_read_ind (
    pnet_t * net,
-   const pf_ar_t * p_ar,
+   pf_ar_t * p_ar,
    const pf_iod_read_request_t * p_read_request,
    uint8_t ** pp_read_data,
    uint16_t * p_read_length,
@@ -0,0 +1,361 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+/**
+ * @file
+ * @brief Fast Startup (FSU)
+ *
+ * When the controller uses Fast Startup (an ARFSUBlock in the connect
+ * request), the FSParameterUUID and the expected submodules are stored in
+ * nvm once cyclic data has started.
+ *
+ * At the next power-on the stored configuration is plugged in the first
+ * call to \a pnet_handle_periodic(), so the device model is ready before the
+ * controller connects. A connect with the same parameters is logged as a
+ * matching startup.
+ *
+ * The time from power-on (stack initialisation) to the first cyclic data is
+ * recorded and logged.
+ */
+
+#ifdef UNIT_TEST
+#define os_get_current_time_us   mock_os_get_current_time_us
+#define pf_file_clear            mock_pf_file_clear
+#define pf_file_load             mock_pf_file_load
+#define pf_file_save_if_modified mock_pf_file_save_if_modified
+#define pf_bg_worker_start_job   mock_pf_bg_worker_start_job
+#endif
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "pf_includes.h"
+
+/**
+ * @internal
+ * Collect the startup parameters from an AR.
+ *
+ * @param p_ar             In:    The AR instance.
+ * @param p_nvm            Out:   The startup parameters.
+ */
+static void pf_fsu_parameters_from_ar (
+   const pf_ar_t * p_ar,
+   pf_fsu_nvm_t * p_nvm)
+{
+   uint16_t api_ix;
+   uint16_t mod_ix;
+   uint16_t sub_ix;
+   uint16_t i;
+   const pf_exp_api_t * p_exp_api;
+   const pf_exp_module_t * p_exp_mod;
+   const pf_exp_submodule_t * p_exp_sub;
+   pf_fsu_submodule_t * p_fsu_sub;
+
+   /* Clear also padding, as the result is compared with memcmp() */
+   memset (p_nvm, 0, sizeof (*p_nvm));
+   p_nvm->fs_parameter_uuid =
+      p_ar->fast_startup_data.fs_parameter_block.fs_parameter_uuid;
+
+   for (api_ix = 0; api_ix < p_ar->exp_ident.nbr_apis; api_ix++)
+   {
+      p_exp_api = &p_ar->exp_ident.api[api_ix];
+      for (mod_ix = 0; mod_ix < p_exp_api->nbr_modules; mod_ix++)
+      {
+         p_exp_mod = &p_exp_api->module[mod_ix];
+         for (sub_ix = 0; sub_ix < p_exp_mod->nbr_submodules; sub_ix++)
+         {
+            if (p_nvm->nbr_submodules >= NELEMENTS (p_nvm->submodule))
+            {
+               return;
+            }
+
+            p_exp_sub = &p_exp_mod->submodule[sub_ix];
+            p_fsu_sub = &p_nvm->submodule[p_nvm->nbr_submodules];
+            p_fsu_sub->api = p_exp_api->api;
+            p_fsu_sub->slot_number = p_exp_mod->slot_number;
+            p_fsu_sub->subslot_number = p_exp_sub->subslot_number;
+            p_fsu_sub->module_ident = p_exp_mod->ident_number;
+            p_fsu_sub->submodule_ident = p_exp_sub->ident_number;
+            for (i = 0; i < p_exp_sub->nbr_data_descriptors; i++)
+            {
+               if (
+                  p_exp_sub->data_descriptor[i].data_direction ==
+                  PF_DIRECTION_INPUT)
+               {
+                  p_fsu_sub->data_cfg.data_dir |= PNET_DIR_INPUT;
+                  p_fsu_sub->data_cfg.insize =
+                     p_exp_sub->data_descriptor[i].submodule_data_length;
+               }
+               if (
+                  p_exp_sub->data_descriptor[i].data_direction ==
+                  PF_DIRECTION_OUTPUT)
+               {
+                  p_fsu_sub->data_cfg.data_dir |= PNET_DIR_OUTPUT;
+                  p_fsu_sub->data_cfg.outsize =
+                     p_exp_sub->data_descriptor[i].submodule_data_length;
+               }
+            }
+            p_nvm->nbr_submodules++;
+         }
+      }
+   }
+}
+
+void pf_fsu_init (pnet_t * net)
+{
+   const char * p_file_directory = pf_cmina_get_file_directory (net);
+
+   if (net->fsu.mutex == NULL)
+   {
+      net->fsu.mutex = os_mutex_create();
+   }
+
+   net->fsu.power_on_time_us = os_get_current_time_us();
+   net->fsu.first_data_done = false;
+   net->fsu.first_data_delay_us = 0;
+   net->fsu.nbr_matching_connects = 0;
+   net->fsu.config_plugged = false;
+
+   os_mutex_lock (net->fsu.mutex);
+   net->fsu.stored_valid =
+      (pf_file_load (
+          p_file_directory,
+          PF_FILENAME_FSU,
+          &net->fsu.stored,
+          sizeof (net->fsu.stored)) == 0);
+   if (
+      net->fsu.stored_valid &&
+      net->fsu.stored.nbr_submodules > NELEMENTS (net->fsu.stored.submodule))
+   {
+      LOG_ERROR (
+         PNET_LOG,
+         "FSU(%d): Invalid number of stored submodules: %u\n",
+         __LINE__,
+         (unsigned)net->fsu.stored.nbr_submodules);
+      memset (&net->fsu.stored, 0, sizeof (net->fsu.stored));
+      net->fsu.stored_valid = false;
+   }
+   os_mutex_unlock (net->fsu.mutex);
+
+   LOG_DEBUG (
+      PNET_LOG,
+      "FSU(%d): %s Fast Startup parameters from nvm.\n",
+      __LINE__,
+      net->fsu.stored_valid ? "Did read" : "No stored");
+}
+
+void pf_fsu_periodic (pnet_t * net)
+{
+   uint16_t ix;
+   const pf_fsu_submodule_t * p_fsu_sub;
+   pf_slot_t * p_slot = NULL;
+   pf_subslot_t * p_subslot = NULL;
+
+   if (net->fsu.config_plugged)
+   {
+      return;
+   }
+   net->fsu.config_plugged = true;
+
+   if (net->fsu.stored_valid == false)
+   {
+      return;
+   }
+
+   LOG_INFO (
+      PNET_LOG,
+      "FSU(%d): Plugging %u stored submodules for Fast Startup.\n",
+      __LINE__,
+      net->fsu.stored.nbr_submodules);
+
+   /* Only the stack thread modifies the stored parameters */
+   for (ix = 0; ix < net->fsu.stored.nbr_submodules; ix++)
+   {
+      p_fsu_sub = &net->fsu.stored.submodule[ix];
+
+      if (
+         pf_cmdev_get_slot_full (
+            net,
+            p_fsu_sub->api,
+            p_fsu_sub->slot_number,
+            &p_slot) != 0)
+      {
+         (void)pf_fspm_exp_module_ind (
+            net,
+            p_fsu_sub->api,
+            p_fsu_sub->slot_number,
+            p_fsu_sub->module_ident);
+      }
+
+      if (
+         pf_cmdev_get_subslot_full (
+            net,
+            p_fsu_sub->api,
+            p_fsu_sub->slot_number,
+            p_fsu_sub->subslot_number,
+            &p_subslot) != 0)
+      {
+         (void)pf_fspm_exp_submodule_ind (
+            net,
+            p_fsu_sub->api,
+            p_fsu_sub->slot_number,
+            p_fsu_sub->subslot_number,
+            p_fsu_sub->module_ident,
+            p_fsu_sub->submodule_ident,
+            &p_fsu_sub->data_cfg);
+      }
+   }
+}
+
+void pf_fsu_cmdev_state_ind (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   pnet_event_values_t event)
+{
+   pf_fsu_nvm_t parameters;
+
+   switch (event)
+   {
+   case PNET_EVENT_STARTUP:
+      if (p_ar->fast_startup_data.valid)
+      {
+         pf_fsu_parameters_from_ar (p_ar, &parameters);
+         p_ar->fast_startup_data.parameters_match =
+            net->fsu.stored_valid &&
+            (memcmp (&parameters, &net->fsu.stored, sizeof (parameters)) == 0);
+         if (p_ar->fast_startup_data.parameters_match)
+         {
+            net->fsu.nbr_matching_connects++;
+         }
+
+         LOG_INFO (
+            PNET_LOG,
+            "FSU(%d): Fast Startup connect for AREP %u. Parameters %s the "
+            "stored ones.\n",
+            __LINE__,
+            p_ar->arep,
+            p_ar->fast_startup_data.parameters_match ? "match"
+                                                     : "differ from");
+      }
+      break;
+   case PNET_EVENT_DATA:
+      if (net->fsu.first_data_done == false)
+      {
+         net->fsu.first_data_done = true;
+         net->fsu.first_data_delay_us =
+            os_get_current_time_us() - net->fsu.power_on_time_us;
+         LOG_INFO (
+            PNET_LOG,
+            "FSU(%d): First cyclic data %" PRIu32
+            " ms after power-on. AREP %u\n",
+            __LINE__,
+            net->fsu.first_data_delay_us / 1000,
+            p_ar->arep);
+      }
+
+      if (
+         p_ar->fast_startup_data.valid &&
+         (p_ar->fast_startup_data.parameters_match == false))
+      {
+         pf_fsu_parameters_from_ar (p_ar, &parameters);
+         os_mutex_lock (net->fsu.mutex);
+         net->fsu.stored = parameters;
+         net->fsu.stored_valid = true;
+         os_mutex_unlock (net->fsu.mutex);
+
+         (void)pf_bg_worker_start_job (net, PF_BGJOB_SAVE_FSU_NVM_DATA);
+      }
+      break;
+   default:
+      break;
+   }
+}
+
+void pf_fsu_save (pnet_t * net)
+{
+   pf_fsu_nvm_t output;
+   pf_fsu_nvm_t temporary_buffer;
+   const char * p_file_directory = pf_cmina_get_file_directory (net);
+   bool valid;
+
+   os_mutex_lock (net->fsu.mutex);
+   valid = net->fsu.stored_valid;
+   output = net->fsu.stored;
+   os_mutex_unlock (net->fsu.mutex);
+
+   if (valid == false)
+   {
+      return;
+   }
+
+   if (
+      pf_file_save_if_modified (
+         p_file_directory,
+         PF_FILENAME_FSU,
+         &output,
+         &temporary_buffer,
+         sizeof (output)) < 0)
+   {
+      LOG_ERROR (
+         PNET_LOG,
+         "FSU(%d): Failed to store Fast Startup parameters.\n",
+         __LINE__);
+   }
+}
+
+void pf_fsu_clear (pnet_t * net)
+{
+   const char * p_file_directory = pf_cmina_get_file_directory (net);
+
+   LOG_DEBUG (
+      PNET_LOG,
+      "FSU(%d): Clearing Fast Startup parameters.\n",
+      __LINE__);
+
+   os_mutex_lock (net->fsu.mutex);
+   net->fsu.stored_valid = false;
+   memset (&net->fsu.stored, 0, sizeof (net->fsu.stored));
+   os_mutex_unlock (net->fsu.mutex);
+
+   pf_file_clear (p_file_directory, PF_FILENAME_FSU);
+}
+
+void pf_fsu_show (const pnet_t * net)
+{
+   printf ("Fast Startup\n");
+   printf (
+      "Stored parameters        : %s\n",
+      net->fsu.stored_valid ? "YES" : "NO");
+   if (net->fsu.stored_valid)
+   {
+      printf (
+         "Stored submodules        : %u\n",
+         (unsigned)net->fsu.stored.nbr_submodules);
+   }
+   printf (
+      "Matching connects        : %" PRIu32 "\n",
+      net->fsu.nbr_matching_connects);
+   if (net->fsu.first_data_done)
+   {
+      printf (
+         "Power-on to cyclic data  : %" PRIu32 " us\n",
+         net->fsu.first_data_delay_us);
+   }
+   else
+   {
+      printf ("Power-on to cyclic data  : Not yet\n");
+   }
+   printf ("\n");
+}
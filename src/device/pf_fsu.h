@@ -0,0 +1,87 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#ifndef PF_FSU_H
+#define PF_FSU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initialize Fast Startup.
+ *
+ * Loads the startup parameters stored by a previous AR, if any.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+void pf_fsu_init (pnet_t * net);
+
+/**
+ * Plug the stored expected configuration, once after startup.
+ *
+ * Triggers the \a pnet_exp_module_ind() and \a pnet_exp_submodule_ind()
+ * user callbacks for the submodules of the stored configuration that are not
+ * yet plugged. The device model is then ready when the controller connects.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+void pf_fsu_periodic (pnet_t * net);
+
+/**
+ * Handle CMDEV events.
+ *
+ * At startup the connect parameters are compared to the stored ones. When
+ * cyclic data starts the parameters are stored, and the time from power-on
+ * to the first cyclic data is recorded.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param p_ar             InOut: The AR instance.
+ * @param event            In:    The new CMDEV state. Use PNET_EVENT_xxx, not
+ *                                PF_CMDEV_STATE_xxx
+ */
+void pf_fsu_cmdev_state_ind (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   pnet_event_values_t event);
+
+/**
+ * Save the stored startup parameters to file.
+ *
+ * Might be called from the background worker.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+void pf_fsu_save (pnet_t * net);
+
+/**
+ * Clear the stored startup parameters, and the file.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+void pf_fsu_clear (pnet_t * net);
+
+/**
+ * Show Fast Startup information.
+ *
+ * @param net              In:    The p-net stack instance
+ */
+void pf_fsu_show (const pnet_t * net);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PF_FSU_H */
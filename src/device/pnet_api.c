@@ -35,6 +35,56 @@
 
 #define PNET_PERIODIC_WARNING_FACTOR 3
 
+/**
+ * @internal
+ * Allocate the memory for the pools that are sized by the configuration.
+ *
+ * All pools are allocated from a single memory area, once at init.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @return  0  on success.
+ *          -1 if an error occurred.
+ */
+static int pnet_alloc_pools (pnet_t * net)
+{
+   pnet_cfg_t * p_cfg = NULL;
+   size_t cmdev_size;
+   size_t alarm_size;
+   uint8_t * p_mem;
+
+   pf_fspm_get_cfg (net, &p_cfg);
+   cmdev_size = pf_cmdev_pool_size (p_cfg);
+   alarm_size = pf_alarm_pool_size (p_cfg);
+
+   p_mem = os_malloc (cmdev_size + alarm_size);
+   if (p_mem == NULL)
+   {
+      LOG_ERROR (
+         PNET_LOG,
+         "API(%d): Failed to allocate memory for diag items and alarm queues "
+         "(%zu bytes)\n",
+         __LINE__,
+         cmdev_size + alarm_size);
+      return -1;
+   }
+   memset (p_mem, 0, cmdev_size + alarm_size);
+
+   net->cmdev_pool = p_mem;
+   net->alarm_pool = p_mem + cmdev_size;
+
+   return 0;
+}
+
+void pnet_free_pools (pnet_t * net)
+{
+   if (net->cmdev_pool != NULL)
+   {
+      os_free (net->cmdev_pool);
+   }
+   net->cmdev_pool = NULL;
+   net->alarm_pool = NULL;
+}
+
 int pnet_init_only (pnet_t * net, const pnet_cfg_t * p_cfg)
 {
    memset (net, 0, sizeof (*net));
@@ -45,6 +95,11 @@ int pnet_init_only (pnet_t * net, const pnet_cfg_t * p_cfg)
       return -1;
    }
 
+   if (pnet_alloc_pools (net) != 0)
+   {
+      return -1;
+   }
+
    net->cmdev_initialized = false; /* TODO How to handle that pf_cmdev_exit()
                                       is used before pf_cmdev_init()? */
 
@@ -72,6 +127,9 @@ int pnet_init_only (pnet_t * net, const pnet_cfg_t * p_cfg)
 
    pf_bg_worker_init (net);
    pf_cmina_init (net); /* Read from permanent pool */
+#if PNET_OPTION_FAST_STARTUP
+   pf_fsu_init (net); /* Read stored Fast Startup parameters */
+#endif
 
    pf_dcp_exit (net); /* Prepare for re-init. */
    pf_dcp_init (net); /* Start DCP */
@@ -119,6 +177,7 @@ pnet_t * pnet_init (const pnet_cfg_t * p_cfg)
 
    if (pnet_init_only (net, p_cfg) != 0)
    {
+      pnet_free_pools (net);
       free (net);
       return NULL;
    }
@@ -155,6 +214,10 @@ void pnet_handle_periodic (pnet_t * net)
 
    pf_pdport_periodic (net);
 
+#if PNET_OPTION_FAST_STARTUP
+   pf_fsu_periodic (net);
+#endif
+
 #if LOG_DEBUG_ENABLED(PNET_LOG)
    end_time_us = os_get_current_time_us();
    if (pf_cmina_has_timed_out (
@@ -188,6 +251,15 @@ void pnet_show (pnet_t * net, unsigned level)
          pf_cmdev_device_show (net);
       }
 
+      if (level & 0x0040)
+      {
+#if PNET_OPTION_FAST_STARTUP
+         pf_fsu_show (net);
+#else
+         printf ("No support for Fast Startup\n\n");
+#endif
+      }
+
       pf_cmrpc_show (net, level);
 
       if (level & 0x0200)
@@ -204,6 +276,8 @@ void pnet_show (pnet_t * net, unsigned level)
       {
          printf ("\n\n");
          pf_cmina_show (net);
+         printf ("\n");
+         pf_dcp_show (net);
       }
       if (level & 0x4000)
       {
@@ -487,6 +561,57 @@ void pnet_sm_released_cnf (pnet_t * net, uint32_t arep)
    }
 }
 
+int pnet_read_record_rsp (
+   pnet_t * net,
+   uint32_t arep,
+   const uint8_t * p_read_data,
+   uint16_t read_length,
+   const pnet_result_t * p_result)
+{
+   int ret = -1;
+   pf_ar_t * p_ar = NULL;
+
+   LOG_DEBUG (
+      PNET_LOG,
+      "API(%d): Application responds to read for AREP %" PRIu32 "\n",
+      __LINE__,
+      arep);
+
+   if (pf_ar_find_by_arep (net, arep, &p_ar) == 0)
+   {
+      ret = pf_cmrpc_rm_read_rsp (
+         net,
+         p_ar,
+         p_read_data,
+         read_length,
+         p_result);
+   }
+
+   return ret;
+}
+
+int pnet_write_record_rsp (
+   pnet_t * net,
+   uint32_t arep,
+   const pnet_result_t * p_result)
+{
+   int ret = -1;
+   pf_ar_t * p_ar = NULL;
+
+   LOG_DEBUG (
+      PNET_LOG,
+      "API(%d): Application responds to write for AREP %" PRIu32 "\n",
+      __LINE__,
+      arep);
+
+   if (pf_ar_find_by_arep (net, arep, &p_ar) == 0)
+   {
+      ret = pf_cmrpc_rm_write_rsp (net, p_ar, p_result);
+   }
+
+   return ret;
+}
+
 int pnet_ar_abort (pnet_t * net, uint32_t arep)
 {
    int ret = -1;
@@ -560,6 +685,34 @@ int pnet_get_ar_error_codes (
    return ret;
 }
 
+int pnet_get_alarm_statistics (
+   pnet_t * net,
+   uint32_t arep,
+   pnet_alarm_statistics_t * p_statistics)
+{
+   int ret = -1;
+   pf_ar_t * p_ar = NULL;
+
+   if (pf_ar_find_by_arep (net, arep, &p_ar) == 0)
+   {
+      p_statistics->low_prio = p_ar->apmx[0].counters;
+      p_statistics->high_prio = p_ar->apmx[1].counters;
+
+      ret = 0;
+   }
+
+   return ret;
+}
+
+int pnet_get_dcp_statistics (
+   pnet_t * net,
+   pnet_dcp_statistics_t * p_statistics)
+{
+   *p_statistics = net->dcp_statistics;
+
+   return 0;
+}
+
 int pnet_alarm_send_process_alarm (
    pnet_t * net,
    uint32_t arep,
@@ -679,6 +832,16 @@ int pnet_diag_remove (
       usi);
 }
 
+int pnet_diag_begin (pnet_t * net)
+{
+   return pf_diag_begin (net);
+}
+
+int pnet_diag_commit (pnet_t * net)
+{
+   return pf_diag_commit (net);
+}
+
 /************************** Diagnosis in standard format *******************/
 
 int pnet_diag_std_add (
@@ -65,6 +65,7 @@ extern "C" {
 #include "pf_cmwrr.h"
 #include "pf_diag.h"
 #include "pf_fspm.h"
+#include "pf_fsu.h"
 #include "pf_pdport.h"
 #include "pf_port.h"
 #include "pf_plugsm.h"
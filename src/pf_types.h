@@ -21,6 +21,15 @@
 #ifndef PF_TYPES_H
 #define PF_TYPES_H
 
+#if PNET_USE_ATOMICS && defined(__cplusplus)
+/* For the unit tests. stdatomic.h is not available in C++ before C++23, but
+ * the std::atomic types have the same size and representation. */
+#include <atomic>
+typedef std::atomic<int> atomic_int;
+typedef std::atomic<unsigned int> atomic_uint;
+typedef std::atomic<uint_least16_t> atomic_uint_least16_t;
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,7 +38,9 @@ extern "C" {
 #include "pf_snmp.h"
 
 #if PNET_USE_ATOMICS
+#ifndef __cplusplus
 #include <stdatomic.h>
+#endif
 #else
 #define atomic_int uint32_t
 #ifdef ATOMIC_VAR_INIT
@@ -65,6 +76,9 @@ static inline uint32_t atomic_fetch_sub (atomic_int * p, uint32_t v)
 
 #define PF_ALARM_NUMBER_OF_PRIORITY_LEVELS 2 /* High and low */
 
+/* Round up a size in the memory pools, to keep the parts aligned */
+#define PF_POOL_ALIGN(size) (((size) + 7u) & ~(size_t)7u)
+
 #define PF_FRAME_BUFFER_SIZE 1500
 
 /** This should be smaller than PF_FRAME_BUFFER_SIZE with the maximum size of
@@ -86,6 +100,9 @@ static inline uint32_t atomic_fetch_sub (atomic_int * p, uint32_t v)
  */
 #define PF_CHECK_PEERS_PER_PORT 1
 
+/** Number of source MAC addresses tracked by the DCP rate limiter */
+#define PF_DCP_MAX_SOURCES 8
+
 /** Including termination */
 #define PF_ALIAS_NAME_MAX_SIZE                                                 \
    (PNET_STATION_NAME_MAX_SIZE + PNET_PORT_NAME_MAX_SIZE)
@@ -570,6 +587,10 @@ typedef enum pf_block_type_values
 
    PF_BT_MULTIPLEBLOCK_HEADER = 0x0400,
 
+   PF_BT_FS_HELLO = 0x0600,
+   PF_BT_FS_PARAMETER = 0x0601,
+   PF_BT_FAST_STARTUP = 0x0602,
+
    PF_BT_MAINTENANCE_ITEM = 0x0f00,
 
    /* Output from a PROFINET device */
@@ -979,6 +1000,30 @@ typedef struct pf_diag_item
    uint16_t next; /* Next in list (array index) */
 } pf_diag_item_t;
 
+/* How a diag item has been changed in an ongoing diagnosis batch */
+typedef enum pf_diag_batch_state
+{
+   PF_DIAG_BATCH_NONE = 0, /* Not changed */
+   PF_DIAG_BATCH_CHANGED,  /* Existed before the batch, and is changed */
+   PF_DIAG_BATCH_ADDED     /* Added in the batch */
+} pf_diag_batch_state_t;
+
+/*
+ * Bookkeeping for a diag item, stored in a separate array with the same
+ * index. Not in pf_diag_item_t, as that is also used in alarm payloads.
+ */
+typedef struct pf_diag_item_link
+{
+   uint16_t prev;       /* Previous in subslot list (array index) */
+   uint16_t index_next; /* Next in diagnosis index bucket (array index) */
+   pf_diag_batch_state_t batch_state;
+
+   /* Location of the diagnosis. Part of the key in the diagnosis index. */
+   uint32_t api_id;
+   uint16_t slot_nbr;
+   uint16_t subslot_nbr;
+} pf_diag_item_link_t;
+
 /* Incoming alarm frames */
 typedef struct pf_apmr_msg
 {
@@ -986,15 +1031,20 @@ typedef struct pf_apmr_msg
    pnal_buf_t * p_buf;
 } pf_apmr_msg_t;
 
+/* Max number of diagnosis items in standard format in one alarm. An encoded
+ * item takes at least 6 bytes of the alarm payload. */
+#define PF_ALARM_MAX_DIAG_ITEMS (PNET_MAX_ALARM_PAYLOAD_DATA_SIZE / 6)
+
 typedef struct pf_alarm_payload
 {
    uint16_t usi;
 
-   /* Number of bytes of manufacturer data */
+   /* Number of bytes in data */
    uint16_t len;
 
-   /* pf_diag_item_t or manufacturer data */
-   uint8_t data[PNET_MAX_ALARM_PAYLOAD_DATA_SIZE];
+   /* Manufacturer data (max PNET_MAX_ALARM_PAYLOAD_DATA_SIZE bytes), or
+    * an array of pf_diag_std_t for diagnosis in standard format */
+   uint8_t data[PF_ALARM_MAX_DIAG_ITEMS * sizeof (pf_diag_std_t)];
 } pf_alarm_payload_t;
 
 /* See also pnet_alarm_argument_t for a subset */
@@ -1009,6 +1059,7 @@ typedef struct pf_alarm_data
 
    pnet_alarm_spec_t alarm_specifier; /* Booleans for diagnosis alarms. */
    uint16_t sequence_number;
+   uint32_t queued_time_us; /* When put in the send queue */
 
    /*
     * pf_alarm_data_t may be followed by alarm_payload:
@@ -1017,11 +1068,25 @@ typedef struct pf_alarm_data
    pf_alarm_payload_t payload;
 } pf_alarm_data_t;
 
+/**
+ * Alarm queue indexes, for a single consumer.
+ *
+ * The indexes run from 0 to 2 * max_items - 1, so a full queue can be
+ * told apart from an empty queue without a shared counter. Only producers
+ * write write_index, and they are serialised by the queue mutex. Only the
+ * consumer writes read_index. When PNET_USE_ATOMICS is enabled the indexes
+ * are atomic and the consumer of the receive queue does not take the mutex.
+ */
+#if PNET_USE_ATOMICS
+typedef atomic_uint_least16_t pf_queue_index_t;
+#else
+typedef uint16_t pf_queue_index_t;
+#endif
+
 typedef struct pf_queue_accountant
 {
-   uint16_t write_index;
-   uint16_t read_index;
-   uint16_t count;
+   pf_queue_index_t write_index;
+   pf_queue_index_t read_index;
    uint16_t max_items;
    os_mutex_t * mutex;
 } pf_queue_accountant_t;
@@ -1029,13 +1094,13 @@ typedef struct pf_queue_accountant
 typedef struct pf_alarm_send_queue
 {
    pf_queue_accountant_t accountant;
-   pf_alarm_data_t items[PNET_MAX_ALARMS];
+   pf_alarm_data_t * items; /* max_items alarms, in the alarm pool */
 } pf_alarm_send_queue_t;
 
 typedef struct pf_alarm_receive_queue
 {
    pf_queue_accountant_t accountant;
-   pf_apmr_msg_t items[PNET_MAX_ALARMS];
+   pf_apmr_msg_t * items; /* max_items frames, in the alarm pool */
 } pf_alarm_receive_queue_t;
 
 #define PF_MAX_SESSION (2 * (PNET_MAX_AR) + 1) /* 2 per AR, and one spare. */
@@ -1089,6 +1154,28 @@ typedef enum pf_cmwrr_state_values
    PF_CMWRR_STATE_DATA,
 } pf_cmwrr_state_values_t;
 
+/**
+ * State of an IODRead or IODWrite request for which the application has
+ * deferred the response, see \a pnet_read_record_rsp() and
+ * \a pnet_write_record_rsp().
+ */
+typedef enum pf_record_rsp_state_values
+{
+   PF_RECORD_RSP_STATE_IDLE,
+   PF_RECORD_RSP_STATE_PENDING, /* Waiting for the application */
+   PF_RECORD_RSP_STATE_READY    /* Response given, not yet sent */
+} pf_record_rsp_state_values_t;
+
+typedef struct pf_record_rsp
+{
+   pf_record_rsp_state_values_t state;
+   bool is_read;
+   uint16_t index;
+   const uint8_t * p_read_data; /* Only valid in state READY */
+   uint16_t read_length;
+   pnet_result_t result;
+} pf_record_rsp_t;
+
 /**
  * The prototype of the externally supplied call-back functions.
  * @param net              InOut: The p-net stack instance
@@ -1125,6 +1212,13 @@ typedef struct pf_scheduler_handle
    uint32_t timer_index; /* private */
 } pf_scheduler_handle_t;
 
+/** Token bucket for rate limits, see pf_scheduler_token_take() */
+typedef struct pf_token_bucket
+{
+   uint16_t tokens;
+   uint32_t time; /* Time of last refill, in microseconds */
+} pf_token_bucket_t;
+
 /**
  * This is the prototype for the Profinet frame handler.
  *
@@ -1649,6 +1743,7 @@ typedef struct pf_rs_info
 typedef struct pf_ar_fsu
 {
    bool valid;
+   bool parameters_match; /** Same as stored from the previous startup */
    struct
    {
       uint32_t fs_parameter_mode; /** Range 0..1 (ON, OFF) */
@@ -1661,6 +1756,43 @@ typedef struct pf_ar_fsu
 #endif
 } pf_ar_fsu_t;
 
+/** Max number of submodules stored for Fast Startup */
+#define PF_FSU_MAX_SUBMODULES                                                  \
+   (PNET_MAX_API * PNET_MAX_SLOTS * PNET_MAX_SUBSLOTS)
+
+/** Expected submodule, as stored for Fast Startup */
+typedef struct pf_fsu_submodule
+{
+   uint32_t api;
+   uint16_t slot_number;
+   uint16_t subslot_number;
+   uint32_t module_ident;
+   uint32_t submodule_ident;
+   pnet_data_cfg_t data_cfg;
+} pf_fsu_submodule_t;
+
+/** Startup parameters stored in nvm for Fast Startup */
+typedef struct pf_fsu_nvm
+{
+   pf_uuid_t fs_parameter_uuid;
+   uint16_t nbr_submodules;
+   pf_fsu_submodule_t submodule[PF_FSU_MAX_SUBMODULES];
+} pf_fsu_nvm_t;
+
+typedef struct pf_fsu
+{
+   /* Protects stored, which is saved to file by the background worker */
+   os_mutex_t * mutex;
+   bool stored_valid;
+   pf_fsu_nvm_t stored;
+
+   bool config_plugged;       /* Stored configuration has been plugged */
+   uint32_t power_on_time_us; /* Time of stack initialisation */
+   bool first_data_done;
+   uint32_t first_data_delay_us; /* From power-on to first cyclic data */
+   uint32_t nbr_matching_connects;
+} pf_fsu_t;
+
 typedef struct pf_ar_server
 {
    uint16_t length_cm_responder_station_name;
@@ -1928,6 +2060,9 @@ typedef enum pf_apmr_state_values
    PF_APMR_STATE_WCNF
 } pf_apmr_state_values_t;
 
+/* Alarm frame Ethernet header: DA, SA, VLAN tag, EtherType and frame ID */
+#define PF_ALARM_HEADER_SIZE 20
+
 /*
  * This type contains all the information needed for one
  * APMS/APMR pair.
@@ -1957,6 +2092,10 @@ typedef struct pf_apmx
    /* Latest sent alarm frame, for possible retransmission */
    pnal_buf_t * p_rta;
 
+   /* Prebuilt Ethernet header of all alarm frames, including VLAN tag and
+    * frame ID. Created when the APMX is activated. */
+   uint8_t header[PF_ALARM_HEADER_SIZE];
+
    bool high_priority; /* True for high priority APMX. For printouts. */
    uint16_t vlan_prio; /* 5 or 6 */
    uint16_t block_type_alarm_notify;
@@ -1968,6 +2107,10 @@ typedef struct pf_apmx
    pf_scheduler_handle_t resend_timeout; /* Scheduler handle for Alarm
                                             retransmission */
    uint32_t resend_counter;
+
+   uint32_t notify_sent_time_us; /* When the latest alarm was sent */
+   bool notify_wait_tack; /* Waiting for TACK for the latest alarm sent */
+   pnet_alarm_prio_statistics_t counters;
 } pf_apmx_t;
 
 typedef enum pf_alpmr_state_values
@@ -2069,6 +2212,12 @@ typedef struct pf_session_info
    uint16_t out_buf_send_len; /* Size of current packet to send */
    uint16_t out_fragment_nbr;
 
+   /* Fragmented responses. out_fragment_nbr is the next fragment to send */
+   pf_rpc_header_t out_rpc_header;
+   uint16_t out_fragment_count;
+   uint16_t out_fragment_acked;  /* Number of fragments acknowledged */
+   uint16_t out_fragment_window; /* Max number of fragments in flight */
+
    pf_get_info_t get_info;
    bool is_big_endian; /* From rpc_header_t in first fragment */
    pnet_result_t rpc_result;
@@ -2081,6 +2230,14 @@ typedef struct pf_session_info
    /* This timer is used to handle ccontrol and fragment re-transmissions */
    pf_scheduler_handle_t resend_timeout;
    uint32_t resend_counter;
+
+   /* The session is parked while the application prepares the response to
+    * an IODRead or IODWrite request. The request is kept in in_buffer. */
+   bool record_rsp_pending;
+   uint32_t record_arep;
+   pf_rpc_header_t record_rpc_req;
+   uint16_t record_req_pos; /* Start of RPC body in in_buffer */
+   uint16_t record_req_len;
 } pf_session_info_t;
 
 #define PF_AR_PLUG_MAX_QUEUE (PNET_MAX_API * PNET_MAX_SLOTS * PNET_MAX_SUBSLOTS)
@@ -2143,6 +2300,13 @@ typedef struct pf_ar
     * (1) prio. */
    pf_alarm_send_queue_t alarm_send_q[PF_ALARM_NUMBER_OF_PRIORITY_LEVELS];
 
+   /* Token bucket for the diagnosis alarm rate limit */
+   pf_token_bucket_t diag_alarm_bucket;
+
+   /* Number of periodic calls where a low prio alarm was ready to be sent but
+    * the send budget was used by high prio alarms */
+   uint16_t alarm_low_prio_skips;
+
    uint16_t nbr_ar_rpc;
    pf_ar_rpc_request_t ar_rpc_request; /* From connect.req */
    pf_ar_rpc_result_t ar_rpc_result;   /* From connect.ind */
@@ -2173,6 +2337,7 @@ typedef struct pf_ar
    uint8_t err_code; /* Error code 2 */
 
    pf_cmwrr_state_values_t cmwrr_state;
+   pf_record_rsp_t record_rsp;
 
    pf_cmsu_state_values_t cmsu_state;
 
@@ -2274,6 +2439,19 @@ typedef enum pf_diag_filter_level
    PF_DIAG_FILTER_M_DEM      /* Manufacturer specific or maintenance demanded */
 } pf_diag_filter_level_t;
 
+/*
+ * Number of diagnosis items by severity. Updated as items are linked into
+ * or unlinked from the subslot diag lists, so the summaries do not need to
+ * look at the items themselves.
+ */
+typedef struct pf_diag_counters
+{
+   uint16_t fault;                /* Manufacturer specific or severity fault */
+   uint16_t maintenance_required; /* Also qualified, with required qualifier */
+   uint16_t maintenance_demanded; /* Also qualified, with demanded qualifier */
+   uint16_t qualified;            /* Qualified, with fault qualifier */
+} pf_diag_counters_t;
+
 /* Real submodule diagnosis summary. */
 typedef struct pf_submod_diag_summary
 {
@@ -2307,6 +2485,25 @@ typedef struct pf_subslot
     * Each subslot has its own list of diagnosis items.
     */
    uint16_t diag_list;
+   pf_diag_counters_t diag_counters; /* Of the items in diag_list */
+
+   /* Diagnosis changed in the ongoing diagnosis batch */
+   bool diag_batch_changed;
+   /* List of items removed in the batch, not yet reported via alarms */
+   uint16_t diag_batch_removed;
+
+#if PNET_MAX_DIAG_CACHE_SIZE > 0
+   /*
+    * Encoded DiagnosisData blocks of diag_list, as sent for diagnosis reads
+    * of all diagnosis items. Regenerated on the next read after a change.
+    * Lists that do not fit are encoded at each read instead, see
+    * "Diagnosis implementation details" in doc/implementation_details.rst.
+    */
+   uint8_t diag_cache[PNET_MAX_DIAG_CACHE_SIZE];
+   uint16_t diag_cache_len;
+   bool diag_cache_valid;
+   bool diag_cache_fits; /* false: too large, encode directly instead */
+#endif
 } pf_subslot_t;
 
 /* Real identification, slot level. */
@@ -2342,15 +2539,30 @@ typedef struct pf_device
    pf_real_ident_t real_ident;
 
    /*
-    * This is the pool of diag items.
-    * It is used instead of dynamic memory to avoid fragmentation.
+    * This is the pool of diag items, with max_diag_items entries.
+    * It is allocated once at init, to avoid fragmentation.
     *
     * Each subslot uses its own list of diag items, and stores the index to
     * the head of its list.
     */
    os_mutex_t * diag_mutex; /* Protect the diag items */
-   pf_diag_item_t diag_items[PNET_MAX_DIAG_ITEMS];
+   pf_diag_item_t * diag_items;
+   pf_diag_item_link_t * diag_links;
+   uint16_t max_diag_items;
    uint16_t diag_items_free; /* Head of the unused list */
+
+   /*
+    * Hash index of the diag items in use, for lookup by location, channel
+    * and error types (or USI). Heads of the bucket lists. There are
+    * max_diag_items buckets.
+    */
+   uint16_t * diag_index;
+
+   /* Sum of the diag counters of all subslots */
+   pf_diag_counters_t diag_counters;
+
+   /* Between pf_diag_begin() and pf_diag_commit() */
+   bool diag_batch;
 } pf_device_t;
 
 /*
@@ -2879,8 +3091,60 @@ typedef struct pf_lldp_port
     * Protected by LLDP mutex.
     */
    bool is_peer_info_received;
+
+#if PNET_USE_ATOMICS
+   /* Sequence counter for lock-free reading of the peer information, see
+    * pf_lldp_get_peer_snapshot(). Odd while the information is updated.
+    */
+   atomic_uint peer_info_seq;
+#endif
+
+   /* Alias name (for me) generated from the peer information, with its
+    * length and hash. Used to quickly reject DCP identify alias filters.
+    * Length is zero if no valid alias is available.
+    * Terminated string. Protected by LLDP mutex.
+    */
+   char alias_name[PF_ALIAS_NAME_MAX_SIZE];
+   uint16_t alias_name_len;
+   uint32_t alias_name_hash;
+
+   /* Prebuilt LLDP frame, copied into a new buffer for each send. Rebuilt
+    * when the station name, IP address, LLDP mode or link status has changed
+    * since it was built.
+    */
+   uint8_t tx_frame[PF_FRAME_BUFFER_SIZE];
+   uint16_t tx_frame_len;
+   bool is_tx_frame_valid;
+   uint32_t tx_frame_generation; /* Value of lldp_tx_generation when built */
+   pf_lldp_link_status_t tx_frame_link_status; /* Link status when built */
+
+   /* Hash of the TLVs (except the TTL value) and length of the last received
+    * LLDP frame that was parsed. Frames with the same content are not
+    * parsed again. Cleared when the peer information is invalidated.
+    */
+   bool is_rx_frame_hash_valid;
+   uint32_t rx_frame_hash;
+   uint16_t rx_frame_len;
 } pf_lldp_port_t;
 
+/** DCP services with their own rate limit */
+typedef enum pf_dcp_rate_service
+{
+   PF_DCP_RATE_IDENTIFY = 0,
+   PF_DCP_RATE_GET,
+   PF_DCP_RATE_SET,
+   PF_DCP_RATE_NUMBER_OF_SERVICES
+} pf_dcp_rate_service_t;
+
+/** Rate limiter state for a source MAC address of DCP requests */
+typedef struct pf_dcp_source
+{
+   bool in_use;
+   pnet_ethaddr_t mac_address;
+   uint32_t last_time; /* Time of last request, in microseconds */
+   pf_token_bucket_t bucket;
+} pf_dcp_source_t;
+
 /** Network interface */
 typedef struct pf_netif
 {
@@ -2945,6 +3209,22 @@ struct pnet
    pf_scheduler_handle_t dcp_sam_timeout;
    pf_scheduler_handle_t dcp_identresp_timeout;
 
+   /** Encoded blocks of the DCP IDENTIFY response, at their position in the
+    *  response frame. Rebuilt at the first IDENTIFY after a change. */
+   uint8_t dcp_identify_rsp[PF_FRAME_BUFFER_SIZE];
+   uint16_t dcp_identify_rsp_len; /* End position of the blocks */
+   uint16_t dcp_station_name_len; /* Refreshed with the blocks */
+   bool dcp_identify_rsp_valid;
+   uint32_t dcp_identify_rsp_generation; /* Value of dcp_identify_generation
+                                            when built */
+   uint32_t dcp_identify_generation;     /* Incremented on each change */
+
+   /** Rate limiting of incoming DCP requests, see dcp_rate_limit and
+    *  dcp_source_rate_limit in pnet_cfg_t. */
+   pf_token_bucket_t dcp_service_bucket[PF_DCP_RATE_NUMBER_OF_SERVICES];
+   pf_dcp_source_t dcp_sources[PF_DCP_MAX_SOURCES];
+   pnet_dcp_statistics_t dcp_statistics;
+
    /********** Profinet frame ID mapping **********/
 
    pf_eth_frame_id_map_t eth_id_map[PF_ETH_MAX_MAP];
@@ -2961,6 +3241,9 @@ struct pnet
    /** APIs and diag items */
    pf_device_t cmdev_device;
 
+   /** Memory for the diag items, sized at init. See pf_cmdev_pool_size() */
+   uint8_t * cmdev_pool;
+
    /********** CMINA **********/
 
    /** Reflects what is/should be stored in NVM */
@@ -3005,6 +3288,10 @@ struct pnet
       pf_ar_t * ar;
    } alarm_endpoint[PNET_MAX_AR];
 
+   /** Memory for the alarm queues of all ARs, sized at init.
+    *  See pf_alarm_pool_size() */
+   uint8_t * alarm_pool;
+
    /********** FSPM **********/
 
    /** Default configuration from user. Used at factory reset */
@@ -3034,6 +3321,14 @@ struct pnet
     */
    os_mutex_t * lldp_mutex;
 
+   /** Incremented when data in the sent LLDP frames is changed.
+    *  See pf_lldp_invalidate_tx_frames() */
+   uint32_t lldp_tx_generation;
+
+   /** Incremented when peer information is stored or invalidated on any
+    *  port. Protected by lldp_mutex. See pf_lldp_get_generation() */
+   uint32_t lldp_peer_generation;
+
    /* Interface data
     *
     * Interface and ports runtime data.
@@ -3072,12 +3367,20 @@ struct pnet
 #if PNET_OPTION_SNMP
    pf_snmp_data_t snmp_data;
 #endif
+
+#if PNET_OPTION_FAST_STARTUP
+   pf_fsu_t fsu;
+#endif
 };
 
 /**
  * @internal
  * Initialise a pnet_t structure into already allocated memory.
  *
+ * The memory is cleared, and the pools sized by the configuration are
+ * allocated. Pools from an earlier call are not freed; use
+ * pnet_free_pools() before initialising the same memory again.
+ *
  * @param net              InOut: The p-net stack instance to be initialised.
  * @param p_cfg            In:    Profinet configuration. These values are used
  *                                at first startup and at factory reset.
@@ -3086,6 +3389,14 @@ struct pnet
  */
 int pnet_init_only (pnet_t * net, const pnet_cfg_t * p_cfg);
 
+/**
+ * @internal
+ * Free the pools allocated by pnet_init_only().
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+void pnet_free_pools (pnet_t * net);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,6 +26,8 @@
 #include <ifaddrs.h>
 #include <linux/ethtool.h>
 #include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #include <linux/sockios.h>
 #include <net/if.h>
 #include <pthread.h>
@@ -224,6 +226,93 @@ uint8_t pnal_buf_header (pnal_buf_t * p, int16_t header_size_increment)
 
 /************************** Networking ***************************************/
 
+/* Number of interfaces with cached link status */
+#define PNAL_LINK_CACHE_SIZE PNET_MAX_PHYSICAL_PORTS
+
+/* Re-read the link status at least this often, even without any link
+   change notification. Microseconds. */
+#define PNAL_LINK_CACHE_MAX_AGE (10 * 1000 * 1000)
+
+/* Size of buffer for receiving netlink messages */
+#define PNAL_NETLINK_BUFFER_SIZE 8192
+
+typedef struct pnal_link_cache_entry
+{
+   char interface_name[IFNAMSIZ]; /* Empty if entry is not used */
+   int ifindex;
+   bool is_valid;
+   uint32_t timestamp; /* When status was read. Microseconds */
+   pnal_eth_status_t status;
+} pnal_link_cache_entry_t;
+
+/**
+ * Cached link status for Ethernet interfaces.
+ *
+ * The cached status is invalidated by link change notifications from the
+ * kernel (RTNLGRP_LINK), so the link settings are read via ioctl() only
+ * when something has changed.
+ *
+ * This is a cache only. The notifications are handled when the stack polls
+ * pnal_eth_get_status(), every PF_LINK_MONITOR_INTERVAL, so a link change
+ * is still detected at the next poll and not when the notification arrives.
+ */
+typedef struct pnal_link_cache
+{
+   pthread_mutex_t mutex;
+   bool is_initialized;
+   int netlink_socket; /* -1 if not available */
+   pnal_link_cache_entry_t entries[PNAL_LINK_CACHE_SIZE];
+} pnal_link_cache_t;
+
+static pnal_link_cache_t pnal_link_cache = {
+   .mutex = PTHREAD_MUTEX_INITIALIZER,
+   .is_initialized = false,
+   .netlink_socket = -1,
+};
+
+/* Number of interfaces with cached statistics. The management interface
+   and the physical ports. */
+#define PNAL_STATS_CACHE_SIZE (PNET_MAX_PHYSICAL_PORTS + 1)
+
+/* Max age of cached statistics. Microseconds */
+#define PNAL_STATS_CACHE_MAX_AGE (100 * 1000)
+
+/* Timeout for netlink statistics queries. Microseconds */
+#define PNAL_STATS_QUERY_TIMEOUT (100 * 1000)
+
+typedef struct pnal_stats_cache_entry
+{
+   char interface_name[IFNAMSIZ]; /* Empty if entry is not used */
+   int ifindex;                   /* 0 if not yet known */
+   bool is_valid;
+   uint32_t timestamp; /* When statistics were read. Microseconds */
+   pnal_port_stats_t stats;
+} pnal_stats_cache_entry_t;
+
+/**
+ * Cached statistics for Ethernet interfaces.
+ *
+ * The statistics are queried per interface index with RTM_GETSTATS, over
+ * a netlink socket that is kept open. The counters are the lowest 32 bits
+ * of the kernel counters, as shown by "ip -s link". getifaddrs() is used
+ * only if the query fails, for example for an unknown interface or on a
+ * kernel without RTM_GETSTATS.
+ */
+typedef struct pnal_stats_cache
+{
+   pthread_mutex_t mutex;
+   bool is_initialized;
+   int netlink_socket; /* -1 if not available */
+   uint32_t sequence;
+   pnal_stats_cache_entry_t entries[PNAL_STATS_CACHE_SIZE];
+} pnal_stats_cache_t;
+
+static pnal_stats_cache_t pnal_stats_cache = {
+   .mutex = PTHREAD_MUTEX_INITIALIZER,
+   .is_initialized = false,
+   .netlink_socket = -1,
+};
+
 /** @internal
  * Convert IPv4 address to string
  * @param ip               In:    IP address
@@ -399,18 +488,126 @@ static uint16_t calculate_capabilities (uint32_t advertised)
    return out;
 }
 
-int pnal_eth_get_status (const char * interface_name, pnal_eth_status_t * status)
+/**
+ * Read the link settings of a network interface using ETHTOOL_GLINKSETTINGS.
+ *
+ * @param control_socket   In:    Socket for ioctl() calls
+ * @param ifr              InOut: Request, with the interface name
+ * @param status           Out:   Link settings (autoneg etc)
+ * @return  0 if the operation succeeded.
+ *         -1 if an error occurred, or if not supported by the kernel.
+ */
+static int pnal_eth_read_link_settings (
+   int control_socket,
+   struct ifreq * ifr,
+   pnal_eth_status_t * status)
 {
-   /* TODO: Possibly use the new ETHTOOL_GLINKSETTINGS instead of ETHTOOL_GSET
-      See:
-   https://stackoverflow.com/questions/41822920/how-to-get-ethtool-settings */
+#ifdef ETHTOOL_GLINKSETTINGS
+   struct
+   {
+      struct ethtool_link_settings settings;
+      uint32_t link_mode_masks[3 * SCHAR_MAX];
+   } ecmd;
+   uint32_t advertising;
+   int8_t nwords;
+
+   /* Handshake: the kernel returns the number of words in each bitmap as a
+      negative value */
+   memset (&ecmd, 0, sizeof (ecmd));
+   ecmd.settings.cmd = ETHTOOL_GLINKSETTINGS;
+   ifr->ifr_data = (char *)&ecmd;
+   if (
+      ioctl (control_socket, SIOCETHTOOL, ifr) < 0 ||
+      ecmd.settings.link_mode_masks_nwords >= 0)
+   {
+      return -1;
+   }
+   nwords = -ecmd.settings.link_mode_masks_nwords;
+
+   memset (&ecmd, 0, sizeof (ecmd));
+   ecmd.settings.cmd = ETHTOOL_GLINKSETTINGS;
+   ecmd.settings.link_mode_masks_nwords = nwords;
+   if (
+      ioctl (control_socket, SIOCETHTOOL, ifr) < 0 ||
+      ecmd.settings.link_mode_masks_nwords != nwords)
+   {
+      return -1;
+   }
 
+   /* The bitmaps are supported, advertising and lp_advertising.
+      The lowest bits are the same as for the legacy ADVERTISED_xxx flags. */
+   advertising = ecmd.link_mode_masks[nwords];
+
+   status->is_autonegotiation_enabled =
+      (ecmd.settings.autoneg == AUTONEG_ENABLE);
+   status->is_autonegotiation_supported = advertising & ADVERTISED_Autoneg;
+   status->operational_mau_type = calculate_mau_type (
+      ecmd.settings.port,
+      ecmd.settings.speed,
+      ecmd.settings.duplex);
+   status->autonegotiation_advertised_capabilities =
+      calculate_capabilities (advertising);
+
+   return 0;
+#else
+   return -1;
+#endif
+}
+
+/**
+ * Read the link settings of a network interface using the legacy
+ * ETHTOOL_GSET command.
+ *
+ * @param control_socket   In:    Socket for ioctl() calls
+ * @param ifr              InOut: Request, with the interface name
+ * @param status           Out:   Link settings (autoneg etc)
+ * @return  0 if the operation succeeded.
+ *         -1 if an error occurred.
+ */
+static int pnal_eth_read_legacy_settings (
+   int control_socket,
+   struct ifreq * ifr,
+   pnal_eth_status_t * status)
+{
+   struct ethtool_cmd eth_status_linux;
+
+   memset (&eth_status_linux, 0, sizeof (eth_status_linux));
+   eth_status_linux.cmd = ETHTOOL_GSET;
+   ifr->ifr_data = (char *)&eth_status_linux;
+   if (ioctl (control_socket, SIOCETHTOOL, ifr) < 0)
+   {
+      return -1;
+   }
+
+   status->is_autonegotiation_enabled =
+      (eth_status_linux.autoneg == AUTONEG_ENABLE);
+   status->is_autonegotiation_supported = eth_status_linux.advertising &
+                                          ADVERTISED_Autoneg;
+   status->operational_mau_type = calculate_mau_type (
+      eth_status_linux.port,
+      ethtool_cmd_speed (&eth_status_linux),
+      eth_status_linux.duplex);
+   status->autonegotiation_advertised_capabilities =
+      calculate_capabilities (eth_status_linux.advertising);
+
+   return 0;
+}
+
+/**
+ * Read the status of an Ethernet link from the kernel.
+ *
+ * @param interface_name   In:    Ethernet interface name, for example eth0
+ * @param status           Out:   Link status (autoneg etc)
+ * @return  0 if the operation succeeded.
+ *         -1 if an error occurred.
+ */
+static int pnal_eth_read_status (
+   const char * interface_name,
+   pnal_eth_status_t * status)
+{
    int ret = -1;
    int control_socket;
    struct ifreq ifr;
-   struct ethtool_cmd eth_status_linux;
-   uint32_t speed = 0;          /* Mbit/s */
-   uint8_t port_type = PORT_TP; /* Linux PORT_xxx */
 
    control_socket = socket (PF_INET, SOCK_DGRAM, IPPROTO_IP);
    if (control_socket < 0)
@@ -418,23 +615,13 @@ int pnal_eth_get_status (const char * interface_name, pnal_eth_status_t * status
       return ret;
    }
 
+   memset (&ifr, 0, sizeof (ifr));
    snprintf (ifr.ifr_name, sizeof (ifr.ifr_name), "%s", interface_name);
-   ifr.ifr_data = (char *)&eth_status_linux;
-   eth_status_linux.cmd = ETHTOOL_GSET;
 
-   if (ioctl (control_socket, SIOCETHTOOL, &ifr) >= 0)
+   if (
+      pnal_eth_read_link_settings (control_socket, &ifr, status) == 0 ||
+      pnal_eth_read_legacy_settings (control_socket, &ifr, status) == 0)
    {
-      speed = ethtool_cmd_speed (&eth_status_linux);
-      port_type = eth_status_linux.port;
-      status->is_autonegotiation_enabled =
-         (eth_status_linux.autoneg == AUTONEG_ENABLE);
-      status->is_autonegotiation_supported = eth_status_linux.advertising &
-                                             ADVERTISED_Autoneg;
-      status->operational_mau_type =
-         calculate_mau_type (port_type, speed, eth_status_linux.duplex);
-      status->autonegotiation_advertised_capabilities =
-         calculate_capabilities (eth_status_linux.advertising);
-
       ret = 0;
    }
 
@@ -448,12 +635,218 @@ int pnal_eth_get_status (const char * interface_name, pnal_eth_status_t * status
    return ret;
 }
 
+/**
+ * Open a netlink socket for link change notifications.
+ *
+ * The socket is non-blocking, and is subscribed to the RTNLGRP_LINK group.
+ *
+ * @return  The socket, or -1 if an error occurred.
+ */
+static int pnal_link_cache_open_socket (void)
+{
+   struct sockaddr_nl address;
+   int netlink_socket;
+
+   netlink_socket = socket (
+      AF_NETLINK,
+      SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+      NETLINK_ROUTE);
+   if (netlink_socket < 0)
+   {
+      return -1;
+   }
+
+   memset (&address, 0, sizeof (address));
+   address.nl_family = AF_NETLINK;
+   address.nl_groups = RTMGRP_LINK;
+   if (
+      bind (netlink_socket, (struct sockaddr *)&address, sizeof (address)) !=
+      0)
+   {
+      close (netlink_socket);
+      return -1;
+   }
+
+   return netlink_socket;
+}
+
+/**
+ * Invalidate the cached status of an interface.
+ *
+ * @param ifindex          In:    Interface index, or 0 for all interfaces.
+ */
+static void pnal_link_cache_invalidate (int ifindex)
+{
+   int ix;
+
+   for (ix = 0; ix < PNAL_LINK_CACHE_SIZE; ix++)
+   {
+      if (ifindex == 0 || pnal_link_cache.entries[ix].ifindex == ifindex)
+      {
+         pnal_link_cache.entries[ix].is_valid = false;
+      }
+   }
+}
+
+/**
+ * Invalidate the cached status of all interfaces mentioned in pending
+ * link change notifications.
+ *
+ * Does not block.
+ */
+static void pnal_link_cache_handle_events (void)
+{
+   uint32_t buffer[PNAL_NETLINK_BUFFER_SIZE / sizeof (uint32_t)];
+   struct nlmsghdr * header;
+   struct ifinfomsg * ifinfo;
+   ssize_t len;
+
+   for (;;)
+   {
+      len = recv (pnal_link_cache.netlink_socket, buffer, sizeof (buffer), 0);
+      if (len < 0)
+      {
+         if (errno == ENOBUFS)
+         {
+            /* Notifications were lost */
+            pnal_link_cache_invalidate (0);
+            continue;
+         }
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         return;
+      }
+
+      for (header = (struct nlmsghdr *)buffer; NLMSG_OK (header, len);
+           header = NLMSG_NEXT (header, len))
+      {
+         if (
+            (header->nlmsg_type == RTM_NEWLINK ||
+             header->nlmsg_type == RTM_DELLINK) &&
+            header->nlmsg_len >= NLMSG_LENGTH (sizeof (*ifinfo)))
+         {
+            ifinfo = NLMSG_DATA (header);
+            if (ifinfo->ifi_index != 0)
+            {
+               pnal_link_cache_invalidate (ifinfo->ifi_index);
+            }
+         }
+      }
+   }
+}
+
+/**
+ * Find the cache entry for an interface, or allocate a new one.
+ *
+ * @param interface_name   In:    Ethernet interface name, for example eth0
+ * @return  The cache entry, or NULL if the cache is full.
+ */
+static pnal_link_cache_entry_t * pnal_link_cache_get_entry (
+   const char * interface_name)
+{
+   pnal_link_cache_entry_t * entry;
+   int ix;
+
+   for (ix = 0; ix < PNAL_LINK_CACHE_SIZE; ix++)
+   {
+      entry = &pnal_link_cache.entries[ix];
+      if (strcmp (entry->interface_name, interface_name) == 0)
+      {
+         return entry;
+      }
+   }
+
+   for (ix = 0; ix < PNAL_LINK_CACHE_SIZE; ix++)
+   {
+      entry = &pnal_link_cache.entries[ix];
+      if (entry->interface_name[0] == '\0')
+      {
+         snprintf (
+            entry->interface_name,
+            sizeof (entry->interface_name),
+            "%s",
+            interface_name);
+         entry->is_valid = false;
+         return entry;
+      }
+   }
+
+   return NULL;
+}
+
+int pnal_eth_get_status (const char * interface_name, pnal_eth_status_t * status)
+{
+   pnal_link_cache_entry_t * entry = NULL;
+   uint32_t now = os_get_current_time_us();
+   int ret;
+
+   pthread_mutex_lock (&pnal_link_cache.mutex);
+
+   if (!pnal_link_cache.is_initialized)
+   {
+      pnal_link_cache.netlink_socket = pnal_link_cache_open_socket();
+      pnal_link_cache.is_initialized = true;
+      if (pnal_link_cache.netlink_socket < 0)
+      {
+         LOG_WARNING (
+            PF_PNAL_LOG,
+            "PNAL(%d): Could not subscribe to link changes. Polling link "
+            "status.\n",
+            __LINE__);
+      }
+   }
+
+   /* Handle pending notifications before reading the status, so no change
+      is missed */
+   if (pnal_link_cache.netlink_socket >= 0)
+   {
+      pnal_link_cache_handle_events();
+      entry = pnal_link_cache_get_entry (interface_name);
+   }
+
+   if (
+      entry != NULL && entry->is_valid &&
+      (now - entry->timestamp) < PNAL_LINK_CACHE_MAX_AGE)
+   {
+      *status = entry->status;
+      pthread_mutex_unlock (&pnal_link_cache.mutex);
+      return 0;
+   }
+
+   ret = pnal_eth_read_status (interface_name, status);
+
+   if (entry != NULL)
+   {
+      entry->ifindex = if_nametoindex (interface_name);
+      entry->status = *status;
+      entry->timestamp = now;
+      entry->is_valid = (ret == 0 && entry->ifindex != 0);
+   }
+
+   pthread_mutex_unlock (&pnal_link_cache.mutex);
+
+   return ret;
+}
+
 int pnal_get_interface_index (const char * interface_name)
 {
    return if_nametoindex (interface_name);
 }
 
-int pnal_get_port_statistics (
+/**
+ * Read interface statistics using getifaddrs().
+ *
+ * This walks all interfaces and addresses on the host, and is used only
+ * if the statistics can not be queried via netlink.
+ *
+ * @param interface_name   In:    Ethernet interface name for example eth0
+ * @param port_stats       Out:   Returned statistics
+ * @return  0 if the operation succeeded.
+ *         -1 if an error occurred.
+ */
+static int pnal_read_port_statistics_from_ifaddrs (
    const char * interface_name,
    pnal_port_stats_t * port_stats)
 {
@@ -493,6 +886,262 @@ int pnal_get_port_statistics (
    return ret;
 }
 
+/**
+ * Open a netlink socket for statistics queries.
+ *
+ * @return  The socket, or -1 if an error occurred.
+ */
+static int pnal_stats_cache_open_socket (void)
+{
+   struct timeval timeout;
+   int netlink_socket;
+
+   netlink_socket =
+      socket (AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+   if (netlink_socket < 0)
+   {
+      return -1;
+   }
+
+   timeout.tv_sec = 0;
+   timeout.tv_usec = PNAL_STATS_QUERY_TIMEOUT;
+   if (
+      setsockopt (
+         netlink_socket,
+         SOL_SOCKET,
+         SO_RCVTIMEO,
+         &timeout,
+         sizeof (timeout)) != 0)
+   {
+      close (netlink_socket);
+      return -1;
+   }
+
+   return netlink_socket;
+}
+
+/**
+ * Parse the response to a RTM_GETSTATS query.
+ *
+ * @param header           In:    Netlink message of type RTM_NEWSTATS
+ * @param port_stats       Out:   Returned statistics
+ * @return  0 if the operation succeeded.
+ *         -1 if the response does not contain 64-bit link statistics.
+ */
+static int pnal_stats_parse_response (
+   const struct nlmsghdr * header,
+   pnal_port_stats_t * port_stats)
+{
+#ifdef RTM_GETSTATS
+   struct rtnl_link_stats64 stats64;
+   const struct rtattr * attribute;
+   int len;
+
+   len = (int)header->nlmsg_len - NLMSG_LENGTH (sizeof (struct if_stats_msg));
+   attribute =
+      (const struct rtattr *)((const uint8_t *)NLMSG_DATA (header) +
+                              NLMSG_ALIGN (sizeof (struct if_stats_msg)));
+
+   for (; RTA_OK (attribute, len); attribute = RTA_NEXT (attribute, len))
+   {
+      if (
+         attribute->rta_type == IFLA_STATS_LINK_64 &&
+         RTA_PAYLOAD (attribute) >= sizeof (stats64))
+      {
+         memcpy (&stats64, RTA_DATA (attribute), sizeof (stats64));
+
+         /* The counters in Profinet are 32 bits, and wrap around */
+         port_stats->if_in_octets = (uint32_t)stats64.rx_bytes;
+         port_stats->if_in_errors = (uint32_t)stats64.rx_errors;
+         port_stats->if_in_discards = (uint32_t)stats64.rx_dropped;
+         port_stats->if_out_octets = (uint32_t)stats64.tx_bytes;
+         port_stats->if_out_errors = (uint32_t)stats64.tx_errors;
+         port_stats->if_out_discards = (uint32_t)stats64.tx_dropped;
+
+         return 0;
+      }
+   }
+#endif
+
+   return -1;
+}
+
+/**
+ * Query the statistics of a network interface using RTM_GETSTATS.
+ *
+ * @param ifindex          In:    Interface index
+ * @param port_stats       Out:   Returned statistics
+ * @return  0 if the operation succeeded.
+ *         -1 if an error occurred, or if not supported by the kernel.
+ */
+static int pnal_stats_query (int ifindex, pnal_port_stats_t * port_stats)
+{
+#ifdef RTM_GETSTATS
+   struct
+   {
+      struct nlmsghdr header;
+      struct if_stats_msg ifsm;
+   } request;
+   uint32_t buffer[PNAL_NETLINK_BUFFER_SIZE / sizeof (uint32_t)];
+   struct nlmsghdr * header;
+   uint32_t sequence = ++pnal_stats_cache.sequence;
+   ssize_t len;
+
+   memset (&request, 0, sizeof (request));
+   request.header.nlmsg_len = NLMSG_LENGTH (sizeof (request.ifsm));
+   request.header.nlmsg_type = RTM_GETSTATS;
+   request.header.nlmsg_flags = NLM_F_REQUEST;
+   request.header.nlmsg_seq = sequence;
+   request.ifsm.family = AF_UNSPEC;
+   request.ifsm.ifindex = ifindex;
+   request.ifsm.filter_mask = IFLA_STATS_FILTER_BIT (IFLA_STATS_LINK_64);
+
+   if (
+      send (
+         pnal_stats_cache.netlink_socket,
+         &request,
+         request.header.nlmsg_len,
+         0) < 0)
+   {
+      return -1;
+   }
+
+   for (;;)
+   {
+      len = recv (pnal_stats_cache.netlink_socket, buffer, sizeof (buffer), 0);
+      if (len < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         return -1;
+      }
+
+      for (header = (struct nlmsghdr *)buffer; NLMSG_OK (header, len);
+           header = NLMSG_NEXT (header, len))
+      {
+         /* Skip late responses to earlier queries that timed out */
+         if (header->nlmsg_seq != sequence)
+         {
+            continue;
+         }
+
+         if (header->nlmsg_type == RTM_NEWSTATS)
+         {
+            return pnal_stats_parse_response (header, port_stats);
+         }
+
+         return -1;
+      }
+   }
+#else
+   return -1;
+#endif
+}
+
+/**
+ * Find the cache entry for an interface, or allocate a new one.
+ *
+ * @param interface_name   In:    Ethernet interface name, for example eth0
+ * @return  The cache entry, or NULL if the cache is full.
+ */
+static pnal_stats_cache_entry_t * pnal_stats_cache_get_entry (
+   const char * interface_name)
+{
+   pnal_stats_cache_entry_t * entry;
+   int ix;
+
+   for (ix = 0; ix < PNAL_STATS_CACHE_SIZE; ix++)
+   {
+      entry = &pnal_stats_cache.entries[ix];
+      if (strcmp (entry->interface_name, interface_name) == 0)
+      {
+         return entry;
+      }
+   }
+
+   for (ix = 0; ix < PNAL_STATS_CACHE_SIZE; ix++)
+   {
+      entry = &pnal_stats_cache.entries[ix];
+      if (entry->interface_name[0] == '\0')
+      {
+         snprintf (
+            entry->interface_name,
+            sizeof (entry->interface_name),
+            "%s",
+            interface_name);
+         entry->ifindex = 0;
+         entry->is_valid = false;
+         return entry;
+      }
+   }
+
+   return NULL;
+}
+
+int pnal_get_port_statistics (
+   const char * interface_name,
+   pnal_port_stats_t * port_stats)
+{
+   pnal_stats_cache_entry_t * entry = NULL;
+   uint32_t now = os_get_current_time_us();
+   int ifindex;
+   int ret = -1;
+
+   pthread_mutex_lock (&pnal_stats_cache.mutex);
+
+   if (!pnal_stats_cache.is_initialized)
+   {
+      pnal_stats_cache.netlink_socket = pnal_stats_cache_open_socket();
+      pnal_stats_cache.is_initialized = true;
+   }
+
+   if (pnal_stats_cache.netlink_socket >= 0)
+   {
+      entry = pnal_stats_cache_get_entry (interface_name);
+   }
+
+   if (
+      entry != NULL && entry->is_valid &&
+      (now - entry->timestamp) < PNAL_STATS_CACHE_MAX_AGE)
+   {
+      *port_stats = entry->stats;
+      pthread_mutex_unlock (&pnal_stats_cache.mutex);
+      return 0;
+   }
+
+   if (pnal_stats_cache.netlink_socket >= 0)
+   {
+      ifindex = (entry != NULL && entry->ifindex != 0)
+                   ? entry->ifindex
+                   : (int)if_nametoindex (interface_name);
+      if (ifindex != 0)
+      {
+         ret = pnal_stats_query (ifindex, port_stats);
+      }
+
+      if (entry != NULL)
+      {
+         /* Look up the interface index again after a failure, as the
+            interface might have been re-created */
+         entry->ifindex = (ret == 0) ? ifindex : 0;
+         entry->stats = *port_stats;
+         entry->timestamp = now;
+         entry->is_valid = (ret == 0);
+      }
+   }
+
+   pthread_mutex_unlock (&pnal_stats_cache.mutex);
+
+   if (ret != 0)
+   {
+      ret = pnal_read_port_statistics_from_ifaddrs (interface_name, port_stats);
+   }
+
+   return ret;
+}
+
 int pnal_get_macaddress (const char * interface_name, pnal_ethaddr_t * mac_addr)
 {
    int fd;
@@ -40,11 +40,22 @@ typedef struct pnal_thread_cfg
    size_t stack_size;
 } pnal_thread_cfg_t;
 
+/** Max size of an SNMP community string, including termination */
+#define PNAL_SNMP_COMMUNITY_MAX_SIZE 33
+
 typedef struct pnal_cfg
 {
    pnal_thread_cfg_t snmp_thread;
    pnal_thread_cfg_t eth_recv_thread;
    pnal_thread_cfg_t bg_worker_thread;
+
+   /**
+    * Communities for read-only and read-write access, used by the built-in
+    * SNMP agent (PNET_OPTION_SNMP_BUILTIN). Empty strings select "public"
+    * and "private". Net-SNMP is configured in snmpd.conf instead.
+    */
+   char snmp_read_community[PNAL_SNMP_COMMUNITY_MAX_SIZE];
+   char snmp_write_community[PNAL_SNMP_COMMUNITY_MAX_SIZE];
 } pnal_cfg_t;
 
 #ifdef __cplusplus
@@ -0,0 +1,2301 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2020 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+/**
+ * @file
+ * @brief Built-in SNMPv1/v2c responder
+ *
+ * Alternative to the Net-SNMP AgentX subagent in pnal_snmp.c. Enabled by
+ * the PNET_OPTION_SNMP_BUILTIN build option.
+ *
+ * A thread listens on UDP port 161 and answers Get, GetNext, GetBulk and
+ * Set requests directly, without any external SNMP daemon. The served
+ * objects are the same as for the Net-SNMP subagent (see src/ports/linux/mib):
+ * - MIB-II system group.
+ * - LLDP-MIB (local and remote system data).
+ * - LLDP-EXT-DOT3-MIB (local and remote port tables).
+ * - LLDP-EXT-PNO-MIB (local and remote tables).
+ *
+ * The objects are described by a constant table of columns, sorted in OID
+ * order. A Get uses binary search to find the column, a GetNext starts at
+ * the first column after the requested OID and selects the lowest row
+ * following it. The rows are generated on demand from the pf_snmp_get_xxx()
+ * accessors, so no data is duplicated.
+ *
+ * Access control is done by community string only. The read-only and
+ * read-write communities are given by snmp_read_community and
+ * snmp_write_community in pnal_cfg_t, or by PNAL_SNMP_READ_COMMUNITY and
+ * PNAL_SNMP_WRITE_COMMUNITY if these are empty. Requests using other
+ * communities are dropped.
+ */
+
+#ifdef UNIT_TEST
+#define pnal_get_system_uptime_10ms mock_pnal_get_system_uptime_10ms
+#endif
+
+#include "pf_includes.h"
+#include "pnal_snmp_builtin.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef PNAL_SNMP_READ_COMMUNITY
+#define PNAL_SNMP_READ_COMMUNITY "public"
+#endif
+
+#ifndef PNAL_SNMP_WRITE_COMMUNITY
+#define PNAL_SNMP_WRITE_COMMUNITY "private"
+#endif
+
+#ifndef PNAL_SNMP_UDP_PORT
+#define PNAL_SNMP_UDP_PORT 161
+#endif
+
+/* Delay after a failed receive, doubled for each consecutive failure up to
+ * the max delay. Microseconds */
+#define PNAL_SNMP_RX_ERROR_DELAY_MIN (10 * 1000)
+#define PNAL_SNMP_RX_ERROR_DELAY_MAX (1000 * 1000)
+
+/* Largest message sent or received. Fits an Ethernet frame without
+ * IP fragmentation. */
+#define PNAL_SNMP_MAX_MESSAGE_SIZE 1472
+
+#define PNAL_SNMP_MAX_OID_LEN        64
+#define PNAL_SNMP_MAX_COLUMN_OID_LEN 14
+#define PNAL_SNMP_MAX_INDEX_LEN      (5 + 32)
+#define PNAL_SNMP_MAX_OCTETS         256
+#define PNAL_SNMP_MAX_VARBINDS       64
+#define PNAL_SNMP_MAX_ROWS           PNET_MAX_PHYSICAL_PORTS
+
+#define PNAL_SNMP_VERSION_1  0
+#define PNAL_SNMP_VERSION_2C 1
+
+/* ASN.1 BER tags */
+#define PNAL_SNMP_TAG_INTEGER      0x02
+#define PNAL_SNMP_TAG_OCTET_STRING 0x04
+#define PNAL_SNMP_TAG_NULL         0x05
+#define PNAL_SNMP_TAG_OID          0x06
+#define PNAL_SNMP_TAG_SEQUENCE     0x30
+#define PNAL_SNMP_TAG_UNSIGNED     0x42
+#define PNAL_SNMP_TAG_TIMETICKS    0x43
+
+/* Varbind exceptions (SNMPv2c) */
+#define PNAL_SNMP_TAG_NO_SUCH_OBJECT   0x80
+#define PNAL_SNMP_TAG_NO_SUCH_INSTANCE 0x81
+#define PNAL_SNMP_TAG_END_OF_MIB_VIEW  0x82
+
+/* PDU types */
+#define PNAL_SNMP_PDU_GET      0xA0
+#define PNAL_SNMP_PDU_GETNEXT  0xA1
+#define PNAL_SNMP_PDU_RESPONSE 0xA2
+#define PNAL_SNMP_PDU_SET      0xA3
+#define PNAL_SNMP_PDU_GETBULK  0xA5
+
+/* Error status */
+#define PNAL_SNMP_ERR_NO_ERROR      0
+#define PNAL_SNMP_ERR_TOO_BIG       1
+#define PNAL_SNMP_ERR_NO_SUCH_NAME  2
+#define PNAL_SNMP_ERR_BAD_VALUE     3
+#define PNAL_SNMP_ERR_GEN_ERR       5
+#define PNAL_SNMP_ERR_NO_ACCESS     6
+#define PNAL_SNMP_ERR_WRONG_TYPE    7
+#define PNAL_SNMP_ERR_WRONG_LENGTH  8
+#define PNAL_SNMP_ERR_COMMIT_FAILED 14
+#define PNAL_SNMP_ERR_NOT_WRITABLE  17
+
+/* sysServices: physical, datalink, internet, end-to-end and applications */
+#define PNAL_SNMP_SYS_SERVICES 78
+
+/**
+ * How the instance part of an OID (the table index) is formed.
+ */
+typedef enum pnal_snmp_index
+{
+   /** Scalar object. Instance is 0. */
+   PNAL_SNMP_INDEX_SCALAR,
+
+   /** lldpLocPortNum */
+   PNAL_SNMP_INDEX_LOCAL_PORT,
+
+   /** lldpLocManAddrSubtype, lldpLocManAddr */
+   PNAL_SNMP_INDEX_LOCAL_MAN_ADDR,
+
+   /** lldpRemTimeMark, lldpRemLocalPortNum, lldpRemIndex */
+   PNAL_SNMP_INDEX_REMOTE,
+
+   /** lldpRemTimeMark, lldpRemLocalPortNum, lldpRemIndex,
+       lldpRemManAddrSubtype, lldpRemManAddr */
+   PNAL_SNMP_INDEX_REMOTE_MAN_ADDR,
+
+   PNAL_SNMP_NUMBER_OF_INDEX_TYPES
+} pnal_snmp_index_t;
+
+typedef struct pnal_snmp_value
+{
+   /** ASN.1 tag, or exception */
+   uint8_t type;
+
+   /** INTEGER (as two's complement), Unsigned32 or TimeTicks */
+   uint32_t integer;
+
+   /** OCTET STRING */
+   uint8_t octets[PNAL_SNMP_MAX_OCTETS];
+   size_t len;
+
+   /** OBJECT IDENTIFIER. Number of elements is given by len. */
+   const uint32_t * p_oid;
+} pnal_snmp_value_t;
+
+typedef struct pnal_snmp_varbind
+{
+   uint32_t oid[PNAL_SNMP_MAX_OID_LEN];
+   size_t oid_len;
+
+   /** Encoded value as received in request (TLV), or NULL */
+   const uint8_t * p_raw;
+   size_t raw_len;
+
+   /** Value to put in response, if p_raw is NULL */
+   pnal_snmp_value_t value;
+} pnal_snmp_varbind_t;
+
+typedef struct pnal_snmp_row
+{
+   uint32_t index[PNAL_SNMP_MAX_INDEX_LEN];
+   size_t index_len;
+   int port;
+} pnal_snmp_row_t;
+
+/** Cached rows of all tables with the same type of index */
+typedef struct pnal_snmp_table
+{
+   bool is_valid;
+   const pnet_t * net;
+   uint32_t generation; /* Value of pf_snmp_get_generation() when built */
+   pnal_snmp_row_t rows[PNAL_SNMP_MAX_ROWS]; /* Sorted by index */
+   size_t n_rows;
+} pnal_snmp_table_t;
+
+/**
+ * Read the value of a column for a given row.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param column           In:    Column number (last arc of column OID).
+ * @param port             In:    Local port number for row. 0 if not
+ *                                applicable.
+ * @param p_value          Out:   Value.
+ * @return  0 if the operation succeeded.
+ *         -1 if there is no such instance.
+ */
+typedef int (*pnal_snmp_get_fn) (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value);
+
+/**
+ * Validate or write the value of a scalar column.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param column           In:    Column number (last arc of column OID).
+ * @param p_tlv            In:    Encoded value, including tag and length.
+ * @param tlv_len          In:    Length of encoded value.
+ * @param commit           In:    false to validate only, true to write.
+ * @return SNMP error status. PNAL_SNMP_ERR_NO_ERROR if successful.
+ */
+typedef int (*pnal_snmp_set_fn) (
+   pnet_t * net,
+   uint32_t column,
+   const uint8_t * p_tlv,
+   size_t tlv_len,
+   bool commit);
+
+typedef struct pnal_snmp_column
+{
+   uint32_t oid[PNAL_SNMP_MAX_COLUMN_OID_LEN];
+   size_t oid_len;
+   pnal_snmp_index_t index;
+   pnal_snmp_get_fn get;
+   pnal_snmp_set_fn set;
+} pnal_snmp_column_t;
+
+typedef struct pnal_snmp_reader
+{
+   const uint8_t * p_buf;
+   size_t pos;
+   size_t end;
+} pnal_snmp_reader_t;
+
+/** Encoder writing backwards from the end of the buffer */
+typedef struct pnal_snmp_writer
+{
+   uint8_t * p_buf;
+   size_t pos;
+} pnal_snmp_writer_t;
+
+typedef struct pnal_snmp_builtin
+{
+   pnet_t * net;
+   int socket;
+   uint8_t rx_buffer[PNAL_SNMP_MAX_MESSAGE_SIZE];
+   uint8_t tx_buffer[PNAL_SNMP_MAX_MESSAGE_SIZE];
+   pnal_snmp_varbind_t request[PNAL_SNMP_MAX_VARBINDS];
+   pnal_snmp_varbind_t response[PNAL_SNMP_MAX_VARBINDS];
+   pnal_snmp_table_t tables[PNAL_SNMP_NUMBER_OF_INDEX_TYPES];
+} pnal_snmp_builtin_t;
+
+static pnal_snmp_builtin_t pnal_snmp;
+
+static const uint32_t pnal_snmp_sys_object_id[] = {1, 3, 6, 1, 4, 1, 24686};
+
+/************************** Column getters and setters **********************/
+
+static void pnal_snmp_put_integer (
+   pnal_snmp_value_t * p_value,
+   uint8_t type,
+   uint32_t integer)
+{
+   p_value->type = type;
+   p_value->integer = integer;
+}
+
+static void pnal_snmp_put_octets (
+   pnal_snmp_value_t * p_value,
+   const void * p_octets,
+   size_t len)
+{
+   if (len > sizeof (p_value->octets))
+   {
+      len = sizeof (p_value->octets);
+   }
+
+   p_value->type = PNAL_SNMP_TAG_OCTET_STRING;
+   memcpy (p_value->octets, p_octets, len);
+   p_value->len = len;
+}
+
+static int pnal_snmp_get_system (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_snmp_system_description_t description;
+   pf_snmp_system_contact_t contact;
+   pf_snmp_system_name_t name;
+   pf_snmp_system_location_t location;
+
+   switch (column)
+   {
+   case 1: /* sysDescr */
+      pf_snmp_get_system_description (net, &description);
+      pnal_snmp_put_octets (
+         p_value,
+         description.string,
+         strlen (description.string));
+      break;
+   case 2: /* sysObjectID */
+      p_value->type = PNAL_SNMP_TAG_OID;
+      p_value->p_oid = pnal_snmp_sys_object_id;
+      p_value->len = NELEMENTS (pnal_snmp_sys_object_id);
+      break;
+   case 3: /* sysUpTime */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_TIMETICKS,
+         pnal_get_system_uptime_10ms());
+      break;
+   case 4: /* sysContact */
+      pf_snmp_get_system_contact (net, &contact);
+      pnal_snmp_put_octets (p_value, contact.string, strlen (contact.string));
+      break;
+   case 5: /* sysName */
+      pf_snmp_get_system_name (net, &name);
+      pnal_snmp_put_octets (p_value, name.string, strlen (name.string));
+      break;
+   case 6: /* sysLocation */
+      pf_snmp_get_system_location (net, &location);
+      pnal_snmp_put_octets (p_value, location.string, strlen (location.string));
+      break;
+   case 7: /* sysServices */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_INTEGER,
+         PNAL_SNMP_SYS_SERVICES);
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_set_system (
+   pnet_t * net,
+   uint32_t column,
+   const uint8_t * p_tlv,
+   size_t tlv_len,
+   bool commit)
+{
+   pf_snmp_system_contact_t contact;
+   pf_snmp_system_name_t name;
+   pf_snmp_system_location_t location;
+   const uint8_t * p_octets;
+   size_t len;
+   size_t max_len;
+   int error = 0;
+
+   /* The TLV is already validated by the parser, so the length field is
+    * whatever remains after tag and length octets. */
+   if (p_tlv[0] != PNAL_SNMP_TAG_OCTET_STRING)
+   {
+      return PNAL_SNMP_ERR_WRONG_TYPE;
+   }
+   p_octets = p_tlv + ((p_tlv[1] & 0x80) ? 2 + (p_tlv[1] & 0x7F) : 2);
+   len = tlv_len - (size_t)(p_octets - p_tlv);
+
+   switch (column)
+   {
+   case 4: /* sysContact */
+      max_len = sizeof (contact.string) - 1;
+      break;
+   case 5: /* sysName */
+      max_len = sizeof (name.string) - 1;
+      break;
+   case 6: /* sysLocation */
+      max_len = sizeof (location.string) - 1;
+      break;
+   default:
+      return PNAL_SNMP_ERR_NOT_WRITABLE;
+   }
+
+   if (len > max_len)
+   {
+      return PNAL_SNMP_ERR_WRONG_LENGTH;
+   }
+
+   if (!commit)
+   {
+      return PNAL_SNMP_ERR_NO_ERROR;
+   }
+
+   switch (column)
+   {
+   case 4:
+      memcpy (contact.string, p_octets, len);
+      contact.string[len] = '\0';
+      error = pf_snmp_set_system_contact (net, &contact);
+      break;
+   case 5:
+      memcpy (name.string, p_octets, len);
+      name.string[len] = '\0';
+      error = pf_snmp_set_system_name (net, &name);
+      break;
+   case 6:
+      memcpy (location.string, p_octets, len);
+      location.string[len] = '\0';
+      error = pf_snmp_set_system_location (net, &location);
+      break;
+   }
+
+   return (error == 0) ? PNAL_SNMP_ERR_NO_ERROR : PNAL_SNMP_ERR_COMMIT_FAILED;
+}
+
+static int pnal_snmp_get_local_system_data (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_lldp_chassis_id_t chassis_id;
+
+   pf_snmp_get_chassis_id (net, &chassis_id);
+   switch (column)
+   {
+   case 1: /* lldpLocChassisIdSubtype */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_INTEGER,
+         chassis_id.subtype);
+      break;
+   case 2: /* lldpLocChassisId */
+      pnal_snmp_put_octets (p_value, chassis_id.string, chassis_id.len);
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_get_config_man_addr (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_lldp_port_list_t port_list;
+
+   switch (column)
+   {
+   case 1: /* lldpConfigManAddrPortsTxEnable */
+      pf_snmp_get_port_list (net, &port_list);
+      pnal_snmp_put_octets (p_value, port_list.ports, sizeof (port_list.ports));
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_get_local_port (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_lldp_port_id_t port_id;
+   pf_lldp_port_description_t port_desc;
+
+   switch (column)
+   {
+   case 2: /* lldpLocPortIdSubtype */
+      pf_snmp_get_port_id (net, port, &port_id);
+      pnal_snmp_put_integer (p_value, PNAL_SNMP_TAG_INTEGER, port_id.subtype);
+      break;
+   case 3: /* lldpLocPortId */
+      pf_snmp_get_port_id (net, port, &port_id);
+      pnal_snmp_put_octets (p_value, port_id.string, port_id.len);
+      break;
+   case 4: /* lldpLocPortDesc */
+      pf_snmp_get_port_description (net, port, &port_desc);
+      pnal_snmp_put_octets (p_value, port_desc.string, port_desc.len);
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_get_local_man_addr (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_snmp_management_address_t address;
+   pf_lldp_interface_number_t port_index;
+
+   switch (column)
+   {
+   case 3: /* lldpLocManAddrLen */
+      pf_snmp_get_management_address (net, &address);
+      pnal_snmp_put_integer (p_value, PNAL_SNMP_TAG_INTEGER, address.len);
+      break;
+   case 4: /* lldpLocManAddrIfSubtype */
+      pf_snmp_get_management_port_index (net, &port_index);
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_INTEGER,
+         port_index.subtype);
+      break;
+   case 5: /* lldpLocManAddrIfId */
+      pf_snmp_get_management_port_index (net, &port_index);
+      pnal_snmp_put_integer (p_value, PNAL_SNMP_TAG_INTEGER, port_index.value);
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_get_remote (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_lldp_chassis_id_t chassis_id;
+   pf_lldp_port_id_t port_id;
+   pf_lldp_port_description_t port_desc;
+
+   switch (column)
+   {
+   case 4: /* lldpRemChassisIdSubtype */
+      if (pf_snmp_get_peer_chassis_id (net, port, &chassis_id) != 0)
+      {
+         return -1;
+      }
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_INTEGER,
+         chassis_id.subtype);
+      break;
+   case 5: /* lldpRemChassisId */
+      if (pf_snmp_get_peer_chassis_id (net, port, &chassis_id) != 0)
+      {
+         return -1;
+      }
+      pnal_snmp_put_octets (p_value, chassis_id.string, chassis_id.len);
+      break;
+   case 6: /* lldpRemPortIdSubtype */
+      if (pf_snmp_get_peer_port_id (net, port, &port_id) != 0)
+      {
+         return -1;
+      }
+      pnal_snmp_put_integer (p_value, PNAL_SNMP_TAG_INTEGER, port_id.subtype);
+      break;
+   case 7: /* lldpRemPortId */
+      if (pf_snmp_get_peer_port_id (net, port, &port_id) != 0)
+      {
+         return -1;
+      }
+      pnal_snmp_put_octets (p_value, port_id.string, port_id.len);
+      break;
+   case 8: /* lldpRemPortDesc */
+      if (pf_snmp_get_peer_port_description (net, port, &port_desc) != 0)
+      {
+         return -1;
+      }
+      pnal_snmp_put_octets (p_value, port_desc.string, port_desc.len);
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_get_remote_man_addr (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_lldp_interface_number_t port_index;
+
+   if (pf_snmp_get_peer_management_port_index (net, port, &port_index) != 0)
+   {
+      return -1;
+   }
+
+   switch (column)
+   {
+   case 3: /* lldpRemManAddrIfSubtype */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_INTEGER,
+         port_index.subtype);
+      break;
+   case 4: /* lldpRemManAddrIfId */
+      pnal_snmp_put_integer (p_value, PNAL_SNMP_TAG_INTEGER, port_index.value);
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_get_xpno (
+   uint32_t column,
+   const pf_snmp_signal_delay_t * p_delays,
+   const pf_lldp_station_name_t * p_station_name,
+   pnal_snmp_value_t * p_value)
+{
+   switch (column)
+   {
+   case 1: /* lldpXPnoLocLPDValue, lldpXPnoRemLPDValue */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_UNSIGNED,
+         p_delays->line_propagation_delay_ns);
+      break;
+   case 2: /* lldpXPnoLocPortTxDValue, lldpXPnoRemPortTxDValue */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_UNSIGNED,
+         p_delays->port_tx_delay_ns);
+      break;
+   case 3: /* lldpXPnoLocPortRxDValue, lldpXPnoRemPortRxDValue */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_UNSIGNED,
+         p_delays->port_rx_delay_ns);
+      break;
+   case 6: /* lldpXPnoLocPortNoS, lldpXPnoRemPortNoS */
+      pnal_snmp_put_octets (
+         p_value,
+         p_station_name->string,
+         p_station_name->len);
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_get_xpno_local (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_snmp_signal_delay_t delays;
+   pf_lldp_station_name_t station_name;
+
+   pf_snmp_get_signal_delays (net, port, &delays);
+   pf_snmp_get_station_name (net, &station_name);
+
+   return pnal_snmp_get_xpno (column, &delays, &station_name, p_value);
+}
+
+static int pnal_snmp_get_xpno_remote (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_snmp_signal_delay_t delays;
+   pf_lldp_station_name_t station_name;
+
+   if (
+      pf_snmp_get_peer_signal_delays (net, port, &delays) != 0 ||
+      pf_snmp_get_peer_station_name (net, port, &station_name) != 0)
+   {
+      return -1;
+   }
+
+   return pnal_snmp_get_xpno (column, &delays, &station_name, p_value);
+}
+
+static int pnal_snmp_get_xdot3 (
+   uint32_t column,
+   const pf_snmp_link_status_t * p_link_status,
+   pnal_snmp_value_t * p_value)
+{
+   switch (column)
+   {
+   case 1: /* lldpXdot3LocPortAutoNegSupported, ...Rem... */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_INTEGER,
+         p_link_status->auto_neg_supported);
+      break;
+   case 2: /* lldpXdot3LocPortAutoNegEnabled, ...Rem... */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_INTEGER,
+         p_link_status->auto_neg_enabled);
+      break;
+   case 3: /* lldpXdot3LocPortAutoNegAdvertisedCap, ...Rem... */
+      pnal_snmp_put_octets (
+         p_value,
+         p_link_status->auto_neg_advertised_cap,
+         sizeof (p_link_status->auto_neg_advertised_cap));
+      break;
+   case 4: /* lldpXdot3LocPortOperMauType, ...Rem... */
+      pnal_snmp_put_integer (
+         p_value,
+         PNAL_SNMP_TAG_INTEGER,
+         p_link_status->oper_mau_type);
+      break;
+   default:
+      return -1;
+   }
+
+   return 0;
+}
+
+static int pnal_snmp_get_xdot3_local (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_snmp_link_status_t link_status;
+
+   pf_snmp_get_link_status (net, port, &link_status);
+
+   return pnal_snmp_get_xdot3 (column, &link_status, p_value);
+}
+
+static int pnal_snmp_get_xdot3_remote (
+   pnet_t * net,
+   uint32_t column,
+   int port,
+   pnal_snmp_value_t * p_value)
+{
+   pf_snmp_link_status_t link_status;
+
+   if (pf_snmp_get_peer_link_status (net, port, &link_status) != 0)
+   {
+      return -1;
+   }
+
+   return pnal_snmp_get_xdot3 (column, &link_status, p_value);
+}
+
+/****************************** Column table *******************************/
+
+#define PNAL_SNMP_OID(...)                                                     \
+   {__VA_ARGS__}, sizeof ((uint32_t[]){__VA_ARGS__}) / sizeof (uint32_t)
+
+#define PNAL_SNMP_LLDP      1, 0, 8802, 1, 1, 2, 1
+#define PNAL_SNMP_LLDP_PNO  PNAL_SNMP_LLDP, 5, 3791, 1
+#define PNAL_SNMP_LLDP_DOT3 PNAL_SNMP_LLDP, 5, 4623, 1
+
+/**
+ * All served columns (and scalars), sorted in OID order.
+ *
+ * For tables, the OID is that of the column object (table.entry.column).
+ * The instance part is given by the index type.
+ */
+static const pnal_snmp_column_t pnal_snmp_columns[] = {
+   /* lldpConfigManAddrTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 1, 7, 1, 1),
+    PNAL_SNMP_INDEX_LOCAL_MAN_ADDR,
+    pnal_snmp_get_config_man_addr,
+    NULL},
+
+   /* lldpLocalSystemData */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 3, 1),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_local_system_data,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 3, 2),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_local_system_data,
+    NULL},
+
+   /* lldpLocPortTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 3, 7, 1, 2),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_local_port,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 3, 7, 1, 3),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_local_port,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 3, 7, 1, 4),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_local_port,
+    NULL},
+
+   /* lldpLocManAddrTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 3, 8, 1, 3),
+    PNAL_SNMP_INDEX_LOCAL_MAN_ADDR,
+    pnal_snmp_get_local_man_addr,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 3, 8, 1, 4),
+    PNAL_SNMP_INDEX_LOCAL_MAN_ADDR,
+    pnal_snmp_get_local_man_addr,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 3, 8, 1, 5),
+    PNAL_SNMP_INDEX_LOCAL_MAN_ADDR,
+    pnal_snmp_get_local_man_addr,
+    NULL},
+
+   /* lldpRemTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 4, 1, 1, 4),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 4, 1, 1, 5),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 4, 1, 1, 6),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 4, 1, 1, 7),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 4, 1, 1, 8),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_remote,
+    NULL},
+
+   /* lldpRemManAddrTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 4, 2, 1, 3),
+    PNAL_SNMP_INDEX_REMOTE_MAN_ADDR,
+    pnal_snmp_get_remote_man_addr,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP, 4, 2, 1, 4),
+    PNAL_SNMP_INDEX_REMOTE_MAN_ADDR,
+    pnal_snmp_get_remote_man_addr,
+    NULL},
+
+   /* lldpXPnoLocTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_PNO, 2, 1, 1, 1),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_xpno_local,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_PNO, 2, 1, 1, 2),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_xpno_local,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_PNO, 2, 1, 1, 3),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_xpno_local,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_PNO, 2, 1, 1, 6),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_xpno_local,
+    NULL},
+
+   /* lldpXPnoRemTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_PNO, 3, 1, 1, 1),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_xpno_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_PNO, 3, 1, 1, 2),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_xpno_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_PNO, 3, 1, 1, 3),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_xpno_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_PNO, 3, 1, 1, 6),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_xpno_remote,
+    NULL},
+
+   /* lldpXdot3LocPortTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_DOT3, 2, 1, 1, 1),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_xdot3_local,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_DOT3, 2, 1, 1, 2),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_xdot3_local,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_DOT3, 2, 1, 1, 3),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_xdot3_local,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_DOT3, 2, 1, 1, 4),
+    PNAL_SNMP_INDEX_LOCAL_PORT,
+    pnal_snmp_get_xdot3_local,
+    NULL},
+
+   /* lldpXdot3RemPortTable */
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_DOT3, 3, 1, 1, 1),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_xdot3_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_DOT3, 3, 1, 1, 2),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_xdot3_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_DOT3, 3, 1, 1, 3),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_xdot3_remote,
+    NULL},
+   {PNAL_SNMP_OID (PNAL_SNMP_LLDP_DOT3, 3, 1, 1, 4),
+    PNAL_SNMP_INDEX_REMOTE,
+    pnal_snmp_get_xdot3_remote,
+    NULL},
+
+   /* system */
+   {PNAL_SNMP_OID (1, 3, 6, 1, 2, 1, 1, 1),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_system,
+    NULL},
+   {PNAL_SNMP_OID (1, 3, 6, 1, 2, 1, 1, 2),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_system,
+    NULL},
+   {PNAL_SNMP_OID (1, 3, 6, 1, 2, 1, 1, 3),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_system,
+    NULL},
+   {PNAL_SNMP_OID (1, 3, 6, 1, 2, 1, 1, 4),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_system,
+    pnal_snmp_set_system},
+   {PNAL_SNMP_OID (1, 3, 6, 1, 2, 1, 1, 5),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_system,
+    pnal_snmp_set_system},
+   {PNAL_SNMP_OID (1, 3, 6, 1, 2, 1, 1, 6),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_system,
+    pnal_snmp_set_system},
+   {PNAL_SNMP_OID (1, 3, 6, 1, 2, 1, 1, 7),
+    PNAL_SNMP_INDEX_SCALAR,
+    pnal_snmp_get_system,
+    NULL},
+};
+
+/******************************* OID lookup ********************************/
+
+/**
+ * Compare two OIDs in lexicographic order.
+ *
+ * @return -1 if a < b, 0 if equal, 1 if a > b.
+ */
+static int pnal_snmp_oid_compare (
+   const uint32_t * a,
+   size_t a_len,
+   const uint32_t * b,
+   size_t b_len)
+{
+   size_t ix;
+
+   for (ix = 0; ix < a_len && ix < b_len; ix++)
+   {
+      if (a[ix] != b[ix])
+      {
+         return (a[ix] < b[ix]) ? -1 : 1;
+      }
+   }
+
+   if (a_len == b_len)
+   {
+      return 0;
+   }
+
+   return (a_len < b_len) ? -1 : 1;
+}
+
+static bool pnal_snmp_oid_is_prefix (
+   const pnal_snmp_column_t * p_column,
+   const uint32_t * oid,
+   size_t oid_len)
+{
+   return oid_len >= p_column->oid_len &&
+          memcmp (p_column->oid, oid, p_column->oid_len * sizeof (oid[0])) ==
+             0;
+}
+
+/**
+ * Find the first column whose OID is greater than the given OID, or which is
+ * a prefix of it.
+ *
+ * @return Index in pnal_snmp_columns[]. NELEMENTS (pnal_snmp_columns) if
+ *         no such column exists.
+ */
+static size_t pnal_snmp_find_column (const uint32_t * oid, size_t oid_len)
+{
+   size_t low = 0;
+   size_t high = NELEMENTS (pnal_snmp_columns);
+   size_t mid;
+
+   while (low < high)
+   {
+      mid = low + (high - low) / 2;
+      if (
+         pnal_snmp_oid_compare (
+            pnal_snmp_columns[mid].oid,
+            pnal_snmp_columns[mid].oid_len,
+            oid,
+            oid_len) <= 0)
+      {
+         low = mid + 1;
+      }
+      else
+      {
+         high = mid;
+      }
+   }
+
+   /* Column OIDs are never prefixes of each other, so only the column
+    * immediately preceding the first greater one may contain the OID. */
+   if (
+      low > 0 &&
+      pnal_snmp_oid_is_prefix (&pnal_snmp_columns[low - 1], oid, oid_len))
+   {
+      return low - 1;
+   }
+
+   return low;
+}
+
+static void pnal_snmp_row_add_address (
+   pnal_snmp_row_t * p_row,
+   const pf_snmp_management_address_t * p_address)
+{
+   size_t ix;
+   size_t len = p_address->value[0];
+
+   if (len > sizeof (p_address->value) - 1)
+   {
+      len = sizeof (p_address->value) - 1;
+   }
+
+   p_row->index[p_row->index_len++] = p_address->subtype;
+   p_row->index[p_row->index_len++] = len;
+   for (ix = 0; ix < len; ix++)
+   {
+      p_row->index[p_row->index_len++] = p_address->value[1 + ix];
+   }
+}
+
+/**
+ * List all rows of a table.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param index            In:    Type of table index.
+ * @param rows             Out:   Rows, in no particular order.
+ * @return Number of rows.
+ */
+static size_t pnal_snmp_get_rows (
+   pnet_t * net,
+   pnal_snmp_index_t index,
+   pnal_snmp_row_t rows[PNAL_SNMP_MAX_ROWS])
+{
+   pf_port_iterator_t iterator;
+   pf_snmp_management_address_t address;
+   uint32_t timestamp;
+   size_t n = 0;
+   int port;
+
+   if (index == PNAL_SNMP_INDEX_SCALAR)
+   {
+      rows[0].index[0] = 0;
+      rows[0].index_len = 1;
+      rows[0].port = 0;
+      return 1;
+   }
+
+   if (index == PNAL_SNMP_INDEX_LOCAL_MAN_ADDR)
+   {
+      pf_snmp_get_management_address (net, &address);
+      rows[0].index_len = 0;
+      rows[0].port = 0;
+      pnal_snmp_row_add_address (&rows[0], &address);
+      return 1;
+   }
+
+   pf_snmp_init_port_iterator (net, &iterator);
+   port = pf_snmp_get_next_port (&iterator);
+   while (port != 0 && n < PNAL_SNMP_MAX_ROWS)
+   {
+      rows[n].index_len = 0;
+      rows[n].port = port;
+
+      if (index == PNAL_SNMP_INDEX_LOCAL_PORT)
+      {
+         rows[n].index[rows[n].index_len++] = port;
+         n++;
+      }
+      else if (pf_snmp_get_peer_timestamp (net, port, &timestamp) == 0)
+      {
+         rows[n].index[rows[n].index_len++] = timestamp;
+         rows[n].index[rows[n].index_len++] = port;
+         rows[n].index[rows[n].index_len++] = port; /* lldpRemIndex */
+
+         if (index == PNAL_SNMP_INDEX_REMOTE)
+         {
+            n++;
+         }
+         else if (
+            pf_snmp_get_peer_management_address (net, port, &address) == 0)
+         {
+            pnal_snmp_row_add_address (&rows[n], &address);
+            n++;
+         }
+      }
+
+      port = pf_snmp_get_next_port (&iterator);
+   }
+
+   return n;
+}
+
+/**
+ * Get the rows of a table, sorted by index.
+ *
+ * The rows are cached, and only listed again when the generation counter
+ * from the stack has changed. Column values are not cached.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param index            In:    Type of table index.
+ * @return Table rows.
+ */
+static const pnal_snmp_table_t * pnal_snmp_get_table (
+   pnet_t * net,
+   pnal_snmp_index_t index)
+{
+   pnal_snmp_table_t * p_table = &pnal_snmp.tables[index];
+   uint32_t generation = pf_snmp_get_generation (net);
+   pnal_snmp_row_t row;
+   size_t ix;
+   size_t iy;
+
+   if (
+      p_table->is_valid && p_table->net == net &&
+      p_table->generation == generation)
+   {
+      return p_table;
+   }
+
+   p_table->n_rows = pnal_snmp_get_rows (net, index, p_table->rows);
+
+   /* Insertion sort. There is at most one row per port. */
+   for (ix = 1; ix < p_table->n_rows; ix++)
+   {
+      row = p_table->rows[ix];
+      iy = ix;
+      while (
+         iy > 0 && pnal_snmp_oid_compare (
+                      p_table->rows[iy - 1].index,
+                      p_table->rows[iy - 1].index_len,
+                      row.index,
+                      row.index_len) > 0)
+      {
+         p_table->rows[iy] = p_table->rows[iy - 1];
+         iy--;
+      }
+      p_table->rows[iy] = row;
+   }
+
+   p_table->is_valid = true;
+   p_table->net = net;
+   p_table->generation = generation;
+
+   return p_table;
+}
+
+/**
+ * Find the first row with an index greater than (or equal to) an OID.
+ *
+ * @param p_table          In:    Table rows, sorted by index.
+ * @param oid              In:    Row index to compare with.
+ * @param oid_len          In:    Number of elements in oid.
+ * @param or_equal         In:    true to also accept a row with the same
+ *                                index.
+ * @return Position in table. p_table->n_rows if there is no such row.
+ */
+static size_t pnal_snmp_find_row (
+   const pnal_snmp_table_t * p_table,
+   const uint32_t * oid,
+   size_t oid_len,
+   bool or_equal)
+{
+   size_t low = 0;
+   size_t high = p_table->n_rows;
+   size_t mid;
+   int compare;
+
+   while (low < high)
+   {
+      mid = low + (high - low) / 2;
+      compare = pnal_snmp_oid_compare (
+         p_table->rows[mid].index,
+         p_table->rows[mid].index_len,
+         oid,
+         oid_len);
+      if (compare < 0 || (compare == 0 && !or_equal))
+      {
+         low = mid + 1;
+      }
+      else
+      {
+         high = mid;
+      }
+   }
+
+   return low;
+}
+
+/**
+ * Invalidate the cached table rows.
+ *
+ * Must be called when the stack is initialised, as the generation counter
+ * then starts over.
+ */
+void pnal_snmp_invalidate_tables (void)
+{
+   size_t ix;
+
+   for (ix = 0; ix < NELEMENTS (pnal_snmp.tables); ix++)
+   {
+      pnal_snmp.tables[ix].is_valid = false;
+   }
+}
+
+/**
+ * Get the value of an object instance.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param p_varbind        InOut: OID to get. Value is updated.
+ * @return  0 if the operation succeeded.
+ *         -1 if the instance does not exist. The value is set to the
+ *            corresponding exception.
+ */
+static int pnal_snmp_get (pnet_t * net, pnal_snmp_varbind_t * p_varbind)
+{
+   const pnal_snmp_table_t * p_table;
+   const pnal_snmp_column_t * p_column;
+   const uint32_t * p_index;
+   size_t index_len;
+   size_t column_ix;
+   size_t ix;
+
+   column_ix = pnal_snmp_find_column (p_varbind->oid, p_varbind->oid_len);
+   if (
+      column_ix == NELEMENTS (pnal_snmp_columns) ||
+      !pnal_snmp_oid_is_prefix (
+         &pnal_snmp_columns[column_ix],
+         p_varbind->oid,
+         p_varbind->oid_len))
+   {
+      p_varbind->value.type = PNAL_SNMP_TAG_NO_SUCH_OBJECT;
+      return -1;
+   }
+   p_column = &pnal_snmp_columns[column_ix];
+   p_index = &p_varbind->oid[p_column->oid_len];
+   index_len = p_varbind->oid_len - p_column->oid_len;
+
+   p_table = pnal_snmp_get_table (net, p_column->index);
+   ix = pnal_snmp_find_row (p_table, p_index, index_len, true);
+   if (
+      ix < p_table->n_rows &&
+      pnal_snmp_oid_compare (
+         p_table->rows[ix].index,
+         p_table->rows[ix].index_len,
+         p_index,
+         index_len) == 0 &&
+      p_column->get (
+         net,
+         p_column->oid[p_column->oid_len - 1],
+         p_table->rows[ix].port,
+         &p_varbind->value) == 0)
+   {
+      return 0;
+   }
+
+   p_varbind->value.type = PNAL_SNMP_TAG_NO_SUCH_INSTANCE;
+   return -1;
+}
+
+/**
+ * Get the next object instance following an OID.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param p_varbind        InOut: OID to start from. OID and value are updated.
+ * @return  0 if the operation succeeded.
+ *         -1 if there is no next instance. The value is set to
+ *            endOfMibView and the OID is left unchanged.
+ */
+static int pnal_snmp_get_next (pnet_t * net, pnal_snmp_varbind_t * p_varbind)
+{
+   const pnal_snmp_table_t * p_table;
+   const pnal_snmp_column_t * p_column;
+   const pnal_snmp_row_t * p_row;
+   const uint32_t * after = NULL;
+   size_t after_len = 0;
+   size_t column_ix;
+   size_t ix;
+
+   column_ix = pnal_snmp_find_column (p_varbind->oid, p_varbind->oid_len);
+   if (
+      column_ix < NELEMENTS (pnal_snmp_columns) &&
+      pnal_snmp_oid_is_prefix (
+         &pnal_snmp_columns[column_ix],
+         p_varbind->oid,
+         p_varbind->oid_len))
+   {
+      /* Only rows following the requested instance are candidates */
+      after = &p_varbind->oid[pnal_snmp_columns[column_ix].oid_len];
+      after_len = p_varbind->oid_len - pnal_snmp_columns[column_ix].oid_len;
+   }
+
+   for (; column_ix < NELEMENTS (pnal_snmp_columns); column_ix++)
+   {
+      p_column = &pnal_snmp_columns[column_ix];
+      p_table = pnal_snmp_get_table (net, p_column->index);
+
+      ix = 0;
+      if (after != NULL)
+      {
+         ix = pnal_snmp_find_row (p_table, after, after_len, false);
+      }
+
+      /* A row may disappear while reading it. Then try the next one. */
+      for (; ix < p_table->n_rows; ix++)
+      {
+         p_row = &p_table->rows[ix];
+         if (
+            p_column->get (
+               net,
+               p_column->oid[p_column->oid_len - 1],
+               p_row->port,
+               &p_varbind->value) == 0)
+         {
+            memcpy (
+               p_varbind->oid,
+               p_column->oid,
+               p_column->oid_len * sizeof (p_varbind->oid[0]));
+            memcpy (
+               &p_varbind->oid[p_column->oid_len],
+               p_row->index,
+               p_row->index_len * sizeof (p_varbind->oid[0]));
+            p_varbind->oid_len = p_column->oid_len + p_row->index_len;
+            return 0;
+         }
+      }
+
+      after = NULL;
+   }
+
+   p_varbind->value.type = PNAL_SNMP_TAG_END_OF_MIB_VIEW;
+   return -1;
+}
+
+/**
+ * Find the writable column for a scalar instance.
+ *
+ * @return Column, or NULL if the OID is not a writable instance.
+ */
+static const pnal_snmp_column_t * pnal_snmp_find_writable (
+   const pnal_snmp_varbind_t * p_varbind)
+{
+   const pnal_snmp_column_t * p_column;
+   size_t column_ix;
+
+   column_ix = pnal_snmp_find_column (p_varbind->oid, p_varbind->oid_len);
+   if (column_ix == NELEMENTS (pnal_snmp_columns))
+   {
+      return NULL;
+   }
+
+   p_column = &pnal_snmp_columns[column_ix];
+   if (
+      p_column->set == NULL || p_column->index != PNAL_SNMP_INDEX_SCALAR ||
+      p_varbind->oid_len != p_column->oid_len + 1 ||
+      !pnal_snmp_oid_is_prefix (p_column, p_varbind->oid, p_varbind->oid_len) ||
+      p_varbind->oid[p_column->oid_len] != 0)
+   {
+      return NULL;
+   }
+
+   return p_column;
+}
+
+/****************************** BER decoding *******************************/
+
+static int pnal_snmp_ber_get_header (
+   pnal_snmp_reader_t * p_reader,
+   uint8_t * p_tag,
+   size_t * p_len)
+{
+   size_t len;
+   size_t n;
+
+   if (p_reader->end - p_reader->pos < 2)
+   {
+      return -1;
+   }
+
+   *p_tag = p_reader->p_buf[p_reader->pos++];
+   len = p_reader->p_buf[p_reader->pos++];
+   if (len & 0x80)
+   {
+      n = len & 0x7F;
+      if (n == 0 || n > 2 || p_reader->end - p_reader->pos < n)
+      {
+         return -1;
+      }
+
+      len = 0;
+      while (n-- > 0)
+      {
+         len = (len << 8) | p_reader->p_buf[p_reader->pos++];
+      }
+   }
+
+   if (p_reader->end - p_reader->pos < len)
+   {
+      return -1;
+   }
+
+   *p_len = len;
+   return 0;
+}
+
+static int pnal_snmp_ber_get_integer (
+   pnal_snmp_reader_t * p_reader,
+   int32_t * p_value)
+{
+   uint8_t tag;
+   size_t len;
+   uint32_t value;
+
+   if (
+      pnal_snmp_ber_get_header (p_reader, &tag, &len) != 0 ||
+      tag != PNAL_SNMP_TAG_INTEGER || len < 1 || len > 4)
+   {
+      return -1;
+   }
+
+   /* Sign extend */
+   value = (p_reader->p_buf[p_reader->pos] & 0x80) ? UINT32_MAX : 0;
+   while (len-- > 0)
+   {
+      value = (value << 8) | p_reader->p_buf[p_reader->pos++];
+   }
+
+   *p_value = (int32_t)value;
+   return 0;
+}
+
+static int pnal_snmp_ber_get_octets (
+   pnal_snmp_reader_t * p_reader,
+   const uint8_t ** pp_octets,
+   size_t * p_len)
+{
+   uint8_t tag;
+
+   if (
+      pnal_snmp_ber_get_header (p_reader, &tag, p_len) != 0 ||
+      tag != PNAL_SNMP_TAG_OCTET_STRING)
+   {
+      return -1;
+   }
+
+   *pp_octets = &p_reader->p_buf[p_reader->pos];
+   p_reader->pos += *p_len;
+   return 0;
+}
+
+static int pnal_snmp_ber_get_oid (
+   pnal_snmp_reader_t * p_reader,
+   uint32_t oid[PNAL_SNMP_MAX_OID_LEN],
+   size_t * p_oid_len)
+{
+   uint8_t tag;
+   size_t len;
+   size_t end;
+   size_t n = 0;
+   uint32_t subid;
+   uint8_t byte;
+
+   if (
+      pnal_snmp_ber_get_header (p_reader, &tag, &len) != 0 ||
+      tag != PNAL_SNMP_TAG_OID || len < 1)
+   {
+      return -1;
+   }
+
+   end = p_reader->pos + len;
+   while (p_reader->pos < end)
+   {
+      subid = 0;
+      do
+      {
+         if (p_reader->pos == end || subid > (UINT32_MAX >> 7))
+         {
+            return -1;
+         }
+         byte = p_reader->p_buf[p_reader->pos++];
+         subid = (subid << 7) | (byte & 0x7F);
+      } while (byte & 0x80);
+
+      if (n == 0)
+      {
+         /* First subidentifier holds the two first arcs */
+         oid[n++] = (subid < 80) ? subid / 40 : 2;
+         subid -= oid[0] * 40;
+      }
+
+      if (n >= PNAL_SNMP_MAX_OID_LEN)
+      {
+         return -1;
+      }
+      oid[n++] = subid;
+   }
+
+   *p_oid_len = n;
+   return 0;
+}
+
+/**
+ * Parse a varbind.
+ *
+ * The value is not decoded, only its location in the buffer is saved.
+ */
+static int pnal_snmp_ber_get_varbind (
+   pnal_snmp_reader_t * p_reader,
+   pnal_snmp_varbind_t * p_varbind)
+{
+   uint8_t tag;
+   size_t len;
+   size_t start;
+
+   if (
+      pnal_snmp_ber_get_header (p_reader, &tag, &len) != 0 ||
+      tag != PNAL_SNMP_TAG_SEQUENCE ||
+      pnal_snmp_ber_get_oid (p_reader, p_varbind->oid, &p_varbind->oid_len) !=
+         0)
+   {
+      return -1;
+   }
+
+   start = p_reader->pos;
+   if (pnal_snmp_ber_get_header (p_reader, &tag, &len) != 0)
+   {
+      return -1;
+   }
+   p_reader->pos += len;
+
+   p_varbind->p_raw = &p_reader->p_buf[start];
+   p_varbind->raw_len = p_reader->pos - start;
+   p_varbind->value.type = PNAL_SNMP_TAG_NULL;
+   return 0;
+}
+
+/****************************** BER encoding *******************************/
+
+static int pnal_snmp_ber_put_bytes (
+   pnal_snmp_writer_t * p_writer,
+   const void * p_data,
+   size_t len)
+{
+   if (len > p_writer->pos)
+   {
+      return -1;
+   }
+
+   p_writer->pos -= len;
+   memcpy (&p_writer->p_buf[p_writer->pos], p_data, len);
+   return 0;
+}
+
+static int pnal_snmp_ber_put_byte (pnal_snmp_writer_t * p_writer, uint8_t byte)
+{
+   return pnal_snmp_ber_put_bytes (p_writer, &byte, 1);
+}
+
+static int pnal_snmp_ber_put_header (
+   pnal_snmp_writer_t * p_writer,
+   uint8_t tag,
+   size_t len)
+{
+   int error = 0;
+
+   if (len < 0x80)
+   {
+      error |= pnal_snmp_ber_put_byte (p_writer, (uint8_t)len);
+   }
+   else if (len <= 0xFF)
+   {
+      error |= pnal_snmp_ber_put_byte (p_writer, (uint8_t)len);
+      error |= pnal_snmp_ber_put_byte (p_writer, 0x81);
+   }
+   else
+   {
+      error |= pnal_snmp_ber_put_byte (p_writer, (uint8_t)len);
+      error |= pnal_snmp_ber_put_byte (p_writer, (uint8_t)(len >> 8));
+      error |= pnal_snmp_ber_put_byte (p_writer, 0x82);
+   }
+
+   error |= pnal_snmp_ber_put_byte (p_writer, tag);
+   return error;
+}
+
+/**
+ * Encode an integer with the minimum number of octets.
+ *
+ * @param is_signed        In:    true for INTEGER, false for unsigned types.
+ */
+static int pnal_snmp_ber_put_integer (
+   pnal_snmp_writer_t * p_writer,
+   uint8_t tag,
+   uint32_t value,
+   bool is_signed)
+{
+   int64_t v = is_signed ? (int64_t)(int32_t)value : (int64_t)value;
+   size_t len = 1;
+   size_t ix;
+   int error = 0;
+
+   /* Unsigned values with the highest bit set need a leading zero */
+   while (len < 5 && (v < -(INT64_C (1) << (8 * len - 1)) ||
+                      v >= (INT64_C (1) << (8 * len - 1))))
+   {
+      len++;
+   }
+
+   for (ix = 0; ix < len; ix++)
+   {
+      error |= pnal_snmp_ber_put_byte (p_writer, (uint8_t)(v >> (8 * ix)));
+   }
+
+   error |= pnal_snmp_ber_put_header (p_writer, tag, len);
+   return error;
+}
+
+static int pnal_snmp_ber_put_subid (
+   pnal_snmp_writer_t * p_writer,
+   uint32_t subid)
+{
+   int error = pnal_snmp_ber_put_byte (p_writer, subid & 0x7F);
+
+   for (subid >>= 7; subid != 0; subid >>= 7)
+   {
+      error |= pnal_snmp_ber_put_byte (p_writer, 0x80 | (subid & 0x7F));
+   }
+
+   return error;
+}
+
+static int pnal_snmp_ber_put_oid (
+   pnal_snmp_writer_t * p_writer,
+   const uint32_t * oid,
+   size_t oid_len)
+{
+   size_t start = p_writer->pos;
+   size_t ix;
+   int error = 0;
+
+   for (ix = oid_len; ix > 2; ix--)
+   {
+      error |= pnal_snmp_ber_put_subid (p_writer, oid[ix - 1]);
+   }
+   error |= pnal_snmp_ber_put_subid (
+      p_writer,
+      (oid_len >= 2) ? oid[0] * 40 + oid[1] : 0);
+
+   error |= pnal_snmp_ber_put_header (
+      p_writer,
+      PNAL_SNMP_TAG_OID,
+      start - p_writer->pos);
+   return error;
+}
+
+static int pnal_snmp_ber_put_varbind (
+   pnal_snmp_writer_t * p_writer,
+   const pnal_snmp_varbind_t * p_varbind)
+{
+   const pnal_snmp_value_t * p_value = &p_varbind->value;
+   size_t start = p_writer->pos;
+   int error = 0;
+
+   if (p_varbind->p_raw != NULL)
+   {
+      error |= pnal_snmp_ber_put_bytes (
+         p_writer,
+         p_varbind->p_raw,
+         p_varbind->raw_len);
+   }
+   else
+   {
+      switch (p_value->type)
+      {
+      case PNAL_SNMP_TAG_INTEGER:
+         error |= pnal_snmp_ber_put_integer (
+            p_writer,
+            p_value->type,
+            p_value->integer,
+            true);
+         break;
+      case PNAL_SNMP_TAG_UNSIGNED:
+      case PNAL_SNMP_TAG_TIMETICKS:
+         error |= pnal_snmp_ber_put_integer (
+            p_writer,
+            p_value->type,
+            p_value->integer,
+            false);
+         break;
+      case PNAL_SNMP_TAG_OCTET_STRING:
+         error |= pnal_snmp_ber_put_bytes (
+            p_writer,
+            p_value->octets,
+            p_value->len);
+         error |= pnal_snmp_ber_put_header (
+            p_writer,
+            p_value->type,
+            p_value->len);
+         break;
+      case PNAL_SNMP_TAG_OID:
+         error |= pnal_snmp_ber_put_oid (
+            p_writer,
+            p_value->p_oid,
+            p_value->len);
+         break;
+      default:
+         /* NULL and exceptions have no content */
+         error |= pnal_snmp_ber_put_header (p_writer, p_value->type, 0);
+         break;
+      }
+   }
+
+   error |= pnal_snmp_ber_put_oid (
+      p_writer,
+      p_varbind->oid,
+      p_varbind->oid_len);
+   error |= pnal_snmp_ber_put_header (
+      p_writer,
+      PNAL_SNMP_TAG_SEQUENCE,
+      start - p_writer->pos);
+   return error;
+}
+
+/**
+ * Encode a GetResponse message.
+ *
+ * @return Number of bytes written to the start of p_buf, or
+ *         -1 if the message does not fit.
+ */
+static int pnal_snmp_ber_put_response (
+   uint8_t * p_buf,
+   size_t size,
+   int32_t version,
+   const uint8_t * p_community,
+   size_t community_len,
+   int32_t request_id,
+   int32_t error_status,
+   int32_t error_index,
+   const pnal_snmp_varbind_t * p_varbinds,
+   size_t n_varbinds)
+{
+   pnal_snmp_writer_t writer = {.p_buf = p_buf, .pos = size};
+   size_t ix;
+   int error = 0;
+
+   for (ix = n_varbinds; ix > 0 && error == 0; ix--)
+   {
+      error |= pnal_snmp_ber_put_varbind (&writer, &p_varbinds[ix - 1]);
+   }
+   error |= pnal_snmp_ber_put_header (
+      &writer,
+      PNAL_SNMP_TAG_SEQUENCE,
+      size - writer.pos);
+
+   error |= pnal_snmp_ber_put_integer (
+      &writer,
+      PNAL_SNMP_TAG_INTEGER,
+      error_index,
+      true);
+   error |= pnal_snmp_ber_put_integer (
+      &writer,
+      PNAL_SNMP_TAG_INTEGER,
+      error_status,
+      true);
+   error |= pnal_snmp_ber_put_integer (
+      &writer,
+      PNAL_SNMP_TAG_INTEGER,
+      request_id,
+      true);
+   error |= pnal_snmp_ber_put_header (
+      &writer,
+      PNAL_SNMP_PDU_RESPONSE,
+      size - writer.pos);
+
+   error |= pnal_snmp_ber_put_bytes (&writer, p_community, community_len);
+   error |= pnal_snmp_ber_put_header (
+      &writer,
+      PNAL_SNMP_TAG_OCTET_STRING,
+      community_len);
+   error |= pnal_snmp_ber_put_integer (
+      &writer,
+      PNAL_SNMP_TAG_INTEGER,
+      version,
+      true);
+   error |= pnal_snmp_ber_put_header (
+      &writer,
+      PNAL_SNMP_TAG_SEQUENCE,
+      size - writer.pos);
+
+   if (error != 0)
+   {
+      return -1;
+   }
+
+   memmove (p_buf, &p_buf[writer.pos], size - writer.pos);
+   return (int)(size - writer.pos);
+}
+
+/**************************** Request handling *****************************/
+
+/**
+ * Check the community of a request.
+ *
+ * @return true if the community is the configured one, or the default
+ *         community if none is configured.
+ */
+static bool pnal_snmp_is_community (
+   const uint8_t * p_community,
+   size_t len,
+   const char * configured,
+   const char * default_community)
+{
+   const char * expected = default_community;
+
+   if (configured[0] != '\0')
+   {
+      expected = configured;
+   }
+
+   return len == strnlen (expected, PNAL_SNMP_COMMUNITY_MAX_SIZE) &&
+          memcmp (p_community, expected, len) == 0;
+}
+
+/**
+ * Handle a Set request.
+ *
+ * Values are validated for all varbinds before any of them is written.
+ *
+ * @return SNMP error status. The index of the failing varbind (starting
+ *         from 1) is written to p_error_index.
+ */
+static int32_t pnal_snmp_handle_set (
+   pnet_t * net,
+   const pnal_snmp_varbind_t * p_varbinds,
+   size_t n_varbinds,
+   int32_t * p_error_index)
+{
+   const pnal_snmp_column_t * p_column;
+   size_t ix;
+   int status;
+   bool commit;
+
+   for (commit = false; ; commit = true)
+   {
+      for (ix = 0; ix < n_varbinds; ix++)
+      {
+         *p_error_index = (int32_t)(ix + 1);
+         p_column = pnal_snmp_find_writable (&p_varbinds[ix]);
+         if (p_column == NULL)
+         {
+            return PNAL_SNMP_ERR_NOT_WRITABLE;
+         }
+
+         status = p_column->set (
+            net,
+            p_column->oid[p_column->oid_len - 1],
+            p_varbinds[ix].p_raw,
+            p_varbinds[ix].raw_len,
+            commit);
+         if (status != PNAL_SNMP_ERR_NO_ERROR)
+         {
+            return status;
+         }
+      }
+
+      if (commit)
+      {
+         break;
+      }
+   }
+
+   *p_error_index = 0;
+   return PNAL_SNMP_ERR_NO_ERROR;
+}
+
+/**
+ * Map an SNMPv2c error status to the closest SNMPv1 one.
+ * See IETF RFC 3584 ch. 4.3.
+ */
+static int32_t pnal_snmp_error_to_v1 (int32_t status)
+{
+   switch (status)
+   {
+   case PNAL_SNMP_ERR_WRONG_TYPE:
+   case PNAL_SNMP_ERR_WRONG_LENGTH:
+      return PNAL_SNMP_ERR_BAD_VALUE;
+   case PNAL_SNMP_ERR_NO_ACCESS:
+   case PNAL_SNMP_ERR_NOT_WRITABLE:
+      return PNAL_SNMP_ERR_NO_SUCH_NAME;
+   case PNAL_SNMP_ERR_COMMIT_FAILED:
+      return PNAL_SNMP_ERR_GEN_ERR;
+   default:
+      return status;
+   }
+}
+
+int pnal_snmp_handle_request (
+   pnet_t * net,
+   const uint8_t * p_request,
+   size_t request_len,
+   uint8_t * p_response,
+   size_t response_size)
+{
+   pnal_snmp_builtin_t * p_snmp = &pnal_snmp;
+   pnet_cfg_t * p_cfg = NULL;
+   pnal_snmp_reader_t reader = {
+      .p_buf = p_request,
+      .pos = 0,
+      .end = request_len};
+   const uint8_t * p_community;
+   size_t community_len;
+   uint8_t tag;
+   uint8_t pdu_type;
+   size_t len;
+   int32_t version;
+   int32_t request_id;
+   int32_t error_status = PNAL_SNMP_ERR_NO_ERROR;
+   int32_t error_index = 0;
+   int32_t non_repeaters;
+   int32_t max_repetitions;
+   size_t n_request = 0;
+   size_t n_response = 0;
+   size_t n_repeaters;
+   size_t ix;
+   size_t jx;
+   size_t end_of_view;
+   bool is_write;
+   const pnal_snmp_varbind_t * p_previous;
+   pnal_snmp_varbind_t * p_varbind;
+   int tx_len;
+
+   /* Message header and PDU */
+   if (
+      pnal_snmp_ber_get_header (&reader, &tag, &len) != 0 ||
+      tag != PNAL_SNMP_TAG_SEQUENCE ||
+      pnal_snmp_ber_get_integer (&reader, &version) != 0 ||
+      (version != PNAL_SNMP_VERSION_1 && version != PNAL_SNMP_VERSION_2C) ||
+      pnal_snmp_ber_get_octets (&reader, &p_community, &community_len) != 0 ||
+      pnal_snmp_ber_get_header (&reader, &pdu_type, &len) != 0 ||
+      pnal_snmp_ber_get_integer (&reader, &request_id) != 0 ||
+      pnal_snmp_ber_get_integer (&reader, &non_repeaters) != 0 ||
+      pnal_snmp_ber_get_integer (&reader, &max_repetitions) != 0 ||
+      pnal_snmp_ber_get_header (&reader, &tag, &len) != 0 ||
+      tag != PNAL_SNMP_TAG_SEQUENCE)
+   {
+      LOG_DEBUG (PF_SNMP_LOG, "SNMP(%d): Malformed message\n", __LINE__);
+      return -1;
+   }
+
+   /* Community. Unknown communities are silently dropped. */
+   pf_fspm_get_cfg (net, &p_cfg);
+   is_write = pnal_snmp_is_community (
+      p_community,
+      community_len,
+      p_cfg->pnal_cfg.snmp_write_community,
+      PNAL_SNMP_WRITE_COMMUNITY);
+   if (
+      !is_write && !pnal_snmp_is_community (
+                      p_community,
+                      community_len,
+                      p_cfg->pnal_cfg.snmp_read_community,
+                      PNAL_SNMP_READ_COMMUNITY))
+   {
+      LOG_DEBUG (PF_SNMP_LOG, "SNMP(%d): Unknown community\n", __LINE__);
+      return -1;
+   }
+
+   if (pdu_type == PNAL_SNMP_PDU_SET && !is_write)
+   {
+      error_status = PNAL_SNMP_ERR_NO_ACCESS;
+      error_index = 1;
+   }
+
+   /* Varbind list */
+   while (reader.pos < reader.end)
+   {
+      if (n_request == NELEMENTS (p_snmp->request))
+      {
+         /* Answered with an empty tooBig response, so that the manager
+          * may split the request. See IETF RFC 3416 ch. 4.2.1. */
+         LOG_DEBUG (PF_SNMP_LOG, "SNMP(%d): Too many varbinds\n", __LINE__);
+         error_status = PNAL_SNMP_ERR_TOO_BIG;
+         error_index = 0;
+         n_request = 0;
+         break;
+      }
+
+      if (
+         pnal_snmp_ber_get_varbind (&reader, &p_snmp->request[n_request]) !=
+         0)
+      {
+         LOG_DEBUG (PF_SNMP_LOG, "SNMP(%d): Malformed varbind\n", __LINE__);
+         return -1;
+      }
+      n_request++;
+   }
+
+   switch (pdu_type)
+   {
+   case PNAL_SNMP_PDU_GET:
+   case PNAL_SNMP_PDU_GETNEXT:
+      for (ix = 0; ix < n_request; ix++)
+      {
+         p_varbind = &p_snmp->response[n_response++];
+         *p_varbind = p_snmp->request[ix];
+         p_varbind->p_raw = NULL;
+
+         if (
+            ((pdu_type == PNAL_SNMP_PDU_GET)
+                ? pnal_snmp_get (net, p_varbind)
+                : pnal_snmp_get_next (net, p_varbind)) != 0 &&
+            version == PNAL_SNMP_VERSION_1)
+         {
+            error_status = PNAL_SNMP_ERR_NO_SUCH_NAME;
+            error_index = (int32_t)(ix + 1);
+            break;
+         }
+      }
+      break;
+   case PNAL_SNMP_PDU_GETBULK:
+      if (version == PNAL_SNMP_VERSION_1)
+      {
+         return -1;
+      }
+
+      /* See IETF RFC 3416 ch. 4.2.3 */
+      if (non_repeaters < 0)
+      {
+         non_repeaters = 0;
+      }
+      if ((size_t)non_repeaters > n_request)
+      {
+         non_repeaters = (int32_t)n_request;
+      }
+      n_repeaters = n_request - (size_t)non_repeaters;
+      if (max_repetitions < 0)
+      {
+         max_repetitions = 0;
+      }
+
+      for (ix = 0; ix < n_request; ix++)
+      {
+         p_varbind = &p_snmp->response[n_response++];
+         *p_varbind = p_snmp->request[ix];
+         p_varbind->p_raw = NULL;
+         (void)pnal_snmp_get_next (net, p_varbind);
+      }
+
+      /* Further repetitions start from the previous result */
+      for (ix = 1; ix < (size_t)max_repetitions && n_repeaters > 0; ix++)
+      {
+         end_of_view = 0;
+         for (jx = 0; jx < n_repeaters; jx++)
+         {
+            if (n_response == NELEMENTS (p_snmp->response))
+            {
+               break;
+            }
+            p_previous = &p_snmp->response[n_response - n_repeaters];
+            p_varbind = &p_snmp->response[n_response++];
+            *p_varbind = *p_previous;
+            if (pnal_snmp_get_next (net, p_varbind) != 0)
+            {
+               end_of_view++;
+            }
+         }
+
+         if (end_of_view == n_repeaters || jx < n_repeaters)
+         {
+            break;
+         }
+      }
+
+      if (max_repetitions == 0)
+      {
+         n_response = (size_t)non_repeaters;
+      }
+      break;
+   case PNAL_SNMP_PDU_SET:
+      if (error_status == PNAL_SNMP_ERR_NO_ERROR)
+      {
+         error_status = pnal_snmp_handle_set (
+            net,
+            p_snmp->request,
+            n_request,
+            &error_index);
+      }
+      break;
+   default:
+      LOG_DEBUG (
+         PF_SNMP_LOG,
+         "SNMP(%d): Unsupported PDU type 0x%02X\n",
+         __LINE__,
+         (unsigned)pdu_type);
+      return -1;
+   }
+
+   /* On error, the varbinds of the request are returned unchanged */
+   if (error_status != PNAL_SNMP_ERR_NO_ERROR || pdu_type == PNAL_SNMP_PDU_SET)
+   {
+      if (version == PNAL_SNMP_VERSION_1)
+      {
+         error_status = pnal_snmp_error_to_v1 (error_status);
+      }
+      memcpy (
+         p_snmp->response,
+         p_snmp->request,
+         n_request * sizeof (p_snmp->request[0]));
+      n_response = n_request;
+   }
+
+   /* GetBulk responses are truncated to fit, see RFC 3416 ch. 4.2.3 */
+   for (;;)
+   {
+      tx_len = pnal_snmp_ber_put_response (
+         p_response,
+         response_size,
+         version,
+         p_community,
+         community_len,
+         request_id,
+         error_status,
+         error_index,
+         p_snmp->response,
+         n_response);
+      if (tx_len >= 0)
+      {
+         return tx_len;
+      }
+
+      if (
+         pdu_type == PNAL_SNMP_PDU_GETBULK &&
+         error_status == PNAL_SNMP_ERR_NO_ERROR && n_response > 1)
+      {
+         n_response--;
+      }
+      else if (n_response > 0)
+      {
+         error_status = PNAL_SNMP_ERR_TOO_BIG;
+         error_index = 0;
+         n_response = 0;
+      }
+      else
+      {
+         return -1;
+      }
+   }
+}
+
+static void pnal_snmp_thread (void * arg)
+{
+   pnal_snmp_builtin_t * p_snmp = arg;
+   struct sockaddr_in remote;
+   socklen_t addr_len;
+   ssize_t rx_len;
+   int tx_len;
+   uint32_t rx_error_delay = 0;
+
+   for (;;)
+   {
+      addr_len = sizeof (remote);
+      rx_len = recvfrom (
+         p_snmp->socket,
+         p_snmp->rx_buffer,
+         sizeof (p_snmp->rx_buffer),
+         0,
+         (struct sockaddr *)&remote,
+         &addr_len);
+      if (rx_len < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+
+         /* Do not spin on a persistent socket error */
+         if (rx_error_delay == 0)
+         {
+            LOG_ERROR (
+               PF_SNMP_LOG,
+               "SNMP(%d): Failed to receive: %s\n",
+               __LINE__,
+               strerror (errno));
+            rx_error_delay = PNAL_SNMP_RX_ERROR_DELAY_MIN;
+         }
+         os_usleep (rx_error_delay);
+         rx_error_delay *= 2;
+         if (rx_error_delay > PNAL_SNMP_RX_ERROR_DELAY_MAX)
+         {
+            rx_error_delay = PNAL_SNMP_RX_ERROR_DELAY_MAX;
+         }
+         continue;
+      }
+      rx_error_delay = 0;
+      if (rx_len == 0)
+      {
+         continue;
+      }
+
+      tx_len = pnal_snmp_handle_request (
+         p_snmp->net,
+         p_snmp->rx_buffer,
+         (size_t)rx_len,
+         p_snmp->tx_buffer,
+         sizeof (p_snmp->tx_buffer));
+      if (tx_len > 0)
+      {
+         (void)sendto (
+            p_snmp->socket,
+            p_snmp->tx_buffer,
+            (size_t)tx_len,
+            0,
+            (struct sockaddr *)&remote,
+            addr_len);
+      }
+   }
+}
+
+int pnal_snmp_init (pnet_t * net, const pnal_cfg_t * pnal_cfg)
+{
+   struct sockaddr_in local;
+   const int enable = 1;
+
+   pnal_snmp.net = net;
+   pnal_snmp_invalidate_tables();
+   pnal_snmp.socket = socket (PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+   if (pnal_snmp.socket == -1)
+   {
+      LOG_ERROR (PF_SNMP_LOG, "SNMP(%d): Failed to open socket\n", __LINE__);
+      return -1;
+   }
+
+   local = (struct sockaddr_in){
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl (INADDR_ANY),
+      .sin_port = htons (PNAL_SNMP_UDP_PORT),
+      .sin_zero = {0},
+   };
+
+   if (
+      setsockopt (
+         pnal_snmp.socket,
+         SOL_SOCKET,
+         SO_REUSEADDR,
+         &enable,
+         sizeof (enable)) != 0 ||
+      bind (pnal_snmp.socket, (struct sockaddr *)&local, sizeof (local)) != 0)
+   {
+      LOG_ERROR (
+         PF_SNMP_LOG,
+         "SNMP(%d): Failed to bind UDP port %u. Is snmpd running?\n",
+         __LINE__,
+         (unsigned)PNAL_SNMP_UDP_PORT);
+      close (pnal_snmp.socket);
+      return -1;
+   }
+
+   os_thread_create (
+      "pn_snmp",
+      pnal_cfg->snmp_thread.prio,
+      pnal_cfg->snmp_thread.stack_size,
+      pnal_snmp_thread,
+      &pnal_snmp);
+   return 0;
+}
@@ -0,0 +1,57 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2020 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#ifndef PNAL_SNMP_BUILTIN_H
+#define PNAL_SNMP_BUILTIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "pnet_api.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Handle an incoming SNMP message.
+ *
+ * Not thread safe. Called from the SNMP thread only.
+ *
+ * @param net              InOut: The p-net stack instance.
+ * @param p_request        In:    Received message.
+ * @param request_len      In:    Length of received message.
+ * @param p_response       Out:   Buffer for response message.
+ * @param response_size    In:    Size of response buffer.
+ * @return Length of response in p_response, or
+ *         -1 if no response should be sent.
+ * @internal
+ */
+int pnal_snmp_handle_request (
+   pnet_t * net,
+   const uint8_t * p_request,
+   size_t request_len,
+   uint8_t * p_response,
+   size_t response_size);
+
+/************ Internal functions, made available for unit testing ************/
+
+void pnal_snmp_invalidate_tables (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PNAL_SNMP_BUILTIN_H */
@@ -35,6 +35,7 @@ mock_os_data_t mock_os_data;
 mock_lldp_data_t mock_lldp_data;
 mock_file_data_t mock_file_data;
 mock_fspm_data_t mock_fspm_data;
+mock_alarm_data_t mock_alarm_data;
 pnal_eth_handle_t mock_eth_handle;
 
 void mock_clear (void)
@@ -43,6 +44,7 @@ void mock_clear (void)
    memset (&mock_lldp_data, 0, sizeof (mock_lldp_data));
    memset (&mock_file_data, 0, sizeof (mock_file_data));
    memset (&mock_fspm_data, 0, sizeof (mock_fspm_data));
+   memset (&mock_alarm_data, 0, sizeof (mock_alarm_data));
    mock_os_data.eth_status[1].operational_mau_type =
       PNAL_ETH_MAU_COPPER_100BaseTX_FULL_DUPLEX;
    mock_os_data.eth_status[1].running = true;
@@ -168,6 +170,10 @@ int mock_pnal_udp_sendto (
    const uint8_t * data,
    int size)
 {
+   if (size <= (int)sizeof (mock_os_data.udp_sendto_copy))
+   {
+      memcpy (mock_os_data.udp_sendto_copy, data, size);
+   }
    mock_os_data.udp_sendto_len = size;
    mock_os_data.udp_sendto_count++;
 
@@ -302,6 +308,21 @@ int mock_pf_alarm_send_diagnosis (
    return 0;
 }
 
+int mock_pf_alarm_send_diagnosis_items (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   uint16_t subslot_nbr,
+   uint16_t usi,
+   const pf_diag_std_t * p_diag_items,
+   uint16_t nbr_of_items)
+{
+   mock_alarm_data.diag_items_alarm_count++;
+   mock_alarm_data.diag_items_count += nbr_of_items;
+   return 0;
+}
+
 void mock_pf_generate_uuid (
    uint32_t timestamp,
    uint32_t session_number,
@@ -40,6 +40,7 @@ typedef struct mock_os_data_obj
    pnal_eth_status_t eth_status[PNET_MAX_PHYSICAL_PORTS + 1];
    pnal_port_stats_t port_statistics[PNET_MAX_PHYSICAL_PORTS + 1];
 
+   uint8_t udp_sendto_copy[PF_MAX_UDP_PAYLOAD_SIZE];
    uint16_t udp_sendto_len;
    uint16_t udp_sendto_count;
 
@@ -74,7 +75,7 @@ typedef struct mock_lldp_data
 typedef struct mock_file_data
 {
    char filename[PNET_MAX_FILENAME_SIZE];
-   uint8_t object[300];
+   uint8_t object[1000];
    size_t size;
    bool is_save_failing; /* Used for injecting error */
    bool is_load_failing; /* Used for injecting error */
@@ -86,10 +87,17 @@ typedef struct mock_fspm_data
    char im_location[PNET_LOCATION_MAX_SIZE];
 } mock_fspm_data_t;
 
+typedef struct mock_alarm_data
+{
+   uint16_t diag_items_alarm_count; /* Alarms with several diag items */
+   uint16_t diag_items_count;
+} mock_alarm_data_t;
+
 extern mock_os_data_t mock_os_data;
 extern mock_lldp_data_t mock_lldp_data;
 extern mock_file_data_t mock_file_data;
 extern mock_fspm_data_t mock_fspm_data;
+extern mock_alarm_data_t mock_alarm_data;
 
 uint32_t mock_os_get_current_time_us (void);
 uint32_t mock_pnal_get_system_uptime_10ms (void);
@@ -161,6 +169,16 @@ int mock_pf_alarm_send_diagnosis (
    uint16_t subslot_nbr,
    pf_diag_item_t * p_item);
 
+int mock_pf_alarm_send_diagnosis_items (
+   pnet_t * net,
+   pf_ar_t * p_ar,
+   uint32_t api_id,
+   uint16_t slot_nbr,
+   uint16_t subslot_nbr,
+   uint16_t usi,
+   const pf_diag_std_t * p_diag_items,
+   uint16_t nbr_of_items);
+
 void mock_pf_generate_uuid (
    uint32_t timestamp,
    uint32_t session_number,
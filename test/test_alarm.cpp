@@ -20,8 +20,96 @@
 
 #include <gtest/gtest.h>
 
+static const uint8_t controller_mac[] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc};
+
 class AlarmTest : public PnetIntegrationTest
 {
+ protected:
+   pf_ar_t * p_ar;
+   bool closed = false;
+
+   virtual void SetUp() override
+   {
+      PnetIntegrationTest::SetUp();
+
+      p_ar = &net->cmrpc_ar[0];
+      p_ar->in_use = true;
+      memcpy (
+         p_ar->ar_param.cm_initiator_mac_add.addr,
+         controller_mac,
+         sizeof (controller_mac));
+      p_ar->alarm_cr_request.rta_timeout_factor = 1;
+      p_ar->alarm_cr_request.max_alarm_data_length = 200;
+      ASSERT_EQ (pf_alarm_activate (net, p_ar), 0);
+      pf_alarm_enable (p_ar);
+   };
+
+   virtual void TearDown() override
+   {
+      if (!closed)
+      {
+         (void)pf_alarm_close (net, p_ar);
+      }
+      PnetIntegrationTest::TearDown();
+   };
+
+   /** Put an alarm in the send queue of a priority (0 = low, 1 = high) */
+   void alarm_post (uint16_t prio, uint16_t slot)
+   {
+      pf_alarm_data_t alarm_data;
+
+      memset (&alarm_data, 0, sizeof (alarm_data));
+      alarm_data.alarm_type =
+         (prio == 1) ? PF_ALARM_TYPE_PULL : PF_ALARM_TYPE_PROCESS;
+      alarm_data.slot_nbr = slot;
+      ASSERT_EQ (
+         pf_alarm_send_queue_post (&p_ar->alarm_send_q[prio], &alarm_data),
+         0);
+   }
+
+   /** Simulate that the controller has acknowledged the alarm in flight */
+   void alarm_ack (uint16_t prio)
+   {
+      pf_apmx_t * p_apmx = &p_ar->apmx[prio];
+
+      pf_scheduler_remove_if_running (net, &p_apmx->resend_timeout);
+      if (p_apmx->p_rta != NULL)
+      {
+         pnal_buf_free (p_apmx->p_rta);
+         p_apmx->p_rta = NULL;
+      }
+      p_apmx->apms_state = PF_APMS_STATE_OPEN;
+      p_apmx->p_alpmx->alpmi_state = PF_ALPMI_STATE_W_ALARM;
+   }
+
+   /** Put an RTA frame without var part in the receive queue of a
+    *  priority. Defaults to a NACK. */
+   void frame_post (
+      uint16_t prio,
+      uint8_t pdu_type = PF_RTA_PDU_TYPE_NACK,
+      bool tack = false,
+      uint16_t send_seq = 0,
+      uint16_t ack_seq = 0)
+   {
+      pf_apmr_msg_t msg;
+      uint8_t * p_data;
+
+      msg.frame_id_pos = 0;
+      msg.p_buf = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+      ASSERT_TRUE (msg.p_buf != NULL);
+      p_data = (uint8_t *)msg.p_buf->payload;
+      memset (p_data, 0, 14);
+      p_data[6] = (PF_ALARM_PDU_TYPE_VERSION_1 << 4) | pdu_type;
+      p_data[7] = (tack ? 0x10 : 0x00) | 0x01; /* TACK and window size */
+      p_data[8] = send_seq >> 8;
+      p_data[9] = send_seq & 0xff;
+      p_data[10] = ack_seq >> 8;
+      p_data[11] = ack_seq & 0xff;
+      msg.p_buf->len = 14; /* Frame ID, fixed part and var_part_len */
+      ASSERT_EQ (
+         pf_alarm_receive_queue_post (&p_ar->apmx[prio].alarm_receive_q, &msg),
+         0);
+   }
 };
 
 class AlarmUnitTest : public PnetUnitTest
@@ -37,7 +125,7 @@ TEST_F (AlarmUnitTest, AlarmCheckAddDiagItemToSummary)
    pf_ar_t ar;
 
    /* Prepare default input data */
-   memset (&ar, 0, sizeof (ar));
+   memset ((void *)&ar, 0, sizeof (ar));
    memset (&subslot, 0, sizeof (subslot));
    subslot.ownsm_state = PF_OWNSM_STATE_IOC;
    subslot.owner = &ar;
@@ -295,9 +383,39 @@ TEST_F (AlarmUnitTest, AlarmCheckAddDiagItemToSummary)
       PNET_DIAG_CH_PROP_MAINT_FAULT);
 }
 
+TEST_F (AlarmUnitTest, AlarmCheckDiagItemAlarmType)
+{
+   pf_diag_item_t diag_item;
+
+   memset (&diag_item, 0, sizeof (diag_item));
+   diag_item.usi = PF_USI_CHANNEL_DIAGNOSIS;
+   diag_item.fmt.std.ch_error_type = PF_WRT_ERROR_REMOTE_MISMATCH;
+   EXPECT_EQ (
+      pf_alarm_diag_item_alarm_type (&diag_item),
+      PF_ALARM_TYPE_PORT_DATA_CHANGE);
+
+   diag_item.usi = PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS;
+   EXPECT_EQ (
+      pf_alarm_diag_item_alarm_type (&diag_item),
+      PF_ALARM_TYPE_PORT_DATA_CHANGE);
+
+   diag_item.fmt.std.ch_error_type = 0x0001; /* Short circuit */
+   EXPECT_EQ (
+      pf_alarm_diag_item_alarm_type (&diag_item),
+      PF_ALARM_TYPE_DIAGNOSIS);
+
+   /* USI format, where the error type field is not used */
+   diag_item.usi = 0x1234;
+   diag_item.fmt.std.ch_error_type = PF_WRT_ERROR_REMOTE_MISMATCH;
+   EXPECT_EQ (
+      pf_alarm_diag_item_alarm_type (&diag_item),
+      PF_ALARM_TYPE_DIAGNOSIS);
+}
+
 TEST_F (AlarmUnitTest, AlarmCheckSendQueueHandling)
 {
    pf_alarm_send_queue_t queue;
+   pf_alarm_data_t items[PNET_MAX_ALARMS];
    pf_alarm_data_t post_message;
    pf_alarm_data_t fetch_message;
    int ix = 0;
@@ -306,7 +424,8 @@ TEST_F (AlarmUnitTest, AlarmCheckSendQueueHandling)
 
    memset (&post_message, 0, sizeof (post_message));
    memset (&fetch_message, 0, sizeof (fetch_message));
-   memset (&queue, 0, sizeof (queue));
+   memset ((void *)&queue, 0, sizeof (queue));
+   pf_alarm_send_queue_init (&queue, items, PNET_MAX_ALARMS);
 
    /* Set up queue */
    EXPECT_FALSE (pf_alarm_queue_is_available(&queue.accountant));
@@ -314,8 +433,7 @@ TEST_F (AlarmUnitTest, AlarmCheckSendQueueHandling)
    pf_alarm_queue_mutex_create (&queue.accountant); /* No-op */
    EXPECT_TRUE (pf_alarm_queue_is_available(&queue.accountant));
    pf_alarm_send_queue_reset (&queue);
-   EXPECT_EQ (queue.accountant.count, 0); /* Do not bother with mutex
-                                            (this test runs in single thread) */
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
 
    /* Fill the queue */
    for (ix = 0; ix < PNET_MAX_ALARMS; ix++)
@@ -324,13 +442,13 @@ TEST_F (AlarmUnitTest, AlarmCheckSendQueueHandling)
       err = pf_alarm_send_queue_post (&queue, &post_message);
       EXPECT_EQ (err, 0);
    }
-   EXPECT_EQ (queue.accountant.count, PNET_MAX_ALARMS);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), PNET_MAX_ALARMS);
 
    /* Add to full queue */
    post_message.sequence_number += 1;
    err = pf_alarm_send_queue_post (&queue, &post_message);
    EXPECT_EQ (err, -1);
-   EXPECT_EQ (queue.accountant.count, PNET_MAX_ALARMS);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), PNET_MAX_ALARMS);
 
    /* Fetch from the queue */
    for (ix = 0; ix < PNET_MAX_ALARMS; ix++)
@@ -339,20 +457,20 @@ TEST_F (AlarmUnitTest, AlarmCheckSendQueueHandling)
       EXPECT_EQ (err, 0);
       EXPECT_EQ (fetch_message.sequence_number, SEQUENCE_START_NUMBER + ix);
    }
-   EXPECT_EQ (queue.accountant.count, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
 
    /* Fetch from empty queue */
    err = pf_alarm_send_queue_fetch (&queue, &fetch_message);
    EXPECT_EQ (err, -1);
-   EXPECT_EQ (queue.accountant.count, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
 
    /* Reset the queue */
    err = pf_alarm_send_queue_post (&queue, &post_message);
    EXPECT_EQ (err, 0);
-   EXPECT_EQ (queue.accountant.count, 1);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 1);
 
    pf_alarm_send_queue_reset (&queue);
-   EXPECT_EQ (queue.accountant.count, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
 
    /* Wrap read_index and write_index, by adding and fetching a lot */
    for (ix = 0; ix < PNET_MAX_ALARMS * 5; ix++)
@@ -360,17 +478,17 @@ TEST_F (AlarmUnitTest, AlarmCheckSendQueueHandling)
       post_message.sequence_number = SEQUENCE_START_NUMBER + ix;
       err = pf_alarm_send_queue_post (&queue, &post_message);
       EXPECT_EQ (err, 0);
-      EXPECT_EQ (queue.accountant.count, 1);
+      EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 1);
 
       err = pf_alarm_send_queue_fetch (&queue, &fetch_message);
       EXPECT_EQ (err, 0);
-      EXPECT_EQ (queue.accountant.count, 0);
+      EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
       EXPECT_EQ (fetch_message.sequence_number, SEQUENCE_START_NUMBER + ix);
    }
 
    /* Close down queue */
    pf_alarm_send_queue_reset (&queue);
-   EXPECT_EQ (queue.accountant.count, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
    EXPECT_TRUE (pf_alarm_queue_is_available(&queue.accountant));
    pf_alarm_queue_mutex_destroy (&queue.accountant);
    pf_alarm_queue_mutex_destroy (&queue.accountant); /* Should be safe */
@@ -386,9 +504,154 @@ TEST_F (AlarmUnitTest, AlarmCheckSendQueueHandling)
    EXPECT_EQ (err, -1);
 }
 
+TEST_F (AlarmUnitTest, AlarmCheckSendQueueSize)
+{
+   pf_alarm_send_queue_t queue;
+   pf_alarm_data_t items[2];
+   pf_alarm_data_t message;
+   int ix;
+
+   memset (&message, 0, sizeof (message));
+   memset ((void *)&queue, 0, sizeof (queue));
+   pf_alarm_send_queue_init (&queue, items, NELEMENTS (items));
+   pf_alarm_queue_mutex_create (&queue.accountant);
+   pf_alarm_send_queue_reset (&queue);
+
+   for (ix = 0; ix < 10; ix++)
+   {
+      EXPECT_EQ (pf_alarm_send_queue_post (&queue, &message), 0);
+      EXPECT_EQ (pf_alarm_send_queue_post (&queue, &message), 0);
+      EXPECT_EQ (pf_alarm_send_queue_post (&queue, &message), -1);
+      EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 2);
+
+      EXPECT_EQ (pf_alarm_send_queue_fetch (&queue, &message), 0);
+      EXPECT_EQ (pf_alarm_send_queue_fetch (&queue, &message), 0);
+      EXPECT_EQ (pf_alarm_send_queue_fetch (&queue, &message), -1);
+      EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
+   }
+
+   pf_alarm_queue_mutex_destroy (&queue.accountant);
+}
+
+TEST_F (AlarmUnitTest, AlarmCheckLatencyHistogram)
+{
+   pnet_alarm_latency_t latency;
+
+   memset (&latency, 0, sizeof (latency));
+
+   pf_alarm_latency_add (&latency, 999);
+   EXPECT_EQ (latency.buckets[0], 1u);
+   pf_alarm_latency_add (&latency, 1000);
+   EXPECT_EQ (latency.buckets[1], 1u);
+   pf_alarm_latency_add (&latency, 3999);
+   EXPECT_EQ (latency.buckets[2], 1u);
+   pf_alarm_latency_add (&latency, 1023999);
+   EXPECT_EQ (latency.buckets[10], 1u);
+   pf_alarm_latency_add (&latency, 1024000);
+   pf_alarm_latency_add (&latency, 0xFFFFFFFF);
+   EXPECT_EQ (latency.buckets[PNET_ALARM_LATENCY_BUCKETS - 1], 2u);
+
+   EXPECT_EQ (latency.count, 6u);
+   EXPECT_EQ (latency.last_us, 0xFFFFFFFFu);
+   EXPECT_EQ (latency.max_us, 0xFFFFFFFFu);
+   pf_alarm_latency_add (&latency, 5);
+   EXPECT_EQ (latency.last_us, 5u);
+   EXPECT_EQ (latency.max_us, 0xFFFFFFFFu);
+   EXPECT_EQ (latency.buckets[0], 2u);
+}
+
+TEST_F (AlarmUnitTest, AlarmCheckSendQueueMergeDiagnosis)
+{
+   pf_alarm_send_queue_t queue;
+   pf_alarm_data_t items[PNET_MAX_ALARMS];
+   pf_alarm_data_t post_message;
+   pf_alarm_data_t fetch_message;
+   pf_diag_std_t * p_item = (pf_diag_std_t *)post_message.payload.data;
+   int err = 0;
+
+   memset (&post_message, 0, sizeof (post_message));
+   memset (&fetch_message, 0, sizeof (fetch_message));
+   memset ((void *)&queue, 0, sizeof (queue));
+   pf_alarm_send_queue_init (&queue, items, PNET_MAX_ALARMS);
+   pf_alarm_queue_mutex_create (&queue.accountant);
+   pf_alarm_send_queue_reset (&queue);
+
+   post_message.alarm_type = PF_ALARM_TYPE_DIAGNOSIS;
+   post_message.slot_nbr = 1;
+   post_message.subslot_nbr = 1;
+   post_message.payload.usi = PF_USI_EXTENDED_CHANNEL_DIAGNOSIS;
+   post_message.payload.len = sizeof (pf_diag_std_t);
+   p_item->ch_nbr = 2;
+   p_item->ch_error_type = 0x0100;
+   p_item->ext_ch_add_value = 7;
+   PF_DIAG_CH_PROP_SPEC_SET (
+      p_item->ch_properties,
+      PF_DIAG_CH_PROP_SPEC_APPEARS);
+
+   /* Nothing to merge with in an empty queue */
+   err = pf_alarm_send_queue_merge (&queue, &post_message);
+   EXPECT_EQ (err, -1);
+   err = pf_alarm_send_queue_post (&queue, &post_message);
+   EXPECT_EQ (err, 0);
+
+   /* Same diagnosis with a new value replaces the waiting alarm */
+   p_item->ext_ch_add_value = 8;
+   err = pf_alarm_send_queue_merge (&queue, &post_message);
+   EXPECT_EQ (err, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 1);
+
+   /* Removal of the old value is sent after the new value */
+   p_item->ext_ch_add_value = 7;
+   PF_DIAG_CH_PROP_SPEC_SET (
+      p_item->ch_properties,
+      PF_DIAG_CH_PROP_SPEC_DIS_OTHERS_REMAIN);
+   err = pf_alarm_send_queue_merge (&queue, &post_message);
+   EXPECT_EQ (err, -1);
+   err = pf_alarm_send_queue_post (&queue, &post_message);
+   EXPECT_EQ (err, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 2);
+
+   /* A new value is not merged ahead of the waiting removal */
+   p_item->ext_ch_add_value = 9;
+   PF_DIAG_CH_PROP_SPEC_SET (
+      p_item->ch_properties,
+      PF_DIAG_CH_PROP_SPEC_APPEARS);
+   err = pf_alarm_send_queue_merge (&queue, &post_message);
+   EXPECT_EQ (err, -1);
+
+   /* Other channel or other alarm type is not merged */
+   p_item->ch_nbr = 3;
+   err = pf_alarm_send_queue_merge (&queue, &post_message);
+   EXPECT_EQ (err, -1);
+   p_item->ch_nbr = 2;
+   post_message.alarm_type = PF_ALARM_TYPE_PULL;
+   err = pf_alarm_send_queue_merge (&queue, &post_message);
+   EXPECT_EQ (err, -1);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 2);
+
+   err = pf_alarm_send_queue_fetch (&queue, &fetch_message);
+   EXPECT_EQ (err, 0);
+   p_item = (pf_diag_std_t *)fetch_message.payload.data;
+   EXPECT_EQ (fetch_message.alarm_type, PF_ALARM_TYPE_DIAGNOSIS);
+   EXPECT_EQ (p_item->ext_ch_add_value, 8UL);
+   EXPECT_EQ (
+      PF_DIAG_CH_PROP_SPEC_GET (p_item->ch_properties),
+      PF_DIAG_CH_PROP_SPEC_APPEARS);
+
+   err = pf_alarm_send_queue_fetch (&queue, &fetch_message);
+   EXPECT_EQ (err, 0);
+   EXPECT_EQ (p_item->ext_ch_add_value, 7UL);
+   EXPECT_EQ (
+      PF_DIAG_CH_PROP_SPEC_GET (p_item->ch_properties),
+      PF_DIAG_CH_PROP_SPEC_DIS_OTHERS_REMAIN);
+
+   pf_alarm_queue_mutex_destroy (&queue.accountant);
+}
+
 TEST_F (AlarmUnitTest, AlarmCheckReceiveQueueHandling)
 {
    pf_alarm_receive_queue_t queue;
+   pf_apmr_msg_t items[PNET_MAX_ALARMS];
    pf_apmr_msg_t post_frame;
    pf_apmr_msg_t fetch_frame;
    int ix = 0;
@@ -398,7 +661,8 @@ TEST_F (AlarmUnitTest, AlarmCheckReceiveQueueHandling)
 
    memset (&post_frame, 0, sizeof (post_frame));
    memset (&fetch_frame, 0, sizeof (fetch_frame));
-   memset (&queue, 0, sizeof (queue));
+   memset ((void *)&queue, 0, sizeof (queue));
+   pf_alarm_receive_queue_init (&queue, items, PNET_MAX_ALARMS);
 
    /* Set up queue */
    EXPECT_FALSE (pf_alarm_queue_is_available(&queue.accountant));
@@ -406,8 +670,7 @@ TEST_F (AlarmUnitTest, AlarmCheckReceiveQueueHandling)
    pf_alarm_queue_mutex_create (&queue.accountant); /* No-op */
    EXPECT_TRUE (pf_alarm_queue_is_available(&queue.accountant));
    pf_alarm_receive_queue_reset (&queue);
-   EXPECT_EQ (queue.accountant.count, 0); /* Do not bother with mutex
-                                            (this test runs in single thread) */
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
 
    /* Fill the queue */
    for (ix = 0; ix < PNET_MAX_ALARMS; ix++)
@@ -416,42 +679,44 @@ TEST_F (AlarmUnitTest, AlarmCheckReceiveQueueHandling)
       post_frame.p_buf = (pnal_buf_t *)(POINTER_START_NUMBER + ix);
       err = pf_alarm_receive_queue_post (&queue, &post_frame);
       EXPECT_EQ (err, 0);
-      EXPECT_EQ (queue.accountant.count, ix + 1);
+      EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), ix + 1);
    }
-   EXPECT_EQ (queue.accountant.count, PNET_MAX_ALARMS);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), PNET_MAX_ALARMS);
 
    /* Add to full queue */
    post_frame.frame_id_pos += 1;
    post_frame.p_buf -= 1;
    err = pf_alarm_receive_queue_post (&queue, &post_frame);
    EXPECT_EQ (err, -1);
-   EXPECT_EQ (queue.accountant.count, PNET_MAX_ALARMS);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), PNET_MAX_ALARMS);
 
    /* Fetch from the queue */
    for (ix = 0; ix < PNET_MAX_ALARMS; ix++)
    {
       err = pf_alarm_receive_queue_fetch (&queue, &fetch_frame);
       EXPECT_EQ (err, 0);
-      EXPECT_EQ (queue.accountant.count, PNET_MAX_ALARMS - ix - 1);
+      EXPECT_EQ (
+         pf_alarm_queue_count (&queue.accountant),
+         PNET_MAX_ALARMS - ix - 1);
       EXPECT_EQ (fetch_frame.frame_id_pos, POSITION_START_NUMBER + ix);
       EXPECT_EQ ((uintptr_t)fetch_frame.p_buf, POINTER_START_NUMBER + ix);
    }
-   EXPECT_EQ (queue.accountant.count, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
 
    /* Fetch from empty queue */
    err = pf_alarm_receive_queue_fetch (&queue, &fetch_frame);
    EXPECT_EQ (err, -1);
-   EXPECT_EQ (queue.accountant.count, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
 
    /* Reset the queue (will free allocated buffers) */
    post_frame.frame_id_pos = 42;
    post_frame.p_buf = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
    err = pf_alarm_receive_queue_post (&queue, &post_frame);
    EXPECT_EQ (err, 0);
-   EXPECT_EQ (queue.accountant.count, 1);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 1);
 
    pf_alarm_receive_queue_reset (&queue);
-   EXPECT_EQ (queue.accountant.count, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
 
    /* Wrap read_index and write_index, by adding and fetching a lot */
    for (ix = 0; ix < PNET_MAX_ALARMS * 5; ix++)
@@ -460,18 +725,18 @@ TEST_F (AlarmUnitTest, AlarmCheckReceiveQueueHandling)
       post_frame.p_buf = (pnal_buf_t *)(POINTER_START_NUMBER + ix);
       err = pf_alarm_receive_queue_post (&queue, &post_frame);
       EXPECT_EQ (err, 0);
-      EXPECT_EQ (queue.accountant.count, 1);
+      EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 1);
 
       err = pf_alarm_receive_queue_fetch (&queue, &fetch_frame);
       EXPECT_EQ (err, 0);
-      EXPECT_EQ (queue.accountant.count, 0);
+      EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
       EXPECT_EQ (fetch_frame.frame_id_pos, POSITION_START_NUMBER + ix);
       EXPECT_EQ ((uintptr_t)fetch_frame.p_buf, POINTER_START_NUMBER + ix);
    }
 
    /* Close down queue */
    pf_alarm_receive_queue_reset (&queue);
-   EXPECT_EQ (queue.accountant.count, 0);
+   EXPECT_EQ (pf_alarm_queue_count (&queue.accountant), 0);
    EXPECT_TRUE (pf_alarm_queue_is_available(&queue.accountant));
    pf_alarm_queue_mutex_destroy (&queue.accountant);
    pf_alarm_queue_mutex_destroy (&queue.accountant); /* Should be safe */
@@ -487,3 +752,208 @@ TEST_F (AlarmUnitTest, AlarmCheckReceiveQueueHandling)
    err = pf_alarm_receive_queue_fetch (&queue, &fetch_frame);
    EXPECT_EQ (err, -1);
 }
+
+TEST_F (AlarmTest, AlarmCheckSendBudget)
+{
+   uint16_t ix;
+
+   for (ix = 0; ix < 3; ix++)
+   {
+      alarm_post (1, ix);
+      alarm_post (0, ix);
+   }
+
+   /* Budget 0 means one alarm per call. High prio goes first. */
+   net->fspm_cfg.alarm_send_budget = 0;
+   pf_alarm_periodic (net);
+   EXPECT_EQ (mock_os_data.eth_send_count, 1);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[1].accountant), 2);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[0].accountant), 3);
+   EXPECT_EQ (p_ar->alarm_low_prio_skips, 1);
+
+   /* Each priority waits for the acknowledgement of its previous alarm */
+   net->fspm_cfg.alarm_send_budget = 4;
+   pf_alarm_periodic (net);
+   EXPECT_EQ (mock_os_data.eth_send_count, 2);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[1].accountant), 2);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[0].accountant), 2);
+   EXPECT_EQ (p_ar->alarm_low_prio_skips, 0);
+   pf_alarm_periodic (net);
+   EXPECT_EQ (mock_os_data.eth_send_count, 2);
+
+   /* A budget of N sends one alarm per priority */
+   alarm_ack (1);
+   alarm_ack (0);
+   pf_alarm_periodic (net);
+   EXPECT_EQ (mock_os_data.eth_send_count, 4);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[1].accountant), 1);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[0].accountant), 1);
+
+   /* A budget of 1 sends only the high prio alarm */
+   net->fspm_cfg.alarm_send_budget = 1;
+   alarm_ack (1);
+   alarm_ack (0);
+   pf_alarm_periodic (net);
+   EXPECT_EQ (mock_os_data.eth_send_count, 5);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[1].accountant), 0);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[0].accountant), 1);
+   EXPECT_EQ (p_ar->apmx[1].counters.sent, 3u);
+   EXPECT_EQ (p_ar->apmx[0].counters.sent, 2u);
+}
+
+TEST_F (AlarmTest, AlarmCheckLowPrioNotStarved)
+{
+   uint16_t ix;
+
+   net->fspm_cfg.alarm_send_budget = 1;
+   alarm_post (0, 1);
+
+   /* High prio alarms keep coming, and use the whole budget */
+   for (ix = 0; ix < PF_ALARM_LOW_PRIO_MAX_SKIPS; ix++)
+   {
+      alarm_post (1, ix);
+      pf_alarm_periodic (net);
+      alarm_ack (1);
+      EXPECT_EQ (mock_os_data.eth_send_count, ix + 1);
+      EXPECT_EQ (p_ar->alarm_low_prio_skips, ix + 1);
+      EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[0].accountant), 1);
+   }
+
+   /* The low prio alarm is sent before the next high prio alarm */
+   alarm_post (1, ix);
+   pf_alarm_periodic (net);
+   EXPECT_EQ (mock_os_data.eth_send_count, ix + 1);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[0].accountant), 0);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[1].accountant), 1);
+   EXPECT_EQ (p_ar->alarm_low_prio_skips, 0);
+
+   /* Then high prio is first again */
+   pf_alarm_periodic (net);
+   EXPECT_EQ (mock_os_data.eth_send_count, ix + 2);
+   EXPECT_EQ (pf_alarm_queue_count (&p_ar->alarm_send_q[1].accountant), 0);
+}
+
+TEST_F (AlarmTest, AlarmCheckReceiveBudget)
+{
+   pf_apmx_t * p_apmx = &p_ar->apmx[1];
+
+   frame_post (1);
+   frame_post (1);
+   frame_post (1);
+   frame_post (0);
+
+   /* Remaining frames are left in the queue for the next call */
+   net->fspm_cfg.alarm_receive_budget = 1;
+   pf_alarm_periodic (net);
+   EXPECT_EQ (pf_alarm_queue_count (&p_apmx->alarm_receive_q.accountant), 2);
+   EXPECT_EQ (
+      pf_alarm_queue_count (&p_ar->apmx[0].alarm_receive_q.accountant),
+      0);
+   EXPECT_EQ (p_apmx->counters.receive_queue_depth_max, 3u);
+   EXPECT_EQ (p_apmx->counters.receive_budget_exhausted, 1u);
+   EXPECT_EQ (p_ar->apmx[0].counters.receive_budget_exhausted, 0u);
+
+   pf_alarm_periodic (net);
+   EXPECT_EQ (pf_alarm_queue_count (&p_apmx->alarm_receive_q.accountant), 1);
+   EXPECT_EQ (p_apmx->counters.receive_budget_exhausted, 2u);
+
+   pf_alarm_periodic (net);
+   EXPECT_EQ (pf_alarm_queue_count (&p_apmx->alarm_receive_q.accountant), 0);
+   EXPECT_EQ (p_apmx->counters.receive_budget_exhausted, 2u);
+
+   /* No limit */
+   frame_post (1);
+   frame_post (1);
+   net->fspm_cfg.alarm_receive_budget = 0;
+   pf_alarm_periodic (net);
+   EXPECT_EQ (pf_alarm_queue_count (&p_apmx->alarm_receive_q.accountant), 0);
+   EXPECT_EQ (p_apmx->counters.receive_budget_exhausted, 2u);
+}
+
+TEST_F (AlarmTest, AlarmCheckPrebuiltHeader)
+{
+   const pnet_ethaddr_t * device_mac = pf_cmina_get_device_macaddr (net);
+   uint8_t expected[PF_ALARM_HEADER_SIZE];
+   uint16_t ix;
+
+   /* DA, SA, VLAN tag with priority 5 (low) or 6 (high), EtherType and
+    * frame ID, as previously encoded for each frame */
+   for (ix = 0; ix < PF_ALARM_NUMBER_OF_PRIORITY_LEVELS; ix++)
+   {
+      memcpy (&expected[0], controller_mac, 6);
+      memcpy (&expected[6], device_mac->addr, 6);
+      expected[12] = 0x81;
+      expected[13] = 0x00;
+      expected[14] = (ix == 1) ? 0xc0 : 0xa0;
+      expected[15] = 0x00;
+      expected[16] = 0x88;
+      expected[17] = 0x92;
+      expected[18] = (ix == 1) ? 0xfc : 0xfe;
+      expected[19] = 0x01;
+      EXPECT_EQ (memcmp (p_ar->apmx[ix].header, expected, sizeof (expected)), 0)
+         << "Priority " << ix;
+
+      /* The sent frame starts with the prebuilt header */
+      mock_os_data.eth_send_count = 0;
+      alarm_post (ix, 1);
+      pf_alarm_periodic (net);
+      ASSERT_EQ (mock_os_data.eth_send_count, 1);
+      EXPECT_EQ (
+         memcmp (mock_os_data.eth_send_copy, expected, sizeof (expected)),
+         0);
+      /* PDU type DATA, with TACK */
+      EXPECT_EQ (mock_os_data.eth_send_copy[24], 0x11);
+      EXPECT_EQ (mock_os_data.eth_send_copy[25] & 0x10, 0x10);
+   }
+}
+
+extern "C" uint32_t pnal_buf_alloc_cnt;
+
+TEST_F (AlarmTest, AlarmCheckNoTackBufferFreed)
+{
+   pf_apmx_t * p_apmx = &p_ar->apmx[1];
+   uint8_t held_frame[PF_FRAME_BUFFER_SIZE];
+   uint32_t outstanding;
+   uint16_t held_len;
+   uint16_t ix;
+
+   /* An alarm notification is held until its TACK arrives */
+   alarm_post (1, 1);
+   pf_alarm_periodic (net);
+   ASSERT_EQ (mock_os_data.eth_send_count, 1);
+   ASSERT_TRUE (p_apmx->p_rta != NULL);
+   held_len = p_apmx->p_rta->len;
+   memcpy (held_frame, p_apmx->p_rta->payload, held_len);
+   outstanding = pnal_buf_alloc_cnt;
+
+   /* Repeated DATA frames are acknowledged with ACK frames. Each of them is
+    * sent in its own buffer, which is not kept. The ack_seq_nbr does not
+    * acknowledge the held alarm notification. */
+   for (ix = 0; ix < 2; ix++)
+   {
+      frame_post (
+         1,
+         PF_RTA_PDU_TYPE_DATA,
+         true,
+         p_apmx->exp_seq_count_o,
+         0x1234);
+      pf_alarm_periodic (net);
+      ASSERT_EQ (mock_os_data.eth_send_count, 2 + ix);
+
+      /* PDU type ACK, without TACK */
+      EXPECT_EQ (mock_os_data.eth_send_copy[24], 0x13);
+      EXPECT_EQ (mock_os_data.eth_send_copy[25] & 0x10, 0x00);
+      EXPECT_EQ (pnal_buf_alloc_cnt, outstanding);
+
+      /* The held alarm notification is not overwritten */
+      ASSERT_TRUE (p_apmx->p_rta != NULL);
+      EXPECT_EQ (p_apmx->p_rta->len, held_len);
+      EXPECT_EQ (memcmp (p_apmx->p_rta->payload, held_frame, held_len), 0);
+   }
+
+   /* Freed when the alarm instance is closed */
+   closed = true;
+   pf_alarm_close (net, p_ar);
+   EXPECT_TRUE (p_apmx->p_rta == NULL);
+   EXPECT_EQ (pnal_buf_alloc_cnt, outstanding - 1);
+}
@@ -111,3 +111,159 @@ TEST_F (BlockReaderUnitTest, BlockReaderTestGetBits)
    EXPECT_EQ (0ul, pf_get_bits (0x80000000, 32, 3)); /* Illegal position */
    EXPECT_EQ (0ul, pf_get_bits (0x80000000, 33, 3)); /* Illegal position */
 }
+
+TEST_F (BlockReaderUnitTest, BlockReaderTestGetIntegersAndHeaders)
+{
+   pf_get_info_t get_info;
+   pf_block_header_t header;
+   uint16_t pos = 0;
+   uint8_t buffer[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+
+   get_info.result = PF_PARSE_OK;
+   get_info.is_big_endian = true;
+   get_info.p_buf = buffer;
+   get_info.len = sizeof (buffer);
+
+   EXPECT_EQ (pf_get_uint16 (&get_info, &pos), 0x0102);
+   EXPECT_EQ (pf_get_uint32 (&get_info, &pos), 0x03040506u);
+   EXPECT_EQ (pos, 6);
+
+   pos = 0;
+   get_info.is_big_endian = false;
+   EXPECT_EQ (pf_get_uint16 (&get_info, &pos), 0x0201);
+   EXPECT_EQ (pf_get_uint32 (&get_info, &pos), 0x06050403u);
+   EXPECT_EQ (get_info.result, PF_PARSE_OK);
+
+   pos = 0;
+   get_info.is_big_endian = true;
+   pf_get_block_header (&get_info, &pos, &header);
+   EXPECT_EQ (get_info.result, PF_PARSE_OK);
+   EXPECT_EQ (header.block_type, 0x0102);
+   EXPECT_EQ (header.block_length, 0x0304);
+   EXPECT_EQ (header.block_version_high, 0x05);
+   EXPECT_EQ (header.block_version_low, 0x06);
+
+   /* Only one byte left */
+   EXPECT_EQ (pf_get_uint16 (&get_info, &pos), 0);
+   EXPECT_EQ (get_info.result, PF_PARSE_END_OF_INPUT);
+   EXPECT_EQ (pos, 6);
+
+   /* Keep first error */
+   pos = 0;
+   EXPECT_EQ (pf_get_uint16 (&get_info, &pos), 0);
+   EXPECT_EQ (get_info.result, PF_PARSE_END_OF_INPUT);
+
+   /* Outputs are cleared on error */
+   pf_get_block_header (&get_info, &pos, &header);
+   EXPECT_EQ (header.block_type, 0);
+   EXPECT_EQ (header.block_length, 0);
+   EXPECT_EQ (header.block_version_high, 0);
+   EXPECT_EQ (header.block_version_low, 0);
+}
+
+TEST_F (BlockReaderUnitTest, BlockReaderTestShortRpcHeader)
+{
+   pf_get_info_t get_info;
+   pf_rpc_header_t rpc;
+   uint16_t pos = 0;
+   uint8_t buffer[79];
+
+   memset (buffer, 0xff, sizeof (buffer));
+   memset (&rpc, 0xa5, sizeof (rpc));
+   get_info.result = PF_PARSE_OK;
+   get_info.is_big_endian = true;
+   get_info.p_buf = buffer;
+   get_info.len = sizeof (buffer);
+
+   pf_get_dce_rpc_header (&get_info, &pos, &rpc);
+   EXPECT_EQ (get_info.result, PF_PARSE_END_OF_INPUT);
+   EXPECT_EQ (pos, 0);
+   EXPECT_EQ (rpc.packet_type, 0);
+   EXPECT_EQ (rpc.length_of_body, 0);
+   EXPECT_EQ (rpc.activity_uuid.data1, 0u);
+}
+
+#if PNET_OPTION_FAST_STARTUP
+TEST_F (BlockReaderUnitTest, BlockReaderTestGetArFsuRequest)
+{
+   pf_get_info_t get_info;
+   uint16_t pos = 0;
+   pf_ar_t ar;
+   /* ARFSUBlockReq content, after the block header */
+   uint8_t buffer[] = {
+      0x00, 0x00,                         /* Padding */
+      0x06, 0x01, 0x00, 0x18, 0x01, 0x00, /* FSParameterBlock header */
+      0x00, 0x00,                         /* Padding */
+      0x00, 0x00, 0x00, 0x01,             /* FSParameterMode */
+      0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, /* FSParameterUUID */
+      0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10,
+   };
+
+   memset ((void *)&ar, 0, sizeof (ar));
+   get_info.result = PF_PARSE_OK;
+   get_info.is_big_endian = true;
+   get_info.p_buf = buffer;
+   get_info.len = sizeof (buffer);
+
+   pf_get_ar_fsu_request (&get_info, &pos, sizeof (buffer) + 2, &ar);
+   EXPECT_EQ (get_info.result, PF_PARSE_OK);
+   EXPECT_EQ (pos, sizeof (buffer));
+   EXPECT_TRUE (ar.fast_startup_data.valid);
+   EXPECT_EQ (ar.fast_startup_data.fs_parameter_block.fs_parameter_mode, 1u);
+   EXPECT_EQ (
+      ar.fast_startup_data.fs_parameter_block.fs_parameter_uuid.data1,
+      0x01020304u);
+   EXPECT_EQ (
+      ar.fast_startup_data.fs_parameter_block.fs_parameter_uuid.data4[7],
+      0x10);
+
+   /* Sub-block longer than the enclosing block */
+   buffer[5] = 0x40;
+   pos = 0;
+   pf_get_ar_fsu_request (&get_info, &pos, sizeof (buffer) + 2, &ar);
+   EXPECT_EQ (get_info.result, PF_PARSE_ERROR);
+   EXPECT_FALSE (ar.fast_startup_data.valid);
+
+   /* FSParameterBlock shorter than its fixed size */
+   buffer[5] = 0x14;
+   pos = 0;
+   get_info.result = PF_PARSE_OK;
+   pf_get_ar_fsu_request (&get_info, &pos, sizeof (buffer) + 2, &ar);
+   EXPECT_EQ (get_info.result, PF_PARSE_ERROR);
+   EXPECT_FALSE (ar.fast_startup_data.valid);
+
+   /* Sub-block length too small to hold the block version */
+   buffer[5] = 0x01;
+   pos = 0;
+   get_info.result = PF_PARSE_OK;
+   pf_get_ar_fsu_request (&get_info, &pos, sizeof (buffer) + 2, &ar);
+   EXPECT_EQ (get_info.result, PF_PARSE_ERROR);
+   EXPECT_FALSE (ar.fast_startup_data.valid);
+
+   /* Block length too small to hold the version and padding */
+   buffer[5] = 0x18;
+   pos = 0;
+   get_info.result = PF_PARSE_OK;
+   pf_get_ar_fsu_request (&get_info, &pos, 1, &ar);
+   EXPECT_EQ (get_info.result, PF_PARSE_ERROR);
+   EXPECT_FALSE (ar.fast_startup_data.valid);
+   pos = 0;
+   get_info.result = PF_PARSE_OK;
+   pf_get_ar_fsu_request (&get_info, &pos, 3, &ar);
+   EXPECT_EQ (get_info.result, PF_PARSE_ERROR);
+
+   /* Block length beyond the end of the buffer */
+   pos = 0;
+   get_info.result = PF_PARSE_OK;
+   pf_get_ar_fsu_request (&get_info, &pos, sizeof (buffer) + 3, &ar);
+   EXPECT_EQ (get_info.result, PF_PARSE_ERROR);
+
+   /* Only padding */
+   pos = 0;
+   get_info.result = PF_PARSE_OK;
+   pf_get_ar_fsu_request (&get_info, &pos, 4, &ar);
+   EXPECT_EQ (get_info.result, PF_PARSE_OK);
+   EXPECT_EQ (pos, 2);
+   EXPECT_TRUE (ar.fast_startup_data.valid);
+}
+#endif
@@ -0,0 +1,461 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2021 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+#include "mocks.h"
+
+#include "pf_block_writer.h"
+#include "pf_includes.h"
+
+#include <gtest/gtest.h>
+
+/* Blocks are written at this position, to check that the position is taken
+ * into account in the buffer size check */
+#define TEST_START_POS 3
+#define TEST_FILL      0xA5
+
+class BlockWriterUnitTest : public PnetUnitTest
+{
+ protected:
+   virtual void SetUp() override
+   {
+      memset ((void *)&ar, 0, sizeof (ar));
+      clear_buffer();
+   }
+
+   void clear_buffer()
+   {
+      memset (buffer, TEST_FILL, sizeof (buffer));
+      pos = TEST_START_POS;
+   }
+
+   /** true if no byte from start_pos and onwards has been written */
+   bool untouched_from (uint16_t start_pos)
+   {
+      uint16_t ix;
+
+      for (ix = start_pos; ix < sizeof (buffer); ix++)
+      {
+         if (buffer[ix] != TEST_FILL)
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /** Buffer size for a block of block_size bytes at TEST_START_POS */
+   uint16_t res_len (size_t block_size)
+   {
+      return (uint16_t)(TEST_START_POS + block_size);
+   }
+
+   pf_ar_t ar;
+   uint8_t buffer[100];
+   uint16_t pos;
+};
+
+TEST_F (BlockWriterUnitTest, BlockWriterArResult)
+{
+   const uint8_t expected[] = {
+      0x81, 0x01, 0x00, 0x1e, 0x01, 0x00, /* Block header */
+      0x00, 0x06,                         /* AR type */
+      0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, /* AR UUID */
+      0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+      0x11, 0x12,                         /* Session key */
+      0x21, 0x22, 0x23, 0x24, 0x25, 0x26, /* Responder MAC */
+      0x88, 0x92,                         /* Responder UDP RT port */
+   };
+   const uint8_t data4[] = {0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10};
+   const uint8_t mac[] = {0x21, 0x22, 0x23, 0x24, 0x25, 0x26};
+
+   ar.ar_param.ar_type = 0x0006;
+   ar.ar_param.ar_uuid.data1 = 0x01020304;
+   ar.ar_param.ar_uuid.data2 = 0x0506;
+   ar.ar_param.ar_uuid.data3 = 0x0708;
+   memcpy (ar.ar_param.ar_uuid.data4, data4, sizeof (data4));
+   ar.ar_param.session_key = 0x1112;
+   memcpy (ar.ar_result.cm_responder_mac_add.addr, mac, sizeof (mac));
+   ar.ar_result.responder_udp_rt_port = 0x8892;
+
+   pf_put_ar_result (true, &ar, res_len (sizeof (expected)), buffer, &pos);
+   EXPECT_EQ (pos, res_len (sizeof (expected)));
+   EXPECT_EQ (
+      memcmp (&buffer[TEST_START_POS], expected, sizeof (expected)),
+      0);
+   EXPECT_TRUE (untouched_from (pos));
+
+   clear_buffer();
+   pf_put_ar_result (true, &ar, res_len (sizeof (expected) - 1), buffer, &pos);
+   EXPECT_EQ (pos, TEST_START_POS);
+   EXPECT_TRUE (untouched_from (0));
+}
+
+TEST_F (BlockWriterUnitTest, BlockWriterIocrResult)
+{
+   /* Little endian */
+   const uint8_t expected[] = {
+      0x02, 0x81, 0x08, 0x00, 0x01, 0x00, /* Block header */
+      0x02, 0x00,                         /* IOCR type */
+      0x03, 0x00,                         /* IOCR reference */
+      0x01, 0x80,                         /* Frame ID */
+   };
+
+   ar.iocrs[1].result.iocr_type = 0x0002;
+   ar.iocrs[1].result.iocr_reference = 0x0003;
+   ar.iocrs[1].result.frame_id = 0x8001;
+
+   pf_put_iocr_result (
+      false,
+      &ar,
+      1,
+      res_len (sizeof (expected)),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, res_len (sizeof (expected)));
+   EXPECT_EQ (
+      memcmp (&buffer[TEST_START_POS], expected, sizeof (expected)),
+      0);
+   EXPECT_TRUE (untouched_from (pos));
+
+   clear_buffer();
+   pf_put_iocr_result (
+      false,
+      &ar,
+      1,
+      res_len (sizeof (expected) - 1),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, TEST_START_POS);
+   EXPECT_TRUE (untouched_from (0));
+}
+
+TEST_F (BlockWriterUnitTest, BlockWriterAlarmCrResult)
+{
+   const uint8_t expected[] = {
+      0x81, 0x03, 0x00, 0x08, 0x01, 0x00, /* Block header */
+      0x00, 0x01,                         /* AlarmCR type */
+      0x00, 0x02,                         /* Local alarm reference */
+      0x00, 0xc8,                         /* Max alarm data length */
+   };
+
+   ar.alarm_cr_result.alarm_cr_type = 0x0001;
+   ar.alarm_cr_result.local_alarm_reference = 0x0002;
+   ar.alarm_cr_result.max_alarm_data_length = 200;
+
+   pf_put_alarm_cr_result (
+      true,
+      &ar,
+      res_len (sizeof (expected)),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, res_len (sizeof (expected)));
+   EXPECT_EQ (
+      memcmp (&buffer[TEST_START_POS], expected, sizeof (expected)),
+      0);
+   EXPECT_TRUE (untouched_from (pos));
+
+   clear_buffer();
+   pf_put_alarm_cr_result (
+      true,
+      &ar,
+      res_len (sizeof (expected) - 1),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, TEST_START_POS);
+   EXPECT_TRUE (untouched_from (0));
+}
+
+TEST_F (BlockWriterUnitTest, BlockWriterArDiff)
+{
+   const uint8_t expected[] = {
+      0x81, 0x04, 0x00, 0x28, 0x01, 0x00, /* Block header */
+      0x00, 0x01,                         /* Number of APIs */
+      0x00, 0x00, 0x00, 0x00,             /* API */
+      0x00, 0x02,                         /* Number of modules */
+      0x00, 0x01,                         /* Slot */
+      0x00, 0x00, 0x00, 0x32,             /* Module ident */
+      0x00, 0x02,                         /* Module state: Proper module */
+      0x00, 0x01,                         /* Number of submodules */
+      0x00, 0x01,                         /* Subslot */
+      0x00, 0x00, 0x00, 0x01,             /* Submodule ident */
+      0x90, 0x00,                         /* Submodule state: Wrong */
+      0x00, 0x02,                         /* Slot */
+      0x00, 0x00, 0x00, 0x00,             /* Module ident */
+      0x00, 0x00,                         /* Module state: No module */
+      0x00, 0x00, 0x00, 0x00,             /* Number of submodules, padded */
+   };
+   pf_exp_api_t * p_api = &ar.exp_ident.api[0];
+   pf_exp_module_t * p_module;
+   pf_exp_submodule_t * p_submodule;
+
+   ar.exp_ident.nbr_diff_apis = 1;
+   ar.exp_ident.diff_api[0] = 0;
+   p_api->api = 0;
+   p_api->nbr_diff_modules = 2;
+   p_api->diff_module[0] = 1;
+   p_api->diff_module[1] = 2;
+
+   p_module = &p_api->module[1];
+   p_module->slot_number = 1;
+   p_module->ident_number = 0x00000032;
+   p_module->state = PF_MODULE_STATE_PROPER_MODULE;
+   p_module->nbr_diff_submodules = 1;
+   p_module->diff_submodule[0] = 0;
+   p_submodule = &p_module->submodule[0];
+   p_submodule->subslot_number = 1;
+   p_submodule->ident_number = 0x00000001;
+   p_submodule->state.ident_info = PF_IDENT_INFO_WRONG;
+   p_submodule->state.format_indicator = true;
+
+   p_module = &p_api->module[2];
+   p_module->slot_number = 2;
+   p_module->ident_number = 0x00000033;
+   p_module->state = PF_MODULE_STATE_NO_MODULE;
+
+   pf_put_ar_diff (true, &ar, res_len (sizeof (expected)), buffer, &pos);
+   EXPECT_EQ (pos, res_len (sizeof (expected)));
+   EXPECT_EQ (
+      memcmp (&buffer[TEST_START_POS], expected, sizeof (expected)),
+      0);
+   EXPECT_TRUE (untouched_from (pos));
+
+   clear_buffer();
+   pf_put_ar_diff (true, &ar, res_len (sizeof (expected) - 1), buffer, &pos);
+   EXPECT_EQ (pos, TEST_START_POS);
+   EXPECT_TRUE (untouched_from (0));
+}
+
+TEST_F (BlockWriterUnitTest, BlockWriterDceRpcHeader)
+{
+   /* Little endian */
+   const uint8_t expected[] = {
+      0x04, 0x02, 0x0e, 0x00,                         /* Version to flags2 */
+      0x10, 0x00, 0x00, 0x00,                         /* Data repr etc */
+      0x44, 0x33, 0x22, 0x11, 0x66, 0x55, 0x88, 0x77, /* Object UUID */
+      0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+      0x01, 0x00, 0xa0, 0xde, 0x97, 0x6c, 0xd1, 0x11, /* Interface UUID */
+      0x82, 0x71, 0x00, 0xa0, 0x24, 0x42, 0xdf, 0x7d,
+      0xa4, 0xa3, 0xa2, 0xa1, 0xb2, 0xb1, 0xc2, 0xc1, /* Activity UUID */
+      0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8,
+      0x05, 0x00, 0x00, 0x00,                         /* Server boot time */
+      0x01, 0x00, 0x00, 0x00,                         /* Interface version */
+      0x10, 0x00, 0x00, 0x00,                         /* Sequence number */
+      0x00, 0x00,                                     /* Opnum */
+      0xff, 0xff,                                     /* Interface hint */
+      0xff, 0xff,                                     /* Activity hint */
+      0x54, 0x01,                                     /* Length of body */
+      0x03, 0x00,                                     /* Fragment number */
+      0x00, 0x03,                                     /* Auth, serial low */
+   };
+   const uint8_t object_data4[] = {1, 2, 3, 4, 5, 6, 7, 8};
+   const uint8_t if_data4[] = {0x82, 0x71, 0x00, 0xa0, 0x24, 0x42, 0xdf, 0x7d};
+   const uint8_t act_data4[] = {0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8};
+   pf_rpc_header_t rpc;
+   uint16_t pos_body_len = 0;
+
+   memset (&rpc, 0, sizeof (rpc));
+   rpc.version = 4;
+   rpc.packet_type = PF_RPC_PT_RESPONSE;
+   rpc.flags.last_fragment = true;
+   rpc.flags.fragment = true;
+   rpc.flags.no_fack = true;
+   rpc.is_big_endian = false;
+   rpc.object_uuid.data1 = 0x11223344;
+   rpc.object_uuid.data2 = 0x5566;
+   rpc.object_uuid.data3 = 0x7788;
+   memcpy (rpc.object_uuid.data4, object_data4, sizeof (object_data4));
+   rpc.interface_uuid.data1 = 0xdea00001;
+   rpc.interface_uuid.data2 = 0x6c97;
+   rpc.interface_uuid.data3 = 0x11d1;
+   memcpy (rpc.interface_uuid.data4, if_data4, sizeof (if_data4));
+   rpc.activity_uuid.data1 = 0xa1a2a3a4;
+   rpc.activity_uuid.data2 = 0xb1b2;
+   rpc.activity_uuid.data3 = 0xc1c2;
+   memcpy (rpc.activity_uuid.data4, act_data4, sizeof (act_data4));
+   rpc.server_boot_time = 5;
+   rpc.interface_version = 1;
+   rpc.sequence_nmb = 0x10;
+   rpc.interface_hint = 0xffff;
+   rpc.activity_hint = 0xffff;
+   rpc.length_of_body = 0x0154;
+   rpc.fragment_nmb = 3;
+   rpc.serial_low = 3;
+
+   pf_put_dce_rpc_header (
+      &rpc,
+      res_len (sizeof (expected)),
+      buffer,
+      &pos,
+      &pos_body_len);
+   EXPECT_EQ (pos, res_len (sizeof (expected)));
+   EXPECT_EQ (pos_body_len, TEST_START_POS + 74);
+   EXPECT_EQ (
+      memcmp (&buffer[TEST_START_POS], expected, sizeof (expected)),
+      0);
+   EXPECT_TRUE (untouched_from (pos));
+
+   clear_buffer();
+   pos_body_len = 0;
+   pf_put_dce_rpc_header (
+      &rpc,
+      res_len (sizeof (expected) - 1),
+      buffer,
+      &pos,
+      &pos_body_len);
+   EXPECT_EQ (pos, TEST_START_POS);
+   EXPECT_EQ (pos_body_len, TEST_START_POS);
+   EXPECT_TRUE (untouched_from (0));
+}
+
+TEST_F (BlockWriterUnitTest, BlockWriterDiagItem)
+{
+   const uint8_t expected_qualified[] = {
+      0x80, 0x03,             /* USI */
+      0x80, 0x00,             /* Channel number */
+      0x08, 0x00,             /* Channel properties */
+      0x00, 0x01,             /* Channel error type */
+      0x80, 0x01,             /* Ext channel error type */
+      0x00, 0x01, 0x00, 0x02, /* Ext channel add value */
+      0x00, 0x00, 0x01, 0x00, /* Qualified channel qualifier */
+   };
+   const uint8_t expected_manufacturer[] = {'a', 'b', 'c'};
+   pf_diag_item_t item;
+
+   memset (&item, 0, sizeof (item));
+   item.usi = PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS;
+   item.fmt.std.ch_nbr = 0x8000;
+   item.fmt.std.ch_properties = 0x0800;
+   item.fmt.std.ch_error_type = 0x0001;
+   item.fmt.std.ext_ch_error_type = 0x8001;
+   item.fmt.std.ext_ch_add_value = 0x00010002;
+   item.fmt.std.qual_ch_qualifier = 0x00000100;
+
+   pf_put_diag_item (
+      true,
+      &item,
+      true,
+      res_len (sizeof (expected_qualified)),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, res_len (sizeof (expected_qualified)));
+   EXPECT_EQ (
+      memcmp (
+         &buffer[TEST_START_POS],
+         expected_qualified,
+         sizeof (expected_qualified)),
+      0);
+   EXPECT_TRUE (untouched_from (pos));
+
+   clear_buffer();
+   pf_put_diag_item (
+      true,
+      &item,
+      true,
+      res_len (sizeof (expected_qualified) - 1),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, TEST_START_POS);
+   EXPECT_TRUE (untouched_from (0));
+
+   /* Manufacturer specific, without USI */
+   memset (&item, 0, sizeof (item));
+   item.usi = 0x1234;
+   item.fmt.usi.len = sizeof (expected_manufacturer);
+   memcpy (
+      item.fmt.usi.manuf_data,
+      expected_manufacturer,
+      sizeof (expected_manufacturer));
+
+   clear_buffer();
+   pf_put_diag_item (
+      true,
+      &item,
+      false,
+      res_len (sizeof (expected_manufacturer)),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, res_len (sizeof (expected_manufacturer)));
+   EXPECT_EQ (
+      memcmp (
+         &buffer[TEST_START_POS],
+         expected_manufacturer,
+         sizeof (expected_manufacturer)),
+      0);
+   EXPECT_TRUE (untouched_from (pos));
+
+   clear_buffer();
+   pf_put_diag_item (
+      true,
+      &item,
+      false,
+      res_len (sizeof (expected_manufacturer) - 1),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, TEST_START_POS);
+   EXPECT_TRUE (untouched_from (0));
+}
+
+TEST_F (BlockWriterUnitTest, BlockWriterAlarmDiagItems)
+{
+   const uint8_t expected[] = {
+      0x00, 0x02, 0x00, 0x24, 0x01, 0x00, /* Block header */
+      0x00, 0x01,                         /* Alarm type: Diagnosis */
+      0x00, 0x00, 0x00, 0x00,             /* API */
+      0x00, 0x01,                         /* Slot */
+      0x00, 0x01,                         /* Subslot */
+      0x00, 0x00, 0x00, 0x32,             /* Module ident */
+      0x00, 0x00, 0x00, 0x01,             /* Submodule ident */
+      0x00, 0x00,                         /* Alarm specifier */
+      0x80, 0x00,                         /* USI */
+      0x00, 0x01, 0x08, 0x00, 0x00, 0x10, /* Channel diagnosis */
+      0x00, 0x02, 0x08, 0x00, 0x00, 0x11, /* Channel diagnosis */
+   };
+   pf_alarm_data_t alarm_data;
+   pf_diag_std_t items[2];
+
+   memset (&alarm_data, 0, sizeof (alarm_data));
+   alarm_data.alarm_type = PF_ALARM_TYPE_DIAGNOSIS;
+   alarm_data.slot_nbr = 1;
+   alarm_data.subslot_nbr = 1;
+   alarm_data.module_ident = 0x32;
+   alarm_data.submodule_ident = 0x01;
+
+   memset (items, 0, sizeof (items));
+   items[0].ch_nbr = 0x0001;
+   items[0].ch_properties = 0x0800;
+   items[0].ch_error_type = 0x0010;
+   items[1].ch_nbr = 0x0002;
+   items[1].ch_properties = 0x0800;
+   items[1].ch_error_type = 0x0011;
+
+   pf_put_alarm_block (
+      true,
+      PF_BT_ALARM_NOTIFICATION_LOW,
+      &alarm_data,
+      0, /* No maintenance status */
+      PF_USI_CHANNEL_DIAGNOSIS,
+      sizeof (items),
+      (uint8_t *)items,
+      NULL,
+      res_len (sizeof (expected)),
+      buffer,
+      &pos);
+   EXPECT_EQ (pos, res_len (sizeof (expected)));
+   EXPECT_EQ (
+      memcmp (&buffer[TEST_START_POS], expected, sizeof (expected)),
+      0);
+   EXPECT_TRUE (untouched_from (pos));
+}
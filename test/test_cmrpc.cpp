@@ -672,6 +672,250 @@ TEST_F (CmrpcTest, CmrpcConnectReleaseIOSAR_DA)
    EXPECT_EQ (appdata.cmdev_state, PNET_EVENT_ABORT);
 }
 
+TEST_F (CmrpcTest, CmrpcShortFrameDropped)
+{
+   uint16_t ix;
+
+   /* The RPC header of a connect request, without its last byte */
+   TEST_TRACE ("\nGenerating truncated RPC header\n");
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, 79);
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 0);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 0);
+   for (ix = 0; ix < NELEMENTS (net->cmrpc_session_info); ix++)
+   {
+      EXPECT_FALSE (net->cmrpc_session_info[ix].in_use);
+   }
+
+   /* A complete request is still handled */
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, sizeof (connect_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 1);
+}
+
+/* Size of the DCE RPC header in the frames above */
+#define RPC_HEADER_SIZE 80
+
+/**
+ * Create a request for a user defined index, from the I&M0 read request.
+ *
+ * Also the application read callback is triggered for user defined indices.
+ *
+ * @param p_req            Out:   Request buffer, size of read_im0_req.
+ * @param implicit         In:    true for a Read Implicit request. It uses a
+ *                                new activity, and the AR is given as target
+ *                                AR instead.
+ */
+static void make_read_user_req (uint8_t * p_req, bool implicit)
+{
+   memcpy (p_req, read_im0_req, sizeof (read_im0_req));
+   p_req[134] = 0x01; /* Index 0x0123 */
+   p_req[135] = 0x23;
+   if (implicit)
+   {
+      p_req[40] ^= 0xff;                      /* Activity UUID */
+      p_req[69] = PF_RPC_DEV_OPNUM_READ_IMPLICIT;
+      memcpy (&p_req[140], &p_req[108], 16); /* Target AR UUID */
+      memset (&p_req[108], 0, 16);           /* AR UUID */
+   }
+}
+
+/**
+ * Create a ping for the activity of a request.
+ *
+ * @param p_req            In:    Request. At least the DCE RPC header.
+ * @param p_ping           Out:   Ping buffer, size RPC_HEADER_SIZE.
+ */
+static void make_ping_req (const uint8_t * p_req, uint8_t * p_ping)
+{
+   memcpy (p_ping, p_req, RPC_HEADER_SIZE);
+   p_ping[1] = PF_RPC_PT_PING;
+   p_ping[74] = 0x00; /* Length of body */
+   p_ping[75] = 0x00;
+}
+
+TEST_F (CmrpcTest, CmrpcDeferredReadResponse)
+{
+   uint8_t read_req[sizeof (read_im0_req)];
+   uint8_t ping_req[RPC_HEADER_SIZE];
+   uint8_t read_data[] = {0x11, 0x22, 0x33};
+   uint16_t ix;
+
+   make_read_user_req (read_req, false);
+   make_ping_req (read_req, ping_req);
+   appdata.defer_read_rsp = true;
+
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, sizeof (connect_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 1);
+
+   TEST_TRACE ("\nApplication defers the read response\n");
+   mock_set_pnal_udp_recvfrom_buffer (read_req, sizeof (read_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.read_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 1);
+
+   TEST_TRACE ("\nPing while waiting for the application\n");
+   mock_set_pnal_udp_recvfrom_buffer (ping_req, sizeof (ping_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 2);
+   EXPECT_EQ (mock_os_data.udp_sendto_len, RPC_HEADER_SIZE);
+   EXPECT_EQ (mock_os_data.udp_sendto_copy[1], PF_RPC_PT_WORKING);
+
+   TEST_TRACE ("\nRe-transmitted request is ignored\n");
+   mock_set_pnal_udp_recvfrom_buffer (read_req, sizeof (read_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.read_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 2);
+
+   TEST_TRACE ("\nApplication gives the read response\n");
+   EXPECT_EQ (
+      pnet_read_record_rsp (
+         net,
+         appdata.main_arep,
+         read_data,
+         sizeof (read_data),
+         NULL),
+      0);
+   EXPECT_EQ (appdata.call_counters.read_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 3);
+   EXPECT_EQ (mock_os_data.udp_sendto_copy[1], PF_RPC_PT_RESPONSE);
+   EXPECT_EQ (
+      mock_os_data.udp_sendto_copy[RPC_HEADER_SIZE],
+      PNET_ERROR_CODE_NOERROR);
+   EXPECT_EQ (
+      memcmp (
+         &mock_os_data
+             .udp_sendto_copy[mock_os_data.udp_sendto_len - sizeof (read_data)],
+         read_data,
+         sizeof (read_data)),
+      0);
+   for (ix = 0; ix < NELEMENTS (net->cmrpc_session_info); ix++)
+   {
+      EXPECT_FALSE (net->cmrpc_session_info[ix].record_rsp_pending);
+   }
+
+   /* Nothing more to respond to */
+   EXPECT_EQ (
+      pnet_read_record_rsp (
+         net,
+         appdata.main_arep,
+         read_data,
+         sizeof (read_data),
+         NULL),
+      -1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 3);
+}
+
+TEST_F (CmrpcTest, CmrpcDeferredReadReleasedOnAbort)
+{
+   uint8_t read_req[sizeof (read_im0_req)];
+   uint16_t ix;
+
+   make_read_user_req (read_req, false);
+   appdata.defer_read_rsp = true;
+
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, sizeof (connect_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 1);
+
+   mock_set_pnal_udp_recvfrom_buffer (read_req, sizeof (read_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.read_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 1);
+
+   TEST_TRACE ("\nAbort the AR while waiting for the application\n");
+   EXPECT_EQ (pnet_ar_abort (net, appdata.main_arep), 0);
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.cmdev_state, PNET_EVENT_ABORT);
+   for (ix = 0; ix < NELEMENTS (net->cmrpc_session_info); ix++)
+   {
+      EXPECT_FALSE (net->cmrpc_session_info[ix].in_use);
+   }
+   EXPECT_EQ (
+      pnet_read_record_rsp (net, appdata.main_arep, NULL, 0, NULL),
+      -1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 1);
+}
+
+TEST_F (CmrpcTest, CmrpcDeferredReadReleasedOnRelease)
+{
+   uint8_t read_req[sizeof (read_im0_req)];
+   uint8_t release_other_req[sizeof (release_req)];
+   uint16_t ix;
+
+   make_read_user_req (read_req, false);
+   appdata.defer_read_rsp = true;
+
+   /* The read is parked on the activity, so release on another one */
+   memcpy (release_other_req, release_req, sizeof (release_req));
+   release_other_req[40] ^= 0xff;
+
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, sizeof (connect_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 1);
+
+   mock_set_pnal_udp_recvfrom_buffer (read_req, sizeof (read_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.read_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 1);
+
+   TEST_TRACE ("\nRelease the AR while waiting for the application\n");
+   mock_set_pnal_udp_recvfrom_buffer (
+      release_other_req,
+      sizeof (release_other_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.release_calls, 1);
+   EXPECT_EQ (appdata.cmdev_state, PNET_EVENT_ABORT);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 2);
+   for (ix = 0; ix < NELEMENTS (net->cmrpc_session_info); ix++)
+   {
+      EXPECT_FALSE (net->cmrpc_session_info[ix].record_rsp_pending);
+   }
+   EXPECT_EQ (
+      pnet_read_record_rsp (net, appdata.main_arep, NULL, 0, NULL),
+      -1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 2);
+}
+
+TEST_F (CmrpcTest, CmrpcDeferredImplicitReadRejected)
+{
+   uint8_t read_req[sizeof (read_im0_req)];
+   uint16_t ix;
+
+   make_read_user_req (read_req, true);
+   appdata.defer_read_rsp = true;
+
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, sizeof (connect_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 1);
+
+   TEST_TRACE ("\nApplication tries to defer an implicit read\n");
+   mock_set_pnal_udp_recvfrom_buffer (read_req, sizeof (read_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.read_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 2);
+   EXPECT_EQ (mock_os_data.udp_sendto_copy[1], PF_RPC_PT_RESPONSE);
+   EXPECT_EQ (
+      mock_os_data.udp_sendto_copy[RPC_HEADER_SIZE],
+      PNET_ERROR_CODE_READ);
+   EXPECT_EQ (
+      mock_os_data.udp_sendto_copy[RPC_HEADER_SIZE + 1],
+      PNET_ERROR_DECODE_PNIORW);
+   EXPECT_EQ (
+      mock_os_data.udp_sendto_copy[RPC_HEADER_SIZE + 2],
+      PNET_ERROR_CODE_1_RES_RESOURCE_BUSY);
+   for (ix = 0; ix < NELEMENTS (net->cmrpc_session_info); ix++)
+   {
+      EXPECT_FALSE (net->cmrpc_session_info[ix].record_rsp_pending);
+   }
+   EXPECT_EQ (
+      pnet_read_record_rsp (net, appdata.main_arep, NULL, 0, NULL),
+      -1);
+}
+
 TEST_F (CmrpcUnitTest, CmrpcCheckGenerateUuid)
 {
    uint32_t timestamp;
@@ -702,3 +946,271 @@ TEST_F (CmrpcUnitTest, CmrpcCheckGenerateUuid)
    EXPECT_EQ (uuid.data4[6], 0xA5);
    EXPECT_EQ (uuid.data4[7], 0xA6);
 }
+
+class CmrpcFragmentTest : public PnetIntegrationTest
+{
+ protected:
+   pf_session_info_t * p_sess;
+
+   /** Set up a session with a response of four fragments, none sent yet */
+   void session_init()
+   {
+      uint16_t ix;
+
+      p_sess = NULL;
+      for (ix = 0; ix < NELEMENTS (net->cmrpc_session_info); ix++)
+      {
+         if (net->cmrpc_session_info[ix].in_use == false)
+         {
+            p_sess = &net->cmrpc_session_info[ix];
+            break;
+         }
+      }
+      ASSERT_TRUE (p_sess != NULL);
+
+      memset (p_sess, 0, sizeof (*p_sess));
+      p_sess->in_use = true;
+      p_sess->socket = -1;
+      p_sess->ix = ix;
+      pf_scheduler_init_handle (&p_sess->resend_timeout, "rpc");
+
+      p_sess->out_buf_len = PNET_MAX_SESSION_BUFFER_SIZE;
+      p_sess->out_fragment_count = 4;
+      p_sess->out_fragment_window = PF_CMRPC_INITIAL_FRAG_WINDOW;
+
+      p_sess->get_info.result = PF_PARSE_OK;
+      p_sess->get_info.is_big_endian = false;
+      p_sess->get_info.p_buf = p_sess->in_buffer;
+      p_sess->get_info.len = sizeof (p_sess->in_buffer);
+   }
+
+   /** Deliver a FACK for fragment_nbr, with a body holding window_size */
+   int fack (uint16_t fragment_nbr, uint16_t window_size)
+   {
+      pf_rpc_header_t rpc_fack;
+
+      memset (&rpc_fack, 0, sizeof (rpc_fack));
+      rpc_fack.fragment_nmb = fragment_nbr;
+      rpc_fack.length_of_body = 4;
+
+      p_sess->in_buffer[0] = 0; /* Version */
+      p_sess->in_buffer[1] = 0; /* Padding */
+      p_sess->in_buffer[2] = window_size & UINT8_MAX;
+      p_sess->in_buffer[3] = window_size >> 8U;
+
+      return pf_cmrpc_fack_ind (net, p_sess, &rpc_fack, 0);
+   }
+
+   /** Fragment number of the last sent fragment */
+   uint16_t last_sent_fragment()
+   {
+      return mock_os_data.udp_sendto_copy[76] +
+             (mock_os_data.udp_sendto_copy[77] << 8U);
+   }
+
+   /** true if the last sent fragment requests a FACK */
+   bool last_sent_requests_fack()
+   {
+      return (mock_os_data.udp_sendto_copy[2] & (1U << PF_RPC_F_NO_FACK)) == 0;
+   }
+};
+
+TEST_F (CmrpcFragmentTest, CmrpcFragmentWindowGrowsFromFack)
+{
+   session_init();
+
+   EXPECT_EQ (pf_cmrpc_send_fragment_window (net, p_sess), 0);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, PF_CMRPC_INITIAL_FRAG_WINDOW);
+   EXPECT_EQ (p_sess->out_fragment_nbr, PF_CMRPC_INITIAL_FRAG_WINDOW);
+   EXPECT_EQ (last_sent_fragment(), PF_CMRPC_INITIAL_FRAG_WINDOW - 1);
+   EXPECT_TRUE (last_sent_requests_fack());
+   EXPECT_TRUE (pf_scheduler_is_running (&p_sess->resend_timeout));
+
+   /* The controller acknowledges fragment 0 and asks for a larger window.
+    * The rest of the response fits in the window. */
+   EXPECT_EQ (fack (0, 3), 0);
+   EXPECT_EQ (p_sess->out_fragment_window, 3);
+   EXPECT_EQ (p_sess->out_fragment_acked, 1);
+   EXPECT_EQ (p_sess->out_fragment_nbr, 4);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 4);
+   EXPECT_EQ (last_sent_fragment(), 3);
+   EXPECT_TRUE (last_sent_requests_fack());
+
+   /* The window is capped */
+   EXPECT_EQ (fack (1, 1000), 0);
+   EXPECT_EQ (p_sess->out_fragment_window, PF_CMRPC_MAX_FRAG_WINDOW);
+   EXPECT_EQ (p_sess->out_fragment_acked, 2);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 4);
+
+   /* A zero window is ignored */
+   EXPECT_EQ (fack (2, 0), 0);
+   EXPECT_EQ (p_sess->out_fragment_window, PF_CMRPC_MAX_FRAG_WINDOW);
+   EXPECT_EQ (p_sess->out_fragment_acked, 3);
+
+   /* The last fragment is acknowledged */
+   EXPECT_EQ (fack (3, PF_CMRPC_MAX_FRAG_WINDOW), 0);
+   EXPECT_EQ (p_sess->out_fragment_count, 0);
+   EXPECT_EQ (p_sess->out_fragment_nbr, 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 0);
+   EXPECT_EQ (p_sess->out_buf_len, 0);
+   EXPECT_FALSE (pf_scheduler_is_running (&p_sess->resend_timeout));
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 4);
+}
+
+TEST_F (CmrpcFragmentTest, CmrpcFragmentStaleFackIgnored)
+{
+   session_init();
+
+   EXPECT_EQ (pf_cmrpc_send_fragment_window (net, p_sess), 0);
+   EXPECT_EQ (fack (1, PF_CMRPC_INITIAL_FRAG_WINDOW), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 2);
+   EXPECT_EQ (p_sess->out_fragment_nbr, 4);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 4);
+
+   /* Duplicate FACK. Nothing more is acknowledged and nothing is sent,
+    * as the window is already full. */
+   EXPECT_EQ (fack (1, PF_CMRPC_INITIAL_FRAG_WINDOW), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 2);
+   EXPECT_EQ (p_sess->out_fragment_nbr, 4);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 4);
+
+   /* Older FACK */
+   EXPECT_EQ (fack (0, PF_CMRPC_INITIAL_FRAG_WINDOW), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 2);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 4);
+
+   /* FACK for a fragment not yet sent */
+   p_sess->out_fragment_nbr = 3;
+   EXPECT_EQ (fack (3, PF_CMRPC_INITIAL_FRAG_WINDOW), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 2);
+   EXPECT_EQ (p_sess->out_fragment_count, 4);
+}
+
+TEST_F (CmrpcFragmentTest, CmrpcFragmentDuplicateFackKeepsResendCounter)
+{
+   session_init();
+
+   EXPECT_EQ (pf_cmrpc_send_fragment_window (net, p_sess), 0);
+   EXPECT_EQ (fack (0, PF_CMRPC_INITIAL_FRAG_WINDOW), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 1);
+   EXPECT_EQ (p_sess->out_fragment_nbr, 3);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 3);
+
+   run_stack (PF_FRAG_TIMEOUT * 1000 + TEST_TICK_INTERVAL_US);
+   EXPECT_EQ (p_sess->resend_counter, PF_CMRPC_NUMBER_OF_RESENDS - 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 5);
+
+   /* A duplicate FACK does not restart the re-transmissions */
+   EXPECT_EQ (fack (0, PF_CMRPC_INITIAL_FRAG_WINDOW), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 1);
+   EXPECT_EQ (p_sess->resend_counter, PF_CMRPC_NUMBER_OF_RESENDS - 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 5);
+
+   /* A duplicate FACK with a larger window sends the fragments that now
+    * fit, but still does not restart the re-transmissions */
+   EXPECT_EQ (fack (0, 3), 0);
+   EXPECT_EQ (p_sess->out_fragment_nbr, 4);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 6);
+   EXPECT_EQ (last_sent_fragment(), 3);
+   EXPECT_TRUE (last_sent_requests_fack());
+   EXPECT_EQ (p_sess->resend_counter, PF_CMRPC_NUMBER_OF_RESENDS - 1);
+
+   /* Progress restarts them */
+   EXPECT_EQ (fack (1, 3), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 2);
+   EXPECT_EQ (p_sess->resend_counter, PF_CMRPC_NUMBER_OF_RESENDS);
+}
+
+TEST_F (CmrpcFragmentTest, CmrpcFragmentCreatedInOutBuffer)
+{
+   const uint16_t body_size = PF_MAX_UDP_PAYLOAD_SIZE - RPC_HEADER_SIZE;
+   uint8_t expected[PNET_MAX_SESSION_BUFFER_SIZE];
+   uint16_t ix;
+
+   session_init();
+   for (ix = 0; ix < sizeof (expected); ix++)
+   {
+      expected[ix] = (uint8_t)(ix * 7 + 3);
+   }
+   memcpy (p_sess->out_buffer, expected, sizeof (expected));
+
+   /* Fragment 1 is put after the header in the sent frame */
+   EXPECT_EQ (pf_cmrpc_send_fragment_window (net, p_sess), 0);
+   EXPECT_EQ (last_sent_fragment(), 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_len, PF_MAX_UDP_PAYLOAD_SIZE);
+   EXPECT_EQ (
+      memcmp (
+         &mock_os_data.udp_sendto_copy[RPC_HEADER_SIZE],
+         &expected[RPC_HEADER_SIZE + body_size],
+         body_size),
+      0);
+
+   /* The response is left unchanged */
+   EXPECT_EQ (memcmp (p_sess->out_buffer, expected, sizeof (expected)), 0);
+}
+
+TEST_F (CmrpcFragmentTest, CmrpcFragmentResendUnacked)
+{
+   session_init();
+
+   EXPECT_EQ (pf_cmrpc_send_fragment_window (net, p_sess), 0);
+   EXPECT_EQ (fack (0, 3), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 1);
+   EXPECT_EQ (p_sess->out_fragment_nbr, 4);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 4);
+
+   /* Fragments 1 to 3 are resent when the timer expires */
+   run_stack (PF_FRAG_TIMEOUT * 1000 + TEST_TICK_INTERVAL_US);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 7);
+   EXPECT_EQ (last_sent_fragment(), 3);
+   EXPECT_TRUE (last_sent_requests_fack());
+   EXPECT_EQ (p_sess->resend_counter, PF_CMRPC_NUMBER_OF_RESENDS - 1);
+   EXPECT_TRUE (pf_scheduler_is_running (&p_sess->resend_timeout));
+
+   /* After a FACK only the remaining fragments are resent */
+   EXPECT_EQ (fack (2, 3), 0);
+   EXPECT_EQ (p_sess->out_fragment_acked, 3);
+   EXPECT_EQ (p_sess->resend_counter, PF_CMRPC_NUMBER_OF_RESENDS);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 7);
+
+   run_stack (PF_FRAG_TIMEOUT * 1000 + TEST_TICK_INTERVAL_US);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 8);
+   EXPECT_EQ (last_sent_fragment(), 3);
+}
+
+TEST_F (CmrpcFragmentTest, CmrpcFragmentAbortAfterResends)
+{
+   pf_ar_t * p_ar = NULL;
+   uint16_t sent;
+   uint16_t ix;
+
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, sizeof (connect_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.state_calls, 1);
+   EXPECT_EQ (appdata.cmdev_state, PNET_EVENT_STARTUP);
+   ASSERT_EQ (pf_ar_find_by_arep (net, appdata.main_arep, &p_ar), 0);
+
+   session_init();
+   p_sess->p_ar = p_ar;
+   EXPECT_EQ (pf_cmrpc_send_fragment_window (net, p_sess), 0);
+   sent = mock_os_data.udp_sendto_count;
+
+   /* Drive the timer callback directly, without other stack activity */
+   for (ix = 0; ix < PF_CMRPC_NUMBER_OF_RESENDS; ix++)
+   {
+      pf_scheduler_remove_if_running (net, &p_sess->resend_timeout);
+      pf_cmrpc_resend_fragments (net, p_sess, 0);
+      sent += PF_CMRPC_INITIAL_FRAG_WINDOW;
+      EXPECT_EQ (mock_os_data.udp_sendto_count, sent);
+      EXPECT_EQ (appdata.call_counters.state_calls, 1);
+   }
+   EXPECT_EQ (p_sess->resend_counter, 0u);
+
+   /* No reaction from the controller. The AR is aborted. */
+   pf_scheduler_remove_if_running (net, &p_sess->resend_timeout);
+   pf_cmrpc_resend_fragments (net, p_sess, 0);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, sent);
+   EXPECT_FALSE (pf_scheduler_is_running (&p_sess->resend_timeout));
+   EXPECT_EQ (appdata.call_counters.state_calls, 2);
+   EXPECT_EQ (appdata.cmdev_state, PNET_EVENT_ABORT);
+}
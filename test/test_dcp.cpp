@@ -37,6 +37,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 class DcpTest : public PnetIntegrationTest
 {
 };
@@ -92,6 +94,13 @@ static uint8_t ident_req[] = {
    0x73, 0x2d, 0x64, 0x65, 0x6d, 0x6f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
+static uint8_t ident_all_req[] = {
+   0x01, 0x0e, 0xcf, 0x00, 0x00, 0x00, 0xc8, 0x5b, 0x76, 0xe6, 0x89, 0xdf,
+   0x88, 0x92, 0xfe, 0xfe, 0x05, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x01,
+   0x00, 0x04, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
 static uint8_t set_name_req[] = {
    0x12, 0x34, 0x00, 0x78, 0x90, 0xab, 0xc8, 0x5b, 0x76, 0xe6, 0x89, 0xdf,
    0x88, 0x92, 0xfe, 0xfd, 0x04, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
@@ -178,6 +187,270 @@ TEST_F (DcpTest, DcpGetWrongLengthTest)
    EXPECT_EQ (appdata.call_counters.write_calls, 0);
 }
 
+TEST_F (DcpTest, DcpRateLimitTest)
+{
+   pnal_buf_t * p_buf;
+   pnet_dcp_statistics_t statistics;
+   int ret;
+   int ix;
+
+   net->fspm_cfg.dcp_source_rate_limit = 2;
+
+   for (ix = 0; ix < 3; ix++)
+   {
+      p_buf = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+      memcpy (p_buf->payload, get_name_req, sizeof (get_name_req));
+      p_buf->len = sizeof (get_name_req);
+      ret = pf_eth_recv (mock_os_data.eth_if_handle, net, p_buf);
+      EXPECT_EQ (ret, 1);
+   }
+
+   ret = pnet_get_dcp_statistics (net, &statistics);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (statistics.get.received, 3u);
+   EXPECT_EQ (statistics.get.dropped, 1u);
+   EXPECT_EQ (statistics.source_dropped, 1u);
+   EXPECT_EQ (statistics.set.received, 0u);
+
+   /* The bucket is refilled after a while */
+   mock_os_data.current_time_us += 500 * 1000;
+   p_buf = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+   memcpy (p_buf->payload, get_name_req, sizeof (get_name_req));
+   p_buf->len = sizeof (get_name_req);
+   ret = pf_eth_recv (mock_os_data.eth_if_handle, net, p_buf);
+   EXPECT_EQ (ret, 1);
+
+   ret = pnet_get_dcp_statistics (net, &statistics);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (statistics.get.received, 4u);
+   EXPECT_EQ (statistics.get.dropped, 1u);
+}
+
+TEST_F (DcpTest, DcpRateLimitSetTest)
+{
+   pnet_dcp_statistics_t statistics;
+   int ret;
+   int ix;
+
+   net->fspm_cfg.dcp_source_rate_limit = 2;
+
+   for (ix = 0; ix < 3; ix++)
+   {
+      send_data (set_name_req, sizeof (set_name_req));
+   }
+
+   ret = pnet_get_dcp_statistics (net, &statistics);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (statistics.set.received, 3u);
+   EXPECT_EQ (statistics.set.dropped, 1u);
+   EXPECT_EQ (statistics.source_dropped, 1u);
+   EXPECT_EQ (statistics.get.received, 0u);
+}
+
+TEST_F (DcpTest, DcpRateLimitIdentifyTest)
+{
+   pnet_dcp_statistics_t statistics;
+   uint16_t responses = 0;
+   int ret;
+   int ix;
+
+   send_data (set_name_req, sizeof (set_name_req));
+
+   /* Let the bucket of the source be refilled after the Set request */
+   net->fspm_cfg.dcp_source_rate_limit = 2;
+   mock_os_data.current_time_us += 1000 * 1000;
+
+   for (ix = 0; ix < 3; ix++)
+   {
+      mock_os_data.eth_send_count = 0;
+      send_data (ident_req, sizeof (ident_req));
+      run_stack (TEST_SCHEDULER_RUNTIME);
+      if (
+         mock_os_data.eth_send_count > 0 &&
+         mock_os_data.eth_send_copy[14] == 0xfe &&
+         mock_os_data.eth_send_copy[15] == 0xff)
+      {
+         responses++;
+      }
+   }
+
+   EXPECT_EQ (responses, 2);
+   ret = pnet_get_dcp_statistics (net, &statistics);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (statistics.identify.received, 3u);
+   EXPECT_EQ (statistics.identify.dropped, 1u);
+   EXPECT_EQ (statistics.source_dropped, 1u);
+}
+
+TEST_F (DcpTest, DcpRateLimitIdentifyOtherStationsTest)
+{
+   uint8_t other_ident_req[sizeof (ident_req)];
+   pnet_dcp_statistics_t statistics;
+   int ret;
+   int ix;
+
+   send_data (set_name_req, sizeof (set_name_req));
+
+   net->fspm_cfg.dcp_rate_limit = 2;
+   net->fspm_cfg.dcp_source_rate_limit = 2;
+   mock_os_data.current_time_us += 1000 * 1000;
+
+   /* Identify requests for "rt-labs-demx" from the same source */
+   memcpy (other_ident_req, ident_req, sizeof (ident_req));
+   other_ident_req[41] = 'x';
+   for (ix = 0; ix < 10; ix++)
+   {
+      send_data (other_ident_req, sizeof (other_ident_req));
+   }
+
+   mock_os_data.eth_send_count = 0;
+   send_data (ident_req, sizeof (ident_req));
+   run_stack (TEST_SCHEDULER_RUNTIME);
+
+   EXPECT_GT (mock_os_data.eth_send_count, 0);
+   EXPECT_EQ (mock_os_data.eth_send_copy[14], 0xfe);
+   EXPECT_EQ (mock_os_data.eth_send_copy[15], 0xff);
+
+   ret = pnet_get_dcp_statistics (net, &statistics);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (statistics.identify.received, 1u);
+   EXPECT_EQ (statistics.identify.dropped, 0u);
+}
+
+TEST_F (DcpTest, DcpRateLimitChangingSourceTest)
+{
+   uint8_t req[sizeof (ident_req)];
+   pnet_dcp_statistics_t statistics;
+   int ret;
+   int ix;
+
+   send_data (set_name_req, sizeof (set_name_req));
+
+   net->fspm_cfg.dcp_rate_limit = 3;
+   net->fspm_cfg.dcp_source_rate_limit = 1;
+   mock_os_data.current_time_us += 1000 * 1000;
+
+   /* A new source MAC address for each request does not give new tokens */
+   memcpy (req, ident_req, sizeof (ident_req));
+   for (ix = 0; ix < 20; ix++)
+   {
+      req[11] = (uint8_t)ix;
+      send_data (req, sizeof (req));
+      run_stack (TEST_SCHEDULER_RUNTIME);
+   }
+
+   ret = pnet_get_dcp_statistics (net, &statistics);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (statistics.identify.received, 20u);
+   EXPECT_EQ (statistics.identify.dropped, 17u);
+   EXPECT_EQ (statistics.source_dropped, 0u);
+
+   /* A tracked source is limited by its own bucket */
+   mock_os_data.current_time_us += 1000 * 1000;
+   req[11] = 0x42;
+   for (ix = 0; ix < 3; ix++)
+   {
+      send_data (req, sizeof (req));
+      run_stack (TEST_SCHEDULER_RUNTIME);
+   }
+
+   ret = pnet_get_dcp_statistics (net, &statistics);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (statistics.identify.received, 23u);
+   EXPECT_EQ (statistics.identify.dropped, 19u);
+   EXPECT_EQ (statistics.source_dropped, 2u);
+}
+
+/**
+ * Find a block in the latest sent DCP response frame.
+ *
+ * @param option           In:    Block option.
+ * @param suboption        In:    Block suboption.
+ * @param p_len            Out:   Length of the block data, after BlockInfo.
+ * @return Position of the block data, or 0 if not found.
+ */
+static uint16_t find_response_block (
+   uint8_t option,
+   uint8_t suboption,
+   uint16_t * p_len)
+{
+   const uint8_t * p_frame = mock_os_data.eth_send_copy;
+   uint16_t pos = 26; /* Ethernet header, frame ID and DCP header */
+   uint16_t end = pos + ((p_frame[24] << 8) | p_frame[25]);
+   uint16_t block_len;
+
+   while ((pos + 4 <= end) && (end <= sizeof (mock_os_data.eth_send_copy)))
+   {
+      block_len = (p_frame[pos + 2] << 8) | p_frame[pos + 3];
+      if (p_frame[pos] == option && p_frame[pos + 1] == suboption)
+      {
+         *p_len = block_len - 2;
+         return pos + 6;
+      }
+      pos += 4 + block_len + (block_len & 1);
+   }
+
+   return 0;
+}
+
+TEST_F (DcpTest, DcpIdentifyResponseUpdatedTest)
+{
+   const uint8_t * p_frame = mock_os_data.eth_send_copy;
+   uint16_t pos;
+   uint16_t len = 0;
+   uint32_t ip;
+
+   /* Identify all, and check the response against the current values */
+   auto identify_all = [&]() {
+      mock_os_data.current_time_us += 1000 * 1000;
+      mock_os_data.eth_send_count = 0;
+      send_data (ident_all_req, sizeof (ident_all_req));
+      run_stack (TEST_SCHEDULER_RUNTIME);
+      ASSERT_GT (mock_os_data.eth_send_count, 0);
+      ASSERT_EQ (p_frame[14], 0xfe);
+      ASSERT_EQ (p_frame[15], 0xff);
+
+      pos = find_response_block (0x02, 0x02, &len);
+      ASSERT_NE (pos, 0);
+      EXPECT_EQ (
+         std::string ((const char *)&p_frame[pos], len),
+         std::string (net->cmina_current_dcp_ase.station_name));
+
+      pos = find_response_block (0x01, 0x02, &len);
+      ASSERT_NE (pos, 0);
+      ASSERT_EQ (len, 12);
+      ip = ((uint32_t)p_frame[pos] << 24) | (p_frame[pos + 1] << 16) |
+           (p_frame[pos + 2] << 8) | p_frame[pos + 3];
+      EXPECT_EQ (
+         ip,
+         net->cmina_current_dcp_ase.full_ip_suite.ip_suite.ip_addr);
+   };
+
+   identify_all();
+
+   send_data (set_name_req, sizeof (set_name_req));
+   EXPECT_STREQ (net->cmina_current_dcp_ase.station_name, "rt-labs-demo");
+   identify_all();
+
+   send_data (set_ip_req, sizeof (set_ip_req));
+   EXPECT_EQ (
+      net->cmina_current_dcp_ase.full_ip_suite.ip_suite.ip_addr,
+      PNAL_MAKEU32 (192, 168, 1, 171));
+   identify_all();
+
+   pnet_factory_reset (net);
+   EXPECT_STREQ (net->cmina_current_dcp_ase.station_name, "");
+   EXPECT_EQ (net->cmina_current_dcp_ase.full_ip_suite.ip_suite.ip_addr, 0u);
+   identify_all();
+
+   /* Temporary name, restored by a power-on reset of the configuration */
+   send_data (set_name_req, sizeof (set_name_req));
+   identify_all();
+   pf_cmina_set_default_cfg (net, 0);
+   EXPECT_STRNE (net->cmina_current_dcp_ase.station_name, "rt-labs-demo");
+   identify_all();
+}
+
 TEST_F (DcpTest, DcpRunTest)
 {
    pnal_buf_t * p_buf;
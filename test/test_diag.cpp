@@ -31,13 +31,20 @@
 #include "mocks.h"
 
 #include "pf_includes.h"
+#include "pf_block_writer.h"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 class DiagTest : public PnetIntegrationTest
 {
 };
 
+class DiagUnitTest : public PnetUnitTest
+{
+};
+
 // clang-format off
 
 static uint8_t connect_req[] =
@@ -135,6 +142,12 @@ TEST_F (DiagTest, DiagRunTest)
    uint8_t iops = PNET_IOXS_BAD;
    uint8_t iocs = PNET_IOXS_BAD;
    uint32_t ix;
+   uint8_t diag_buffer[100];
+   uint8_t expected_buffer[100];
+   uint16_t diag_pos = 0;
+   uint16_t expected_pos = 0;
+   const uint16_t qualified_per_alarm = PNET_MAX_ALARM_PAYLOAD_DATA_SIZE / 16;
+   const uint16_t channel_per_alarm = PNET_MAX_ALARM_PAYLOAD_DATA_SIZE / 6;
    pnet_diag_source_t diag_source = {
       .api = TEST_API_IDENT,
       .slot = TEST_SLOT_IDENT,
@@ -314,6 +327,10 @@ TEST_F (DiagTest, DiagRunTest)
       TEST_DIAG_EXT_ADDVALUE,
       TEST_DIAG_QUALIFIER);
    EXPECT_EQ (ret, 0);
+   EXPECT_EQ (net->cmdev_device.diag_counters.fault, 1);
+   EXPECT_EQ (net->cmdev_device.diag_counters.maintenance_required, 2);
+   EXPECT_EQ (net->cmdev_device.diag_counters.maintenance_demanded, 1);
+   EXPECT_EQ (net->cmdev_device.diag_counters.qualified, 0);
 
    ret = pnet_diag_std_remove (
       net,
@@ -321,6 +338,8 @@ TEST_F (DiagTest, DiagRunTest)
       TEST_CHANNEL_ERRORTYPE,
       TEST_DIAG_EXT_ERRTYPE);
    EXPECT_EQ (ret, 0);
+   EXPECT_EQ (net->cmdev_device.diag_counters.fault, 0);
+   EXPECT_EQ (net->cmdev_device.diag_counters.maintenance_required, 2);
 
    ret = pnet_diag_std_remove (
       net,
@@ -342,6 +361,8 @@ TEST_F (DiagTest, DiagRunTest)
       TEST_CHANNEL_ERRORTYPE_D,
       TEST_DIAG_EXT_ERRTYPE);
    EXPECT_EQ (ret, 0);
+   EXPECT_EQ (net->cmdev_device.diag_counters.maintenance_required, 0);
+   EXPECT_EQ (net->cmdev_device.diag_counters.maintenance_demanded, 0);
 
    TEST_TRACE ("Try to remove it again\n");
    ret = pnet_diag_std_remove (
@@ -1066,6 +1087,185 @@ TEST_F (DiagTest, DiagRunTest)
       NULL);
    EXPECT_EQ (ret, -1);
 
+   TEST_TRACE ("\nAdd several diagnoses in a batch. Then remove them.\n");
+   ret = pnet_diag_begin (net);
+   EXPECT_EQ (ret, 0);
+   ret = pnet_diag_begin (net);
+   EXPECT_EQ (ret, -1);
+   for (ix = 0; ix < 5; ix++)
+   {
+      diag_source.ch = ix;
+      ret = pnet_diag_std_add (
+         net,
+         &diag_source,
+         TEST_CHANNEL_NUMBER_OF_BITS,
+         PNET_DIAG_CH_PROP_MAINT_FAULT,
+         TEST_CHANNEL_ERRORTYPE,
+         TEST_DIAG_EXT_ERRTYPE,
+         TEST_DIAG_EXT_ADDVALUE,
+         TEST_DIAG_QUALIFIER_NOTSET);
+      EXPECT_EQ (ret, 0);
+   }
+   EXPECT_EQ (net->cmdev_device.diag_counters.fault, 5);
+
+   /* Added and removed in the same batch, so never reported */
+   ret = pnet_diag_std_remove (
+      net,
+      &diag_source,
+      TEST_CHANNEL_ERRORTYPE,
+      TEST_DIAG_EXT_ERRTYPE);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (mock_alarm_data.diag_items_count, 0);
+
+   /* Qualified channel diagnosis is 16 bytes per item. With the default
+    * PNET_MAX_ALARM_PAYLOAD_DATA_SIZE of 28 bytes, one item fits per alarm. */
+   ret = pnet_diag_commit (net);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (mock_alarm_data.diag_items_count, 4);
+   EXPECT_EQ (
+      mock_alarm_data.diag_items_alarm_count,
+      (4 + qualified_per_alarm - 1) / qualified_per_alarm);
+   ret = pnet_diag_commit (net);
+   EXPECT_EQ (ret, -1);
+
+   ret = pnet_diag_begin (net);
+   EXPECT_EQ (ret, 0);
+   for (ix = 0; ix < 4; ix++)
+   {
+      diag_source.ch = ix;
+      ret = pnet_diag_std_remove (
+         net,
+         &diag_source,
+         TEST_CHANNEL_ERRORTYPE,
+         TEST_DIAG_EXT_ERRTYPE);
+      EXPECT_EQ (ret, 0);
+   }
+   ret = pnet_diag_commit (net);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (mock_alarm_data.diag_items_count, 8);
+   EXPECT_EQ (net->cmdev_device.diag_counters.fault, 0);
+
+   /* Channel diagnosis is 6 bytes per item. With the default
+    * PNET_MAX_ALARM_PAYLOAD_DATA_SIZE of 28 bytes, four items fit per alarm,
+    * so five items are sent in two alarms. */
+   mock_alarm_data.diag_items_alarm_count = 0;
+   ret = pnet_diag_begin (net);
+   EXPECT_EQ (ret, 0);
+   for (ix = 0; ix < 5; ix++)
+   {
+      diag_source.ch = ix;
+      ret = pnet_diag_add (
+         net,
+         &diag_source,
+         TEST_CHANNEL_NUMBER_OF_BITS,
+         PNET_DIAG_CH_PROP_MAINT_FAULT,
+         TEST_CHANNEL_ERRORTYPE,
+         0,
+         0,
+         0,
+         PF_USI_CHANNEL_DIAGNOSIS,
+         0,
+         NULL);
+      EXPECT_EQ (ret, 0);
+   }
+   ret = pnet_diag_commit (net);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (mock_alarm_data.diag_items_count, 13);
+   EXPECT_EQ (
+      mock_alarm_data.diag_items_alarm_count,
+      (5 + channel_per_alarm - 1) / channel_per_alarm);
+
+   ret = pnet_diag_begin (net);
+   EXPECT_EQ (ret, 0);
+   for (ix = 0; ix < 5; ix++)
+   {
+      diag_source.ch = ix;
+      ret = pnet_diag_remove (
+         net,
+         &diag_source,
+         TEST_CHANNEL_ERRORTYPE,
+         0,
+         PF_USI_CHANNEL_DIAGNOSIS);
+      EXPECT_EQ (ret, 0);
+   }
+   ret = pnet_diag_commit (net);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (mock_alarm_data.diag_items_count, 18);
+   EXPECT_EQ (net->cmdev_device.diag_counters.fault, 0);
+   diag_source.ch = TEST_CHANNEL_IDENT;
+
+   TEST_TRACE ("\nRead diagnosis data, both cached and directly encoded.\n");
+   ret = pnet_diag_std_add (
+      net,
+      &diag_source,
+      TEST_CHANNEL_NUMBER_OF_BITS,
+      PNET_DIAG_CH_PROP_MAINT_FAULT,
+      TEST_CHANNEL_ERRORTYPE,
+      TEST_DIAG_EXT_ERRTYPE,
+      TEST_DIAG_EXT_ADDVALUE,
+      TEST_DIAG_QUALIFIER_NOTSET);
+   EXPECT_EQ (ret, 0);
+   ret = pnet_diag_usi_add (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_SUBSLOT_IDENT,
+      TEST_DIAG_USI_CUSTOM,
+      3,
+      (uint8_t *)"ABC");
+   EXPECT_EQ (ret, 0);
+
+   pf_put_diagnosis_device (
+      net,
+      true,
+      PF_DIAG_FILTER_ALL,
+      sizeof (diag_buffer),
+      diag_buffer,
+      &diag_pos);
+   EXPECT_EQ (diag_pos, 20 + 16 + 20 + 3);
+   pf_put_diagnosis_device (
+      net,
+      true,
+      PF_DIAG_FILTER_FAULT_ALL,
+      sizeof (expected_buffer),
+      expected_buffer,
+      &expected_pos);
+   EXPECT_EQ (expected_pos, diag_pos);
+   EXPECT_EQ (memcmp (diag_buffer, expected_buffer, diag_pos), 0);
+
+   ret = pnet_diag_std_remove (
+      net,
+      &diag_source,
+      TEST_CHANNEL_ERRORTYPE,
+      TEST_DIAG_EXT_ERRTYPE);
+   EXPECT_EQ (ret, 0);
+   diag_pos = 0;
+   pf_put_diagnosis_device (
+      net,
+      true,
+      PF_DIAG_FILTER_ALL,
+      sizeof (diag_buffer),
+      diag_buffer,
+      &diag_pos);
+   EXPECT_EQ (diag_pos, 20 + 3);
+
+   ret = pnet_diag_usi_remove (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_SUBSLOT_IDENT,
+      TEST_DIAG_USI_CUSTOM);
+   EXPECT_EQ (ret, 0);
+   diag_pos = 0;
+   pf_put_diagnosis_device (
+      net,
+      true,
+      PF_DIAG_FILTER_ALL,
+      sizeof (diag_buffer),
+      diag_buffer,
+      &diag_pos);
+   EXPECT_EQ (diag_pos, 0);
+
    TEST_TRACE ("\nGenerating mock release request\n");
    mock_set_pnal_udp_recvfrom_buffer (release_req, sizeof (release_req));
    run_stack (TEST_UDP_DELAY);
@@ -1073,3 +1273,520 @@ TEST_F (DiagTest, DiagRunTest)
    EXPECT_EQ (appdata.call_counters.state_calls, 5);
    EXPECT_EQ (appdata.cmdev_state, PNET_EVENT_ABORT);
 }
+
+TEST_F (DiagUnitTest, DiagCheckAlarmMaxItems)
+{
+   /* AlarmNotification header and MaintenanceItem + USI */
+   const uint16_t overhead = 26 + 16;
+   const uint16_t payload_size = PNET_MAX_ALARM_PAYLOAD_DATA_SIZE;
+   pf_ar_t ar;
+
+   memset ((void *)&ar, 0, sizeof (ar));
+
+   /* Smallest max alarm data length allowed for the controller */
+   ar.alarm_cr_request.max_alarm_data_length = 200;
+   EXPECT_EQ (
+      pf_diag_alarm_max_items (&ar, PF_USI_CHANNEL_DIAGNOSIS),
+      std::min<uint16_t> (payload_size / 6, (200 - overhead) / 6));
+   EXPECT_EQ (
+      pf_diag_alarm_max_items (&ar, PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+      std::min<uint16_t> (payload_size / 12, (200 - overhead) / 12));
+   EXPECT_EQ (
+      pf_diag_alarm_max_items (&ar, PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS),
+      std::min<uint16_t> (payload_size / 16, (200 - overhead) / 16));
+
+   /* Largest */
+   ar.alarm_cr_request.max_alarm_data_length = 1432;
+   EXPECT_EQ (
+      pf_diag_alarm_max_items (&ar, PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS),
+      std::min<uint16_t> (payload_size / 16, (1432 - overhead) / 16));
+
+   /* At least one item is always sent */
+   ar.alarm_cr_request.max_alarm_data_length = overhead + 15;
+   EXPECT_EQ (
+      pf_diag_alarm_max_items (&ar, PF_USI_QUALIFIED_CHANNEL_DIAGNOSIS),
+      1);
+   ar.alarm_cr_request.max_alarm_data_length = 0;
+   EXPECT_EQ (pf_diag_alarm_max_items (&ar, PF_USI_CHANNEL_DIAGNOSIS), 1);
+}
+
+/** Number of diag items in the free list */
+static uint16_t diag_free_count (const pnet_t * net)
+{
+   uint16_t count = 0;
+   uint16_t ix = net->cmdev_device.diag_items_free;
+
+   while (ix != PF_DIAG_IX_NULL)
+   {
+      count++;
+      ix = net->cmdev_device.diag_items[ix].next;
+   }
+
+   return count;
+}
+
+TEST_F (DiagTest, DiagIndexCollisions)
+{
+   pf_device_t * p_dev = &net->cmdev_device;
+   pf_diag_item_t * p_item;
+   pnet_diag_source_t diag_source = {
+      .api = TEST_API_IDENT,
+      .slot = TEST_SLOT_IDENT,
+      .subslot = TEST_SUBSLOT_IDENT,
+      .ch = TEST_CHANNEL_IDENT,
+      .ch_grouping = PNET_DIAG_CH_INDIVIDUAL_CHANNEL,
+      .ch_direction = TEST_CHANNEL_DIRECTION};
+   uint16_t item_ix;
+   uint16_t bucket;
+   uint16_t head_ix = PF_DIAG_IX_NULL;
+   uint16_t second_ix = PF_DIAG_IX_NULL;
+   uint16_t third_ix;
+
+   /* Index all diag items, with the item index as channel number. There are
+    * as many buckets as items, so some buckets hold several items. */
+   ASSERT_EQ (diag_free_count (net), p_dev->max_diag_items);
+   while (pf_cmdev_new_diag (net, &item_ix) == 0)
+   {
+      p_item = &p_dev->diag_items[item_ix];
+      p_item->usi = PF_USI_EXTENDED_CHANNEL_DIAGNOSIS;
+      p_item->fmt.std.ch_nbr = item_ix;
+      PF_DIAG_CH_PROP_ACC_SET (
+         p_item->fmt.std.ch_properties,
+         PNET_DIAG_CH_INDIVIDUAL_CHANNEL);
+      PF_DIAG_CH_PROP_DIR_SET (
+         p_item->fmt.std.ch_properties,
+         TEST_CHANNEL_DIRECTION);
+      p_item->fmt.std.ch_error_type = TEST_CHANNEL_ERRORTYPE;
+      p_item->fmt.std.ext_ch_error_type = TEST_DIAG_EXT_ERRTYPE;
+      pf_cmdev_index_diag (
+         net,
+         item_ix,
+         TEST_API_IDENT,
+         TEST_SLOT_IDENT,
+         TEST_SUBSLOT_IDENT);
+   }
+   EXPECT_EQ (diag_free_count (net), 0);
+
+   for (item_ix = 0; item_ix < p_dev->max_diag_items; item_ix++)
+   {
+      diag_source.ch = item_ix;
+      EXPECT_EQ (
+         pf_cmdev_find_diag (
+            net,
+            &diag_source,
+            TEST_CHANNEL_ERRORTYPE,
+            TEST_DIAG_EXT_ERRTYPE,
+            PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+         item_ix);
+   }
+
+   /* Find a bucket with a collision */
+   for (bucket = 0; bucket < p_dev->max_diag_items; bucket++)
+   {
+      head_ix = p_dev->diag_index[bucket];
+      if (
+         head_ix != PF_DIAG_IX_NULL &&
+         p_dev->diag_links[head_ix].index_next != PF_DIAG_IX_NULL)
+      {
+         second_ix = p_dev->diag_links[head_ix].index_next;
+         break;
+      }
+   }
+   ASSERT_LT (bucket, p_dev->max_diag_items);
+   third_ix = p_dev->diag_links[second_ix].index_next;
+
+   /* The key of an item in the same bucket, at other locations or with
+    * other error types, does not match */
+   diag_source.ch = second_ix;
+   diag_source.subslot = TEST_SUBSLOT_IDENT + 1;
+   EXPECT_EQ (
+      pf_cmdev_find_diag (
+         net,
+         &diag_source,
+         TEST_CHANNEL_ERRORTYPE,
+         TEST_DIAG_EXT_ERRTYPE,
+         PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+      PF_DIAG_IX_NULL);
+   diag_source.subslot = TEST_SUBSLOT_IDENT;
+   EXPECT_EQ (
+      pf_cmdev_find_diag (
+         net,
+         &diag_source,
+         TEST_CHANNEL_ERRORTYPE_B,
+         TEST_DIAG_EXT_ERRTYPE,
+         PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+      PF_DIAG_IX_NULL);
+
+   /* Remove the second item in the bucket */
+   pf_cmdev_unindex_diag (net, second_ix);
+   EXPECT_EQ (p_dev->diag_index[bucket], head_ix);
+   EXPECT_EQ (p_dev->diag_links[head_ix].index_next, third_ix);
+   EXPECT_EQ (
+      pf_cmdev_find_diag (
+         net,
+         &diag_source,
+         TEST_CHANNEL_ERRORTYPE,
+         TEST_DIAG_EXT_ERRTYPE,
+         PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+      PF_DIAG_IX_NULL);
+   diag_source.ch = head_ix;
+   EXPECT_EQ (
+      pf_cmdev_find_diag (
+         net,
+         &diag_source,
+         TEST_CHANNEL_ERRORTYPE,
+         TEST_DIAG_EXT_ERRTYPE,
+         PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+      head_ix);
+
+   /* Remove the head of the bucket */
+   pf_cmdev_unindex_diag (net, head_ix);
+   EXPECT_EQ (p_dev->diag_index[bucket], third_ix);
+   EXPECT_EQ (
+      pf_cmdev_find_diag (
+         net,
+         &diag_source,
+         TEST_CHANNEL_ERRORTYPE,
+         TEST_DIAG_EXT_ERRTYPE,
+         PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+      PF_DIAG_IX_NULL);
+
+   /* All other items are still found */
+   for (item_ix = 0; item_ix < p_dev->max_diag_items; item_ix++)
+   {
+      if (item_ix == head_ix || item_ix == second_ix)
+      {
+         continue;
+      }
+      diag_source.ch = item_ix;
+      EXPECT_EQ (
+         pf_cmdev_find_diag (
+            net,
+            &diag_source,
+            TEST_CHANNEL_ERRORTYPE,
+            TEST_DIAG_EXT_ERRTYPE,
+            PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+         item_ix);
+   }
+
+   /* Freeing an item also removes it from the index */
+   if (third_ix != PF_DIAG_IX_NULL)
+   {
+      pf_cmdev_free_diag (net, third_ix);
+      EXPECT_NE (p_dev->diag_index[bucket], third_ix);
+   }
+   for (item_ix = 0; item_ix < p_dev->max_diag_items; item_ix++)
+   {
+      if (item_ix != third_ix)
+      {
+         pf_cmdev_free_diag (net, item_ix);
+      }
+   }
+   EXPECT_EQ (diag_free_count (net), p_dev->max_diag_items);
+   for (bucket = 0; bucket < p_dev->max_diag_items; bucket++)
+   {
+      EXPECT_EQ (p_dev->diag_index[bucket], PF_DIAG_IX_NULL);
+   }
+}
+
+TEST_F (DiagTest, DiagLinkUnlink)
+{
+   pf_device_t * p_dev = &net->cmdev_device;
+   pf_subslot_t subslot;
+   uint16_t item_ix[3];
+   uint16_t ix;
+
+   memset (&subslot, 0, sizeof (subslot));
+   subslot.diag_list = PF_DIAG_IX_NULL;
+   subslot.diag_batch_removed = PF_DIAG_IX_NULL;
+
+   /* Each item is linked first in the list */
+   for (ix = 0; ix < NELEMENTS (item_ix); ix++)
+   {
+      ASSERT_EQ (pf_cmdev_new_diag (net, &item_ix[ix]), 0);
+      p_dev->diag_items[item_ix[ix]].usi = TEST_DIAG_USI_CUSTOM + ix;
+      pf_diag_link (net, &subslot, item_ix[ix]);
+   }
+   EXPECT_EQ (subslot.diag_list, item_ix[2]);
+   EXPECT_EQ (p_dev->diag_links[item_ix[2]].prev, PF_DIAG_IX_NULL);
+   EXPECT_EQ (p_dev->diag_items[item_ix[2]].next, item_ix[1]);
+   EXPECT_EQ (p_dev->diag_links[item_ix[1]].prev, item_ix[2]);
+   EXPECT_EQ (p_dev->diag_items[item_ix[1]].next, item_ix[0]);
+   EXPECT_EQ (p_dev->diag_links[item_ix[0]].prev, item_ix[1]);
+   EXPECT_EQ (p_dev->diag_items[item_ix[0]].next, PF_DIAG_IX_NULL);
+   EXPECT_EQ (subslot.diag_counters.fault, 3);
+   EXPECT_EQ (p_dev->diag_counters.fault, 3);
+
+   /* Remove from the middle */
+   pf_diag_unlink (net, &subslot, item_ix[1]);
+   EXPECT_EQ (subslot.diag_list, item_ix[2]);
+   EXPECT_EQ (p_dev->diag_items[item_ix[2]].next, item_ix[0]);
+   EXPECT_EQ (p_dev->diag_links[item_ix[0]].prev, item_ix[2]);
+   EXPECT_EQ (subslot.diag_counters.fault, 2);
+   EXPECT_EQ (p_dev->diag_counters.fault, 2);
+
+   /* Remove the head */
+   pf_diag_unlink (net, &subslot, item_ix[2]);
+   EXPECT_EQ (subslot.diag_list, item_ix[0]);
+   EXPECT_EQ (p_dev->diag_links[item_ix[0]].prev, PF_DIAG_IX_NULL);
+   EXPECT_EQ (p_dev->diag_items[item_ix[0]].next, PF_DIAG_IX_NULL);
+   EXPECT_EQ (subslot.diag_counters.fault, 1);
+
+   /* Remove the last one */
+   pf_diag_unlink (net, &subslot, item_ix[0]);
+   EXPECT_EQ (subslot.diag_list, PF_DIAG_IX_NULL);
+   EXPECT_EQ (subslot.diag_counters.fault, 0);
+   EXPECT_EQ (p_dev->diag_counters.fault, 0);
+
+   /* Link again after removal */
+   pf_diag_link (net, &subslot, item_ix[1]);
+   EXPECT_EQ (subslot.diag_list, item_ix[1]);
+   EXPECT_EQ (p_dev->diag_items[item_ix[1]].next, PF_DIAG_IX_NULL);
+   EXPECT_EQ (p_dev->diag_links[item_ix[1]].prev, PF_DIAG_IX_NULL);
+   pf_diag_unlink (net, &subslot, item_ix[1]);
+
+   for (ix = 0; ix < NELEMENTS (item_ix); ix++)
+   {
+      pf_cmdev_free_diag (net, item_ix[ix]);
+   }
+}
+
+TEST_F (DiagTest, DiagPullSubmoduleFreesItems)
+{
+   pf_subslot_t * p_subslot = NULL;
+   pnet_diag_source_t diag_source = {
+      .api = TEST_API_IDENT,
+      .slot = TEST_SLOT_IDENT,
+      .subslot = TEST_SUBSLOT_IDENT,
+      .ch = TEST_CHANNEL_IDENT,
+      .ch_grouping = PNET_DIAG_CH_INDIVIDUAL_CHANNEL,
+      .ch_direction = TEST_CHANNEL_DIRECTION};
+   uint16_t nbr_free;
+   uint16_t ix;
+   int ret;
+
+   ret = pnet_plug_module (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_MOD_8_8_IDENT);
+   ASSERT_EQ (ret, 0);
+   ret = pnet_plug_submodule (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_SUBSLOT_IDENT,
+      TEST_MOD_8_8_IDENT,
+      TEST_SUBMOD_CUSTOM_IDENT,
+      PNET_DIR_IO,
+      TEST_DATASIZE_INPUT,
+      TEST_DATASIZE_OUTPUT);
+   ASSERT_EQ (ret, 0);
+   nbr_free = diag_free_count (net);
+
+   /* Added in a batch, as the diag functions report an error when there is
+    * no connection to send the alarm on */
+   ret = pnet_diag_begin (net);
+   EXPECT_EQ (ret, 0);
+   for (ix = 0; ix < 3; ix++)
+   {
+      diag_source.ch = ix;
+      ret = pnet_diag_std_add (
+         net,
+         &diag_source,
+         TEST_CHANNEL_NUMBER_OF_BITS,
+         PNET_DIAG_CH_PROP_MAINT_FAULT,
+         TEST_CHANNEL_ERRORTYPE,
+         TEST_DIAG_EXT_ERRTYPE,
+         TEST_DIAG_EXT_ADDVALUE,
+         TEST_DIAG_QUALIFIER_NOTSET);
+      EXPECT_EQ (ret, 0);
+   }
+   ret = pnet_diag_usi_add (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_SUBSLOT_IDENT,
+      TEST_DIAG_USI_CUSTOM,
+      3,
+      (uint8_t *)"ABC");
+   EXPECT_EQ (ret, 0);
+   ret = pnet_diag_commit (net);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (diag_free_count (net), nbr_free - 4);
+   EXPECT_EQ (net->cmdev_device.diag_counters.fault, 4);
+
+   /* No pull alarm is sent without a connection, which is reported as an
+    * error. The submodule is pulled anyway. */
+   (void)pnet_pull_submodule (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_SUBSLOT_IDENT);
+   EXPECT_NE (
+      pf_cmdev_get_subslot_full (
+         net,
+         TEST_API_IDENT,
+         TEST_SLOT_IDENT,
+         TEST_SUBSLOT_IDENT,
+         &p_subslot),
+      0);
+   EXPECT_EQ (diag_free_count (net), nbr_free);
+   EXPECT_EQ (net->cmdev_device.diag_counters.fault, 0);
+   for (ix = 0; ix < 3; ix++)
+   {
+      diag_source.ch = ix;
+      EXPECT_EQ (
+         pf_cmdev_find_diag (
+            net,
+            &diag_source,
+            TEST_CHANNEL_ERRORTYPE,
+            TEST_DIAG_EXT_ERRTYPE,
+            PF_USI_EXTENDED_CHANNEL_DIAGNOSIS),
+         PF_DIAG_IX_NULL);
+   }
+   EXPECT_EQ (
+      pf_cmdev_find_diag (net, &diag_source, 0, 0, TEST_DIAG_USI_CUSTOM),
+      PF_DIAG_IX_NULL);
+
+   /* Plugged again without diagnoses */
+   ret = pnet_plug_submodule (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_SUBSLOT_IDENT,
+      TEST_MOD_8_8_IDENT,
+      TEST_SUBMOD_CUSTOM_IDENT,
+      PNET_DIR_IO,
+      TEST_DATASIZE_INPUT,
+      TEST_DATASIZE_OUTPUT);
+   ASSERT_EQ (ret, 0);
+   ASSERT_EQ (
+      pf_cmdev_get_subslot_full (
+         net,
+         TEST_API_IDENT,
+         TEST_SLOT_IDENT,
+         TEST_SUBSLOT_IDENT,
+         &p_subslot),
+      0);
+   EXPECT_EQ (p_subslot->diag_list, PF_DIAG_IX_NULL);
+   EXPECT_EQ (p_subslot->diag_counters.fault, 0);
+
+   diag_source.ch = TEST_CHANNEL_IDENT;
+   ret = pnet_diag_begin (net);
+   EXPECT_EQ (ret, 0);
+   ret = pnet_diag_std_add (
+      net,
+      &diag_source,
+      TEST_CHANNEL_NUMBER_OF_BITS,
+      PNET_DIAG_CH_PROP_MAINT_FAULT,
+      TEST_CHANNEL_ERRORTYPE,
+      TEST_DIAG_EXT_ERRTYPE,
+      TEST_DIAG_EXT_ADDVALUE,
+      TEST_DIAG_QUALIFIER_NOTSET);
+   EXPECT_EQ (ret, 0);
+   ret = pnet_diag_commit (net);
+   EXPECT_EQ (ret, 0);
+   EXPECT_EQ (diag_free_count (net), nbr_free - 1);
+   EXPECT_EQ (p_subslot->diag_counters.fault, 1);
+}
+
+#if PNET_MAX_DIAG_CACHE_SIZE > 0
+TEST_F (DiagTest, DiagCacheLimit)
+{
+   pf_subslot_t * p_subslot = NULL;
+   pnet_diag_source_t diag_source = {
+      .api = TEST_API_IDENT,
+      .slot = TEST_SLOT_IDENT,
+      .subslot = TEST_SUBSLOT_IDENT,
+      .ch = TEST_CHANNEL_IDENT,
+      .ch_grouping = PNET_DIAG_CH_INDIVIDUAL_CHANNEL,
+      .ch_direction = TEST_CHANNEL_DIRECTION};
+   const uint16_t block_size = 20;
+   uint8_t diag_buffer[PNET_MAX_DIAG_CACHE_SIZE + 100];
+   uint8_t expected_buffer[PNET_MAX_DIAG_CACHE_SIZE + 100];
+   uint16_t diag_pos;
+   uint16_t expected_pos;
+   uint16_t item_size = 0;
+   uint16_t max_cached = 0;
+   uint16_t ix;
+   int ret;
+
+   ret = pnet_plug_module (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_MOD_8_8_IDENT);
+   ASSERT_EQ (ret, 0);
+   ret = pnet_plug_submodule (
+      net,
+      TEST_API_IDENT,
+      TEST_SLOT_IDENT,
+      TEST_SUBSLOT_IDENT,
+      TEST_MOD_8_8_IDENT,
+      TEST_SUBMOD_CUSTOM_IDENT,
+      PNET_DIR_IO,
+      TEST_DATASIZE_INPUT,
+      TEST_DATASIZE_OUTPUT);
+   ASSERT_EQ (ret, 0);
+   ASSERT_EQ (
+      pf_cmdev_get_subslot_full (
+         net,
+         TEST_API_IDENT,
+         TEST_SLOT_IDENT,
+         TEST_SUBSLOT_IDENT,
+         &p_subslot),
+      0);
+
+   /* One DiagnosisData block for the USI, and one entry per channel. The
+    * cache holds (PNET_MAX_DIAG_CACHE_SIZE - block_size) / item_size
+    * diagnoses, larger lists are encoded at each read. */
+   for (ix = 0; (ix == 0) || (ix <= max_cached); ix++)
+   {
+      ret = pnet_diag_begin (net);
+      EXPECT_EQ (ret, 0);
+      diag_source.ch = ix;
+      ret = pnet_diag_std_add (
+         net,
+         &diag_source,
+         TEST_CHANNEL_NUMBER_OF_BITS,
+         PNET_DIAG_CH_PROP_MAINT_FAULT,
+         TEST_CHANNEL_ERRORTYPE,
+         TEST_DIAG_EXT_ERRTYPE,
+         TEST_DIAG_EXT_ADDVALUE,
+         TEST_DIAG_QUALIFIER_NOTSET);
+      EXPECT_EQ (ret, 0);
+      ret = pnet_diag_commit (net);
+      EXPECT_EQ (ret, 0);
+
+      diag_pos = 0;
+      pf_put_diagnosis_device (
+         net,
+         true,
+         PF_DIAG_FILTER_ALL,
+         sizeof (diag_buffer),
+         diag_buffer,
+         &diag_pos);
+      if (ix == 0)
+      {
+         item_size = diag_pos - block_size;
+         max_cached = (PNET_MAX_DIAG_CACHE_SIZE - block_size) / item_size;
+      }
+      EXPECT_EQ (diag_pos, block_size + (ix + 1) * item_size);
+      EXPECT_EQ (p_subslot->diag_cache_fits, ix < max_cached);
+
+      /* Same result as encoding directly */
+      expected_pos = 0;
+      pf_put_diagnosis_device (
+         net,
+         true,
+         PF_DIAG_FILTER_FAULT_ALL,
+         sizeof (expected_buffer),
+         expected_buffer,
+         &expected_pos);
+      EXPECT_EQ (expected_pos, diag_pos);
+      EXPECT_EQ (memcmp (diag_buffer, expected_buffer, diag_pos), 0);
+   }
+   EXPECT_EQ (ix, max_cached + 1);
+}
+#endif
@@ -178,3 +178,63 @@ TEST_F (FspmTest, FspmSaveImLocationShouldTruncateLargeStrings)
    EXPECT_EQ (strlen (actual), 22u);
    EXPECT_STREQ (mock_file_data.filename, PF_FILENAME_IM);
 }
+
+TEST_F (FspmTest, FspmDeferredRecordResponse)
+{
+   pf_ar_t ar;
+   pf_iod_read_request_t read_request;
+   pf_iod_write_request_t write_request;
+   pnet_result_t result;
+   uint8_t response[] = {0x01, 0x02, 0x03};
+   uint8_t * p_data = NULL;
+   uint16_t length = 100;
+
+   memset ((void *)&ar, 0, sizeof (ar));
+   memset (&read_request, 0, sizeof (read_request));
+   memset (&write_request, 0, sizeof (write_request));
+   memset (&result, 0, sizeof (result));
+   ar.arep = 1;
+   read_request.index = 0x0123;
+   write_request.index = 0x0123;
+
+   /* Response given by the application, no callback */
+   ar.record_rsp.state = PF_RECORD_RSP_STATE_READY;
+   ar.record_rsp.is_read = true;
+   ar.record_rsp.p_read_data = response;
+   ar.record_rsp.read_length = sizeof (response);
+   EXPECT_EQ (
+      pf_fspm_cm_read_ind (net, &ar, &read_request, &p_data, &length, &result),
+      0);
+   EXPECT_EQ (p_data, response);
+   EXPECT_EQ (length, sizeof (response));
+   EXPECT_EQ (appdata.call_counters.read_calls, 0);
+
+   /* Response does not fit */
+   length = 2;
+   EXPECT_EQ (
+      pf_fspm_cm_read_ind (net, &ar, &read_request, &p_data, &length, &result),
+      -1);
+   EXPECT_EQ (result.pnio_status.error_code, PNET_ERROR_CODE_READ);
+   EXPECT_EQ (
+      result.pnio_status.error_code_1,
+      PNET_ERROR_CODE_1_APP_READ_ERROR);
+
+   /* Error response from the application */
+   memset (&result, 0, sizeof (result));
+   ar.record_rsp.is_read = false;
+   ar.record_rsp.result.pnio_status.error_code = PNET_ERROR_CODE_WRITE;
+   ar.record_rsp.result.pnio_status.error_code_1 =
+      PNET_ERROR_CODE_1_APP_WRITE_ERROR;
+   EXPECT_EQ (
+      pf_fspm_cm_write_ind (net, &ar, &write_request, 0, NULL, &result),
+      -1);
+   EXPECT_EQ (result.pnio_status.error_code, PNET_ERROR_CODE_WRITE);
+   EXPECT_EQ (
+      result.pnio_status.error_code_1,
+      PNET_ERROR_CODE_1_APP_WRITE_ERROR);
+   EXPECT_EQ (appdata.call_counters.write_calls, 0);
+
+   /* Nothing is pending for an unknown AR */
+   EXPECT_EQ (pnet_read_record_rsp (net, 4711, NULL, 0, NULL), -1);
+   EXPECT_EQ (pnet_write_record_rsp (net, 4711, NULL), -1);
+}
@@ -0,0 +1,221 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2021 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+#include "mocks.h"
+
+#include "pf_includes.h"
+
+#include <gtest/gtest.h>
+
+class FsuTest : public PnetIntegrationTest
+{
+ protected:
+   pf_ar_t ar;
+
+   /** Set up an AR with a Fast Startup block and one expected submodule */
+   void ar_init (uint32_t fs_uuid_data1)
+   {
+      pf_exp_submodule_t * p_exp_sub;
+
+      memset ((void *)&ar, 0, sizeof (ar));
+      ar.fast_startup_data.valid = true;
+      ar.fast_startup_data.fs_parameter_block.fs_parameter_uuid.data1 =
+         fs_uuid_data1;
+
+      ar.exp_ident.nbr_apis = 1;
+      ar.exp_ident.api[0].api = TEST_API_IDENT;
+      ar.exp_ident.api[0].nbr_modules = 1;
+      ar.exp_ident.api[0].module[0].slot_number = TEST_SLOT_IDENT;
+      ar.exp_ident.api[0].module[0].ident_number = TEST_MOD_8_8_IDENT;
+      ar.exp_ident.api[0].module[0].nbr_submodules = 1;
+
+      p_exp_sub = &ar.exp_ident.api[0].module[0].submodule[0];
+      p_exp_sub->subslot_number = TEST_SUBSLOT_IDENT;
+      p_exp_sub->ident_number = TEST_SUBMOD_CUSTOM_IDENT;
+      p_exp_sub->nbr_data_descriptors = 2;
+      p_exp_sub->data_descriptor[0].data_direction = PF_DIRECTION_INPUT;
+      p_exp_sub->data_descriptor[0].submodule_data_length =
+         TEST_DATASIZE_INPUT;
+      p_exp_sub->data_descriptor[1].data_direction = PF_DIRECTION_OUTPUT;
+      p_exp_sub->data_descriptor[1].submodule_data_length =
+         TEST_DATASIZE_OUTPUT;
+   }
+};
+
+TEST_F (FsuTest, FsuStoreAndMatchAtNextStartup)
+{
+   ar_init (0x12345678);
+
+   /* No stored parameters yet */
+   EXPECT_FALSE (net->fsu.stored_valid);
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_STARTUP);
+   EXPECT_FALSE (ar.fast_startup_data.parameters_match);
+   EXPECT_EQ (net->fsu.nbr_matching_connects, 0u);
+
+   /* Stored when cyclic data starts */
+   mock_os_data.current_time_us += 2000;
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_DATA);
+   EXPECT_TRUE (net->fsu.first_data_done);
+   EXPECT_EQ (net->fsu.first_data_delay_us, 2000u);
+   EXPECT_TRUE (net->fsu.stored_valid);
+   EXPECT_EQ (net->fsu.stored.fs_parameter_uuid.data1, 0x12345678u);
+   ASSERT_EQ (net->fsu.stored.nbr_submodules, 1u);
+   EXPECT_EQ (net->fsu.stored.submodule[0].slot_number, TEST_SLOT_IDENT);
+   EXPECT_EQ (net->fsu.stored.submodule[0].subslot_number, TEST_SUBSLOT_IDENT);
+   EXPECT_EQ (net->fsu.stored.submodule[0].module_ident, TEST_MOD_8_8_IDENT);
+   EXPECT_EQ (
+      net->fsu.stored.submodule[0].submodule_ident,
+      (uint32_t)TEST_SUBMOD_CUSTOM_IDENT);
+   EXPECT_EQ (net->fsu.stored.submodule[0].data_cfg.data_dir, PNET_DIR_IO);
+   EXPECT_EQ (
+      net->fsu.stored.submodule[0].data_cfg.insize,
+      TEST_DATASIZE_INPUT);
+   EXPECT_EQ (
+      net->fsu.stored.submodule[0].data_cfg.outsize,
+      TEST_DATASIZE_OUTPUT);
+
+   /* Saved to nvm by the background worker */
+   pf_fsu_save (net);
+   EXPECT_STREQ (mock_file_data.filename, PF_FILENAME_FSU);
+   EXPECT_EQ (mock_file_data.size, sizeof (pf_fsu_nvm_t));
+
+   /* Next power-on reads the parameters from nvm */
+   memset (&net->fsu.stored, 0, sizeof (net->fsu.stored));
+   net->fsu.stored_valid = false;
+   pf_fsu_init (net);
+   EXPECT_TRUE (net->fsu.stored_valid);
+   EXPECT_FALSE (net->fsu.first_data_done);
+   EXPECT_EQ (net->fsu.stored.fs_parameter_uuid.data1, 0x12345678u);
+   EXPECT_EQ (net->fsu.stored.nbr_submodules, 1u);
+
+   /* A connect with the same parameters matches */
+   ar_init (0x12345678);
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_STARTUP);
+   EXPECT_TRUE (ar.fast_startup_data.parameters_match);
+   EXPECT_EQ (net->fsu.nbr_matching_connects, 1u);
+
+   /* A connect with another FSParameterUUID does not match */
+   ar_init (0x87654321);
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_STARTUP);
+   EXPECT_FALSE (ar.fast_startup_data.parameters_match);
+   EXPECT_EQ (net->fsu.nbr_matching_connects, 1u);
+}
+
+TEST_F (FsuTest, FsuRejectInvalidStoredParameters)
+{
+   pf_fsu_nvm_t * p_nvm = (pf_fsu_nvm_t *)mock_file_data.object;
+
+   ar_init (0x12345678);
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_STARTUP);
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_DATA);
+   pf_fsu_save (net);
+   ASSERT_EQ (mock_file_data.size, sizeof (pf_fsu_nvm_t));
+
+   /* Corrupt number of submodules in nvm */
+   p_nvm->nbr_submodules = PF_FSU_MAX_SUBMODULES + 1;
+   pf_fsu_init (net);
+   EXPECT_FALSE (net->fsu.stored_valid);
+   EXPECT_EQ (net->fsu.stored.nbr_submodules, 0u);
+
+   /* Maximum number is accepted */
+   p_nvm->nbr_submodules = PF_FSU_MAX_SUBMODULES;
+   pf_fsu_init (net);
+   EXPECT_TRUE (net->fsu.stored_valid);
+}
+
+TEST_F (FsuTest, FsuNoStoreWithoutFastStartupBlock)
+{
+   ar_init (0x12345678);
+   ar.fast_startup_data.valid = false;
+
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_STARTUP);
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_DATA);
+   EXPECT_TRUE (net->fsu.first_data_done);
+   EXPECT_FALSE (net->fsu.stored_valid);
+
+   pf_fsu_save (net);
+   EXPECT_STREQ (mock_file_data.filename, "");
+}
+
+TEST_F (FsuTest, FsuPlugStoredConfigAtStartup)
+{
+   pf_subslot_t * p_subslot = NULL;
+   pf_fsu_submodule_t * p_fsu_sub;
+
+   EXPECT_NE (
+      pf_cmdev_get_subslot_full (
+         net,
+         TEST_API_IDENT,
+         TEST_SLOT_IDENT,
+         TEST_SUBSLOT_IDENT,
+         &p_subslot),
+      0);
+
+   net->fsu.stored_valid = true;
+   net->fsu.stored.nbr_submodules = 1;
+   p_fsu_sub = &net->fsu.stored.submodule[0];
+   p_fsu_sub->api = TEST_API_IDENT;
+   p_fsu_sub->slot_number = TEST_SLOT_IDENT;
+   p_fsu_sub->subslot_number = TEST_SUBSLOT_IDENT;
+   p_fsu_sub->module_ident = TEST_MOD_8_8_IDENT;
+   p_fsu_sub->submodule_ident = TEST_SUBMOD_CUSTOM_IDENT;
+   p_fsu_sub->data_cfg.data_dir = PNET_DIR_IO;
+   p_fsu_sub->data_cfg.insize = TEST_DATASIZE_INPUT;
+   p_fsu_sub->data_cfg.outsize = TEST_DATASIZE_OUTPUT;
+
+   pf_fsu_periodic (net);
+   EXPECT_TRUE (net->fsu.config_plugged);
+   ASSERT_EQ (
+      pf_cmdev_get_subslot_full (
+         net,
+         TEST_API_IDENT,
+         TEST_SLOT_IDENT,
+         TEST_SUBSLOT_IDENT,
+         &p_subslot),
+      0);
+   EXPECT_EQ (p_subslot->ident_number, (uint32_t)TEST_SUBMOD_CUSTOM_IDENT);
+
+   /* Only plugged once after startup */
+   p_fsu_sub->slot_number = TEST_SLOT_IDENT + 1;
+   pf_fsu_periodic (net);
+   EXPECT_NE (
+      pf_cmdev_get_subslot_full (
+         net,
+         TEST_API_IDENT,
+         TEST_SLOT_IDENT + 1,
+         TEST_SUBSLOT_IDENT,
+         &p_subslot),
+      0);
+}
+
+TEST_F (FsuTest, FsuClearAtFactoryReset)
+{
+   ar_init (0x12345678);
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_STARTUP);
+   pf_fsu_cmdev_state_ind (net, &ar, PNET_EVENT_DATA);
+   pf_fsu_save (net);
+   ASSERT_TRUE (net->fsu.stored_valid);
+   ASSERT_STREQ (mock_file_data.filename, PF_FILENAME_FSU);
+
+   pnet_factory_reset (net);
+   EXPECT_FALSE (net->fsu.stored_valid);
+   EXPECT_EQ (net->fsu.stored.nbr_submodules, 0u);
+   EXPECT_STREQ (mock_file_data.filename, "");
+
+   /* Nothing to load at next power-on */
+   pf_fsu_init (net);
+   EXPECT_FALSE (net->fsu.stored_valid);
+}
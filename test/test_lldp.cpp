@@ -894,6 +894,77 @@ TEST_F (LldpTest, LldpGetPeerTimestamp)
    EXPECT_EQ (actual, expected);
 }
 
+TEST_F (LldpTest, LldpGetPeerSnapshot)
+{
+   const pf_lldp_peer_info_t received = fake_peer_info();
+   pf_lldp_peer_snapshot_t snapshot;
+
+   /* Nothing received */
+   pf_lldp_get_peer_snapshot (net, LOCAL_PORT, &snapshot);
+   EXPECT_FALSE (snapshot.is_received);
+
+   /* Receive fake data at fake timestamp */
+   mock_os_data.system_uptime_10ms = 0x12345678;
+   pf_lldp_store_peer_info (net, LOCAL_PORT, &received);
+
+   pf_lldp_get_peer_snapshot (net, LOCAL_PORT, &snapshot);
+   EXPECT_TRUE (snapshot.is_received);
+   EXPECT_EQ (snapshot.timestamp_10ms, 0x12345678u);
+   EXPECT_EQ (memcmp (&snapshot.info, &received, sizeof (received)), 0);
+
+   pf_lldp_invalidate_peer_info (net, LOCAL_PORT);
+   pf_lldp_get_peer_snapshot (net, LOCAL_PORT, &snapshot);
+   EXPECT_FALSE (snapshot.is_received);
+   EXPECT_FALSE (snapshot.info.chassis_id.is_valid);
+}
+
+TEST_F (LldpTest, LldpGetPeerSnapshotWhileUpdated)
+{
+   const pf_lldp_peer_info_t received = fake_peer_info();
+   pf_lldp_peer_snapshot_t snapshot;
+   pf_port_t * p_port_data = pf_port_get_state (net, LOCAL_PORT);
+
+   mock_os_data.system_uptime_10ms = 0x12345678;
+   pf_lldp_store_peer_info (net, LOCAL_PORT, &received);
+
+#if PNET_USE_ATOMICS
+   /* Writer that does not finish. The reader falls back to the mutex. */
+   p_port_data->lldp.peer_info_seq++;
+#endif
+   pf_lldp_get_peer_snapshot (net, LOCAL_PORT, &snapshot);
+   EXPECT_TRUE (snapshot.is_received);
+   EXPECT_EQ (snapshot.timestamp_10ms, 0x12345678u);
+   EXPECT_EQ (memcmp (&snapshot.info, &received, sizeof (received)), 0);
+#if PNET_USE_ATOMICS
+   p_port_data->lldp.peer_info_seq++;
+#endif
+   EXPECT_TRUE (p_port_data->lldp.is_peer_info_received);
+}
+
+TEST_F (LldpTest, LldpGetGeneration)
+{
+   const pf_lldp_peer_info_t received = fake_peer_info();
+   uint32_t generation;
+
+   generation = pf_lldp_get_generation (net);
+   EXPECT_EQ (pf_lldp_get_generation (net), generation);
+
+   /* Nothing to invalidate */
+   pf_lldp_invalidate_peer_info (net, LOCAL_PORT);
+   EXPECT_EQ (pf_lldp_get_generation (net), generation);
+
+   pf_lldp_store_peer_info (net, LOCAL_PORT, &received);
+   EXPECT_NE (pf_lldp_get_generation (net), generation);
+   generation = pf_lldp_get_generation (net);
+
+   pf_lldp_invalidate_peer_info (net, LOCAL_PORT);
+   EXPECT_NE (pf_lldp_get_generation (net), generation);
+   generation = pf_lldp_get_generation (net);
+
+   pf_lldp_invalidate_tx_frames (net);
+   EXPECT_NE (pf_lldp_get_generation (net), generation);
+}
+
 TEST_F (LldpTest, LldpGetPeerChassisId)
 {
    const pf_lldp_peer_info_t received = fake_peer_info();
@@ -970,6 +1041,30 @@ TEST_F (LldpTest, LldpGetPeerManagementAddress)
    EXPECT_EQ (memcmp (&actual, &expected, sizeof (actual)), 0);
 }
 
+TEST_F (LldpTest, LldpIsAliasMatching)
+{
+   const pf_lldp_peer_info_t received = fake_peer_info();
+   const char * alias = "Port ID received from remote device."
+                        "Chassis ID received from remote device";
+
+   /* Nothing received */
+   EXPECT_FALSE (pf_lldp_is_alias_matching (net, alias));
+
+   /* Receive fake data */
+   pf_lldp_store_peer_info (net, LOCAL_PORT, &received);
+
+   EXPECT_TRUE (pf_lldp_is_alias_matching (net, alias));
+   EXPECT_FALSE (pf_lldp_is_alias_matching (net, "Port ID received"));
+   EXPECT_FALSE (pf_lldp_is_alias_matching (
+      net,
+      "Port ID received from remote device."
+      "Chassis ID received from remote devicE"));
+
+   /* Peer information times out */
+   pf_lldp_invalidate_peer_info (net, LOCAL_PORT);
+   EXPECT_FALSE (pf_lldp_is_alias_matching (net, alias));
+}
+
 TEST_F (LldpTest, LldpGetPeerStationName)
 {
    pf_lldp_station_name_t station_name;
@@ -1020,6 +1115,87 @@ TEST_F (LldpTest, LldpGetPeerLinkStatus)
    EXPECT_EQ (memcmp (&actual, &expected, sizeof (actual)), 0);
 }
 
+extern "C" uint32_t pnal_buf_alloc_cnt;
+
+TEST_F (LldpTest, LldpSendPrebuiltFrame)
+{
+   std::string frame;
+   uint16_t send_count = mock_os_data.eth_send_count;
+   uint32_t alloc_cnt = pnal_buf_alloc_cnt;
+
+   snprintf (
+      net->cmina_current_dcp_ase.station_name,
+      sizeof (net->cmina_current_dcp_ase.station_name),
+      "%s",
+      "lldp-test");
+
+   /* Frame is not rebuilt until invalidated */
+   run_stack (PF_LLDP_SEND_INTERVAL * 1000 + TEST_SCHEDULER_CALLBACK_DELAY);
+   EXPECT_EQ (
+      mock_os_data.eth_send_count,
+      send_count + PNET_MAX_PHYSICAL_PORTS);
+   frame.assign ((char *)mock_os_data.eth_send_copy, mock_os_data.eth_send_len);
+   EXPECT_EQ (frame.find ("lldp-test"), std::string::npos);
+
+   /* Each frame is sent in its own buffer, which is freed after sending */
+   EXPECT_EQ (pnal_buf_alloc_cnt, alloc_cnt);
+
+   pf_lldp_invalidate_tx_frames (net);
+
+   run_stack (PF_LLDP_SEND_INTERVAL * 1000);
+   EXPECT_EQ (
+      mock_os_data.eth_send_count,
+      send_count + 2 * PNET_MAX_PHYSICAL_PORTS);
+   frame.assign ((char *)mock_os_data.eth_send_copy, mock_os_data.eth_send_len);
+   EXPECT_NE (frame.find ("lldp-test"), std::string::npos);
+}
+
+TEST_F (LldpTest, LldpRecvIdenticalFrame)
+{
+   uint8_t frame[PF_FRAME_BUFFER_SIZE];
+   const uint16_t offset = 14; /* Ethernet header */
+   pnal_buf_t * p_buf;
+   const pf_port_t * p_port_data = pf_port_get_state (net, LOCAL_PORT);
+   size_t size;
+   uint16_t ttl_pos;
+   int ret;
+
+   size = pf_lldp_construct_frame (net, LOCAL_PORT, frame);
+
+   /* TTL value is after the chassis ID and port ID TLVs */
+   ttl_pos = offset;
+   ttl_pos += 2 + (((frame[ttl_pos] << 8) | frame[ttl_pos + 1]) & 0x1FF);
+   ttl_pos += 2 + (((frame[ttl_pos] << 8) | frame[ttl_pos + 1]) & 0x1FF);
+   ttl_pos += 2;
+
+   p_buf = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+   memcpy (p_buf->payload, frame, size);
+   p_buf->len = size;
+   ret = pf_lldp_recv (net, LOCAL_PORT, p_buf, offset);
+   EXPECT_EQ (ret, 1);
+   EXPECT_TRUE (p_port_data->lldp.is_peer_info_received);
+   EXPECT_EQ (p_port_data->lldp.peer_info.ttl, PF_LLDP_TTL);
+
+   /* Same frame with another TTL is not parsed again */
+   frame[ttl_pos + 1] = 30;
+   p_buf = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+   memcpy (p_buf->payload, frame, size);
+   p_buf->len = size;
+   ret = pf_lldp_recv (net, LOCAL_PORT, p_buf, offset);
+   EXPECT_EQ (ret, 1);
+   EXPECT_EQ (p_port_data->lldp.peer_info.ttl, PF_LLDP_TTL);
+
+   /* Parsed again after the peer information has been invalidated */
+   pf_lldp_invalidate_peer_info (net, LOCAL_PORT);
+   p_buf = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+   memcpy (p_buf->payload, frame, size);
+   p_buf->len = size;
+   ret = pf_lldp_recv (net, LOCAL_PORT, p_buf, offset);
+   EXPECT_EQ (ret, 1);
+   EXPECT_TRUE (p_port_data->lldp.is_peer_info_received);
+   EXPECT_EQ (p_port_data->lldp.peer_info.ttl, 30);
+}
+
 TEST_F (LldpTest, LldpConstructFrame)
 {
    uint8_t frame[MAX_ETH_FRAME_SIZE];
@@ -427,3 +427,27 @@ TEST_F (PnetapiTest, PnetapiShowTest)
    EXPECT_EQ (appdata.call_counters.state_calls, 2);
    EXPECT_EQ (appdata.cmdev_state, PNET_EVENT_ABORT);
 }
+
+TEST_F (PnetapiTest, PnetapiReinitAllocatesPools)
+{
+   ASSERT_TRUE (net->cmdev_pool != NULL);
+
+   /* Nothing is read from the memory before it is initialised */
+   pnet_free_pools (net);
+   EXPECT_TRUE (net->cmdev_pool == NULL);
+   memset ((void *)net, 0xa5, sizeof (*net));
+   EXPECT_EQ (pnet_init_only (net, &pnet_default_cfg), 0);
+   ASSERT_TRUE (net->cmdev_pool != NULL);
+   EXPECT_EQ (net->cmdev_device.diag_items[0].usi, 0);
+
+   /* Larger pools for a larger configuration */
+   pnet_free_pools (net);
+   pnet_default_cfg.max_diag_items = 2 * net->cmdev_device.max_diag_items;
+   EXPECT_EQ (pnet_init_only (net, &pnet_default_cfg), 0);
+   EXPECT_EQ (
+      net->cmdev_device.max_diag_items,
+      pnet_default_cfg.max_diag_items);
+   EXPECT_EQ (
+      net->alarm_pool,
+      net->cmdev_pool + pf_cmdev_pool_size (&pnet_default_cfg));
+}
@@ -135,6 +135,40 @@ TEST_F (SchedulerUnitTest, SchedulerSanitizeDelayTest)
    ASSERT_NEAR (result, 1000, margin);
 }
 
+TEST_F (SchedulerUnitTest, SchedulerTokenBucket)
+{
+   pf_token_bucket_t bucket;
+   uint32_t now = 1000000;
+
+   /* Bucket size 3, refilled with 2 tokens per second */
+   bucket.tokens = 3;
+   bucket.time = now;
+   EXPECT_TRUE (pf_scheduler_token_take (&bucket, 2, 3, now));
+   EXPECT_TRUE (pf_scheduler_token_take (&bucket, 2, 3, now));
+   EXPECT_TRUE (pf_scheduler_token_take (&bucket, 2, 3, now));
+   EXPECT_FALSE (pf_scheduler_token_take (&bucket, 2, 3, now));
+
+   /* Not enough time for a new token */
+   now += 499999;
+   EXPECT_FALSE (pf_scheduler_token_take (&bucket, 2, 3, now));
+
+   /* One token per 500 ms. The remainder is not lost. */
+   now += 1;
+   EXPECT_TRUE (pf_scheduler_token_take (&bucket, 2, 3, now));
+   EXPECT_FALSE (pf_scheduler_token_take (&bucket, 2, 3, now));
+   now += 750000;
+   EXPECT_TRUE (pf_scheduler_token_take (&bucket, 2, 3, now));
+   now += 250000;
+   EXPECT_TRUE (pf_scheduler_token_take (&bucket, 2, 3, now));
+   EXPECT_FALSE (pf_scheduler_token_take (&bucket, 2, 3, now));
+
+   /* Never more than the bucket size */
+   now += 10000000;
+   EXPECT_EQ (bucket.tokens, 0);
+   EXPECT_TRUE (pf_scheduler_token_take (&bucket, 2, 3, now));
+   EXPECT_EQ (bucket.tokens, 2);
+}
+
 TEST_F (SchedulerTest, SchedulerAddRemove)
 {
    int ret;
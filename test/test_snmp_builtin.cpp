@@ -0,0 +1,1261 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2020 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+/**
+ * @file
+ * @brief Unit test for the built-in SNMP responder in pnal_snmp_builtin.c.
+ *
+ * Requests are encoded here and passed to pnal_snmp_handle_request(), and
+ * the responses are decoded and checked.
+ */
+
+#include "utils_for_testing.h"
+#include "mocks.h"
+
+#include "pf_includes.h"
+#include "pnal_snmp_builtin.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define LOCAL_PORT 1
+
+#define MAX_MESSAGE_SIZE 1472
+#define MAX_VARBINDS     64
+#define MAX_OID_LEN      64
+
+#define VERSION_1  0
+#define VERSION_2C 1
+
+#define TAG_INTEGER        0x02
+#define TAG_OCTET_STRING   0x04
+#define TAG_NULL           0x05
+#define TAG_OID            0x06
+#define TAG_SEQUENCE       0x30
+#define TAG_NO_SUCH_OBJECT   0x80
+#define TAG_NO_SUCH_INSTANCE 0x81
+#define TAG_END_OF_MIB       0x82
+
+#define PDU_GET      0xA0
+#define PDU_GETNEXT  0xA1
+#define PDU_RESPONSE 0xA2
+#define PDU_SET      0xA3
+#define PDU_GETBULK  0xA5
+
+#define ERR_NO_ERROR     0
+#define ERR_TOO_BIG      1
+#define ERR_NO_SUCH_NAME 2
+#define ERR_BAD_VALUE    3
+#define ERR_NO_ACCESS    6
+#define ERR_WRONG_TYPE   7
+#define ERR_WRONG_LENGTH 8
+#define ERR_NOT_WRITABLE 17
+
+typedef std::vector<uint8_t> bytes_t;
+typedef std::vector<uint32_t> oid_t;
+
+typedef struct varbind
+{
+   oid_t oid;
+   uint8_t type;
+   bytes_t value;
+} varbind_t;
+
+typedef struct response
+{
+   int32_t version;
+   std::string community;
+   int32_t request_id;
+   int32_t error_status;
+   int32_t error_index;
+   std::vector<varbind_t> varbinds;
+} response_t;
+
+static const oid_t oid_sys_descr = {1, 3, 6, 1, 2, 1, 1, 1, 0};
+static const oid_t oid_sys_object_id = {1, 3, 6, 1, 2, 1, 1, 2, 0};
+static const oid_t oid_sys_contact = {1, 3, 6, 1, 2, 1, 1, 4, 0};
+static const oid_t oid_sys_name = {1, 3, 6, 1, 2, 1, 1, 5, 0};
+static const oid_t oid_sys_location = {1, 3, 6, 1, 2, 1, 1, 6, 0};
+static const oid_t oid_sys_services = {1, 3, 6, 1, 2, 1, 1, 7, 0};
+static const oid_t oid_sys_unknown = {1, 3, 6, 1, 2, 1, 1, 99, 0};
+static const oid_t oid_zero = {0, 0};
+static const oid_t oid_rem_chassis_id_subtype =
+   {1, 0, 8802, 1, 1, 2, 1, 4, 1, 1, 4};
+
+/******************************* Encoding **********************************/
+
+static bytes_t ber_tlv (uint8_t tag, const bytes_t & content)
+{
+   bytes_t out = {tag};
+   size_t len = content.size();
+
+   if (len < 0x80)
+   {
+      out.push_back ((uint8_t)len);
+   }
+   else if (len <= 0xFF)
+   {
+      out.push_back (0x81);
+      out.push_back ((uint8_t)len);
+   }
+   else
+   {
+      out.push_back (0x82);
+      out.push_back ((uint8_t)(len >> 8));
+      out.push_back ((uint8_t)len);
+   }
+
+   out.insert (out.end(), content.begin(), content.end());
+   return out;
+}
+
+static bytes_t ber_integer (int32_t value)
+{
+   bytes_t content;
+   int64_t v = value;
+
+   /* Minimum number of octets in two's complement */
+   do
+   {
+      content.insert (content.begin(), (uint8_t)v);
+      v >>= 8;
+   } while (!((v == 0 && (content[0] & 0x80) == 0) ||
+              (v == -1 && (content[0] & 0x80) != 0)));
+
+   return ber_tlv (TAG_INTEGER, content);
+}
+
+static bytes_t ber_octets (const std::string & octets)
+{
+   return ber_tlv (TAG_OCTET_STRING, bytes_t (octets.begin(), octets.end()));
+}
+
+static bytes_t ber_null (void)
+{
+   return ber_tlv (TAG_NULL, bytes_t());
+}
+
+static void ber_subid (bytes_t & out, uint32_t subid)
+{
+   bytes_t encoded = {(uint8_t)(subid & 0x7F)};
+
+   for (subid >>= 7; subid != 0; subid >>= 7)
+   {
+      encoded.insert (encoded.begin(), (uint8_t)(0x80 | (subid & 0x7F)));
+   }
+
+   out.insert (out.end(), encoded.begin(), encoded.end());
+}
+
+static bytes_t ber_oid (const oid_t & oid)
+{
+   bytes_t content;
+   size_t ix;
+
+   ber_subid (content, oid[0] * 40 + oid[1]);
+   for (ix = 2; ix < oid.size(); ix++)
+   {
+      ber_subid (content, oid[ix]);
+   }
+
+   return ber_tlv (TAG_OID, content);
+}
+
+static bytes_t ber_varbind (const bytes_t & oid, const bytes_t & value)
+{
+   bytes_t content = oid;
+
+   content.insert (content.end(), value.begin(), value.end());
+   return ber_tlv (TAG_SEQUENCE, content);
+}
+
+static bytes_t ber_varbind (const oid_t & oid, const bytes_t & value)
+{
+   return ber_varbind (ber_oid (oid), value);
+}
+
+static bytes_t ber_varbind (const oid_t & oid)
+{
+   return ber_varbind (ber_oid (oid), ber_null());
+}
+
+/**
+ * Encode a request message.
+ *
+ * For GetBulk, the error status and index fields are non-repeaters and
+ * max-repetitions.
+ */
+static bytes_t snmp_message (
+   int32_t version,
+   const std::string & community,
+   uint8_t pdu_type,
+   int32_t request_id,
+   int32_t error_status,
+   int32_t error_index,
+   const std::vector<bytes_t> & varbinds)
+{
+   bytes_t list;
+   bytes_t pdu;
+   bytes_t message;
+   bytes_t field;
+
+   for (const bytes_t & varbind : varbinds)
+   {
+      list.insert (list.end(), varbind.begin(), varbind.end());
+   }
+
+   pdu = ber_integer (request_id);
+   field = ber_integer (error_status);
+   pdu.insert (pdu.end(), field.begin(), field.end());
+   field = ber_integer (error_index);
+   pdu.insert (pdu.end(), field.begin(), field.end());
+   field = ber_tlv (TAG_SEQUENCE, list);
+   pdu.insert (pdu.end(), field.begin(), field.end());
+
+   message = ber_integer (version);
+   field = ber_octets (community);
+   message.insert (message.end(), field.begin(), field.end());
+   field = ber_tlv (pdu_type, pdu);
+   message.insert (message.end(), field.begin(), field.end());
+
+   return ber_tlv (TAG_SEQUENCE, message);
+}
+
+/******************************* Decoding **********************************/
+
+typedef struct reader
+{
+   const uint8_t * p_buf;
+   size_t pos;
+   size_t end;
+} reader_t;
+
+static bool ber_get_header (
+   reader_t * p_reader,
+   uint8_t * p_tag,
+   size_t * p_len)
+{
+   size_t len;
+   size_t n;
+
+   if (p_reader->end - p_reader->pos < 2)
+   {
+      return false;
+   }
+
+   *p_tag = p_reader->p_buf[p_reader->pos++];
+   len = p_reader->p_buf[p_reader->pos++];
+   if (len & 0x80)
+   {
+      n = len & 0x7F;
+      len = 0;
+      while (n-- > 0 && p_reader->pos < p_reader->end)
+      {
+         len = (len << 8) | p_reader->p_buf[p_reader->pos++];
+      }
+   }
+
+   *p_len = len;
+   return p_reader->end - p_reader->pos >= len;
+}
+
+static bool ber_get_integer (reader_t * p_reader, int32_t * p_value)
+{
+   uint8_t tag;
+   size_t len;
+   uint32_t value;
+
+   if (!ber_get_header (p_reader, &tag, &len) || tag != TAG_INTEGER)
+   {
+      return false;
+   }
+
+   value = (p_reader->p_buf[p_reader->pos] & 0x80) ? UINT32_MAX : 0;
+   while (len-- > 0)
+   {
+      value = (value << 8) | p_reader->p_buf[p_reader->pos++];
+   }
+
+   *p_value = (int32_t)value;
+   return true;
+}
+
+static bool ber_get_oid (reader_t * p_reader, oid_t * p_oid)
+{
+   uint8_t tag;
+   size_t len;
+   size_t end;
+   uint32_t subid;
+
+   if (!ber_get_header (p_reader, &tag, &len) || tag != TAG_OID)
+   {
+      return false;
+   }
+
+   p_oid->clear();
+   end = p_reader->pos + len;
+   while (p_reader->pos < end)
+   {
+      subid = 0;
+      do
+      {
+         subid = (subid << 7) | (p_reader->p_buf[p_reader->pos] & 0x7F);
+      } while (p_reader->p_buf[p_reader->pos++] & 0x80);
+
+      if (p_oid->empty())
+      {
+         p_oid->push_back (subid / 40);
+         subid %= 40;
+      }
+      p_oid->push_back (subid);
+   }
+
+   return true;
+}
+
+static bool snmp_decode (
+   const uint8_t * p_buf,
+   size_t len,
+   response_t * p_response)
+{
+   reader_t reader = {p_buf, 0, len};
+   varbind_t varbind;
+   uint8_t tag;
+   size_t field_len;
+   size_t end;
+
+   p_response->varbinds.clear();
+
+   if (
+      !ber_get_header (&reader, &tag, &field_len) || tag != TAG_SEQUENCE ||
+      reader.pos + field_len != len ||
+      !ber_get_integer (&reader, &p_response->version) ||
+      !ber_get_header (&reader, &tag, &field_len) ||
+      tag != TAG_OCTET_STRING)
+   {
+      return false;
+   }
+   p_response->community.assign ((const char *)&p_buf[reader.pos], field_len);
+   reader.pos += field_len;
+
+   if (
+      !ber_get_header (&reader, &tag, &field_len) || tag != PDU_RESPONSE ||
+      !ber_get_integer (&reader, &p_response->request_id) ||
+      !ber_get_integer (&reader, &p_response->error_status) ||
+      !ber_get_integer (&reader, &p_response->error_index) ||
+      !ber_get_header (&reader, &tag, &field_len) || tag != TAG_SEQUENCE)
+   {
+      return false;
+   }
+
+   while (reader.pos < reader.end)
+   {
+      if (
+         !ber_get_header (&reader, &tag, &field_len) ||
+         tag != TAG_SEQUENCE || !ber_get_oid (&reader, &varbind.oid) ||
+         !ber_get_header (&reader, &varbind.type, &field_len))
+      {
+         return false;
+      }
+
+      end = reader.pos + field_len;
+      varbind.value.assign (&p_buf[reader.pos], &p_buf[end]);
+      reader.pos = end;
+      p_response->varbinds.push_back (varbind);
+   }
+
+   return true;
+}
+
+static std::string value_as_string (const varbind_t & varbind)
+{
+   return std::string (varbind.value.begin(), varbind.value.end());
+}
+
+static bool oid_is_less (const oid_t & a, const oid_t & b)
+{
+   return std::lexicographical_compare (a.begin(), a.end(), b.begin(), b.end());
+}
+
+/********************************* Tests ***********************************/
+
+class SnmpBuiltinTest : public PnetIntegrationTest
+{
+ protected:
+   uint8_t response_buffer[MAX_MESSAGE_SIZE];
+
+   virtual void SetUp() override
+   {
+      PnetIntegrationTest::SetUp();
+      pnal_snmp_invalidate_tables();
+      receive_lldp_frame();
+   }
+
+   /** Receive our own LLDP frame, so that there are remote table rows.
+    * Optional fields not sent by us are added afterwards. */
+   void receive_lldp_frame (void)
+   {
+      uint8_t frame[PF_FRAME_BUFFER_SIZE];
+      pf_lldp_peer_snapshot_t snapshot;
+      pnal_buf_t * p_buf;
+      size_t size;
+
+      size = pf_lldp_construct_frame (net, LOCAL_PORT, frame);
+      p_buf = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+      memcpy (p_buf->payload, frame, size);
+      p_buf->len = size;
+      ASSERT_EQ (pf_lldp_recv (net, LOCAL_PORT, p_buf, 14), 1);
+
+      pf_lldp_get_peer_snapshot (net, LOCAL_PORT, &snapshot);
+      ASSERT_TRUE (snapshot.is_received);
+      snprintf (
+         snapshot.info.port_description.string,
+         sizeof (snapshot.info.port_description.string),
+         "Port 1");
+      snapshot.info.port_description.len = 6;
+      snapshot.info.port_description.is_valid = true;
+      snapshot.info.port_delay.rx_delay_local = 1;
+      snapshot.info.port_delay.tx_delay_local = 2;
+      snapshot.info.port_delay.cable_delay_local = 3;
+      snapshot.info.port_delay.is_valid = true;
+      pf_lldp_store_peer_info (net, LOCAL_PORT, &snapshot.info);
+   }
+
+   int handle (const bytes_t & request, size_t response_size)
+   {
+      return pnal_snmp_handle_request (
+         net,
+         request.data(),
+         request.size(),
+         response_buffer,
+         response_size);
+   }
+
+   /** Handle a request and decode the response */
+   ::testing::AssertionResult exchange (
+      const bytes_t & request,
+      response_t * p_response,
+      size_t response_size = MAX_MESSAGE_SIZE)
+   {
+      int len = handle (request, response_size);
+
+      if (len < 0)
+      {
+         return ::testing::AssertionFailure() << "No response";
+      }
+      if ((size_t)len > response_size)
+      {
+         return ::testing::AssertionFailure() << "Response overflow";
+      }
+      if (!snmp_decode (response_buffer, (size_t)len, p_response))
+      {
+         return ::testing::AssertionFailure() << "Malformed response";
+      }
+
+      return ::testing::AssertionSuccess();
+   }
+};
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinGet)
+{
+   response_t response;
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GET,
+         0x12345678,
+         0,
+         0,
+         {ber_varbind (oid_sys_services), ber_varbind (oid_sys_unknown)}),
+      &response));
+
+   EXPECT_EQ (response.version, VERSION_2C);
+   EXPECT_EQ (response.community, "public");
+   EXPECT_EQ (response.request_id, 0x12345678);
+   EXPECT_EQ (response.error_status, ERR_NO_ERROR);
+   EXPECT_EQ (response.error_index, 0);
+   ASSERT_EQ (response.varbinds.size(), 2u);
+   EXPECT_EQ (response.varbinds[0].oid, oid_sys_services);
+   EXPECT_EQ (response.varbinds[0].type, TAG_INTEGER);
+   EXPECT_EQ (response.varbinds[0].value, bytes_t ({78}));
+   EXPECT_EQ (response.varbinds[1].oid, oid_sys_unknown);
+   EXPECT_EQ (response.varbinds[1].type, TAG_NO_SUCH_OBJECT);
+
+   /* Unknown community is dropped */
+   EXPECT_EQ (
+      handle (
+         snmp_message (
+            VERSION_2C,
+            "secret",
+            PDU_GET,
+            1,
+            0,
+            0,
+            {ber_varbind (oid_sys_services)}),
+         MAX_MESSAGE_SIZE),
+      -1);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinInvalidLength)
+{
+   const bytes_t request = snmp_message (
+      VERSION_2C,
+      "public",
+      PDU_GET,
+      1,
+      0,
+      0,
+      {ber_varbind (oid_sys_services)});
+   bytes_t invalid;
+   size_t len;
+
+   /* Every truncated message is dropped */
+   for (len = 0; len < request.size(); len++)
+   {
+      EXPECT_EQ (
+         handle (bytes_t (request.begin(), request.begin() + len), 100),
+         -1)
+         << "Length " << len;
+   }
+
+   /* Outer length longer than message */
+   invalid = request;
+   invalid[1]++;
+   EXPECT_EQ (handle (invalid, MAX_MESSAGE_SIZE), -1);
+
+   /* Value length longer than message. The NULL value is last. */
+   invalid = request;
+   invalid[invalid.size() - 1] = 1;
+   EXPECT_EQ (handle (invalid, MAX_MESSAGE_SIZE), -1);
+
+   /* Length fields of more than two octets are not supported */
+   invalid = request;
+   invalid.insert (invalid.begin() + 1, {0x83, 0x00, 0x00});
+   EXPECT_EQ (handle (invalid, MAX_MESSAGE_SIZE), -1);
+
+   /* Long form length is accepted */
+   invalid = request;
+   invalid.insert (invalid.begin() + 1, {0x82, 0x00});
+   EXPECT_GT (handle (invalid, MAX_MESSAGE_SIZE), 0);
+
+   /* Integers longer than four octets are dropped. The request ID is
+    * at offset 15, after version, community and PDU header. */
+   invalid = request;
+   ASSERT_EQ (invalid[15], TAG_INTEGER);
+   ASSERT_EQ (invalid[16], 1);
+   invalid.erase (invalid.begin() + 16, invalid.begin() + 18);
+   invalid.insert (invalid.begin() + 16, {5, 0, 0, 0, 0, 1});
+   invalid[1] += 4;
+   invalid[14] += 4;
+   EXPECT_EQ (handle (invalid, MAX_MESSAGE_SIZE), -1);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinOidOverflow)
+{
+   response_t response;
+   oid_t oid;
+   bytes_t encoded_oid;
+
+   /* Largest sub-identifier */
+   encoded_oid = {TAG_OID, 7, 0x2B, 6, 0x8F, 0xFF, 0xFF, 0xFF, 0x7F};
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GET,
+         1,
+         0,
+         0,
+         {ber_varbind (encoded_oid, ber_null())}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 1u);
+   EXPECT_EQ (response.varbinds[0].oid, oid_t ({1, 3, 6, UINT32_MAX}));
+   EXPECT_EQ (response.varbinds[0].type, TAG_NO_SUCH_OBJECT);
+
+   /* Sub-identifier does not fit 32 bits */
+   encoded_oid = {TAG_OID, 7, 0x2B, 6, 0x90, 0x80, 0x80, 0x80, 0x00};
+   EXPECT_EQ (
+      handle (
+         snmp_message (
+            VERSION_2C,
+            "public",
+            PDU_GET,
+            1,
+            0,
+            0,
+            {ber_varbind (encoded_oid, ber_null())}),
+         MAX_MESSAGE_SIZE),
+      -1);
+
+   /* Last sub-identifier is not terminated */
+   encoded_oid = {TAG_OID, 4, 0x2B, 6, 0x81, 0x81};
+   EXPECT_EQ (
+      handle (
+         snmp_message (
+            VERSION_2C,
+            "public",
+            PDU_GET,
+            1,
+            0,
+            0,
+            {ber_varbind (encoded_oid, ber_null())}),
+         MAX_MESSAGE_SIZE),
+      -1);
+
+   /* Longest OID */
+   oid = oid_zero;
+   oid.resize (MAX_OID_LEN, 1);
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 1u);
+   EXPECT_EQ (response.varbinds[0].oid, oid);
+
+   /* OID too long */
+   oid.push_back (1);
+   EXPECT_EQ (
+      handle (
+         snmp_message (
+            VERSION_2C,
+            "public",
+            PDU_GET,
+            1,
+            0,
+            0,
+            {ber_varbind (oid)}),
+         MAX_MESSAGE_SIZE),
+      -1);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinTooManyVarbinds)
+{
+   std::vector<bytes_t> varbinds (MAX_VARBINDS, ber_varbind (oid_sys_services));
+   response_t response;
+
+   ASSERT_TRUE (exchange (
+      snmp_message (VERSION_2C, "public", PDU_GET, 1, 0, 0, varbinds),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_ERROR);
+   EXPECT_EQ (response.varbinds.size(), (size_t)MAX_VARBINDS);
+
+   /* One varbind too many */
+   varbinds.push_back (ber_varbind (oid_sys_services));
+   ASSERT_TRUE (exchange (
+      snmp_message (VERSION_2C, "public", PDU_GET, 2, 0, 0, varbinds),
+      &response));
+   EXPECT_EQ (response.request_id, 2);
+   EXPECT_EQ (response.error_status, ERR_TOO_BIG);
+   EXPECT_EQ (response.error_index, 0);
+   EXPECT_EQ (response.varbinds.size(), 0u);
+
+   /* Same for SNMPv1 */
+   ASSERT_TRUE (exchange (
+      snmp_message (VERSION_1, "public", PDU_GETNEXT, 3, 0, 0, varbinds),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_TOO_BIG);
+   EXPECT_EQ (response.varbinds.size(), 0u);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinGetBulkTruncation)
+{
+   const bytes_t request = snmp_message (
+      VERSION_2C,
+      "public",
+      PDU_GETBULK,
+      1,
+      0,
+      MAX_VARBINDS,
+      {ber_varbind (oid_zero)});
+   response_t full;
+   response_t response;
+   size_t size;
+   size_t ix;
+   size_t previous_count;
+   bool is_too_big_seen = false;
+   int len;
+
+   ASSERT_TRUE (exchange (request, &full));
+   EXPECT_EQ (full.error_status, ERR_NO_ERROR);
+   ASSERT_GT (full.varbinds.size(), 1u);
+   previous_count = full.varbinds.size();
+
+   /* Smaller buffers give fewer varbinds, then tooBig, then nothing */
+   for (size = MAX_MESSAGE_SIZE; size > 0; size--)
+   {
+      len = handle (request, size);
+      if (len < 0)
+      {
+         EXPECT_TRUE (is_too_big_seen) << "Size " << size;
+         break;
+      }
+
+      ASSERT_LE ((size_t)len, size);
+      ASSERT_TRUE (snmp_decode (response_buffer, (size_t)len, &response));
+      if (response.error_status == ERR_TOO_BIG)
+      {
+         EXPECT_EQ (response.varbinds.size(), 0u);
+         is_too_big_seen = true;
+         continue;
+      }
+
+      EXPECT_FALSE (is_too_big_seen) << "Size " << size;
+      EXPECT_EQ (response.error_status, ERR_NO_ERROR);
+      ASSERT_GE (response.varbinds.size(), 1u);
+      EXPECT_LE (response.varbinds.size(), previous_count);
+      previous_count = response.varbinds.size();
+      for (ix = 0; ix < response.varbinds.size(); ix++)
+      {
+         EXPECT_EQ (response.varbinds[ix].oid, full.varbinds[ix].oid);
+      }
+   }
+   EXPECT_TRUE (is_too_big_seen);
+   EXPECT_GT (size, 0u);
+
+   /* Not supported by SNMPv1 */
+   EXPECT_EQ (
+      handle (
+         snmp_message (
+            VERSION_1,
+            "public",
+            PDU_GETBULK,
+            1,
+            0,
+            MAX_VARBINDS,
+            {ber_varbind (oid_zero)}),
+         MAX_MESSAGE_SIZE),
+      -1);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinGetBulkRepetitions)
+{
+   response_t response;
+   int32_t max_repetitions;
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GETBULK,
+         1,
+         1,
+         3,
+         {ber_varbind (oid_sys_descr), ber_varbind (oid_sys_contact)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 4u);
+   EXPECT_EQ (response.varbinds[0].oid, oid_sys_object_id);
+   EXPECT_EQ (response.varbinds[1].oid, oid_sys_name);
+   EXPECT_EQ (response.varbinds[2].oid, oid_sys_location);
+   EXPECT_EQ (response.varbinds[3].oid, oid_sys_services);
+
+   /* Zero or negative max-repetitions gives the non-repeaters only */
+   for (max_repetitions = 0; max_repetitions >= -2; max_repetitions--)
+   {
+      ASSERT_TRUE (exchange (
+         snmp_message (
+            VERSION_2C,
+            "public",
+            PDU_GETBULK,
+            1,
+            1,
+            max_repetitions,
+            {ber_varbind (oid_sys_descr), ber_varbind (oid_sys_contact)}),
+         &response));
+      EXPECT_EQ (response.error_status, ERR_NO_ERROR);
+      ASSERT_EQ (response.varbinds.size(), 1u);
+      EXPECT_EQ (response.varbinds[0].oid, oid_sys_object_id);
+   }
+
+   /* Largest negative value */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GETBULK,
+         1,
+         0,
+         INT32_MIN,
+         {ber_varbind (oid_sys_descr)}),
+      &response));
+   EXPECT_EQ (response.varbinds.size(), 0u);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinV1ErrorMapping)
+{
+   const std::string too_long (256, 'x');
+   response_t response;
+
+   /* Unknown object */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_1,
+         "public",
+         PDU_GET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_services), ber_varbind (oid_sys_unknown)}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_SUCH_NAME);
+   EXPECT_EQ (response.error_index, 2);
+   ASSERT_EQ (response.varbinds.size(), 2u);
+   EXPECT_EQ (response.varbinds[0].oid, oid_sys_services);
+   EXPECT_EQ (response.varbinds[0].type, TAG_NULL);
+   EXPECT_EQ (response.varbinds[1].oid, oid_sys_unknown);
+
+   /* End of MIB view */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_1,
+         "public",
+         PDU_GETNEXT,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_t ({2}))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_SUCH_NAME);
+   EXPECT_EQ (response.error_index, 1);
+
+   /* wrongType */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "private",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_name, ber_integer (1))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_WRONG_TYPE);
+   EXPECT_EQ (response.error_index, 1);
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_1,
+         "private",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_name, ber_integer (1))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_BAD_VALUE);
+   EXPECT_EQ (response.error_index, 1);
+
+   /* wrongLength */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "private",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_contact, ber_octets (too_long))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_WRONG_LENGTH);
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_1,
+         "private",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_contact, ber_octets (too_long))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_BAD_VALUE);
+
+   /* notWritable */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "private",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_descr, ber_octets ("x"))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NOT_WRITABLE);
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_1,
+         "private",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_descr, ber_octets ("x"))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_SUCH_NAME);
+
+   /* noAccess, when using the read-only community */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_name, ber_octets ("x"))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_ACCESS);
+   EXPECT_EQ (response.error_index, 1);
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_1,
+         "public",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_name, ber_octets ("x"))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_SUCH_NAME);
+   EXPECT_EQ (response.error_index, 1);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinConfiguredCommunities)
+{
+   response_t response;
+
+   snprintf (
+      net->fspm_cfg.pnal_cfg.snmp_read_community,
+      sizeof (net->fspm_cfg.pnal_cfg.snmp_read_community),
+      "reader");
+   snprintf (
+      net->fspm_cfg.pnal_cfg.snmp_write_community,
+      sizeof (net->fspm_cfg.pnal_cfg.snmp_write_community),
+      "writer");
+
+   /* The default communities are no longer accepted */
+   EXPECT_EQ (
+      handle (
+         snmp_message (
+            VERSION_2C,
+            "public",
+            PDU_GET,
+            1,
+            0,
+            0,
+            {ber_varbind (oid_sys_services)}),
+         MAX_MESSAGE_SIZE),
+      -1);
+   EXPECT_EQ (
+      handle (
+         snmp_message (
+            VERSION_2C,
+            "private",
+            PDU_SET,
+            1,
+            0,
+            0,
+            {ber_varbind (oid_sys_name, ber_octets ("x"))}),
+         MAX_MESSAGE_SIZE),
+      -1);
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "reader",
+         PDU_GET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_services)}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_ERROR);
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "reader",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_name, ber_octets ("x"))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_ACCESS);
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "writer",
+         PDU_SET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_descr, ber_octets ("x"))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NOT_WRITABLE);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinSetValidateThenCommit)
+{
+   response_t response;
+   std::string original_contact;
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GET,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_sys_contact)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 1u);
+   original_contact = value_as_string (response.varbinds[0]);
+   ASSERT_NE (original_contact, "New contact");
+
+   /* Second varbind is invalid, so nothing is written */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "private",
+         PDU_SET,
+         2,
+         0,
+         0,
+         {ber_varbind (oid_sys_contact, ber_octets ("New contact")),
+          ber_varbind (oid_sys_location, ber_integer (1))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_WRONG_TYPE);
+   EXPECT_EQ (response.error_index, 2);
+   ASSERT_EQ (response.varbinds.size(), 2u);
+   EXPECT_EQ (value_as_string (response.varbinds[0]), "New contact");
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GET,
+         3,
+         0,
+         0,
+         {ber_varbind (oid_sys_contact)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 1u);
+   EXPECT_EQ (value_as_string (response.varbinds[0]), original_contact);
+
+   /* All varbinds valid */
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "private",
+         PDU_SET,
+         4,
+         0,
+         0,
+         {ber_varbind (oid_sys_contact, ber_octets ("New contact")),
+          ber_varbind (oid_sys_location, ber_octets ("New location"))}),
+      &response));
+   EXPECT_EQ (response.error_status, ERR_NO_ERROR);
+   EXPECT_EQ (response.error_index, 0);
+   ASSERT_EQ (response.varbinds.size(), 2u);
+   EXPECT_EQ (response.varbinds[0].oid, oid_sys_contact);
+   EXPECT_EQ (response.varbinds[1].oid, oid_sys_location);
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GET,
+         5,
+         0,
+         0,
+         {ber_varbind (oid_sys_contact), ber_varbind (oid_sys_location)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 2u);
+   EXPECT_EQ (value_as_string (response.varbinds[0]), "New contact");
+   EXPECT_EQ (value_as_string (response.varbinds[1]), "New location");
+}
+
+/* Walk through all objects. Also verifies that the column table is sorted,
+ * as each returned instance must be found again by Get. */
+TEST_F (SnmpBuiltinTest, SnmpBuiltinGetNextWalk)
+{
+   const size_t n_ports = pnet_default_cfg.num_physical_ports;
+   /* Scalars and lldpLocManAddrTable, local port tables and the remote
+    * tables with one peer */
+   const size_t expected_count = (1 + 2 + 3 + 7) + 11 * n_ports + 15;
+   response_t response;
+   response_t get_response;
+   oid_t oid = oid_zero;
+   size_t count = 0;
+
+   for (;;)
+   {
+      ASSERT_TRUE (exchange (
+         snmp_message (
+            VERSION_2C,
+            "public",
+            PDU_GETNEXT,
+            1,
+            0,
+            0,
+            {ber_varbind (oid)}),
+         &response));
+      ASSERT_EQ (response.error_status, ERR_NO_ERROR);
+      ASSERT_EQ (response.varbinds.size(), 1u);
+      if (response.varbinds[0].type == TAG_END_OF_MIB)
+      {
+         EXPECT_EQ (response.varbinds[0].oid, oid);
+         break;
+      }
+
+      EXPECT_TRUE (oid_is_less (oid, response.varbinds[0].oid));
+      oid = response.varbinds[0].oid;
+      count++;
+      ASSERT_LE (count, expected_count);
+
+      ASSERT_TRUE (exchange (
+         snmp_message (
+            VERSION_2C,
+            "public",
+            PDU_GET,
+            1,
+            0,
+            0,
+            {ber_varbind (oid)}),
+         &get_response));
+      ASSERT_EQ (get_response.varbinds.size(), 1u);
+      EXPECT_EQ (get_response.varbinds[0].type, response.varbinds[0].type);
+   }
+
+   EXPECT_EQ (count, expected_count);
+
+   /* Remote rows disappear with the peer */
+   pf_lldp_invalidate_peer_info (net, LOCAL_PORT);
+   oid = oid_zero;
+   count = 0;
+   for (;;)
+   {
+      ASSERT_TRUE (exchange (
+         snmp_message (
+            VERSION_2C,
+            "public",
+            PDU_GETNEXT,
+            1,
+            0,
+            0,
+            {ber_varbind (oid)}),
+         &response));
+      ASSERT_EQ (response.varbinds.size(), 1u);
+      if (response.varbinds[0].type == TAG_END_OF_MIB)
+      {
+         break;
+      }
+      oid = response.varbinds[0].oid;
+      count++;
+      ASSERT_LE (count, expected_count);
+   }
+   EXPECT_EQ (count, expected_count - 15);
+}
+
+TEST_F (SnmpBuiltinTest, SnmpBuiltinRowsCachedUntilChanged)
+{
+   pf_port_t * p_port = pf_port_get_state (net, LOCAL_PORT);
+   pf_lldp_peer_snapshot_t snapshot;
+   response_t response;
+   oid_t first_row_oid;
+   oid_t expected_oid;
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GETNEXT,
+         1,
+         0,
+         0,
+         {ber_varbind (oid_rem_chassis_id_subtype)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 1u);
+   first_row_oid = response.varbinds[0].oid;
+   expected_oid = oid_rem_chassis_id_subtype;
+   expected_oid.push_back (p_port->lldp.timestamp_for_last_peer_change);
+   expected_oid.push_back (LOCAL_PORT);
+   expected_oid.push_back (LOCAL_PORT);
+   EXPECT_EQ (first_row_oid, expected_oid);
+
+   /* Not seen without a change of the generation counter */
+   p_port->lldp.timestamp_for_last_peer_change += 100;
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GETNEXT,
+         2,
+         0,
+         0,
+         {ber_varbind (oid_rem_chassis_id_subtype)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 1u);
+   EXPECT_EQ (response.varbinds[0].oid, first_row_oid);
+
+   /* New peer information gives the row a new index */
+   mock_os_data.system_uptime_10ms += 500;
+   pf_lldp_get_peer_snapshot (net, LOCAL_PORT, &snapshot);
+   pf_lldp_store_peer_info (net, LOCAL_PORT, &snapshot.info);
+   expected_oid = oid_rem_chassis_id_subtype;
+   expected_oid.push_back (mock_os_data.system_uptime_10ms);
+   expected_oid.push_back (LOCAL_PORT);
+   expected_oid.push_back (LOCAL_PORT);
+   ASSERT_NE (expected_oid, first_row_oid);
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GETNEXT,
+         3,
+         0,
+         0,
+         {ber_varbind (oid_rem_chassis_id_subtype)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 1u);
+   EXPECT_EQ (response.varbinds[0].oid, expected_oid);
+
+   ASSERT_TRUE (exchange (
+      snmp_message (
+         VERSION_2C,
+         "public",
+         PDU_GET,
+         4,
+         0,
+         0,
+         {ber_varbind (first_row_oid), ber_varbind (expected_oid)}),
+      &response));
+   ASSERT_EQ (response.varbinds.size(), 2u);
+   EXPECT_EQ (response.varbinds[0].type, TAG_NO_SUCH_INSTANCE);
+   EXPECT_EQ (response.varbinds[1].type, TAG_INTEGER);
+}
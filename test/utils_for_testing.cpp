@@ -112,6 +112,10 @@ int my_read_ind (
       idx,
       sequence_number);
    p_appdata->call_counters.read_calls++;
+   if (p_appdata->defer_read_rsp)
+   {
+      return PNET_RECORD_RSP_PENDING;
+   }
    return 0;
 }
 
@@ -124,6 +124,7 @@ typedef struct app_data_for_testing_obj
       available_submodule_types[TEST_MAX_NUMBER_AVAILABLE_SUBMODULE_TYPES];
    bool init_done;
    uint16_t read_fails;
+   bool defer_read_rsp;
    call_counters_t call_counters;
    pf_scheduler_handle_t scheduler_handle_a;
    pf_scheduler_handle_t scheduler_handle_b;
@@ -271,6 +272,11 @@ class PnetIntegrationTestBase : public ::testing::Test
     * @param len            In: Length of data packet
     */
    virtual void send_data (uint8_t * data_packet, uint16_t len);
+
+   virtual void TearDown() override
+   {
+      pnet_free_pools (net);
+   };
 };
 
 class PnetIntegrationTest : public PnetIntegrationTestBase